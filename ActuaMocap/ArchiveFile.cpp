@@ -0,0 +1,89 @@
+#include "ArchiveFile.h"
+#include <fstream>
+#include <iostream>
+#include "MappedFile.h"
+
+static i32 ReadLittleEndianI32(const u8* bytes) {
+	// .OFF files were written on a little endian PC, read them the same way on any host
+	return (i32)((u32)bytes[0] | ((u32)bytes[1] << 8) | ((u32)bytes[2] << 16) | ((u32)bytes[3] << 24));
+}
+
+ArchiveFile::~ArchiveFile()
+{
+}
+
+ArchiveFile::ArchiveFile()
+{
+}
+
+bool ArchiveFile::Open(std::string offsetFilePath, std::string dataFile)
+{
+	_offsets.clear();
+	auto mapped = std::make_shared<MappedFile>();
+	if (!mapped->Open(dataFile)) {
+		std::cout << "Failed to map archive " << dataFile << "\n";
+		_data.reset();
+		return false;
+	}
+	_data = mapped;
+	_loadedDataFile = dataFile;
+	_loadedOffsetFilePath = offsetFilePath;
+	return LoadOffsets(offsetFilePath);
+}
+
+bool ArchiveFile::LoadOffsets(std::string offsetFilePath)
+{
+	std::ifstream is(offsetFilePath, std::ifstream::binary);
+	if (!is) {
+		std::cout << "Failed to open offsets file " << offsetFilePath << "\n";
+		return false;
+	}
+	std::vector<u8> bytes((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+	if (bytes.size() % sizeof(FileOffset) != 0) {
+		std::cout << offsetFilePath << " has " << bytes.size() % sizeof(FileOffset) << " trailing bytes, ignoring them\n";
+	}
+
+	size_t numOffsets = bytes.size() / sizeof(FileOffset);
+	size_t dataSize = _data->GetSize();
+	_offsets.resize(numOffsets);
+	for (size_t i = 0; i < numOffsets; i++) {
+		FileOffset& entry = _offsets[i];
+		entry.offset = ReadLittleEndianI32(&bytes[i * sizeof(FileOffset)]);
+		entry.size = ReadLittleEndianI32(&bytes[i * sizeof(FileOffset) + 4]);
+		if (entry.offset < 0 || entry.size < 0 || (size_t)entry.offset > dataSize || (size_t)entry.size > dataSize - entry.offset) {
+			std::cout << offsetFilePath << " entry " << i << " points outside the data file\n";
+			entry.offset = 0;
+			entry.size = -1; // marks the entry unusable
+		}
+	}
+	return true;
+}
+
+bool ArchiveFile::GetResourceRange(size_t index, size_t& offsetOut, size_t& sizeOut) const
+{
+	if (index >= _offsets.size() || _offsets[index].size < 0) {
+		return false;
+	}
+	offsetOut = _offsets[index].offset;
+	sizeOut = _offsets[index].size;
+	return true;
+}
+
+bool ArchiveFile::GetResourceFile(size_t index, ResourceFile& out) const
+{
+	size_t offset, size;
+	if (!GetResourceRange(index, offset, size)) {
+		return false;
+	}
+	out.data = _data->GetData() + offset;
+	out.size = size;
+	return true;
+}
+
+bool ArchiveFile::GetResourceFileFromOffset(size_t offset, ResourceFile& out) const
+{
+	if (offset % sizeof(FileOffset) != 0) {
+		return false;
+	}
+	return GetResourceFile(offset / sizeof(FileOffset), out);
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include "BasicTypedefs.h"
+
+class MappedFile;
+
+// one entry of a .OFF file - where a resource lives in the matching .DAT
+struct FileOffset { i32 offset, size; };
+struct ResourceFile {
+	const u8* data;
+	size_t size;
+};
+
+/// <summary>
+/// a Gremlin .DAT/.OFF archive pair. the .DAT is mapped read only and resources are handed
+/// out as slices of it, the .OFF is parsed into a bounds checked index.
+/// </summary>
+class ArchiveFile
+{
+public:
+	~ArchiveFile();
+	ArchiveFile();
+	bool Open(std::string offsetFilePath, std::string dataFile);
+	inline size_t GetNumResources() const {
+		return _offsets.size();
+	}
+	bool GetResourceFile(size_t index, ResourceFile& out) const;
+	/// <summary>
+	/// offset is a byte offset into the .OFF file, as in the BIN_ defines in Euro.h
+	/// </summary>
+	bool GetResourceFileFromOffset(size_t offset, ResourceFile& out) const;
+	bool GetResourceRange(size_t index, size_t& offsetOut, size_t& sizeOut) const;
+	inline const std::shared_ptr<const MappedFile>& GetMappedData() const {
+		return _data;
+	}
+	inline const std::string& GetDataFilePath() const {
+		return _loadedDataFile;
+	}
+private:
+	bool LoadOffsets(std::string offsetFilePath);
+private:
+	std::vector<FileOffset> _offsets;
+	std::shared_ptr<const MappedFile> _data;
+	std::string _loadedOffsetFilePath;
+	std::string _loadedDataFile;
+
+};
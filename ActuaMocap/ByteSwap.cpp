@@ -0,0 +1,123 @@
+#include "ByteSwap.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MOCAP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MOCAP_TARGET_AVX2
+#else
+#define MOCAP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static inline u32 SwapWord(u32 w) {
+	return (w >> 24) | ((w >> 8) & 0x0000ff00) | ((w << 8) & 0x00ff0000) | (w << 24);
+}
+
+void ByteSwap32Scalar(const void* src, void* dst, size_t count)
+{
+	const u8* in = (const u8*)src;
+	u8* out = (u8*)dst;
+	for (size_t i = 0; i < count; i++) {
+		u32 w;
+		memcpy(&w, in + i * 4, 4); // memcpy so unaligned / aliased buffers are fine
+		w = SwapWord(w);
+		memcpy(out + i * 4, &w, 4);
+	}
+}
+
+#ifdef MOCAP_X86
+
+void ByteSwap32SSE2(const void* src, void* dst, size_t count)
+{
+	// SSE2 has no byte shuffle, so swap the 16 bit halves of each word
+	// and then the bytes within each half with shifts
+	const u8* in = (const u8*)src;
+	u8* out = (u8*)dst;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i * 4));
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i*)(out + i * 4), v);
+	}
+	ByteSwap32Scalar(in + i * 4, out + i * 4, count - i);
+}
+
+MOCAP_TARGET_AVX2 void ByteSwap32AVX2(const void* src, void* dst, size_t count)
+{
+	const u8* in = (const u8*)src;
+	u8* out = (u8*)dst;
+	const __m256i mask = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+	);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(in + i * 4));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(in + i * 4 + 32));
+		_mm256_storeu_si256((__m256i*)(out + i * 4), _mm256_shuffle_epi8(a, mask));
+		_mm256_storeu_si256((__m256i*)(out + i * 4 + 32), _mm256_shuffle_epi8(b, mask));
+	}
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*)(in + i * 4));
+		_mm256_storeu_si256((__m256i*)(out + i * 4), _mm256_shuffle_epi8(a, mask));
+	}
+	ByteSwap32SSE2(in + i * 4, out + i * 4, count - i);
+}
+
+bool CpuSupportsAVX2()
+{
+	static const bool supported = []() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}();
+	return supported;
+}
+
+#else
+
+void ByteSwap32SSE2(const void* src, void* dst, size_t count)
+{
+	ByteSwap32Scalar(src, dst, count);
+}
+
+void ByteSwap32AVX2(const void* src, void* dst, size_t count)
+{
+	ByteSwap32Scalar(src, dst, count);
+}
+
+bool CpuSupportsAVX2()
+{
+	return false;
+}
+
+#endif
+
+void ByteSwap32(const void* src, void* dst, size_t count)
+{
+	if (CpuSupportsAVX2()) {
+		ByteSwap32AVX2(src, dst, count);
+	}
+	else {
+		ByteSwap32SSE2(src, dst, count);
+	}
+}
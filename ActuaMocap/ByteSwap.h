@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>
+#include "BasicTypedefs.h"
+
+/// <summary>
+/// copy count 32 bit words from src to dst, reversing the byte order of each word.
+/// picks the widest kernel the cpu supports (AVX2, then SSE2, then scalar).
+/// src and dst don't need to be aligned and may be the same buffer.
+/// </summary>
+void ByteSwap32(const void* src, void* dst, size_t count);
+
+// the individual kernels, exposed so the benchmarks can compare them
+void ByteSwap32Scalar(const void* src, void* dst, size_t count);
+void ByteSwap32SSE2(const void* src, void* dst, size_t count);
+void ByteSwap32AVX2(const void* src, void* dst, size_t count);
+
+bool CpuSupportsAVX2();
@@ -0,0 +1,297 @@
+#include "ComapzFormat.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COMAPZ_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static_assert(ComapzChannels % 4 == 0, "the SSE2 decoder works on whole vectors of 4 channels");
+
+#define ComapzMaxQuantised 65535
+
+static void PutU32(std::vector<u8>& out, u32 v) {
+	for (int i = 0; i < 4; i++) {
+		out.push_back((u8)(v >> (i * 8)));
+	}
+}
+
+static void PutF32(std::vector<u8>& out, float f) {
+	u32 v;
+	memcpy(&v, &f, 4);
+	PutU32(out, v);
+}
+
+static u32 GetU32(const u8* p) {
+	return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static float GetF32(const u8* p) {
+	u32 v = GetU32(p);
+	float f;
+	memcpy(&f, &v, 4);
+	return f;
+}
+
+static inline u32 ZigZag(i32 v) {
+	return ((u32)v << 1) ^ (u32)(v >> 31);
+}
+
+static inline i32 UnZigZag(u32 z) {
+	return (i32)(z >> 1) ^ -(i32)(z & 1);
+}
+
+static inline u32 BitsNeeded(u32 v) {
+	u32 bits = 0;
+	while (v) {
+		bits++;
+		v >>= 1;
+	}
+	return bits;
+}
+
+class BitWriter {
+public:
+	BitWriter(std::vector<u8>& out) : _out(out) {}
+	void Write(u32 value, u32 bits) {
+		if (bits == 0) {
+			return;
+		}
+		_acc |= (u64)value << _count;
+		_count += bits;
+		while (_count >= 8) {
+			_out.push_back((u8)_acc);
+			_acc >>= 8;
+			_count -= 8;
+		}
+	}
+	void Flush() {
+		if (_count > 0) {
+			_out.push_back((u8)_acc);
+		}
+		_acc = 0;
+		_count = 0;
+	}
+private:
+	std::vector<u8>& _out;
+	u64 _acc = 0;
+	u32 _count = 0;
+};
+
+class BitReader {
+public:
+	BitReader(const u8* data, const u8* end) : _data(data), _end(end) {}
+	u32 Read(u32 bits) {
+		if (bits == 0) {
+			return 0;
+		}
+		if (_count < bits) {
+			Refill();
+		}
+		u32 v = (u32)(_acc & ((1ull << bits) - 1));
+		_acc >>= bits;
+		_count -= bits;
+		return v;
+	}
+	// drop the rest of the current byte, blocks start byte aligned
+	const u8* Align() {
+		_data -= _count / 8; // hand back whole bytes loaded ahead but not read
+		_acc = 0;
+		_count = 0;
+		return _data;
+	}
+	inline bool Overran() const {
+		return _data > _end;
+	}
+private:
+	void Refill() {
+		if (_end - _data >= 8) {
+			// top up to at least 56 bits with one unaligned load
+			u64 word;
+			memcpy(&word, _data, 8);
+			_acc |= word << _count;
+			u32 bytes = (63 - _count) / 8;
+			_data += bytes;
+			_count += bytes * 8;
+			return;
+		}
+		while (_count <= 56) {
+			u64 byte = _data < _end ? *_data : 0;
+			_data++;
+			_acc |= byte << _count;
+			_count += 8;
+		}
+	}
+private:
+	const u8* _data;
+	const u8* _end;
+	u64 _acc = 0;
+	u32 _count = 0;
+};
+
+bool IsComapz(const u8* data, size_t size)
+{
+	return size >= ComapzHeaderSize && memcmp(data, ComapzMagic, 4) == 0;
+}
+
+bool ReadComapzInfo(const u8* data, size_t size, ComapzInfo& out)
+{
+	if (!IsComapz(data, size) || GetU32(data + 4) != ComapzVersion || GetU32(data + 12) != ComapzBlockFrames) {
+		return false;
+	}
+	out.numFrames = GetU32(data + 8);
+	out.tolerance = GetF32(data + 16);
+	out.maxError = 0;
+	for (int c = 0; c < ComapzChannels; c++) {
+		out.maxError = std::max(out.maxError, GetF32(data + 20 + ComapzChannels * 4 + c * 4) * 0.5f);
+	}
+	return true;
+}
+
+size_t ComapzMaxFrames(size_t size)
+{
+	if (size < ComapzHeaderSize) {
+		return 0;
+	}
+	return (size - ComapzHeaderSize) / ComapzChannels * ComapzBlockFrames;
+}
+
+void EncodeComapz(const MocapFrame* frames, size_t numFrames, float tolerance, std::vector<u8>& out)
+{
+	const float* values = numFrames > 0 ? &frames[0].points[0].x : nullptr;
+	float channelMin[ComapzChannels];
+	float channelStep[ComapzChannels];
+	for (int c = 0; c < ComapzChannels; c++) {
+		float lo = INFINITY, hi = -INFINITY;
+		for (size_t f = 0; f < numFrames; f++) {
+			lo = std::min(lo, values[f * ComapzChannels + c]);
+			hi = std::max(hi, values[f * ComapzChannels + c]);
+		}
+		if (numFrames == 0) {
+			lo = hi = 0;
+		}
+		channelMin[c] = lo;
+		channelStep[c] = std::max((hi - lo) / ComapzMaxQuantised, 2.0f * tolerance);
+		if (channelStep[c] <= 0) {
+			channelStep[c] = 1.0f;
+		}
+	}
+
+	out.clear();
+	out.insert(out.end(), ComapzMagic, ComapzMagic + 4);
+	PutU32(out, ComapzVersion);
+	PutU32(out, (u32)numFrames);
+	PutU32(out, ComapzBlockFrames);
+	PutF32(out, tolerance);
+	for (int c = 0; c < ComapzChannels; c++) {
+		PutF32(out, channelMin[c]);
+	}
+	for (int c = 0; c < ComapzChannels; c++) {
+		PutF32(out, channelStep[c]);
+	}
+
+	// quantise then predict exactly as the decoder will
+	std::vector<i32> residuals(numFrames * ComapzChannels);
+	for (int c = 0; c < ComapzChannels; c++) {
+		i32 q0 = 0, q1 = 0;
+		for (size_t f = 0; f < numFrames; f++) {
+			float v = (values[f * ComapzChannels + c] - channelMin[c]) / channelStep[c];
+			i32 q = std::min(std::max((i32)lroundf(v), 0), ComapzMaxQuantised);
+			residuals[f * ComapzChannels + c] = q - (2 * q1 - q0);
+			q0 = f == 0 ? q : q1;
+			q1 = q;
+		}
+	}
+
+	BitWriter writer(out);
+	for (size_t block = 0; block < numFrames; block += ComapzBlockFrames) {
+		size_t blockEnd = std::min(numFrames, block + ComapzBlockFrames);
+		u8 bits[ComapzChannels];
+		for (int c = 0; c < ComapzChannels; c++) {
+			u32 largest = 0;
+			for (size_t f = block; f < blockEnd; f++) {
+				largest = std::max(largest, ZigZag(residuals[f * ComapzChannels + c]));
+			}
+			bits[c] = (u8)BitsNeeded(largest);
+		}
+		out.insert(out.end(), bits, bits + ComapzChannels);
+		for (int c = 0; c < ComapzChannels; c++) {
+			for (size_t f = block; f < blockEnd; f++) {
+				writer.Write(ZigZag(residuals[f * ComapzChannels + c]), bits[c]);
+			}
+		}
+		writer.Flush();
+	}
+}
+
+bool DecodeComapz(const u8* data, size_t size, MocapFrame* out)
+{
+	ComapzInfo info;
+	if (!ReadComapzInfo(data, size, info)) {
+		return false;
+	}
+	alignas(16) float channelMin[ComapzChannels];
+	alignas(16) float channelStep[ComapzChannels];
+	for (int c = 0; c < ComapzChannels; c++) {
+		channelMin[c] = GetF32(data + 20 + c * 4);
+		channelStep[c] = GetF32(data + 20 + ComapzChannels * 4 + c * 4);
+	}
+
+	alignas(16) i32 q0[ComapzChannels] = {};
+	alignas(16) i32 q1[ComapzChannels] = {};
+	alignas(16) i32 residuals[ComapzBlockFrames][ComapzChannels];
+	const u8* p = data + ComapzHeaderSize;
+	const u8* end = data + size;
+	size_t numFrames = info.numFrames;
+	for (size_t block = 0; block < numFrames; block += ComapzBlockFrames) {
+		size_t blockFrames = std::min((size_t)ComapzBlockFrames, numFrames - block);
+		if ((size_t)(end - p) < ComapzChannels) {
+			return false;
+		}
+		const u8* bits = p;
+		for (int c = 0; c < ComapzChannels; c++) {
+			// residuals of 16 bit values never need more, and wider reads aren't defined
+			if (bits[c] > 32) {
+				return false;
+			}
+		}
+		BitReader reader(p + ComapzChannels, end);
+		// bit unpacking is serial, gather the block's residuals frame major so the
+		// reconstruction below runs across channels
+		for (int c = 0; c < ComapzChannels; c++) {
+			for (size_t f = 0; f < blockFrames; f++) {
+				residuals[f][c] = UnZigZag(reader.Read(bits[c]));
+			}
+		}
+		p = reader.Align();
+		if (reader.Overran()) {
+			return false;
+		}
+
+		for (size_t f = 0; f < blockFrames; f++) {
+			float* dst = &out[block + f].points[0].x;
+#ifdef COMAPZ_SSE2
+			for (int c = 0; c < ComapzChannels; c += 4) {
+				__m128i a = _mm_load_si128((const __m128i*)&q0[c]);
+				__m128i b = _mm_load_si128((const __m128i*)&q1[c]);
+				__m128i r = _mm_load_si128((const __m128i*)&residuals[f][c]);
+				__m128i q = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(b, 1), a), r);
+				_mm_store_si128((__m128i*)&q0[c], block + f == 0 ? q : b);
+				_mm_store_si128((__m128i*)&q1[c], q);
+				__m128 v = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(q), _mm_load_ps(&channelStep[c])), _mm_load_ps(&channelMin[c]));
+				_mm_storeu_ps(dst + c, v);
+			}
+#else
+			for (int c = 0; c < ComapzChannels; c++) {
+				i32 q = 2 * q1[c] - q0[c] + residuals[f][c];
+				q0[c] = block + f == 0 ? q : q1[c];
+				q1[c] = q;
+				dst[c] = channelMin[c] + (float)q * channelStep[c];
+			}
+#endif
+		}
+	}
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+#include <stddef.h>
+#include "MocapFrame.h"
+#include "BasicTypedefs.h"
+
+/*
+	.comapz - packed native clip format
+
+	little endian throughout.
+	header:
+		char magic[4]              "CMPZ"
+		u32  version
+		u32  numFrames
+		u32  blockFrames           frames per block, ComapzBlockFrames
+		f32  tolerance             error asked for when the clip was packed
+		f32  channelMin[84]        per channel (point * 3 + axis) minimum
+		f32  channelStep[84]       quantisation step, value = min + q * step, max error step / 2
+	then for each block of blockFrames frames (the last may be short):
+		u8   bits[84]              bit width of each channel's residuals in this block
+		     residuals             for each channel, one zig-zag residual per frame packed at bits[channel],
+		                           padded to a whole byte at the end of the block
+
+	q is a 16 bit integer per channel. residuals are the error of a linear prediction from the
+	previous two frames (the first frame predicts 0, the second repeats the first).
+*/
+
+#define ComapzMagic "CMPZ"
+#define ComapzVersion 1
+#define ComapzBlockFrames 16
+#define ComapzChannels (PlayerPoints * 3)
+#define ComapzHeaderSize (4 + 4 + 4 + 4 + 4 + ComapzChannels * 4 * 2)
+
+struct ComapzInfo {
+	u32 numFrames;
+	float tolerance;
+	float maxError; // largest step / 2 across all channels - can exceed tolerance where a channel's range needed coarser steps to fit 16 bits
+};
+
+bool IsComapz(const u8* data, size_t size);
+bool ReadComapzInfo(const u8* data, size_t size, ComapzInfo& out);
+// the most frames a whole .comapz of size bytes can hold, each block takes at least its bit widths
+size_t ComapzMaxFrames(size_t size);
+
+/// <summary>
+/// pack frames, each position is reproduced to within tolerance unless its channel's range is
+/// more than 65535 * 2 * tolerance, in which case the step grows to fit 16 bits (see ComapzInfo::maxError)
+/// </summary>
+void EncodeComapz(const MocapFrame* frames, size_t numFrames, float tolerance, std::vector<u8>& out);
+
+/// <summary>
+/// unpack a whole .comapz into out (numFrames from ReadComapzInfo frames long)
+/// </summary>
+bool DecodeComapz(const u8* data, size_t size, MocapFrame* out);
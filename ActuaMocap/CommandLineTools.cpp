@@ -0,0 +1,395 @@
+#include "CommandLineTools.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <fstream>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+#include "Config.h"
+#include "IFilesystem.h"
+#include "MocapBenchmarks.h"
+#include "MocapFile.h"
+#include "MocapFileWriter.h"
+#include "ArchiveFile.h"
+#include "ComapzFormat.h"
+#include "MocapResampler.h"
+#include "MocapLibrary.h"
+#include "MocapMotionGraph.h"
+#include "MocapClipSoA.h"
+#include "MocapTimeWarp.h"
+#include "MocapKeyClip.h"
+#include "ThreadPool.h"
+
+struct CommandLineTool {
+	std::string name;
+	std::string usage;
+	int minArgs; // number of arguments after the tool name
+	std::function<int(const std::vector<std::string>&, const Config&, IFilesystem*)> run;
+};
+
+// write every entry of an archive that's a clip out as its own clip file. the entries are read as one batch of
+// ranged reads rather than through the archive's mapping, so a cold archive is read with many requests in flight
+static int ExtractArchive(const std::string& datPath, const std::string& outFolder, bool reverseEndianness, IFilesystem* fileSystem) {
+	ArchiveFile archive;
+	std::string offsetsPath = datPath.substr(0, datPath.size() - 4) + ".OFF";
+	if (!FileHasExtension(datPath, ".DAT") || !archive.Open(offsetsPath, datPath)) {
+		std::cout << "couldn't open " << datPath << " with " << offsetsPath << "\n";
+		return -1;
+	}
+	size_t slash = datPath.find_last_of("\\/");
+	std::string baseName = datPath.substr(slash == std::string::npos ? 0 : slash + 1);
+	baseName = baseName.substr(0, baseName.size() - 4);
+
+	std::vector<FileRead> reads;
+	std::vector<size_t> entries;
+	for (size_t i = 0; i < archive.GetNumResources(); i++) {
+		size_t offset, size;
+		if (!archive.GetResourceRange(i, offset, size)) {
+			continue;
+		}
+		FileRead read;
+		read.path = datPath;
+		read.offset = offset;
+		read.length = size;
+		reads.push_back(read);
+		entries.push_back(i);
+	}
+	std::atomic<size_t> written(0);
+	std::vector<char> notClips(reads.size(), 0);
+	fileSystem->ReadFiles(reads, [&](size_t i) {
+		const FileRead& read = reads[i];
+		if (!read.ok) {
+			return;
+		}
+		if (!MocapFile::IsClipBuffer(read.data.data(), read.data.size(), reverseEndianness)) {
+			notClips[i] = 1;
+			return;
+		}
+		std::string extension = IsComapz(read.data.data(), read.data.size()) ? ".comapz" : IsComapk(read.data.data(), read.data.size()) ? ".comapk" : ".comap";
+		std::string outPath = JoinPath(outFolder, baseName + "_" + std::to_string(entries[i]) + extension);
+		std::ofstream out(outPath, std::ofstream::binary | std::ofstream::trunc);
+		out.write((const char*)read.data.data(), read.data.size());
+		if (out) {
+			written++;
+		}
+	});
+	size_t skipped = 0;
+	for (size_t i = 0; i < reads.size(); i++) {
+		if (notClips[i]) {
+			std::cout << "skipped entry " << entries[i] << ", " << reads[i].length << " bytes, it isn't a clip\n";
+			skipped++;
+		}
+	}
+	std::cout << "extracted " << written << " of " << archive.GetNumResources() << " entries to " << outFolder << ", " << skipped << " weren't clips\n";
+	return written + skipped == reads.size() ? 0 : -1;
+}
+
+// line clipName up against otherName with dynamic time warping and print where each frame lands and how far off it is,
+// or with no otherName against every clip in the library, best first
+static int AlignClips(const std::string& clipName, const std::string& otherName, size_t band, const Config& config, IFilesystem* fileSystem) {
+	MocapLibrary library(config.ReverseFileEndianness);
+	if (!library.Load(config.MocapFilesFolder, fileSystem)) {
+		std::cout << "couldn't load the library in " << config.MocapFilesFolder << "\n";
+		return -1;
+	}
+	const MocapClipEntry* entry = library.FindClip(clipName);
+	const MocapClipEntry* otherEntry = otherName.empty() ? nullptr : library.FindClip(otherName);
+	if (entry == nullptr || entry->numFrames == 0 || (!otherName.empty() && (otherEntry == nullptr || otherEntry->numFrames == 0))) {
+		std::cout << "no frames for " << (entry == nullptr || entry->numFrames == 0 ? clipName : otherName) << " in " << config.MocapFilesFolder << "\n";
+		return -1;
+	}
+	auto buildClip = [&library](const MocapClipEntry& clipEntry, TimeWarpClip& out) {
+		MocapClipSoA poses;
+		poses.Build(library.GetFrames() + clipEntry.firstFrame, clipEntry.numFrames);
+		out.Build(poses);
+	};
+	TimeWarpClip clip;
+	buildClip(*entry, clip);
+
+	if (otherEntry != nullptr) {
+		TimeWarpClip other;
+		buildClip(*otherEntry, other);
+		TimeWarpAligner aligner;
+		TimeWarpAlignment alignment;
+		aligner.Align(clip, other, band, alignment);
+		std::cout << clipName << " (" << clip.GetNumFrames() << " frames) against " << otherName << " (" << other.GetNumFrames()
+			<< " frames): mean distance " << alignment.cost << " over " << alignment.path.size() << " steps\n";
+		std::cout << "frame\tmatched\tdeviation\n";
+		size_t step = 0;
+		for (size_t f = 0; f < clip.GetNumFrames(); f++) {
+			u32 first = alignment.path[step].b;
+			while (step + 1 < alignment.path.size() && alignment.path[step + 1].a == f) {
+				step++;
+			}
+			u32 last = alignment.path[step].b;
+			std::cout << f << "\t" << first;
+			if (last != first) {
+				std::cout << "-" << last;
+			}
+			std::cout << "\t" << alignment.deviation[f] << "\n";
+			step++;
+		}
+		return 0;
+	}
+
+	const std::vector<MocapClipEntry>& entries = library.GetClips();
+	std::vector<TimeWarpClip> others(entries.size());
+	GetThreadPool().ParallelFor(entries.size(), [&](size_t i) {
+		buildClip(entries[i], others[i]);
+	});
+	std::vector<const TimeWarpClip*> pointers;
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (&entries[i] != entry && entries[i].numFrames > 0) {
+			pointers.push_back(&others[i]);
+			indices.push_back(i);
+		}
+	}
+	std::vector<TimeWarpAlignment> alignments;
+	auto start = std::chrono::high_resolution_clock::now();
+	AlignAgainstClips(clip, pointers, band, alignments);
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	std::vector<size_t> order(alignments.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&alignments](size_t a, size_t b) {
+		return alignments[a].cost < alignments[b].cost;
+	});
+	std::cout << clipName << " aligned against " << alignments.size() << " clips in " << seconds * 1000.0 << " ms on "
+		<< GetThreadPool().GetNumThreads() << " threads, closest first:\n";
+	for (size_t i = 0; i < order.size() && i < 20; i++) {
+		const TimeWarpAlignment& alignment = alignments[order[i]];
+		const std::string& name = entries[indices[order[i]]].name;
+		std::cout << "  " << name << "\t" << alignment.cost << "\tworst frame " << (std::max_element(alignment.deviation.begin(), alignment.deviation.end()) - alignment.deviation.begin()) << "\n";
+	}
+	return 0;
+}
+
+// reduce every clip in the library to keys within tolerance and write each as a .comapk in outFolder
+static int ReduceLibrary(const std::string& outFolder, float tolerance, const Config& config, IFilesystem* fileSystem) {
+	MocapLibrary library(config.ReverseFileEndianness);
+	if (!library.Load(config.MocapFilesFolder, fileSystem) || library.GetTotalFrames() == 0) {
+		std::cout << "no clips to reduce in " << config.MocapFilesFolder << "\n";
+		return -1;
+	}
+	const std::vector<MocapClipEntry>& entries = library.GetClips();
+	std::vector<MocapClipSoA> clips(entries.size());
+	std::vector<const MocapClipSoA*> pointers(entries.size());
+	GetThreadPool().ParallelFor(entries.size(), [&](size_t i) {
+		clips[i].Build(library.GetFrames() + entries[i].firstFrame, entries[i].numFrames);
+		pointers[i] = &clips[i];
+	});
+	std::vector<MocapKeyClip> keys(entries.size());
+	auto start = std::chrono::high_resolution_clock::now();
+	ReduceClips(pointers.data(), pointers.size(), tolerance, keys.data());
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::atomic<size_t> written(0), fileBytes(0);
+	GetThreadPool().ParallelFor(entries.size(), [&](size_t i) {
+		if (keys[i].GetNumFrames() != entries[i].numFrames) {
+			std::cout << entries[i].name << " is too long to reduce\n";
+			return;
+		}
+		std::vector<u8> bytes;
+		keys[i].Encode(bytes);
+		size_t dot = entries[i].name.rfind('.');
+		std::string outPath = JoinPath(outFolder, entries[i].name.substr(0, dot) + ".comapk");
+		std::ofstream out(outPath, std::ofstream::binary | std::ofstream::trunc);
+		out.write((const char*)bytes.data(), bytes.size());
+		if (out) {
+			written++;
+			fileBytes += bytes.size();
+		}
+	});
+
+	size_t numKeys = 0, keyBytes = 0;
+	float maxError = 0.0f;
+	for (const MocapKeyClip& clip : keys) {
+		numKeys += clip.GetNumKeys();
+		keyBytes += clip.GetSizeBytes();
+		maxError = std::max(maxError, clip.GetMaxError());
+	}
+	size_t pointFrames = library.GetTotalFrames() * PlayerPoints;
+	size_t denseBytes = library.GetTotalFrames() * sizeof(MocapFrame);
+	std::cout << "wrote " << written << " of " << entries.size() << " clips to " << outFolder << ", " << fileBytes << " bytes\n";
+	std::cout << "  tolerance " << tolerance << ", largest error " << maxError << ", " << numKeys << " keys for " << pointFrames << " point frames ("
+		<< numKeys * 100.0 / pointFrames << "%)\n";
+	std::cout << "  " << keyBytes << " bytes in memory against " << denseBytes << " dense (" << (double)denseBytes / keyBytes << "x smaller)\n";
+	std::cout << "  reduced in " << seconds * 1000.0 << " ms on " << GetThreadPool().GetNumThreads() << " threads\n";
+	return written == entries.size() ? 0 : -1;
+}
+
+static const std::vector<CommandLineTool>& GetTools() {
+	static const std::vector<CommandLineTool> tools = {
+		{ "--convert", "--convert <in.comap|in.comapz|in.comapk> <out.comap|out.comapz|out.comapk> [tolerance]", 2,
+			[](const std::vector<std::string>& args, const Config& config, IFilesystem* /*fileSystem*/) {
+				MocapFile file(config.ReverseFileEndianness);
+				file.Load(args[0]);
+				if (file.GetNumFrames() == 0) {
+					return -1;
+				}
+				bool ok;
+				if (FileHasExtension(args[1], ".comapz")) {
+					float tolerance = args.size() > 2 ? (float)atof(args[2].c_str()) : config.ComapzTolerance;
+					ok = WriteComapz(file, args[1], tolerance);
+				}
+				else if (FileHasExtension(args[1], ".comapk")) {
+					float tolerance = args.size() > 2 ? (float)atof(args[2].c_str()) : config.KeyframeTolerance;
+					ok = WriteComapk(file, args[1], tolerance);
+				}
+				else {
+					ok = WriteComap(file, args[1], config.ReverseFileEndianness);
+				}
+				std::cout << (ok ? "wrote " : "failed to write ") << args[1] << "\n";
+				return ok ? 0 : -1;
+			}
+		},
+		{ "--extract", "--extract <archive.DAT> <out folder>", 2,
+			[](const std::vector<std::string>& args, const Config& config, IFilesystem* fileSystem) {
+				return ExtractArchive(args[0], args[1], config.ReverseFileEndianness, fileSystem);
+			}
+		},
+		{ "--resample", "--resample <target fps> <out folder> [catmull-rom|lanczos3] [comap|comapz]", 2,
+			[](const std::vector<std::string>& args, const Config& config, IFilesystem* fileSystem) {
+				ResampleJob job;
+				job.folder = config.MocapFilesFolder;
+				job.outFolder = args[1];
+				job.sourceFps = MocapDefaultFps;
+				job.targetFps = atof(args[0].c_str());
+				job.filter = args.size() > 2 && args[2] == "lanczos3" ? ResampleFilter::Lanczos3 : ResampleFilter::CatmullRom;
+				job.comapz = args.size() > 3 && args[3] == "comapz";
+				job.comapzTolerance = config.ComapzTolerance;
+				job.reverseEndianness = config.ReverseFileEndianness;
+				if (job.targetFps <= 0.0) {
+					std::cout << "invalid target fps " << args[0] << "\n";
+					return -1;
+				}
+				ResampleStats stats;
+				bool ok = ResampleFolder(job, fileSystem, stats);
+				std::cout << "resampled " << stats.clips << " clips from " << job.sourceFps << " to " << job.targetFps << " fps, "
+					<< stats.sourceFrames << " -> " << stats.outputFrames << " frames, " << stats.skipped << " skipped, " << stats.failed << " failed\n";
+				if (stats.seconds > 0.0 && stats.resampleSeconds > 0.0) {
+					std::cout << "  " << stats.outputFrames / stats.seconds << " frames/s written including file io, on "
+						<< GetThreadPool().GetNumThreads() << " threads\n";
+					std::cout << "  " << stats.outputFrames / stats.resampleSeconds << " frames/s per thread resampling alone\n";
+				}
+				return ok ? 0 : -1;
+			}
+		},
+		{ "--motion-graph", "--motion-graph [threshold] [window frames]", 0,
+			[](const std::vector<std::string>& args, const Config& config, IFilesystem* fileSystem) {
+				MotionGraphOptions options;
+				if (args.size() > 0) {
+					options.threshold = (float)atof(args[0].c_str());
+				}
+				if (args.size() > 1) {
+					options.window = (u32)atoi(args[1].c_str());
+				}
+				MocapLibrary library(config.ReverseFileEndianness);
+				if (!library.Load(config.MocapFilesFolder, fileSystem) || library.GetTotalFrames() == 0) {
+					std::cout << "no clips to build a motion graph from in " << config.MocapFilesFolder << "\n";
+					return -1;
+				}
+				MocapMotionGraph graph;
+				MotionGraphBuildStats stats;
+				bool ok = graph.Build(library, options, stats, [](size_t done, size_t total) {
+					std::cout << "\rcomparing frames " << done * 100 / total << "%" << std::flush;
+				});
+				std::cout << "\n";
+				std::string path = JoinPath(config.MocapFilesFolder, MotionGraphFileName);
+				ok = ok && graph.Save(path, fileSystem);
+				if (ok) {
+					std::cout << "wrote " << graph.GetTransitions().size() << " transitions from " << stats.minima << " matches (" << stats.pruned
+						<< " dropped outside the connected graph) to " << path << "\n";
+					std::cout << "  " << stats.pairs << " frame pairs in " << stats.seconds << " s, " << stats.pairs / stats.seconds / 1e6
+						<< " M pairs/s on " << GetThreadPool().GetNumThreads() << " threads\n";
+				}
+				return ok ? 0 : -1;
+			}
+		},
+		{ "--reduce", "--reduce <out folder> [tolerance]", 1,
+			[](const std::vector<std::string>& args, const Config& config, IFilesystem* fileSystem) {
+				float tolerance = args.size() > 1 ? (float)atof(args[1].c_str()) : config.KeyframeTolerance;
+				return ReduceLibrary(args[0], tolerance, config, fileSystem);
+			}
+		},
+		{ "--align", "--align <clip> [other clip] [band frames]", 1,
+			[](const std::vector<std::string>& args, const Config& config, IFilesystem* fileSystem) {
+				size_t band = args.size() > 2 ? (size_t)atoi(args[2].c_str()) : TimeWarpDefaultBand;
+				return AlignClips(args[0], args.size() > 1 ? args[1] : std::string(), band, config, fileSystem);
+			}
+		},
+		{ "--benchmark", "--benchmark <load|comapz|reads|poses|blend|pose-search|matching|align|keys>", 1,
+			[](const std::vector<std::string>& args, const Config& config, IFilesystem* fileSystem) {
+				if (args[0] == "load") {
+					BenchmarkComapLoading(config, fileSystem);
+					return 0;
+				}
+				if (args[0] == "comapz") {
+					BenchmarkComapz(config, fileSystem);
+					return 0;
+				}
+				if (args[0] == "reads") {
+					BenchmarkFileReads(config, fileSystem);
+					return 0;
+				}
+				if (args[0] == "poses") {
+					BenchmarkPoseInterpolation(config, fileSystem);
+					return 0;
+				}
+				if (args[0] == "blend") {
+					BenchmarkBlending(config, fileSystem);
+					return 0;
+				}
+				if (args[0] == "pose-search") {
+					BenchmarkPoseSearch(config, fileSystem);
+					return 0;
+				}
+				if (args[0] == "matching") {
+					BenchmarkMotionMatching(config, fileSystem);
+					return 0;
+				}
+				if (args[0] == "align") {
+					BenchmarkTimeWarping(config, fileSystem);
+					return 0;
+				}
+				if (args[0] == "keys") {
+					BenchmarkKeyframes(config, fileSystem);
+					return 0;
+				}
+				std::cout << "unknown benchmark " << args[0] << "\n";
+				return -1;
+			}
+		},
+	};
+	return tools;
+}
+
+static void PrintUsage() {
+	std::cout << "usage:\n";
+	for (const auto& tool : GetTools()) {
+		std::cout << "  ActuaMocap " << tool.usage << "\n";
+	}
+}
+
+int RunCommandLineTool(int argc, char* argv[], const Config& config, IFilesystem* fileSystem)
+{
+	std::string name = argv[1];
+	std::vector<std::string> args(argv + 2, argv + argc);
+	for (const auto& tool : GetTools()) {
+		if (tool.name != name) {
+			continue;
+		}
+		if ((int)args.size() < tool.minArgs) {
+			PrintUsage();
+			return -1;
+		}
+		return tool.run(args, config, fileSystem);
+	}
+	PrintUsage();
+	return -1;
+}
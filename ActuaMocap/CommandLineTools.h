@@ -0,0 +1,11 @@
+#pragma once
+class Config;
+class IFilesystem;
+
+/// <summary>
+/// run one of the offline tools (benchmarks, converters...) named on the command line.
+/// </summary>
+/// <returns>
+/// the process exit code
+/// </returns>
+int RunCommandLineTool(int argc, char* argv[], const Config& config, IFilesystem* fileSystem);
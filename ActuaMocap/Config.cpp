@@ -16,5 +16,38 @@ Config::Config()
 			else if (key == "Font") {
 				Font = value;
 			}
+			else if (key == "MapMocapFiles") {
+				MapMocapFiles = atoi(value.c_str()) != 0;
+			}
+			else if (key == "StreamingThresholdMB") {
+				StreamingThresholdMB = atoi(value.c_str());
+			}
+			else if (key == "StreamingBudgetMB") {
+				StreamingBudgetMB = atoi(value.c_str());
+			}
+			else if (key == "ClipCacheBudgetMB") {
+				ClipCacheBudgetMB = atoi(value.c_str());
+			}
+			else if (key == "DecodedCacheFolder") {
+				DecodedCacheFolder = value;
+			}
+			else if (key == "PreloadLibrary") {
+				PreloadLibrary = atoi(value.c_str()) != 0;
+			}
+			else if (key == "ComapzTolerance") {
+				ComapzTolerance = (float)atof(value.c_str());
+			}
+			else if (key == "KeyframeTolerance") {
+				KeyframeTolerance = (float)atof(value.c_str());
+			}
 		});
 }
+
+MocapLoadOptions Config::GetMocapLoadOptions() const
+{
+	MocapLoadOptions options;
+	options.map = MapMocapFiles;
+	options.streamThresholdBytes = StreamingThresholdMB * 1024 * 1024;
+	options.streamBudgetBytes = StreamingBudgetMB * 1024 * 1024;
+	return options;
+}
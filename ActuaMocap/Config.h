@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include "MocapFile.h"
 class Config
 {
 public:
@@ -8,5 +9,14 @@ public:
 	std::string Theme;
 	std::string Font;
 	bool ReverseFileEndianness;
+	bool MapMocapFiles = false; // map files read only instead of decoding them up front
+	size_t StreamingThresholdMB = 0; // stream files bigger than this through a ring of frames, 0 never streams
+	size_t StreamingBudgetMB = 64; // memory ceiling for a streamed file's decoded frames
+	size_t ClipCacheBudgetMB = 256; // recently played clips kept decoded, 0 turns the cache off
+	std::string DecodedCacheFolder; // where decoded copies of clips are kept for fast startup, empty turns it off
+	bool PreloadLibrary = false; // decode every clip in MocapFilesFolder into one arena at startup
+	float ComapzTolerance = 0.01f; // largest position error allowed when packing .comapz files
+	float KeyframeTolerance = 0.014f; // largest position error allowed when reducing clips to .comapk keys, about 1 mm on a player
+	MocapLoadOptions GetMocapLoadOptions() const;
 };
 
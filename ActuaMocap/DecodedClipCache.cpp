@@ -0,0 +1,217 @@
+#include "DecodedClipCache.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <string.h>
+#include <stdio.h>
+#include "MocapFile.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <errno.h>
+#endif
+
+static_assert(sizeof(DecodedImageHeader) == 72, "DecodedImageHeader is written to disk as is");
+
+static u64 HeaderChecksum(DecodedImageHeader header)
+{
+	header.headerChecksum = 0;
+	return Fnv1a64(&header, sizeof(header));
+}
+
+static bool MakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(path.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+DecodedClipCache::DecodedClipCache(const std::string& folder, IFilesystem* fileSystem, bool reverseSourceEndianness)
+	:_folder(folder),
+	_fileSystem(fileSystem),
+	_reverseSourceEndianness(reverseSourceEndianness)
+{
+	if (!MakeDirectory(_folder)) {
+		std::cout << "couldn't create decoded clip cache folder " << _folder << "\n";
+	}
+	_thread = std::thread(&DecodedClipCache::WorkerThread, this);
+}
+
+DecodedClipCache::~DecodedClipCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+	_thread.join();
+}
+
+std::string DecodedClipCache::GetImagePath(const std::string& sourcePath) const
+{
+	// the file name keeps the folder readable, the hash of the full path keeps same named clips apart
+	size_t slash = sourcePath.find_last_of("\\/");
+	std::string name = slash == std::string::npos ? sourcePath : sourcePath.substr(slash + 1);
+	char hash[17];
+	snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)Fnv1a64(sourcePath.data(), sourcePath.size()));
+	return JoinPath(_folder, name + "." + hash + ".cmn");
+}
+
+bool DecodedClipCache::ValidateHeader(const DecodedImageHeader& header, size_t imageSize)
+{
+	if (imageSize < sizeof(DecodedImageHeader) || memcmp(header.magic, DecodedImageMagic, 4) != 0) {
+		return false;
+	}
+	if (header.version != DecodedImageVersion || header.headerSize != sizeof(DecodedImageHeader) || header.frameSize != sizeof(MocapFrame)) {
+		return false;
+	}
+	if (header.headerChecksum != HeaderChecksum(header)) {
+		return false;
+	}
+	return header.numFrames == (imageSize - header.headerSize) / header.frameSize
+		&& (imageSize - header.headerSize) % header.frameSize == 0;
+}
+
+bool DecodedClipCache::ValidatePayload(const DecodedImageHeader& header, const u8* image, size_t imageSize)
+{
+	return Fnv1a64Words(image + header.headerSize, imageSize - header.headerSize) == header.payloadChecksum;
+}
+
+bool DecodedClipCache::TryOpen(const std::string& sourcePath, MocapFile& file)
+{
+	FileStat stat;
+	if (!_fileSystem->GetFileStat(sourcePath, stat)) {
+		return false;
+	}
+	auto image = std::make_shared<MappedFile>();
+	if (!image->Open(GetImagePath(sourcePath))) {
+		Regenerate(sourcePath);
+		return false;
+	}
+	DecodedImageHeader header;
+	if (image->GetSize() < sizeof(header)) {
+		Regenerate(sourcePath);
+		return false;
+	}
+	memcpy(&header, image->GetData(), sizeof(header));
+	u64 flags = _reverseSourceEndianness ? DecodedImageFlagSourceSwapped : 0;
+	if (!ValidateHeader(header, image->GetSize()) || header.flags != flags
+		|| header.sourceSize != stat.size || header.sourceModifiedTime != stat.modifiedTime
+		|| !ValidatePayload(header, image->GetData(), image->GetSize())) {
+		image.reset();
+		Regenerate(sourcePath);
+		return false;
+	}
+	return file.LoadNativeImage(image, header.headerSize, (size_t)header.numFrames);
+}
+
+void DecodedClipCache::Regenerate(const std::string& sourcePath)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_queued.insert(sourcePath).second) {
+			return;
+		}
+		_queue.push_back(sourcePath);
+	}
+	_wake.notify_one();
+}
+
+bool DecodedClipCache::Restamp(const std::string& imagePath, const DecodedImageHeader& oldHeader, const FileStat& stat)
+{
+	DecodedImageHeader header = oldHeader;
+	header.sourceModifiedTime = stat.modifiedTime;
+	header.headerChecksum = HeaderChecksum(header);
+	// only the header changes, and a torn write just fails the checksum next time
+	std::fstream out(imagePath, std::fstream::in | std::fstream::out | std::fstream::binary);
+	if (!out) {
+		return false;
+	}
+	out.write((const char*)&header, sizeof(header));
+	return (bool)out;
+}
+
+bool DecodedClipCache::Build(const std::string& sourcePath)
+{
+	FileStat stat;
+	std::vector<u8> source;
+	if (!_fileSystem->GetFileStat(sourcePath, stat) || !MocapFile::ReadWholeFile(sourcePath, source) || source.size() != stat.size) {
+		return false;
+	}
+	u64 sourceHash = Fnv1a64(source.data(), source.size());
+	u64 flags = _reverseSourceEndianness ? DecodedImageFlagSourceSwapped : 0;
+	std::string imagePath = GetImagePath(sourcePath);
+
+	{
+		// touched but unchanged, e.g. a fresh checkout - the frames on disk are still right if they match their checksum
+		std::vector<u8> image;
+		DecodedImageHeader header;
+		if (MocapFile::ReadWholeFile(imagePath, image) && image.size() >= sizeof(header)) {
+			memcpy(&header, image.data(), sizeof(header));
+			if (ValidateHeader(header, image.size()) && header.flags == flags && header.sourceSize == stat.size
+				&& header.sourceHash == sourceHash && ValidatePayload(header, image.data(), image.size())) {
+				if (Restamp(imagePath, header, stat)) {
+					return true;
+				}
+			}
+		}
+	}
+
+	std::vector<MocapFrame> frames;
+	if (!MocapFile::DecodeBuffer(source.data(), source.size(), _reverseSourceEndianness, frames)) {
+		std::cout << "couldn't decode " << sourcePath << " for the decoded clip cache\n";
+		return false;
+	}
+	DecodedImageHeader header = {};
+	memcpy(header.magic, DecodedImageMagic, 4);
+	header.version = DecodedImageVersion;
+	header.headerSize = sizeof(DecodedImageHeader);
+	header.frameSize = sizeof(MocapFrame);
+	header.numFrames = frames.size();
+	header.sourceSize = stat.size;
+	header.sourceModifiedTime = stat.modifiedTime;
+	header.sourceHash = sourceHash;
+	header.flags = flags;
+	header.payloadChecksum = Fnv1a64Words(frames.data(), frames.size() * sizeof(MocapFrame));
+	header.headerChecksum = HeaderChecksum(header);
+
+	std::string tempPath = imagePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ofstream::binary | std::ofstream::trunc);
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)frames.data(), frames.size() * sizeof(MocapFrame));
+		if (!out) {
+			std::cout << "couldn't write " << tempPath << "\n";
+			return false;
+		}
+	}
+	// a mapped old image can't be replaced on windows, it gets another go the next time that clip is opened
+	if (!_fileSystem->MoveFileReplacing(tempPath, imagePath)) {
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+void DecodedClipCache::WorkerThread()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_wake.wait(lock, [this]() { return _quit || !_queue.empty(); });
+		if (_quit) {
+			return;
+		}
+		std::string sourcePath = _queue.front();
+		_queue.pop_front();
+		lock.unlock();
+		Build(sourcePath);
+		lock.lock();
+		_queued.erase(sourcePath);
+	}
+}
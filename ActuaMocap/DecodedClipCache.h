@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "BasicTypedefs.h"
+#include "IFilesystem.h"
+
+class MocapFile;
+
+#define DecodedImageMagic "CMPN"
+#define DecodedImageVersion 2
+#define DecodedImageFlagSourceSwapped 1 // frames were byte swapped from the source, i.e. ReverseFileEndianness was set
+
+/// <summary>
+/// header of a cached clip image. everything after it is the clip's frames as native endian MocapFrames
+/// </summary>
+struct DecodedImageHeader {
+	char magic[4];
+	u32 version;
+	u32 headerSize;
+	u32 frameSize;          // sizeof(MocapFrame) of the build that wrote it
+	u64 numFrames;
+	u64 sourceSize;
+	i64 sourceModifiedTime;
+	u64 sourceHash;         // FNV-1a of the source file's bytes
+	u64 headerChecksum;     // FNV-1a of this header with this field zeroed
+	u64 flags;
+	u64 payloadChecksum;    // Fnv1a64Words of the frames after the header
+};
+
+/// <summary>
+/// a folder of clips that have already been decoded and byte swapped, so the next run can map
+/// them and start playing without decoding anything. each image is stamped with the size,
+/// modification time and content hash of the file it came from, and checksummed so a corrupt one isn't trusted.
+/// files big enough to be streamed never come here.
+/// images that are missing, stale or corrupt are rebuilt on a background thread, written to
+/// a temporary file first and renamed into place so a half written image is never opened
+/// </summary>
+class DecodedClipCache
+{
+public:
+	DecodedClipCache(const std::string& folder, IFilesystem* fileSystem, bool reverseSourceEndianness);
+	~DecodedClipCache();
+	DecodedClipCache(const DecodedClipCache&) = delete;
+	DecodedClipCache& operator=(const DecodedClipCache&) = delete;
+	/// <summary>
+	/// map the cached image of sourcePath into file if there's an up to date one.
+	/// returns false and queues a rebuild if there isn't
+	/// </summary>
+	bool TryOpen(const std::string& sourcePath, MocapFile& file);
+	/// <summary>
+	/// rebuild the image of sourcePath in the background. repeated requests for the same path are merged
+	/// </summary>
+	void Regenerate(const std::string& sourcePath);
+	/// <summary>
+	/// build the image of sourcePath on this thread
+	/// </summary>
+	bool Build(const std::string& sourcePath);
+	std::string GetImagePath(const std::string& sourcePath) const;
+	static bool ValidateHeader(const DecodedImageHeader& header, size_t imageSize);
+	// the frames after a valid header against its payloadChecksum
+	static bool ValidatePayload(const DecodedImageHeader& header, const u8* image, size_t imageSize);
+private:
+	void WorkerThread();
+	bool Restamp(const std::string& imagePath, const DecodedImageHeader& oldHeader, const FileStat& stat);
+private:
+	std::string _folder;
+	IFilesystem* _fileSystem;
+	bool _reverseSourceEndianness;
+
+	std::deque<std::string> _queue;
+	std::set<std::string> _queued;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _quit = false;
+	std::thread _thread;
+};
@@ -0,0 +1,51 @@
+#include "FileReads.h"
+#include <fstream>
+#include "ThreadPool.h"
+
+static bool ReadRange(FileRead& read)
+{
+	std::ifstream in(read.path, std::ifstream::binary | std::ifstream::ate);
+	if (!in) {
+		return false;
+	}
+	u64 size = (u64)in.tellg();
+	u64 available = read.offset < size ? size - read.offset : 0;
+	size_t length = read.length == ReadToEndOfFile || read.length > available ? (size_t)available : read.length;
+	read.data.resize(length);
+	in.seekg(read.offset, in.beg);
+	in.read((char*)read.data.data(), length);
+	return (size_t)in.gcount() == length;
+}
+
+void ReadFilesOnThreadPool(std::vector<FileRead>& reads, const FileReadCallback& onComplete)
+{
+	GetIoThreadPool().ParallelFor(reads.size(), [&](size_t i) {
+		reads[i].ok = ReadRange(reads[i]);
+		if (onComplete) {
+			onComplete(i);
+		}
+	});
+}
+
+void ReadAndProcessFiles(IFilesystem* fileSystem, const std::vector<std::string>& paths, const std::vector<u64>& sizes,
+	size_t batchBytes, const std::function<void(size_t, const FileRead&)>& process)
+{
+	size_t first = 0;
+	while (first < paths.size()) {
+		// always take at least one file, however big
+		size_t end = first;
+		u64 bytes = 0;
+		while (end < paths.size() && (end == first || bytes + sizes[end] <= batchBytes)) {
+			bytes += sizes[end++];
+		}
+		std::vector<FileRead> reads(end - first);
+		for (size_t i = 0; i < reads.size(); i++) {
+			reads[i].path = paths[first + i];
+		}
+		fileSystem->ReadFiles(reads);
+		GetThreadPool().ParallelFor(reads.size(), [&](size_t i) {
+			process(first + i, reads[i]);
+		});
+		first = end;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include "IFilesystem.h"
+
+/// <summary>
+/// IFilesystem::ReadFiles for backends without a native async read, one blocking read per GetIoThreadPool thread
+/// </summary>
+void ReadFilesOnThreadPool(std::vector<FileRead>& reads, const FileReadCallback& onComplete);
+
+/// <summary>
+/// read each of paths whole through fileSystem, about batchBytes at a time going by sizes,
+/// and call process(i, read) for every file of a batch across the thread pool once that batch is in.
+/// keeps memory bounded however big the library is
+/// </summary>
+void ReadAndProcessFiles(IFilesystem* fileSystem, const std::vector<std::string>& paths, const std::vector<u64>& sizes,
+	size_t batchBytes, const std::function<void(size_t, const FileRead&)>& process);
+
+#define DefaultReadBatchBytes (64 * 1024 * 1024)
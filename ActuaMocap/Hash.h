@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+#include <string.h>
+#include "BasicTypedefs.h"
+
+#define Fnv1a64OffsetBasis 0xcbf29ce484222325ull
+#define Fnv1a64Prime 0x100000001b3ull
+
+/// <summary>
+/// 64 bit FNV-1a of size bytes. pass the previous result as hash to continue a running hash
+/// </summary>
+inline u64 Fnv1a64(const void* data, size_t size, u64 hash = Fnv1a64OffsetBasis)
+{
+	const u8* bytes = (const u8*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= Fnv1a64Prime;
+	}
+	return hash;
+}
+
+/// <summary>
+/// FNV-1a taken a 64 bit word at a time rather than a byte. about 8x quicker and still catches
+/// torn or corrupted files, but it isn't the same hash as Fnv1a64 and mixes less well
+/// </summary>
+inline u64 Fnv1a64Words(const void* data, size_t size, u64 hash = Fnv1a64OffsetBasis)
+{
+	const u8* bytes = (const u8*)data;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		u64 word;
+		memcpy(&word, bytes + i, 8);
+		hash ^= word;
+		hash *= Fnv1a64Prime;
+	}
+	return Fnv1a64(bytes + i, size - i, hash);
+}
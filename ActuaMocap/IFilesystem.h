@@ -1,9 +1,102 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
 #include "BasicTypedefs.h"
+
+#ifdef _WIN32
+#define PathSeparator '\\'
+#else
+#define PathSeparator '/'
+#endif
+
+struct FileStat {
+	u64 size = 0;
+	i64 modifiedTime = 0; // only meaningful compared against another stat of the same file
+
+	inline bool operator==(const FileStat& other) const {
+		return size == other.size && modifiedTime == other.modifiedTime;
+	}
+	inline bool operator!=(const FileStat& other) const {
+		return !(*this == other);
+	}
+};
+
+struct DirectoryEntry {
+	std::string name; // relative to the directory that was listed
+	bool isDirectory = false;
+	FileStat stat;
+};
+
+enum class FileChangeType {
+	Added,
+	Modified,
+	Removed,
+	Overflow // too many changes to keep up with, rescan the directory
+};
+
+struct FileChange {
+	FileChangeType type;
+	std::string name;
+};
+
+/// <summary>
+/// changes to the files directly inside one directory
+/// </summary>
+class IDirectoryWatch {
+public:
+	virtual ~IDirectoryWatch() {}
+	/// <summary>
+	/// append every change since the last call to out. never blocks
+	/// </summary>
+	virtual void Poll(std::vector<FileChange>& out) = 0;
+};
+
+#define ReadToEndOfFile ((size_t)-1)
+
+struct FileRead {
+	std::string path;
+	u64 offset = 0;
+	size_t length = ReadToEndOfFile;
+	std::vector<u8> data; // what was read, shorter than length if the file ended first
+	bool ok = false;
+};
+
+typedef std::function<void(size_t index)> FileReadCallback;
+
 class IFilesystem {
 public:
+	virtual ~IFilesystem() {}
 	virtual std::vector<std::string> ListFilesInDirectory(std::string dir) const = 0;
 	virtual u32 GetMaxFilepathLength() const = 0;
-};
\ No newline at end of file
+	virtual bool GetFileStat(const std::string& path, FileStat& out) const = 0;
+	// rename from to to, replacing to if it exists. used to publish files that were written to a temporary name
+	virtual bool MoveFileReplacing(const std::string& from, const std::string& to) const = 0;
+	/// <summary>
+	/// names and stats of everything in dir, without . and .. .
+	/// recursive lists subdirectories too, in parallel, naming their contents by path relative to dir
+	/// </summary>
+	virtual std::vector<DirectoryEntry> ListDirectoryEntries(const std::string& dir, bool recursive = false) const = 0;
+	/// <summary>
+	/// start watching dir, nullptr if it can't be watched
+	/// </summary>
+	virtual std::unique_ptr<IDirectoryWatch> WatchDirectory(const std::string& dir) const = 0;
+	/// <summary>
+	/// carry out every read in reads, keeping as many in flight at once as the backend allows,
+	/// and return once they've all finished. onComplete(i) is called as each one finishes,
+	/// possibly from several threads at once
+	/// </summary>
+	virtual void ReadFiles(std::vector<FileRead>& reads, const FileReadCallback& onComplete = FileReadCallback()) const = 0;
+};
+
+inline std::string JoinPath(const std::string& dir, const std::string& name) {
+	if (dir.empty() || dir.back() == '/' || dir.back() == '\\') {
+		return dir + name;
+	}
+	return dir + PathSeparator + name;
+}
+
+inline bool FileHasExtension(const std::string& name, const std::string& ext) {
+	return name.size() >= ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0;
+}
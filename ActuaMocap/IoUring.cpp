@@ -0,0 +1,198 @@
+#ifdef __linux__
+#include "IoUring.h"
+#include <string.h>
+#include <vector>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// the kernel reads the submission tail and writes the completion tail from other cpus,
+// so those are published and read with release/acquire ordering
+#define LoadAcquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define StoreRelease(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+IoUring::IoUring()
+{
+}
+
+IoUring::~IoUring()
+{
+	Close();
+}
+
+bool IoUring::Init(unsigned entries)
+{
+	Close();
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (fd < 0) {
+		return false;
+	}
+	_ringFd = fd;
+	_sqEntries = params.sq_entries;
+	if (!SupportsRead()) {
+		// kernels before 5.6 set up a ring but fail every IORING_OP_READ with -EINVAL
+		Close();
+		return false;
+	}
+
+	_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMap) {
+		_sqRingSize = _cqRingSize = _sqRingSize > _cqRingSize ? _sqRingSize : _cqRingSize;
+	}
+	_sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (_sqRing == MAP_FAILED) {
+		_sqRing = nullptr;
+		Close();
+		return false;
+	}
+	if (singleMap) {
+		_cqRing = _sqRing;
+	}
+	else {
+		_cqRing = mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (_cqRing == MAP_FAILED) {
+			_cqRing = nullptr;
+			Close();
+			return false;
+		}
+	}
+	_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	void* sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		Close();
+		return false;
+	}
+	_sqes = (io_uring_sqe*)sqes;
+
+	u8* sq = (u8*)_sqRing;
+	_sqHead = (unsigned*)(sq + params.sq_off.head);
+	_sqTail = (unsigned*)(sq + params.sq_off.tail);
+	_sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+	_sqArray = (unsigned*)(sq + params.sq_off.array);
+	u8* cq = (u8*)_cqRing;
+	_cqHead = (unsigned*)(cq + params.cq_off.head);
+	_cqTail = (unsigned*)(cq + params.cq_off.tail);
+	_cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+	_cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+	return true;
+}
+
+bool IoUring::SupportsRead() const
+{
+	// IORING_REGISTER_PROBE arrived in the same kernel as IORING_OP_READ, so failing to probe means no reads either
+	const unsigned numOps = 256;
+	std::vector<u8> buffer(sizeof(io_uring_probe) + numOps * sizeof(io_uring_probe_op), 0);
+	io_uring_probe* probe = (io_uring_probe*)buffer.data();
+	if (syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_PROBE, probe, numOps) < 0) {
+		return false;
+	}
+	return IORING_OP_READ <= probe->last_op && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+
+void IoUring::Close()
+{
+	if (_sqes) {
+		munmap(_sqes, _sqesSize);
+	}
+	if (_cqRing && _cqRing != _sqRing) {
+		munmap(_cqRing, _cqRingSize);
+	}
+	if (_sqRing) {
+		munmap(_sqRing, _sqRingSize);
+	}
+	if (_ringFd >= 0) {
+		close(_ringFd);
+	}
+	_sqes = nullptr;
+	_cqRing = nullptr;
+	_sqRing = nullptr;
+	_ringFd = -1;
+	_sqEntries = 0;
+	_toSubmit = 0;
+	_submitted = 0;
+}
+
+bool IoUring::QueueRead(int fd, void* buffer, u32 length, u64 offset, u64 userData)
+{
+	unsigned tail = *_sqTail; // only this thread writes the tail
+	if (tail - LoadAcquire(_sqHead) >= _sqEntries) {
+		return false;
+	}
+	unsigned index = tail & *_sqMask;
+	io_uring_sqe* sqe = &_sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (u64)(uintptr_t)buffer;
+	sqe->len = length;
+	sqe->off = offset;
+	sqe->user_data = userData;
+	_sqArray[index] = index;
+	StoreRelease(_sqTail, tail + 1);
+	_toSubmit++;
+	return true;
+}
+
+bool IoUring::Enter(unsigned toSubmit, unsigned minComplete, int& submitted)
+{
+	while (true) {
+		submitted = (int)syscall(__NR_io_uring_enter, _ringFd, toSubmit, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0);
+		if (submitted >= 0) {
+			return true;
+		}
+		if (errno != EINTR) {
+			return false;
+		}
+	}
+}
+
+bool IoUring::SubmitAndWait(unsigned minComplete)
+{
+	int submitted;
+	if (!Enter(_toSubmit, minComplete, submitted)) {
+		return false;
+	}
+	_toSubmit -= (unsigned)submitted;
+	_submitted += (unsigned)submitted;
+	return true;
+}
+
+bool IoUring::Drain()
+{
+	u64 userData;
+	i32 result;
+	while (true) {
+		while (PopCompletion(userData, result)) {
+		}
+		if (_submitted == 0) {
+			return true;
+		}
+		// submitting nothing, so whatever is still sitting in the submission queue never starts
+		int submitted;
+		if (!Enter(0, 1, submitted)) {
+			return false;
+		}
+	}
+}
+
+bool IoUring::PopCompletion(u64& userData, i32& result)
+{
+	unsigned head = *_cqHead; // only this thread moves the head
+	if (head == LoadAcquire(_cqTail)) {
+		return false;
+	}
+	const io_uring_cqe& cqe = _cqes[head & *_cqMask];
+	userData = cqe.user_data;
+	result = cqe.res;
+	StoreRelease(_cqHead, head + 1);
+	_submitted--;
+	return true;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+#ifdef __linux__
+#include <stddef.h>
+#include "BasicTypedefs.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/// <summary>
+/// just enough of io_uring to keep a queue of reads in flight, set up with the raw syscalls
+/// so there's no liburing dependency. not thread safe, use one ring per thread
+/// </summary>
+class IoUring
+{
+public:
+	IoUring();
+	~IoUring();
+	IoUring(const IoUring&) = delete;
+	IoUring& operator=(const IoUring&) = delete;
+	/// <summary>
+	/// false if the kernel doesn't support io_uring or it's been disabled, e.g. in a container,
+	/// or if it's too old for IORING_OP_READ
+	/// </summary>
+	bool Init(unsigned entries);
+	inline bool IsOpen() const {
+		return _ringFd >= 0;
+	}
+	inline unsigned GetQueueDepth() const {
+		return _sqEntries;
+	}
+	/// <summary>
+	/// queue a read of length bytes at offset in fd into buffer, false if the submission queue is full
+	/// </summary>
+	bool QueueRead(int fd, void* buffer, u32 length, u64 offset, u64 userData);
+	/// <summary>
+	/// submit everything queued and wait until at least minComplete completions are ready
+	/// </summary>
+	bool SubmitAndWait(unsigned minComplete);
+	/// <summary>
+	/// take the oldest completion, false if there isn't one. result is bytes read or -errno
+	/// </summary>
+	bool PopCompletion(u64& userData, i32& result);
+	/// <summary>
+	/// wait out every read the kernel has been handed, throwing their completions away. reads queued but never
+	/// submitted are dropped. false if the kernel stopped answering, their buffers may still be written to then
+	/// </summary>
+	bool Drain();
+private:
+	bool Enter(unsigned toSubmit, unsigned minComplete, int& submitted);
+	void Close();
+	// asks the kernel with IORING_REGISTER_PROBE
+	bool SupportsRead() const;
+private:
+	int _ringFd = -1;
+	unsigned _sqEntries = 0;
+	unsigned _toSubmit = 0;
+	unsigned _submitted = 0; // handed to the kernel and not popped yet
+
+	void* _sqRing = nullptr;
+	size_t _sqRingSize = 0;
+	void* _cqRing = nullptr; // same mapping as _sqRing on kernels with IORING_FEAT_SINGLE_MMAP
+	size_t _cqRingSize = 0;
+	io_uring_sqe* _sqes = nullptr;
+	size_t _sqesSize = 0;
+
+	unsigned* _sqHead = nullptr;
+	unsigned* _sqTail = nullptr;
+	unsigned* _sqMask = nullptr;
+	unsigned* _sqArray = nullptr;
+	unsigned* _cqHead = nullptr;
+	unsigned* _cqTail = nullptr;
+	unsigned* _cqMask = nullptr;
+	io_uring_cqe* _cqes = nullptr;
+};
+
+#endif
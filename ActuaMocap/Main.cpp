@@ -15,10 +15,20 @@
 #include "MocapFile.h"
 #include "Renderer.h"
 #include "ToolUi.h"
+#ifdef _WIN32
 #include "WindowsFilesystem.h"
+typedef WindowsFilesystem PlatformFilesystem;
+#else
+#include "PosixFilesystem.h"
+typedef PosixFilesystem PlatformFilesystem;
+#endif
 #include "MocapAnimation.h"
+#include "MocapCrowd.h"
 #include "Config.h"
 #include "Euro.h"
+#include "CommandLineTools.h"
+#include "MocapLibrary.h"
+#include "DecodedClipCache.h"
 
 #define SCR_WIDTH 1200
 #define SCR_HEIGHT 800
@@ -58,8 +68,15 @@ void CloseWindow() {
 
 
 
-int main()
+int main(int argc, char* argv[])
 {
+    if (argc > 1) {
+        // offline tools don't need a window
+        Config config;
+        PlatformFilesystem fileSystem;
+        return RunCommandLineTool(argc, argv, config, (IFilesystem*)&fileSystem);
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -131,13 +148,23 @@ int main()
     };
 
     Config config;
+    PlatformFilesystem fileSystem;
+    std::unique_ptr<DecodedClipCache> decodedCache;
+    if (!config.DecodedCacheFolder.empty()) {
+        decodedCache = std::make_unique<DecodedClipCache>(config.DecodedCacheFolder, (IFilesystem*)&fileSystem, config.ReverseFileEndianness);
+    }
+    MocapLoadOptions loadOptions = config.GetMocapLoadOptions();
+    loadOptions.decodedCache = decodedCache.get();
     MocapFile file(config.ReverseFileEndianness);
-    //file.LoadFromWindowsDatFile(config.MocapFilesFolder + "\\EURO.DAT", config.MocapFilesFolder + "\\EURO.OFF", BIN_MAIN);
-    file.Load(config.MocapFilesFolder + "\\485 MPB_JUGGLE.comap");
+    file.Open(JoinPath(config.MocapFilesFolder, "485 MPB_JUGGLE.comap"), loadOptions);
     Renderer renderer({ SCR_WIDTH, SCR_HEIGHT, config.Font });
     MocapAnimation animation(&file, connectivity);
-    WindowsFilesystem windowsFileSystem;
-    ToolUi ui(window, (IFilesystem*)&windowsFileSystem, &animation, &file, config);
+    std::unique_ptr<MocapLibrary> library;
+    if (config.PreloadLibrary) {
+        library = std::make_unique<MocapLibrary>(config.ReverseFileEndianness);
+        library->Load(config.MocapFilesFolder, (IFilesystem*)&fileSystem);
+    }
+    ToolUi ui(window, (IFilesystem*)&fileSystem, &animation, &file, config, library.get(), decodedCache.get());
 
     camera.WorldUp = glm::vec3{ 0, 1, 0 };
     camera.Position = glm::vec3{ -5.12247, 21.4454, 57.0002 };
@@ -154,6 +181,14 @@ int main()
 
     gRenderer = &renderer;
 
+    Camera otherCamera = camera;
+    otherCamera.Position = glm::vec3{ 0, 600, 1100 };
+    otherCamera.Yaw = -90;
+    otherCamera.Pitch = -28;
+    otherCamera.MovementSpeed = 200;
+    otherCamera.updateCameraVectors();
+    bool showingCrowd = false;
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
@@ -180,7 +215,19 @@ int main()
         // ------
         glClearColor(1.0, 1.0, 1.0, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        renderer.DrawMocapFrame(animation.GetCurrentFrame(), camera);
+        const MocapCrowd* crowd = ui.GetCrowd();
+        if ((crowd != nullptr) != showingCrowd) {
+            // swap between a view of the whole pitch and wherever the camera was on the single skeleton
+            showingCrowd = crowd != nullptr;
+            std::swap(camera, otherCamera);
+        }
+        if (crowd) {
+            renderer.DrawLineList(crowd->GetPitchLines().data(), crowd->GetPitchLines().size(), camera, glm::vec4(0.2, 0.6, 0.2, 1.0));
+            renderer.DrawSphereInstances(crowd->GetInstances().data(), crowd->GetInstances().size(), camera);
+        }
+        else {
+            renderer.DrawMocapFrame(animation.GetCurrentFrame(), camera);
+        }
         ui.Draw();
 
         glfwSwapBuffers(window);
@@ -0,0 +1,113 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+	_fileHandle = file;
+	_size = (size_t)size.QuadPart;
+	_path = path;
+	_isOpen = true;
+	if (_size == 0) {
+		// CreateFileMapping refuses empty files, an empty mapping is still a valid one
+		return true;
+	}
+	_mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mappingHandle == NULL) {
+		Close();
+		return false;
+	}
+	_data = (const u8*)MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (_data == nullptr) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data) {
+		UnmapViewOfFile(_data);
+	}
+	if (_mappingHandle) {
+		CloseHandle(_mappingHandle);
+	}
+	if (_fileHandle) {
+		CloseHandle(_fileHandle);
+	}
+	_data = nullptr;
+	_mappingHandle = nullptr;
+	_fileHandle = nullptr;
+	_size = 0;
+	_isOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+	_size = (size_t)st.st_size;
+	if (_size > 0) {
+		void* mapped = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+		if (mapped == MAP_FAILED) {
+			close(fd);
+			_size = 0;
+			return false;
+		}
+		_data = (const u8*)mapped;
+	}
+	close(fd); // the mapping keeps its own reference to the file
+	_path = path;
+	_isOpen = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data) {
+		munmap((void*)_data, _size);
+	}
+	_data = nullptr;
+	_size = 0;
+	_isOpen = false;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <stddef.h>
+#include "BasicTypedefs.h"
+
+/// <summary>
+/// a whole file mapped read only into the address space.
+/// pages come from the os file cache, so every viewer instance mapping the same
+/// file shares one copy of it
+/// </summary>
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	bool Open(const std::string& path);
+	void Close();
+	inline bool IsOpen() const {
+		return _isOpen;
+	}
+	inline const u8* GetData() const {
+		return _data;
+	}
+	inline size_t GetSize() const {
+		return _size;
+	}
+	inline const std::string& GetPath() const {
+		return _path;
+	}
+private:
+	const u8* _data = nullptr;
+	size_t _size = 0;
+	bool _isOpen = false;
+	std::string _path;
+#ifdef _WIN32
+	void* _fileHandle = nullptr;
+	void* _mappingHandle = nullptr;
+#endif
+};
@@ -1,120 +1,227 @@
 #include "MocapAnimation.h"
 #include "MocapFile.h"
+#include "MocapBlend.h"
 #include <iostream>
 
 MocapAnimation::MocapAnimation(const MocapFile* mocapFile, const SkeletonConnectivity& connectivity)
-	:_mocapFile(mocapFile),
-	_connectivity(connectivity),
-	_skeletonRoot(_skeleton)
+	:_mocapFile(mocapFile)
 {
-	memcpy(_currentFrame.points, &_mocapFile->CGetFrames()[0], PlayerPoints * sizeof(glm::vec3)); // load first frame
+	_skeleton.Build(connectivity, PlayerPoints + 1);
+	BuildClip();
 	SetFileLengthSeconds();
-	_skeletonRoot->SetLocalPos({ 0,0,0 });
-	_skeletonRoot->SetLocalEulers({ 0,0,0 });
-
+	Sample(0.0); // load first frame
 }
 
 void MocapAnimation::Update(double deltaT)
 {
-	const auto& frames = _mocapFile->CGetFrames();
-	int numFrames = frames.size();
+	if (_fading) {
+		_fadeElapsed += deltaT;
+		if (_fadeElapsed >= _fadeSeconds) {
+			_fading = false;
+			_fadeClip.Clear();
+		}
+	}
+	Sample(_time + deltaT * _rate);
+}
+
+void MocapAnimation::Sample(double seconds)
+{
+	_time = seconds;
+	size_t numFrames = _mocapFile->GetNumFrames();
 	if (numFrames == 0) {
 		return;
 	}
+	MocapFramePair pair = MapTimeToFrames(seconds, _fps, numFrames, _wrap);
+	if (_keyFramesStale || (int)pair.frame != _previousFrame || (int)pair.next != _nextFrame) {
+		_previousFrame = (int)pair.frame;
+		_nextFrame = (int)pair.next;
+		FetchKeyFrames();
+	}
+	_animationProgressSeconds = (pair.frame + pair.t) / _fps;
+	// set _currentPose - interpolate each point between two frames in the loaded file
+	if (_interpolation == MocapInterpolation::CatmullRom) {
+		EvaluateCubicPose(_cubicSegment, pair.t, _currentPose);
+	}
+	else {
+		LerpPoses(*_previousKeyPose, *_nextKeyPose, pair.t, _currentPose);
+	}
+	if (_fading) {
+		ApplyCrossfade();
+	}
+	_currentFrameStale = true;
+}
+
+void MocapAnimation::ApplyCrossfade()
+{
+	MocapPoseSoA outgoing;
+	const MocapPoseSoA* from = &_fadePose;
+	if (size_t numFrames = _fadeClip.GetNumFrames()) {
+		MocapFramePair pair = MapTimeToFrames(_fadeFromTime + _fadeElapsed * _rate, _fps, numFrames, _wrap);
+		if (_interpolation == MocapInterpolation::CatmullRom && _fadeClip.HasCubic()) {
+			_fadeClip.SampleCubic(pair.frame, pair.t, outgoing);
+		}
+		else {
+			_fadeClip.Sample(pair.frame, pair.next, pair.t, outgoing);
+		}
+		from = &outgoing;
+	}
+	// ease in and out so neither end of the fade starts with a jolt
+	float t = (float)(_fadeElapsed / _fadeSeconds);
+	t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+	t = t * t * (3.0f - 2.0f * t);
+	CrossfadePoses(*from, _currentPose, t, _currentPose);
+}
 
-	_animationProgressSeconds += deltaT;
-	_counter += deltaT;
-	if (_counter >= _inverseFps) {
-		_counter = 0;
-		_previousFrame++;
-		_nextFrame++;
-		if (_previousFrame >= numFrames) {
-			_previousFrame = 0;
-			
+void MocapAnimation::CrossfadeToFile(const MocapFile* file, double fadeSeconds, double startSeconds)
+{
+	bool fade = fadeSeconds > 0.0 && _mocapFile->GetNumFrames() > 0;
+	if (fade) {
+		_fadeFromTime = _time;
+		if (_clip.GetNumFrames() > 0) {
+			_fadeClip.Swap(_clip);
 		}
-		if (_nextFrame >= numFrames) {
-			_nextFrame = 0;
-			_animationProgressSeconds = 0.0;
+		else {
+			_fadeClip.Clear();
+			_fadePose = _currentPose;
 		}
 	}
-	// set _currentFrame - interpolate each frame between two frames in the loaded file
-	double t = _counter / _inverseFps;
-	for (int i = 0; i < PlayerPoints; i++) {
-		_currentFrame.points[i] = glm::mix(
-			frames[_previousFrame].points[i],
-			frames[_nextFrame].points[i],
-			t
-		);
+	SetMocapFile(file);
+	ResetAfterNewFileLoad();
+	if (fade) {
+		_fading = true;
+		_fadeSeconds = fadeSeconds;
+		_fadeElapsed = 0.0;
+	}
+	if (fade || startSeconds != 0.0) {
+		Sample(startSeconds);
+	}
+}
+
+void MocapAnimation::EndCrossfade()
+{
+	if (!_fading) {
+		return;
 	}
+	_fading = false;
+	_fadeClip.Clear();
+	Sample(_time);
 }
 
 void MocapAnimation::SetFps(double newFps)
 {
+	if (!(newFps > 0.0)) {
+		return;
+	}
+	// keep the playhead on the same frame
+	_time *= _fps / newFps;
 	_fps = newFps;
-	_inverseFps = 1 / newFps;
 	SetFileLengthSeconds();
 }
 
+void MocapAnimation::SetWrapMode(MocapWrapMode wrap)
+{
+	_wrap = wrap;
+	Sample(_time);
+}
+
+void MocapAnimation::SetInterpolation(MocapInterpolation interpolation)
+{
+	_interpolation = interpolation;
+	if (_interpolation == MocapInterpolation::CatmullRom) {
+		_clip.BuildCubic(); // no-op when the clip isn't held or already has them
+	}
+	_keyFramesStale = true;
+	Sample(_time);
+}
+
 void MocapAnimation::ResetAfterNewFileLoad()
 {
-	_previousFrame = 0;
-	_nextFrame = 1;
-	_counter = 0.0;
+	_fading = false; // CrossfadeToFile turns it back on, _fadeClip is left for it
+	_time = 0.0;
 	_animationProgressSeconds = 0.0;
 	SetFileLengthSeconds();
-
+	BuildClip();
+	_keyFramesStale = true;
+	Sample(0.0);
 }
 
 
 void MocapAnimation::SetToFrame(int frameNumber)
 {
-	const auto& frames = _mocapFile->CGetFrames();
-	if (frameNumber < 0 || frameNumber >= frames.size()) {
-		std::cout << "invalid frame number " << frameNumber << " anumation has " << frames.size() << " frames\n";
-	}
-	const auto& frame2Set = frames[frameNumber];
-	for (int i = 0; i < PlayerPoints; i++) {
-		_currentFrame.points[i] = frame2Set.points[i];
-	}
-	_previousFrame = frameNumber;
-	_nextFrame = frameNumber + 1;
-
-	int numFrames = frames.size();
-	if (_nextFrame >= numFrames) {
-		_nextFrame = 0;
+	int numFrames = _mocapFile->GetNumFrames();
+	if (frameNumber < 0 || frameNumber >= numFrames) {
+		std::cout << "invalid frame number " << frameNumber << " anumation has " << numFrames << " frames\n";
+		return;
 	}
-	_counter = 0;
+	// scrubbing shows the frame asked for, not a blend with a clip that's no longer playing
+	_fading = false;
+	_fadeClip.Clear();
+	Sample(frameNumber / _fps);
 	PopulateSkeleton();
 }
 
 int MocapAnimation::GetNumFrames()
 {
-	const auto& frames = _mocapFile->CGetFrames();
-	int numFrames = frames.size();
-	return numFrames;
+	return _mocapFile->GetNumFrames();
 }
 
 void MocapAnimation::PopulateSkeleton()
 {
-	for (int i = 0; i < _connectivity.size(); i++) {
-		auto parentIndex = _connectivity[i].first;
-		const auto& children = _connectivity[i].second;
-		auto& parent =_skeleton[parentIndex];
-		for (int j = 0; j < children.size(); j++) {
-			auto childIndex = children[j];
-			auto& child = _skeleton[childIndex];
-			const auto& childPos = _currentFrame.points[childIndex - 1];
-			const auto& parentPos = parent.GetWorldPosition();
-			
-			child.SetLocalPos(parentPos - childPos);
-			parent.AddChild(&child);
-		}
-	}
+	_skeleton.SetFromPose(_currentPose);
 }
 
 void MocapAnimation::SetFileLengthSeconds()
 {
-	const auto& frames = _mocapFile->CGetFrames();
-	int numFrames = frames.size();
+	int numFrames = _mocapFile->GetNumFrames();
 	_fileLengthSeconds = (double)numFrames / _fps;
 }
+
+void MocapAnimation::FetchKeyFrames()
+{
+	int numFrames = _mocapFile->GetNumFrames();
+	if (numFrames == 0) {
+		return;
+	}
+	_keyFramesStale = false;
+	int previous = _previousFrame < numFrames ? _previousFrame : 0;
+	int next = _nextFrame < numFrames ? _nextFrame : 0;
+	if (_clip.GetNumFrames() == (size_t)numFrames) {
+		_previousKeyPose = &_clip.GetPose(previous);
+		_nextKeyPose = &_clip.GetPose(next);
+		if (_clip.HasCubic()) {
+			_cubicSegment = _clip.GetCubicSegment(previous);
+		}
+		return;
+	}
+	MocapFrame frame;
+	_mocapFile->GetFrame(previous, frame);
+	PoseFromFrame(frame, _keyPoses[0]);
+	_mocapFile->GetFrame(next, frame);
+	PoseFromFrame(frame, _keyPoses[1]);
+	_previousKeyPose = &_keyPoses[0];
+	_nextKeyPose = &_keyPoses[1];
+	if (_interpolation == MocapInterpolation::CatmullRom) {
+		// the frames either side of this step as well, wrapping the same way playback does
+		MocapPoseSoA before, after;
+		_mocapFile->GetFrame((previous + numFrames - 1) % numFrames, frame);
+		PoseFromFrame(frame, before);
+		_mocapFile->GetFrame((next + 1) % numFrames, frame);
+		PoseFromFrame(frame, after);
+		CatmullRomCoefficients(before, _keyPoses[0], _keyPoses[1], after, _cubicSegmentScratch);
+		_cubicSegment = _cubicSegmentScratch;
+	}
+}
+
+void MocapAnimation::BuildClip()
+{
+	// mapped and streamed files stay out of memory on purpose, only convert the two frames in use
+	if (_mocapFile->GetFramePointer()) {
+		_clip.Build(*_mocapFile);
+		if (_interpolation == MocapInterpolation::CatmullRom) {
+			_clip.BuildCubic();
+		}
+	}
+	else {
+		_clip.Clear();
+	}
+}
@@ -1,52 +1,119 @@
 #pragma once
 #include "MocapFrame.h"
-#include "MocapNode.h"
+#include "MocapSkeleton.h"
+#include "MocapClipSoA.h"
+#include "MocapSampler.h"
 #include <vector>
 
 
 class MocapFile;
 
-typedef std::vector < std::pair<size_t, std::vector<size_t>>> SkeletonConnectivity; // parent, vector of children
 class MocapAnimation {
 public:
 	MocapAnimation(const MocapFile* mocapFile, const SkeletonConnectivity& connectivity);
+	// advance the playhead by deltaT * the playback rate and sample there
 	void Update(double deltaT);
-	void SetFps(double newFps);
+	/// <summary>
+	/// move the playhead straight to seconds and blend the pose there. costs the same wherever
+	/// seconds is, only the frames either side are fetched, and only when they change
+	/// </summary>
+	void Sample(double seconds);
+	void SetFps(double newFps); // ignored unless above 0
+	// 1 is normal speed, negative plays backwards
+	inline void SetRate(double rate) {
+		_rate = rate;
+	}
+	inline double GetRate() const {
+		return _rate;
+	}
+	void SetWrapMode(MocapWrapMode wrap);
+	inline MocapWrapMode GetWrapMode() const {
+		return _wrap;
+	}
+	inline double GetPlayheadSeconds() const {
+		return _time;
+	}
+	void SetInterpolation(MocapInterpolation interpolation);
+	inline MocapInterpolation GetInterpolation() const {
+		return _interpolation;
+	}
 	void ResetAfterNewFileLoad();
+	/// <summary>
+	/// switch to file, fading from the current clip over fadeSeconds. the old clip keeps playing
+	/// through the fade from a copy held here, or holds its last pose if it wasn't in memory.
+	/// 0 seconds is a hard cut, the same as SetMocapFile and ResetAfterNewFileLoad.
+	/// the new clip starts playing from startSeconds
+	/// </summary>
+	void CrossfadeToFile(const MocapFile* file, double fadeSeconds, double startSeconds = 0.0);
+	inline bool IsFading() const {
+		return _fading;
+	}
+	// show the incoming clip alone straight away. fades only advance in Update, so anything that stops calling it ends them
+	void EndCrossfade();
+	inline void SetMocapFile(const MocapFile* mocapFile) {
+		_mocapFile = mocapFile;
+	}
 	inline const MocapFrame& GetCurrentFrame() {
+		if (_currentFrameStale) {
+			PoseToFrame(_currentPose, _currentFrame);
+			_currentFrameStale = false;
+		}
 		return _currentFrame;
 	}
+	inline const MocapPoseSoA& GetCurrentPose() {
+		return _currentPose;
+	}
 	inline const int GetCurrentFrameNumber() {
 		return _previousFrame;
 	}
 	inline double GetCurrentLengthSeconds() {
 		return _fileLengthSeconds;
 	}
+	// position within the clip of the pose on screen, after wrapping
 	double GetAnimationProgressSeconds() {
 		return _animationProgressSeconds;
 	}
 
-	inline MocapNode* GetSkeletonRoot() {
-		return _skeletonRoot;
+	inline const MocapSkeleton& GetSkeleton() const {
+		return _skeleton;
 	}
 
 	void SetToFrame(int frameNumber);
 	int GetNumFrames();
+	// move the skeleton's joints to the current pose, allocates nothing
 	void PopulateSkeleton();
 private:
 	void SetFileLengthSeconds();
+	void FetchKeyFrames();
+	void BuildClip();
+	void ApplyCrossfade();
 	
 private:
-	double _fps = 16.0;
-	double _inverseFps = 1 / 16.0;
+	double _fps = MocapDefaultFps;
+	double _time = 0.0; // playhead, unwrapped
+	double _rate = 1.0;
+	MocapWrapMode _wrap = MocapWrapMode::Loop;
 	int _previousFrame = 0;
 	int _nextFrame = 1;
-	double _counter = 0.0;
-	MocapFrame _currentFrame;
+	bool _keyFramesStale = true; // the file or interpolation changed, fetch even if the frame numbers haven't
+	MocapPoseSoA _currentPose = {};
+	MocapFrame _currentFrame; // _currentPose converted back for the renderer, only when asked for
+	bool _currentFrameStale = true;
+	MocapClipSoA _clip; // the whole file as poses, when its frames are already decoded in memory
+	MocapPoseSoA _keyPoses[2] = {}; // otherwise _previousFrame and _nextFrame are converted here, so mapped files are only decoded once per step
+	const MocapPoseSoA* _previousKeyPose = &_keyPoses[0];
+	const MocapPoseSoA* _nextKeyPose = &_keyPoses[1];
+	MocapInterpolation _interpolation = MocapInterpolation::Linear;
+	MocapPoseSoA _cubicSegmentScratch[4] = {}; // coefficients for the current step when there's no _clip to precompute them in
+	const MocapPoseSoA* _cubicSegment = _cubicSegmentScratch;
+	bool _fading = false;
+	double _fadeSeconds = 0.0;
+	double _fadeElapsed = 0.0;
+	double _fadeFromTime = 0.0; // playhead of the outgoing clip when the fade started
+	MocapClipSoA _fadeClip;     // the outgoing clip, empty when it's held as _fadePose instead
+	MocapPoseSoA _fadePose = {};
 	const MocapFile* _mocapFile;
 	double _fileLengthSeconds;
-	double _animationProgressSeconds;
-	MocapNode _skeleton[PlayerPoints+1];
-	MocapNode* _skeletonRoot;
-	SkeletonConnectivity _connectivity;
+	double _animationProgressSeconds = 0.0;
+	MocapSkeleton _skeleton; // PlayerPoints + 1 joints, built once from the connectivity
 };
\ No newline at end of file
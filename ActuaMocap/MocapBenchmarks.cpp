@@ -0,0 +1,744 @@
+#include "MocapBenchmarks.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+#include "Config.h"
+#include "IFilesystem.h"
+#include "MocapFile.h"
+#include "ByteSwap.h"
+#include "ComapzFormat.h"
+#include "MocapClipSoA.h"
+#include "MocapPoseBatch.h"
+#include "MocapBlend.h"
+#include "MocapCrowd.h"
+#include "MocapPoseIndex.h"
+#include "MocapMotionMatching.h"
+#include "MocapTimeWarp.h"
+#include "MocapKeyClip.h"
+#include "ThreadPool.h"
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using BenchClock = std::chrono::high_resolution_clock;
+
+static double SecondsSince(BenchClock::time_point start) {
+	return std::chrono::duration<double>(BenchClock::now() - start).count();
+}
+
+static std::vector<std::string> ListComapFiles(const Config& config, IFilesystem* fileSystem) {
+	std::vector<std::string> paths;
+	for (const auto& name : fileSystem->ListFilesInDirectory(config.MocapFilesFolder)) {
+		if (FileHasExtension(name, ".comap")) {
+			paths.push_back(JoinPath(config.MocapFilesFolder, name));
+		}
+	}
+	return paths;
+}
+
+// the loader MocapFile used before the bulk read - four one byte reads per float into a growing
+// byte vector, then a second pass from a float vector into frames. kept here as the baseline.
+static size_t LegacyLoad(const std::string& filePath, bool reverseEndianness, std::vector<MocapFrame>& frames) {
+	std::vector<float> floats;
+	std::ifstream in(filePath, std::ifstream::binary);
+	int begin = in.tellg();
+	in.seekg(0, in.end);
+	int end = in.tellg();
+	in.seekg(0, in.beg);
+	int length = end - begin;
+
+	int floatBufferSize = length / 4;
+	std::vector<char> bbuffer;
+	for (int i = 0; i < floatBufferSize; i++) {
+		char b1, b2, b3, b4;
+		in.read(&b1, 1);
+		in.read(&b2, 1);
+		in.read(&b3, 1);
+		in.read(&b4, 1);
+		if (reverseEndianness) {
+			bbuffer.push_back(b4);
+			bbuffer.push_back(b3);
+			bbuffer.push_back(b2);
+			bbuffer.push_back(b1);
+		}
+		else {
+			bbuffer.push_back(b1);
+			bbuffer.push_back(b2);
+			bbuffer.push_back(b3);
+			bbuffer.push_back(b4);
+		}
+		floats.push_back(*((float*)&bbuffer[(bbuffer.size() - 4)]));
+	}
+
+	frames.clear();
+	int numFrames = floats.size() / MocapFrameSizeFloats;
+	for (int i = 0; i < numFrames; i++) {
+		MocapFrame frame;
+		for (int j = 0; j < PlayerPoints; j++) {
+			int startIndex = i * MocapFrameSizeFloats + j * 3 + 1;
+			frame.points[j] = glm::vec3{ floats[startIndex], floats[startIndex + 1], floats[startIndex + 2] };
+		}
+		frames.push_back(frame);
+	}
+	return length;
+}
+
+static void BenchmarkSwapKernel(const char* name, void(*kernel)(const void*, void*, size_t), std::vector<u32>& buffer) {
+	const int iterations = 50;
+	auto start = BenchClock::now();
+	for (int i = 0; i < iterations; i++) {
+		kernel(buffer.data(), buffer.data(), buffer.size());
+	}
+	double secs = SecondsSince(start);
+	double mb = (double)buffer.size() * 4 * iterations / (1024.0 * 1024.0);
+	std::cout << "  " << name << ": " << mb / secs << " MB/s\n";
+}
+
+void BenchmarkComapLoading(const Config& config, IFilesystem* fileSystem)
+{
+	auto paths = ListComapFiles(config, fileSystem);
+	if (paths.empty()) {
+		std::cout << "no .comap files found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+	const int passes = 5;
+
+	// warm the os file cache so both loaders are measured against the same state
+	MocapFile file(config.ReverseFileEndianness);
+	for (const auto& path : paths) {
+		file.Load(path);
+	}
+
+	size_t legacyBytes = 0;
+	auto start = BenchClock::now();
+	std::vector<MocapFrame> legacyFrames;
+	for (int pass = 0; pass < passes; pass++) {
+		for (const auto& path : paths) {
+			legacyBytes += LegacyLoad(path, config.ReverseFileEndianness, legacyFrames);
+		}
+	}
+	double legacySecs = SecondsSince(start);
+
+	size_t bulkFrames = 0;
+	start = BenchClock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		for (const auto& path : paths) {
+			file.Load(path);
+			bulkFrames += file.CGetFrames().size();
+		}
+	}
+	double bulkSecs = SecondsSince(start);
+	size_t bulkBytes = bulkFrames * MocapFrameSizeBytes;
+
+	double legacyMbs = legacyBytes / (1024.0 * 1024.0) / legacySecs;
+	double bulkMbs = bulkBytes / (1024.0 * 1024.0) / bulkSecs;
+	std::cout << "loaded " << paths.size() << " files x " << passes << " passes\n";
+	std::cout << "  per byte ifstream loader: " << legacyMbs << " MB/s\n";
+	std::cout << "  bulk read + swap kernel:  " << bulkMbs << " MB/s (" << bulkMbs / legacyMbs << "x)\n";
+
+	std::cout << "byte swap kernels, 16 MB in place" << (CpuSupportsAVX2() ? "" : " (no AVX2 on this cpu)") << "\n";
+	std::vector<u32> buffer(4 * 1024 * 1024, 0x3f800000);
+	BenchmarkSwapKernel("scalar", ByteSwap32Scalar, buffer);
+	BenchmarkSwapKernel("SSE2  ", ByteSwap32SSE2, buffer);
+	if (CpuSupportsAVX2()) {
+		BenchmarkSwapKernel("AVX2  ", ByteSwap32AVX2, buffer);
+	}
+}
+
+void BenchmarkComapz(const Config& config, IFilesystem* fileSystem)
+{
+	auto paths = ListComapFiles(config, fileSystem);
+	std::vector<std::vector<u8>> raw, packed;
+	std::vector<MocapFrame> frames;
+	size_t rawBytes = 0, packedBytes = 0, totalFrames = 0;
+	float worstError = 0;
+	for (const auto& path : paths) {
+		MocapFile file(config.ReverseFileEndianness);
+		file.Load(path);
+		if (file.GetNumFrames() == 0) {
+			continue;
+		}
+		std::ifstream in(path, std::ifstream::binary);
+		raw.emplace_back((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		packed.emplace_back();
+		EncodeComapz(file.CGetFrames().data(), file.GetNumFrames(), config.ComapzTolerance, packed.back());
+
+		frames.resize(file.GetNumFrames());
+		DecodeComapz(packed.back().data(), packed.back().size(), frames.data());
+		for (size_t f = 0; f < frames.size(); f++) {
+			for (int p = 0; p < PlayerPoints; p++) {
+				glm::vec3 d = glm::abs(frames[f].points[p] - file.CGetFrames()[f].points[p]);
+				worstError = glm::max(worstError, glm::max(d.x, glm::max(d.y, d.z)));
+			}
+		}
+		rawBytes += raw.back().size();
+		packedBytes += packed.back().size();
+		totalFrames += frames.size();
+	}
+	if (totalFrames == 0) {
+		std::cout << "no .comap files found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+	std::cout << raw.size() << " clips, " << totalFrames << " frames, tolerance " << config.ComapzTolerance << "\n";
+	std::cout << "  .comap " << rawBytes << " bytes, .comapz " << packedBytes << " bytes (" << (double)rawBytes / packedBytes << "x smaller)\n";
+	std::cout << "  worst position error " << worstError << "\n";
+
+	// decode from memory so only the decoders are compared
+	const int passes = 20;
+	auto start = BenchClock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		for (const auto& bytes : raw) {
+			frames.resize(bytes.size() / MocapFrameSizeBytes);
+			MocapFile::DecodeComapFrames(bytes.data(), frames.size(), config.ReverseFileEndianness, frames.data());
+		}
+	}
+	double rawSecs = SecondsSince(start);
+	start = BenchClock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		for (const auto& bytes : packed) {
+			ComapzInfo info;
+			ReadComapzInfo(bytes.data(), bytes.size(), info);
+			frames.resize(info.numFrames);
+			DecodeComapz(bytes.data(), bytes.size(), frames.data());
+		}
+	}
+	double packedSecs = SecondsSince(start);
+	double decodedMb = (double)totalFrames * sizeof(MocapFrame) * passes / (1024.0 * 1024.0);
+	std::cout << "  .comap decode:  " << decodedMb / rawSecs << " MB/s of frames\n";
+	std::cout << "  .comapz decode: " << decodedMb / packedSecs << " MB/s of frames\n";
+}
+
+// ask the os to forget the files' cached pages, so the next read comes from the disk
+static bool DropFromPageCache(const std::vector<std::string>& paths) {
+#ifdef __linux__
+	for (const auto& path : paths) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd >= 0) {
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void BenchmarkFileReads(const Config& config, IFilesystem* fileSystem)
+{
+	auto paths = ListComapFiles(config, fileSystem);
+	if (paths.empty()) {
+		std::cout << "no .comap files found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+	bool cold = DropFromPageCache(paths);
+	if (!cold) {
+		std::cout << "can't drop the page cache on this platform, timings after the first pass are warm\n";
+	}
+	const int passes = 3;
+	for (int pass = 0; pass < passes; pass++) {
+		DropFromPageCache(paths);
+		size_t serialBytes = 0;
+		std::vector<u8> bytes;
+		auto start = BenchClock::now();
+		for (const auto& path : paths) {
+			MocapFile::ReadWholeFile(path, bytes);
+			serialBytes += bytes.size();
+		}
+		double serialSecs = SecondsSince(start);
+
+		DropFromPageCache(paths);
+		std::vector<FileRead> reads(paths.size());
+		for (size_t i = 0; i < paths.size(); i++) {
+			reads[i].path = paths[i];
+		}
+		start = BenchClock::now();
+		fileSystem->ReadFiles(reads);
+		double batchSecs = SecondsSince(start);
+		size_t batchBytes = 0;
+		for (const auto& read : reads) {
+			batchBytes += read.data.size();
+		}
+
+		double mb = serialBytes / (1024.0 * 1024.0);
+		std::cout << paths.size() << " files, " << mb << " MB" << (cold ? ", cold cache" : "") << "\n";
+		std::cout << "  serial ifstream: " << serialSecs * 1000.0 << " ms, " << mb / serialSecs << " MB/s\n";
+		std::cout << "  ReadFiles:       " << batchSecs * 1000.0 << " ms, " << batchBytes / (1024.0 * 1024.0) / batchSecs << " MB/s ("
+			<< serialSecs / batchSecs << "x)\n";
+	}
+}
+
+// results are summed into here so the compiler can't drop the work being timed
+static volatile float gBenchSink;
+
+static void BenchmarkLerpKernel(const char* name, void(*kernel)(const MocapPoseSoA&, const MocapPoseSoA&, float, MocapPoseSoA&),
+	const std::vector<std::unique_ptr<MocapClipSoA>>& clips, size_t totalPoses, double aosPosesPerSec) {
+	const int passes = 20;
+	MocapPoseSoA out;
+	float sum = 0;
+	auto start = BenchClock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		float t = (pass + 0.5f) / passes;
+		for (const auto& clip : clips) {
+			for (size_t f = 0; f + 1 < clip->GetNumFrames(); f++) {
+				kernel(clip->GetPose(f), clip->GetPose(f + 1), t, out);
+				sum += out.x[f % PlayerPoints];
+			}
+		}
+	}
+	double posesPerSec = totalPoses * passes / SecondsSince(start);
+	std::cout << "  " << name << posesPerSec / 1e6 << " M poses/s (" << posesPerSec / aosPosesPerSec << "x)\n";
+	gBenchSink = sum;
+}
+
+void BenchmarkPoseInterpolation(const Config& config, IFilesystem* fileSystem)
+{
+	auto paths = ListComapFiles(config, fileSystem);
+	std::vector<std::vector<MocapFrame>> aosClips;
+	std::vector<std::unique_ptr<MocapClipSoA>> soaClips;
+	size_t totalPoses = 0;
+	for (const auto& path : paths) {
+		MocapFile file(config.ReverseFileEndianness);
+		file.Load(path);
+		if (file.GetNumFrames() < 2) {
+			continue;
+		}
+		aosClips.push_back(file.CGetFrames());
+		soaClips.push_back(std::make_unique<MocapClipSoA>());
+		soaClips.back()->Build(file);
+		totalPoses += file.GetNumFrames() - 1;
+	}
+	if (totalPoses == 0) {
+		std::cout << "no .comap files found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+	std::cout << soaClips.size() << " clips, " << totalPoses << " poses per pass" << (CpuSupportsAVX2() ? "" : " (no AVX on this cpu)") << "\n";
+
+	// the loop MocapAnimation::Update used before the SoA layout
+	const int passes = 20;
+	MocapFrame out;
+	MocapPoseSoA pose;
+	float sum = 0;
+	auto start = BenchClock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		double t = (pass + 0.5) / passes;
+		for (const auto& frames : aosClips) {
+			for (size_t f = 0; f + 1 < frames.size(); f++) {
+				for (int i = 0; i < PlayerPoints; i++) {
+					out.points[i] = glm::mix(frames[f].points[i], frames[f + 1].points[i], t);
+				}
+				sum += out.points[f % PlayerPoints].x;
+			}
+		}
+	}
+	double aosPosesPerSec = totalPoses * passes / SecondsSince(start);
+	std::cout << "  MocapFrame glm::mix: " << aosPosesPerSec / 1e6 << " M poses/s\n";
+	gBenchSink = sum;
+
+	BenchmarkLerpKernel("SoA scalar:          ", LerpPosesScalar, soaClips, totalPoses, aosPosesPerSec);
+	BenchmarkLerpKernel("SoA SSE2:            ", LerpPosesSSE2, soaClips, totalPoses, aosPosesPerSec);
+	if (CpuSupportsAVX2()) {
+		BenchmarkLerpKernel("SoA AVX:             ", LerpPosesAVX, soaClips, totalPoses, aosPosesPerSec);
+	}
+
+	// catmull-rom from the precomputed coefficients, one segment read per pose like the lerp's two frames
+	for (auto& clip : soaClips) {
+		clip->BuildCubic();
+	}
+	start = BenchClock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		float t = (pass + 0.5f) / passes;
+		for (const auto& clip : soaClips) {
+			for (size_t f = 0; f + 1 < clip->GetNumFrames(); f++) {
+				clip->SampleCubic(f, t, pose);
+				sum += pose.x[f % PlayerPoints];
+			}
+		}
+	}
+	double cubicPosesPerSec = totalPoses * passes / SecondsSince(start);
+	std::cout << "  SoA catmull-rom:     " << cubicPosesPerSec / 1e6 << " M poses/s (" << cubicPosesPerSec / aosPosesPerSec << "x)\n";
+	gBenchSink = sum;
+
+	// a preview sized batch of poses at scattered times, as EvaluatePoses would get from a crowd
+	const size_t batchSize = 10000;
+	std::vector<MocapPoseRequest> requests(batchSize);
+	for (size_t i = 0; i < batchSize; i++) {
+		requests[i].clip = soaClips[i % soaClips.size()].get();
+		requests[i].seconds = i * 0.37;
+	}
+	std::vector<MocapPoseSoA> poses(batchSize);
+	start = BenchClock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		EvaluatePosesSerial(requests.data(), batchSize, MocapDefaultFps, poses.data());
+	}
+	double serialPosesPerSec = batchSize * passes / SecondsSince(start);
+	start = BenchClock::now();
+	for (int pass = 0; pass < passes; pass++) {
+		EvaluatePoses(requests.data(), batchSize, MocapDefaultFps, poses.data());
+	}
+	double batchPosesPerSec = batchSize * passes / SecondsSince(start);
+	std::cout << "batches of " << batchSize << " (clip, time) requests\n";
+	std::cout << "  EvaluatePosesSerial: " << serialPosesPerSec / 1e6 << " M poses/s\n";
+	std::cout << "  EvaluatePoses:       " << batchPosesPerSec / 1e6 << " M poses/s on " << GetThreadPool().GetNumThreads() << " threads\n";
+}
+
+void BenchmarkBlending(const Config& config, IFilesystem* fileSystem)
+{
+	auto paths = ListComapFiles(config, fileSystem);
+	std::vector<std::unique_ptr<MocapClipSoA>> clips;
+	for (const auto& path : paths) {
+		MocapFile file(config.ReverseFileEndianness);
+		file.Load(path);
+		if (file.GetNumFrames() < 2) {
+			continue;
+		}
+		clips.push_back(std::make_unique<MocapClipSoA>());
+		clips.back()->Build(file);
+		clips.back()->BuildCubic();
+	}
+	if (clips.empty()) {
+		std::cout << "no .comap files found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+
+	// a 22 man match, each player mixing a locomotion pair with an upper body pair
+	const size_t players = 2 * CrowdTeamSize;
+	std::vector<MocapBlendTree> trees(players);
+	for (size_t p = 0; p < players; p++) {
+		std::vector<size_t> leaves;
+		for (size_t c = 0; c < 4; c++) {
+			leaves.push_back(trees[p].AddClip(clips[(p * 4 + c) % clips.size()].get(), p * 0.25, 0.8 + 0.1 * c));
+		}
+		size_t legs = trees[p].AddBlend({ leaves[0], leaves[1] });
+		size_t arms = trees[p].AddBlend({ leaves[2], leaves[3] });
+		size_t root = trees[p].AddBlend({ legs, arms });
+		trees[p].SetGroupWeight(root, 0, JointGroupArms, 0.0f);
+		trees[p].SetGroupWeight(root, 1, JointGroupLegs, 0.0f);
+	}
+
+	const int ticks = 2000;
+	std::cout << players << " players, 4 clips each in a 3 blend tree\n";
+	for (int interpolation = 0; interpolation < 2; interpolation++) {
+		float sum = 0;
+		auto start = BenchClock::now();
+		for (int tick = 0; tick < ticks; tick++) {
+			double seconds = tick / 60.0;
+			for (auto& tree : trees) {
+				sum += tree.Evaluate(seconds, MocapDefaultFps, (MocapInterpolation)interpolation).y[tick % PlayerPoints];
+			}
+		}
+		double msPerTick = SecondsSince(start) * 1000.0 / ticks;
+		std::cout << (interpolation == 0 ? "  linear:      " : "  catmull-rom: ") << msPerTick << " ms per tick, "
+			<< players * ticks / (msPerTick * ticks / 1000.0) / 1e6 << " M trees/s\n";
+		gBenchSink = sum;
+	}
+}
+
+void BenchmarkPoseSearch(const Config& config, IFilesystem* fileSystem)
+{
+	// built in memory rather than loaded, so the benchmark never writes beside the clips
+	MocapPoseIndex index(config.ReverseFileEndianness);
+	auto start = BenchClock::now();
+	index.Update(config.MocapFilesFolder, fileSystem);
+	double buildSeconds = SecondsSince(start);
+	if (index.GetNumFrames() == 0) {
+		std::cout << "no clips found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+	std::cout << index.GetNumFrames() << " frames from " << index.GetClips().size() << " clips indexed in " << buildSeconds << " s\n";
+
+	// every 4th frame of the library, and each again with every point nudged so none are exact matches
+	std::vector<MocapFrame> queries;
+	u32 rng = 1;
+	for (const auto& clip : index.GetClips()) {
+		MocapFile file(config.ReverseFileEndianness);
+		file.Load(JoinPath(config.MocapFilesFolder, clip.name));
+		for (size_t f = 0; f < file.GetNumFrames(); f += 4) {
+			MocapFrame frame;
+			file.GetFrame(f, frame);
+			queries.push_back(frame);
+			for (int p = 0; p < PlayerPoints; p++) {
+				if (IsMissingPoint(frame.points[p])) {
+					continue;
+				}
+				rng = rng * 1664525u + 1013904223u;
+				frame.points[p] += glm::vec3(((rng >> 8) % 1000) / 1000.0f - 0.5f);
+			}
+			queries.push_back(frame);
+		}
+	}
+
+	const size_t k = 8;
+	std::vector<PoseMatch> indexed, bruteForce;
+	double indexSeconds = 0.0, bruteForceSeconds = 0.0;
+	size_t mismatches = 0;
+	for (const auto& query : queries) {
+		auto queryStart = BenchClock::now();
+		index.Query(query, k, indexed);
+		indexSeconds += SecondsSince(queryStart);
+		queryStart = BenchClock::now();
+		index.QueryBruteForce(query, k, bruteForce);
+		bruteForceSeconds += SecondsSince(queryStart);
+		// compared by distance, poses repeated in the library can come back in either order
+		bool same = indexed.size() == bruteForce.size();
+		for (size_t i = 0; same && i < indexed.size(); i++) {
+			same = fabsf(indexed[i].distance - bruteForce[i].distance) <= 1e-4f * (1.0f + bruteForce[i].distance);
+		}
+		mismatches += !same;
+	}
+	std::cout << queries.size() << " queries for the " << k << " nearest poses\n";
+	std::cout << "  index:       " << indexSeconds * 1000.0 / queries.size() << " ms per query\n";
+	std::cout << "  brute force: " << bruteForceSeconds * 1000.0 / queries.size() << " ms per query\n";
+	std::cout << "  " << mismatches << " queries disagreed\n";
+}
+
+void BenchmarkMotionMatching(const Config& config, IFilesystem* fileSystem)
+{
+	MocapPoseIndex poseIndex(config.ReverseFileEndianness);
+	poseIndex.Update(config.MocapFilesFolder, fileSystem);
+	MocapCrowd crowd;
+	for (const auto& path : ListComapFiles(config, fileSystem)) {
+		MocapFile file(config.ReverseFileEndianness);
+		file.Load(path);
+		crowd.AddClip(file);
+	}
+	if (crowd.GetNumClips() == 0) {
+		std::cout << "no .comap files found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+	const size_t players = 2 * CrowdTeamSize;
+	crowd.SetNumPlayers(players);
+	auto start = BenchClock::now();
+	crowd.SetMotionMatching(true, poseIndex);
+	const MocapMatchDatabase& database = *crowd.GetMatchDatabase();
+	std::cout << database.GetNumSearchable() << " frames from " << crowd.GetNumClips() << " clips in the database, built in " << SecondsSince(start) << " s\n";
+
+	// queries from random frames heading off in random directions at random speeds
+	const int queries = 20000;
+	u32 rng = 1;
+	auto next = [&rng]() {
+		rng = rng * 1664525u + 1013904223u;
+		return rng >> 8;
+	};
+	double prunedSeconds = 0.0, bruteForceSeconds = 0.0;
+	size_t mismatches = 0;
+	size_t searched = 0;
+	for (int q = 0; q < queries; q++) {
+		u32 clip = next() % database.GetNumClips();
+		if (database.GetNumFrames(clip) < 2) {
+			continue;
+		}
+		u32 frame = next() % (database.GetNumFrames(clip) - 1);
+		float query[MotionMatchFeatures];
+		database.GetFeatures(clip, frame, query);
+		float angle = (next() % 1000) / 1000.0f * 6.2831853f;
+		float speed = (next() % 1000) / 1000.0f * database.GetMaxSpeed();
+		glm::vec2 trajectory[MotionMatchTrajectoryPoints];
+		for (int k = 0; k < MotionMatchTrajectoryPoints; k++) {
+			trajectory[k] = glm::vec2(cosf(angle), sinf(angle)) * speed * (float)MotionMatchTrajectoryFrames[k];
+		}
+		database.SetTrajectory(trajectory, query);
+		MotionMatchResult pruned, bruteForce;
+		auto queryStart = BenchClock::now();
+		bool foundPruned = database.Search(query, FLT_MAX, clip, frame, pruned);
+		prunedSeconds += SecondsSince(queryStart);
+		queryStart = BenchClock::now();
+		bool foundBruteForce = database.SearchBruteForce(query, FLT_MAX, clip, frame, bruteForce);
+		bruteForceSeconds += SecondsSince(queryStart);
+		searched++;
+		mismatches += foundPruned != foundBruteForce || fabsf(pruned.cost - bruteForce.cost) > 1e-4f * (1.0f + bruteForce.cost);
+	}
+	std::cout << searched << " searches\n";
+	std::cout << "  bounding boxes: " << prunedSeconds * 1e6 / searched << " us per search\n";
+	std::cout << "  brute force:    " << bruteForceSeconds * 1e6 / searched << " us per search\n";
+	std::cout << "  " << mismatches << " searches disagreed\n";
+
+	const int ticks = 60 * 60;
+	size_t searches = 0;
+	double searchMicroseconds = 0.0, updateMs = 0.0;
+	crowd.SetControlStick(glm::vec2(1.0f, 0.0f));
+	for (int tick = 0; tick < ticks; tick++) {
+		crowd.Update(1.0 / 60.0);
+		searches += crowd.GetLastSearches();
+		searchMicroseconds += crowd.GetLastSearchMicroseconds() * crowd.GetLastSearches();
+		updateMs += crowd.GetLastUpdateMs();
+	}
+	std::cout << players << " players for a minute at 60 ticks a second: " << updateMs / ticks << " ms per tick, "
+		<< searches << " searches at " << (searches > 0 ? searchMicroseconds / searches : 0.0) << " us each\n";
+}
+
+void BenchmarkTimeWarping(const Config& config, IFilesystem* fileSystem)
+{
+	std::vector<std::unique_ptr<TimeWarpClip>> clips;
+	for (const auto& path : ListComapFiles(config, fileSystem)) {
+		MocapFile file(config.ReverseFileEndianness);
+		file.Load(path);
+		if (file.GetNumFrames() == 0) {
+			continue;
+		}
+		MocapClipSoA poses;
+		poses.Build(file);
+		clips.push_back(std::make_unique<TimeWarpClip>());
+		clips.back()->Build(poses);
+	}
+	if (clips.empty()) {
+		std::cout << "no .comap files found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+	size_t pairs = clips.size() * (clips.size() - 1) / 2;
+	std::cout << clips.size() << " clips, " << pairs << " pairs" << (CpuSupportsAVX2() ? "" : " (no AVX on this cpu)") << "\n";
+
+	// with a band wider than any clip the wavefront fills every cell too, so it has to land on the same cost
+	TimeWarpAligner aligner;
+	TimeWarpAlignment naive, banded;
+	double naiveSeconds = 0.0, fullSeconds = 0.0, bandSeconds = 0.0;
+	size_t mismatches = 0;
+	for (size_t a = 0; a < clips.size(); a++) {
+		for (size_t b = a + 1; b < clips.size(); b++) {
+			auto start = BenchClock::now();
+			TimeWarpAligner::AlignNaive(*clips[a], *clips[b], naive);
+			naiveSeconds += SecondsSince(start);
+			start = BenchClock::now();
+			aligner.Align(*clips[a], *clips[b], SIZE_MAX, banded);
+			fullSeconds += SecondsSince(start);
+			mismatches += fabsf(naive.cost - banded.cost) > 1e-4f * (1.0f + naive.cost);
+			start = BenchClock::now();
+			aligner.Align(*clips[a], *clips[b], TimeWarpDefaultBand, banded);
+			bandSeconds += SecondsSince(start);
+		}
+	}
+	std::cout << "  naive, every cell:        " << naiveSeconds * 1000.0 / pairs << " ms per pair\n";
+	std::cout << "  wavefront, every cell:    " << fullSeconds * 1000.0 / pairs << " ms per pair\n";
+	std::cout << "  wavefront, band of " << TimeWarpDefaultBand << ":    " << bandSeconds * 1000.0 / pairs << " ms per pair\n";
+	std::cout << "  " << mismatches << " pairs disagreed\n";
+
+	std::vector<const TimeWarpClip*> others;
+	for (const auto& clip : clips) {
+		others.push_back(clip.get());
+	}
+	std::vector<TimeWarpAlignment> alignments;
+	auto start = BenchClock::now();
+	for (const auto& clip : clips) {
+		AlignAgainstClips(*clip, others, TimeWarpDefaultBand, alignments);
+	}
+	double seconds = SecondsSince(start);
+	std::cout << "every clip against the library on " << GetThreadPool().GetNumThreads() << " threads: " << seconds << " s, "
+		<< seconds * 1000.0 / (clips.size() * clips.size()) << " ms per pair\n";
+}
+
+void BenchmarkKeyframes(const Config& config, IFilesystem* fileSystem)
+{
+	std::vector<std::unique_ptr<MocapClipSoA>> clips;
+	for (const auto& path : ListComapFiles(config, fileSystem)) {
+		MocapFile file(config.ReverseFileEndianness);
+		file.Load(path);
+		if (file.GetNumFrames() < 2) {
+			continue;
+		}
+		clips.push_back(std::make_unique<MocapClipSoA>());
+		clips.back()->Build(file);
+	}
+	if (clips.empty()) {
+		std::cout << "no .comap files found in " << config.MocapFilesFolder << "\n";
+		return;
+	}
+	std::vector<const MocapClipSoA*> pointers;
+	size_t totalFrames = 0;
+	for (const auto& clip : clips) {
+		pointers.push_back(clip.get());
+		totalFrames += clip->GetNumFrames();
+	}
+	std::vector<MocapKeyClip> keys(clips.size());
+	auto start = BenchClock::now();
+	ReduceClips(pointers.data(), pointers.size(), config.KeyframeTolerance, keys.data());
+	double reduceSeconds = SecondsSince(start);
+
+	// every frame sampled back from the keys, against the frame it came from
+	size_t numKeys = 0, keyBytes = 0, missingMismatches = 0;
+	float worst = 0.0f;
+	for (size_t c = 0; c < clips.size(); c++) {
+		numKeys += keys[c].GetNumKeys();
+		keyBytes += keys[c].GetSizeBytes();
+		MocapPoseSoA pose;
+		for (size_t f = 0; f < clips[c]->GetNumFrames(); f++) {
+			const MocapPoseSoA& original = clips[c]->GetPose(f);
+			keys[c].SampleFrame(f, 0.0f, pose);
+			for (int p = 0; p < PlayerPoints; p++) {
+				glm::vec3 a(original.x[p], original.y[p], original.z[p]);
+				glm::vec3 b(pose.x[p], pose.y[p], pose.z[p]);
+				if (IsMissingPoint(a) != IsMissingPoint(b)) {
+					missingMismatches++;
+				}
+				else if (!IsMissingPoint(a)) {
+					worst = fmaxf(worst, glm::length(a - b));
+				}
+			}
+		}
+	}
+	size_t denseBytes = totalFrames * sizeof(MocapPoseSoA);
+	std::cout << clips.size() << " clips, " << totalFrames << " frames, tolerance " << config.KeyframeTolerance << "\n";
+	std::cout << "  reduced in " << reduceSeconds * 1000.0 << " ms on " << GetThreadPool().GetNumThreads() << " threads, "
+		<< numKeys * 100.0 / (totalFrames * PlayerPoints) << "% of point frames kept as keys\n";
+	std::cout << "  " << keyBytes << " bytes of keys against " << denseBytes << " dense (" << (double)denseBytes / keyBytes << "x smaller)\n";
+	std::cout << "  worst error " << worst << ", " << missingMismatches << " points missing on one side only\n";
+
+	// random frames of random clips, then a crowd's worth of players each playing on through its own clip
+	const size_t samples = 1000000;
+	std::vector<MocapPoseRequest> requests(samples);
+	u32 rng = 1;
+	for (auto& request : requests) {
+		rng = rng * 1664525u + 1013904223u;
+		request.clip = clips[(rng >> 8) % clips.size()].get();
+		rng = rng * 1664525u + 1013904223u;
+		request.seconds = (rng >> 8) / (double)(1 << 24) * request.clip->GetNumFrames() / MocapDefaultFps;
+	}
+	std::vector<MocapPoseSoA> out(samples);
+	start = BenchClock::now();
+	EvaluatePosesSerial(requests.data(), samples, MocapDefaultFps, out.data());
+	double denseSeconds = SecondsSince(start);
+	for (auto& request : requests) {
+		request.keys = &keys[std::find(pointers.begin(), pointers.end(), request.clip) - pointers.begin()];
+	}
+	start = BenchClock::now();
+	EvaluatePosesSerial(requests.data(), samples, MocapDefaultFps, out.data());
+	double keySeconds = SecondsSince(start);
+	std::cout << "random access: dense " << samples / denseSeconds / 1e6 << " M poses/s, keys " << samples / keySeconds / 1e6 << " M poses/s\n";
+
+	// dense, then keys looked up afresh every tick, then keys with a cursor per player as the crowd has
+	const size_t players = 2000, ticks = 300;
+	const char* const modes[] = { "dense:        ", "keys:         ", "keys, cursor: " };
+	std::vector<MocapKeyCursor> cursors(players);
+	requests.resize(players);
+	for (size_t i = 0; i < players; i++) {
+		requests[i].keys = nullptr;
+		requests[i].keyCursor = nullptr;
+		requests[i].clip = clips[i % clips.size()].get();
+	}
+	double denseTickSeconds = 0.0;
+	for (int mode = 0; mode < 3; mode++) {
+		start = BenchClock::now();
+		for (size_t tick = 0; tick < ticks; tick++) {
+			for (size_t i = 0; i < players; i++) {
+				requests[i].seconds = i * 0.37 + tick / 60.0;
+			}
+			EvaluatePosesSerial(requests.data(), players, MocapDefaultFps, out.data());
+		}
+		double seconds = SecondsSince(start) / ticks;
+		if (mode == 0) {
+			denseTickSeconds = seconds;
+		}
+		std::cout << players << " players playing on, " << modes[mode] << seconds * 1000.0 << " ms per tick ("
+			<< seconds / denseTickSeconds << "x dense)\n";
+		for (size_t i = 0; i < players; i++) {
+			requests[i].keys = &keys[i % clips.size()];
+			requests[i].keyCursor = mode == 1 ? &cursors[i] : nullptr;
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+class Config;
+class IFilesystem;
+
+// offline benchmarks, run from the command line with --benchmark <name>
+void BenchmarkComapLoading(const Config& config, IFilesystem* fileSystem);
+void BenchmarkComapz(const Config& config, IFilesystem* fileSystem);
+// cold cache serial reads of every clip against one IFilesystem::ReadFiles batch
+void BenchmarkFileReads(const Config& config, IFilesystem* fileSystem);
+// poses/sec interpolating every clip with the MocapFrame glm::mix loop against the MocapPoseSoA kernels
+void BenchmarkPoseInterpolation(const Config& config, IFilesystem* fileSystem);
+// ms per tick evaluating a crossfade style blend tree for every player in a match
+void BenchmarkBlending(const Config& config, IFilesystem* fileSystem);
+// ms per query finding the nearest poses with MocapPoseIndex against comparing every frame, checking the two agree
+void BenchmarkPoseSearch(const Config& config, IFilesystem* fileSystem);
+// us per motion matching search, pruned against brute force, and ms per tick driving a match's players by it
+void BenchmarkMotionMatching(const Config& config, IFilesystem* fileSystem);
+// ms per clip pair for dynamic time warping, the banded anti-diagonal kernels against the whole cost matrix a cell at a time
+void BenchmarkTimeWarping(const Config& config, IFilesystem* fileSystem);
+// size and worst error reducing every clip to keys at KeyframeTolerance, and poses/sec sampling the keys against the dense frames
+void BenchmarkKeyframes(const Config& config, IFilesystem* fileSystem);
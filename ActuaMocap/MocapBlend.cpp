@@ -0,0 +1,145 @@
+#include "MocapBlend.h"
+#include "MocapClipSoA.h"
+#include "BasicTypedefs.h"
+#include <string.h>
+
+// by point, from the skeleton connectivity in Main.cpp
+static const u8 PointJointGroups[PlayerPoints] = {
+	JointGroupTorso, JointGroupTorso, JointGroupTorso, JointGroupTorso, JointGroupTorso,
+	JointGroupArms, JointGroupArms, // right elbow, right hand
+	JointGroupTorso,
+	JointGroupArms, JointGroupArms, // left elbow, left hand
+	JointGroupLegs, JointGroupLegs, // hang off the feet
+	JointGroupLegs, JointGroupLegs, JointGroupLegs, JointGroupLegs, // right pelvis, right knee, two off the right foot
+	JointGroupLegs, JointGroupLegs, JointGroupLegs, JointGroupLegs, // left pelvis, left knee, two off the left foot
+	JointGroupLegs, JointGroupLegs, // right foot, left foot
+	JointGroupTorso, JointGroupTorso, JointGroupTorso, JointGroupTorso, JointGroupTorso, JointGroupTorso, // shoulders among them
+};
+
+MocapJointGroup GetJointGroup(int point)
+{
+	return (MocapJointGroup)PointJointGroups[point];
+}
+
+void BlendPoses(const MocapPoseSoA* const* poses, const float* groupWeights, size_t count, MocapPoseSoA& out)
+{
+	MocapPoseSoA sum = {};
+	MocapPoseSoA totalWeight = {};
+	MocapPoseSoA weights = {}; // padding lanes stay 0
+	for (size_t i = 0; i < count; i++) {
+		const MocapPoseSoA& pose = *poses[i];
+		const float* group = groupWeights + i * NumJointGroups;
+		for (int p = 0; p < PlayerPoints; p++) {
+			bool missing = IsMissingPoint(glm::vec3(pose.x[p], pose.y[p], pose.z[p]));
+			float w = missing ? 0.0f : group[PointJointGroups[p]];
+			weights.x[p] = w;
+			weights.y[p] = w;
+			weights.z[p] = w;
+		}
+		AddWeightedPose(pose, weights, sum);
+		AddScaledPose(weights, 1.0f, totalWeight);
+	}
+	const float* ps = sum.x;
+	const float* pw = totalWeight.x;
+	float* po = out.x;
+	for (int i = 0; i < PosePaddedPoints * 3; i++) {
+		po[i] = pw[i] != 0.0f ? ps[i] / pw[i] : MocapMissingPointValue;
+	}
+	// keep the padding at zero like every other pose
+	for (int p = PlayerPoints; p < PosePaddedPoints; p++) {
+		out.x[p] = out.y[p] = out.z[p] = 0.0f;
+	}
+}
+
+void CrossfadePoses(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out)
+{
+	const MocapPoseSoA* poses[2] = { &a, &b };
+	float weights[2 * NumJointGroups];
+	for (int g = 0; g < NumJointGroups; g++) {
+		weights[g] = 1.0f - t;
+		weights[NumJointGroups + g] = t;
+	}
+	BlendPoses(poses, weights, 2, out);
+}
+
+MocapBlendTree::MocapBlendTree()
+{
+}
+
+size_t MocapBlendTree::AddClip(const MocapClipSoA* clip, double offsetSeconds, double rate, MocapWrapMode wrap)
+{
+	Node node;
+	node.clip = clip;
+	node.offsetSeconds = offsetSeconds;
+	node.rate = rate;
+	node.wrap = wrap;
+	_nodes.push_back(node);
+	_poses.resize(_nodes.size());
+	return _nodes.size() - 1;
+}
+
+size_t MocapBlendTree::AddBlend(const std::vector<size_t>& children)
+{
+	Node node;
+	node.clip = nullptr;
+	node.offsetSeconds = 0.0;
+	node.rate = 1.0;
+	node.wrap = MocapWrapMode::Loop;
+	for (size_t child : children) {
+		if (child < _nodes.size()) {
+			node.children.push_back(child);
+		}
+	}
+	node.weights.assign(node.children.size() * NumJointGroups, 1.0f);
+	_nodes.push_back(node);
+	_poses.resize(_nodes.size());
+	return _nodes.size() - 1;
+}
+
+void MocapBlendTree::SetWeight(size_t blendNode, size_t childSlot, float weight)
+{
+	for (int g = 0; g < NumJointGroups; g++) {
+		SetGroupWeight(blendNode, childSlot, (MocapJointGroup)g, weight);
+	}
+}
+
+void MocapBlendTree::SetGroupWeight(size_t blendNode, size_t childSlot, MocapJointGroup group, float weight)
+{
+	if (blendNode >= _nodes.size() || childSlot >= _nodes[blendNode].children.size()) {
+		return;
+	}
+	_nodes[blendNode].weights[childSlot * NumJointGroups + group] = weight;
+}
+
+const MocapPoseSoA& MocapBlendTree::Evaluate(double seconds, double fps, MocapInterpolation interpolation)
+{
+	static const MocapPoseSoA empty = {};
+	if (_nodes.empty()) {
+		return empty;
+	}
+	for (size_t i = 0; i < _nodes.size(); i++) {
+		const Node& node = _nodes[i];
+		MocapPoseSoA& out = _poses[i];
+		if (node.clip) {
+			size_t numFrames = node.clip->GetNumFrames();
+			if (numFrames == 0) {
+				memset(&out, 0, sizeof(MocapPoseSoA));
+				continue;
+			}
+			MocapFramePair pair = MapTimeToFrames(node.offsetSeconds + seconds * node.rate, fps, numFrames, node.wrap);
+			if (interpolation == MocapInterpolation::CatmullRom && node.clip->HasCubic()) {
+				node.clip->SampleCubic(pair.frame, pair.t, out);
+			}
+			else {
+				node.clip->Sample(pair.frame, pair.next, pair.t, out);
+			}
+			continue;
+		}
+		_childPoses.clear();
+		for (size_t child : node.children) {
+			_childPoses.push_back(&_poses[child]);
+		}
+		BlendPoses(_childPoses.data(), node.weights.data(), _childPoses.size(), out);
+	}
+	return _poses.back();
+}
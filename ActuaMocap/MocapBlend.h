@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <stddef.h>
+#include "MocapPoseSoA.h"
+#include "MocapSampler.h"
+
+class MocapClipSoA;
+
+enum MocapJointGroup {
+	JointGroupTorso, // head, spine, hips and shoulders
+	JointGroupArms,
+	JointGroupLegs,  // pelvis points, knees and feet
+	NumJointGroups
+};
+
+MocapJointGroup GetJointGroup(int point);
+
+/// <summary>
+/// out = the weighted average of count poses, with groupWeights[i * NumJointGroups + group] weighting
+/// pose i's points in that group. weights don't need to add up to 1. a point missing from a pose is
+/// left out of that point's average, and stays missing if it's missing from every pose that's weighted
+/// </summary>
+void BlendPoses(const MocapPoseSoA* const* poses, const float* groupWeights, size_t count, MocapPoseSoA& out);
+
+/// <summary>
+/// BlendPoses of two poses, b weighted by t and a by 1 - t in every group
+/// </summary>
+void CrossfadePoses(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out);
+
+/// <summary>
+/// clips playing at their own offsets and rates, mixed by blend nodes with a weight per child per joint group.
+/// nodes can only take children added before them, so evaluating in order is enough and there's no recursion.
+/// holds a pose per node, so use one tree per player when evaluating in parallel
+/// </summary>
+class MocapBlendTree
+{
+public:
+	MocapBlendTree();
+	/// <summary>
+	/// a leaf playing clip, which must outlive the tree. returns the node's index
+	/// </summary>
+	size_t AddClip(const MocapClipSoA* clip, double offsetSeconds = 0.0, double rate = 1.0, MocapWrapMode wrap = MocapWrapMode::Loop);
+	/// <summary>
+	/// a node mixing children, weighted 1 each until set otherwise. returns the node's index
+	/// </summary>
+	size_t AddBlend(const std::vector<size_t>& children);
+	void SetWeight(size_t blendNode, size_t childSlot, float weight); // every joint group
+	void SetGroupWeight(size_t blendNode, size_t childSlot, MocapJointGroup group, float weight);
+	inline size_t GetNumNodes() const {
+		return _nodes.size();
+	}
+	/// <summary>
+	/// evaluate every node at seconds and return the last one added, which is the root. a zero pose for an empty tree
+	/// </summary>
+	const MocapPoseSoA& Evaluate(double seconds, double fps, MocapInterpolation interpolation = MocapInterpolation::Linear);
+private:
+	struct Node {
+		const MocapClipSoA* clip; // nullptr for blend nodes
+		double offsetSeconds;
+		double rate;
+		MocapWrapMode wrap;
+		std::vector<size_t> children;
+		std::vector<float> weights; // NumJointGroups per child
+	};
+	std::vector<Node> _nodes;
+	std::vector<MocapPoseSoA> _poses; // one per node, filled by Evaluate
+	std::vector<const MocapPoseSoA*> _childPoses;
+};
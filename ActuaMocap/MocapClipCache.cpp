@@ -0,0 +1,80 @@
+#include "MocapClipCache.h"
+#include "MocapFile.h"
+
+MocapClipCache::MocapClipCache(size_t budgetBytes)
+	:_budgetBytes(budgetBytes)
+{
+}
+
+std::shared_ptr<MocapFile> MocapClipCache::Find(const std::string& key, const FileStat& stat)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _entries.find(key);
+	if (found == _entries.end()) {
+		_misses++;
+		return nullptr;
+	}
+	if (found->second->stat != stat) {
+		// the file changed on disk since it was cached
+		EraseLocked(found->second);
+		_misses++;
+		return nullptr;
+	}
+	_lru.splice(_lru.begin(), _lru, found->second);
+	_hits++;
+	return found->second->file;
+}
+
+void MocapClipCache::Insert(const std::string& key, const FileStat& stat, std::shared_ptr<MocapFile> file)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto found = _entries.find(key);
+	if (found != _entries.end()) {
+		EraseLocked(found->second);
+	}
+	size_t bytes = file->GetMemoryFootprint();
+	if (bytes > _budgetBytes) {
+		return;
+	}
+	_lru.push_front({ key, stat, std::move(file), bytes });
+	_entries[key] = _lru.begin();
+	_bytes += bytes;
+	EvictToBudgetLocked();
+}
+
+void MocapClipCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_lru.clear();
+	_entries.clear();
+	_bytes = 0;
+}
+
+MocapClipCacheStats MocapClipCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	MocapClipCacheStats stats;
+	stats.hits = _hits;
+	stats.misses = _misses;
+	stats.evictions = _evictions;
+	stats.entries = _lru.size();
+	stats.bytes = _bytes;
+	stats.budgetBytes = _budgetBytes;
+	return stats;
+}
+
+void MocapClipCache::EraseLocked(std::list<Entry>::iterator it)
+{
+	// whoever is still playing the clip keeps it alive through their own shared_ptr
+	_bytes -= it->bytes;
+	_entries.erase(it->key);
+	_lru.erase(it);
+}
+
+void MocapClipCache::EvictToBudgetLocked()
+{
+	while (_bytes > _budgetBytes && !_lru.empty()) {
+		EraseLocked(std::prev(_lru.end()));
+		_evictions++;
+	}
+}
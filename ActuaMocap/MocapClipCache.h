@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "IFilesystem.h"
+#include "BasicTypedefs.h"
+
+class MocapFile;
+
+struct MocapClipCacheStats {
+	u64 hits = 0;
+	u64 misses = 0;    // includes lookups that found a stale entry
+	u64 evictions = 0; // entries dropped to stay under budget, stale entries aren't counted
+	size_t entries = 0;
+	size_t bytes = 0;
+	size_t budgetBytes = 0;
+};
+
+/// <summary>
+/// recently loaded clips kept decoded, so flipping back and forth between a few clips
+/// only pays for each load once. entries are keyed by path and only valid while the
+/// file's size and modification time match what they were when it was loaded.
+/// the least recently used entries are dropped once the total footprint passes the budget.
+/// safe to use from the loading threads and the ui thread at once
+/// </summary>
+class MocapClipCache
+{
+public:
+	MocapClipCache(size_t budgetBytes);
+	/// <summary>
+	/// the cached clip for key if stat still matches, nullptr otherwise. a stale entry is dropped
+	/// </summary>
+	std::shared_ptr<MocapFile> Find(const std::string& key, const FileStat& stat);
+	/// <summary>
+	/// add a freshly loaded clip, replacing any entry under the same key.
+	/// a clip bigger than the whole budget isn't kept
+	/// </summary>
+	void Insert(const std::string& key, const FileStat& stat, std::shared_ptr<MocapFile> file);
+	void Clear();
+	MocapClipCacheStats GetStats() const;
+private:
+	struct Entry {
+		std::string key;
+		FileStat stat;
+		std::shared_ptr<MocapFile> file;
+		size_t bytes;
+	};
+	void EraseLocked(std::list<Entry>::iterator it);
+	void EvictToBudgetLocked();
+private:
+	// front is the most recently used
+	std::list<Entry> _lru;
+	std::unordered_map<std::string, std::list<Entry>::iterator> _entries;
+	size_t _bytes = 0;
+	size_t _budgetBytes;
+	u64 _hits = 0;
+	u64 _misses = 0;
+	u64 _evictions = 0;
+	mutable std::mutex _mutex;
+};
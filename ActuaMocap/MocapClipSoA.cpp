@@ -0,0 +1,107 @@
+#include "MocapClipSoA.h"
+#include "MocapFile.h"
+#include <stdlib.h>
+#include <utility>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static void* AllocateAligned(size_t size, size_t alignment) {
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	void* p = nullptr;
+	return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+#endif
+}
+
+static void FreeAligned(void* p) {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+MocapClipSoA::MocapClipSoA()
+{
+}
+
+MocapClipSoA::~MocapClipSoA()
+{
+	FreeAligned(_poses);
+	FreeAligned(_cubic);
+}
+
+void MocapClipSoA::Allocate(size_t numFrames)
+{
+	_numFrames = 0;
+	_hasCubic = false;
+	if (numFrames > _capacity) {
+		FreeAligned(_poses);
+		_poses = (MocapPoseSoA*)AllocateAligned(numFrames * sizeof(MocapPoseSoA), alignof(MocapPoseSoA));
+		_capacity = _poses ? numFrames : 0;
+		if (!_poses) {
+			return;
+		}
+	}
+	_numFrames = numFrames;
+}
+
+void MocapClipSoA::Build(const MocapFrame* frames, size_t numFrames)
+{
+	Allocate(numFrames);
+	for (size_t i = 0; i < _numFrames; i++) {
+		PoseFromFrame(frames[i], _poses[i]);
+	}
+}
+
+void MocapClipSoA::Build(const MocapFile& file)
+{
+	if (const MocapFrame* frames = file.GetFramePointer()) {
+		Build(frames, file.GetNumFrames());
+		return;
+	}
+	Allocate(file.GetNumFrames());
+	MocapFrame frame;
+	for (size_t i = 0; i < _numFrames; i++) {
+		file.GetFrame(i, frame);
+		PoseFromFrame(frame, _poses[i]);
+	}
+}
+
+void MocapClipSoA::Clear()
+{
+	_numFrames = 0;
+	_hasCubic = false;
+}
+
+void MocapClipSoA::Swap(MocapClipSoA& other)
+{
+	std::swap(_poses, other._poses);
+	std::swap(_numFrames, other._numFrames);
+	std::swap(_capacity, other._capacity);
+	std::swap(_cubic, other._cubic);
+	std::swap(_cubicCapacity, other._cubicCapacity);
+	std::swap(_hasCubic, other._hasCubic);
+}
+
+void MocapClipSoA::BuildCubic()
+{
+	if (_numFrames == 0 || _hasCubic) {
+		return;
+	}
+	if (_numFrames > _cubicCapacity) {
+		FreeAligned(_cubic);
+		_cubic = (MocapPoseSoA*)AllocateAligned(_numFrames * 4 * sizeof(MocapPoseSoA), alignof(MocapPoseSoA));
+		_cubicCapacity = _cubic ? _numFrames : 0;
+		if (!_cubic) {
+			return;
+		}
+	}
+	size_t n = _numFrames;
+	for (size_t i = 0; i < n; i++) {
+		CatmullRomCoefficients(_poses[(i + n - 1) % n], _poses[i], _poses[(i + 1) % n], _poses[(i + 2) % n], _cubic + i * 4);
+	}
+	_hasCubic = true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stddef.h>
+#include "MocapPoseSoA.h"
+
+class MocapFile;
+
+/// <summary>
+/// every frame of a clip as MocapPoseSoA, in one 32 byte aligned block, so a pose
+/// between any two frames is a single LerpPoses call
+/// </summary>
+class MocapClipSoA
+{
+public:
+	MocapClipSoA();
+	~MocapClipSoA();
+	MocapClipSoA(const MocapClipSoA&) = delete;
+	MocapClipSoA& operator=(const MocapClipSoA&) = delete;
+	void Build(const MocapFrame* frames, size_t numFrames);
+	/// <summary>
+	/// convert every frame of file, whichever backend holds them
+	/// </summary>
+	void Build(const MocapFile& file);
+	void Clear();
+	void Swap(MocapClipSoA& other);
+	inline size_t GetNumFrames() const {
+		return _numFrames;
+	}
+	inline const MocapPoseSoA& GetPose(size_t index) const {
+		return _poses[index];
+	}
+	inline const MocapPoseSoA* GetPoses() const {
+		return _poses;
+	}
+	/// <summary>
+	/// blend frames a and b by t into out
+	/// </summary>
+	inline void Sample(size_t a, size_t b, float t, MocapPoseSoA& out) const {
+		LerpPoses(_poses[a], _poses[b], t, out);
+	}
+	/// <summary>
+	/// precompute Catmull-Rom coefficients for the segment after every frame, 4 poses each.
+	/// the last frame's segment runs back to the first, as looping playback does
+	/// </summary>
+	void BuildCubic();
+	inline bool HasCubic() const {
+		return _hasCubic;
+	}
+	inline const MocapPoseSoA* GetCubicSegment(size_t frame) const {
+		return _cubic + frame * 4;
+	}
+	/// <summary>
+	/// the pose t of the way from frame to the one after it, on the curve. needs BuildCubic
+	/// </summary>
+	inline void SampleCubic(size_t frame, float t, MocapPoseSoA& out) const {
+		EvaluateCubicPose(GetCubicSegment(frame), t, out);
+	}
+private:
+	void Allocate(size_t numFrames);
+private:
+	MocapPoseSoA* _poses = nullptr;
+	size_t _numFrames = 0;
+	size_t _capacity = 0;
+	MocapPoseSoA* _cubic = nullptr; // 4 coefficient poses per frame once BuildCubic has run
+	size_t _cubicCapacity = 0;
+	bool _hasCubic = false;
+};
@@ -0,0 +1,484 @@
+#include "MocapCrowd.h"
+#include "MocapFile.h"
+#include "ThreadPool.h"
+#include "BasicTypedefs.h"
+#include <chrono>
+#include <float.h>
+#include <string.h>
+#include <math.h>
+#include <glm/gtc/constants.hpp>
+
+#define CrowdBlockSize 16 // players per ParallelFor index
+#define CrowdSphereRadius 0.5f
+// a point blending to or from a missing one is dragged most of the way to MocapMissingPointValue,
+// far below anything a player could reach, so hide it rather than draw it underground
+#define CrowdHiddenBelow (MocapMissingPointValue / 100.0f)
+
+#define CrowdMatchFadeSeconds 0.25
+#define CrowdMatchSearchSeconds 0.1 // between searches while a clip plays on
+#define CrowdMatchJumpBias 0.8f     // a jump has to cost less than this much of carrying on
+#define CrowdMatchResponse 0.2f     // per frame, how quickly the predicted trajectory turns to follow the stick
+#define CrowdMatchTurnRate 3.0f     // radians per second
+#define CrowdWanderSeconds 3.0      // players not under control pick a new direction this often
+#define CrowdWanderLeash 150.0f     // and head home once they get this far away
+
+static const glm::vec4 HomeColour = { 0.85f, 0.1f, 0.1f, 1.0f };
+static const glm::vec4 AwayColour = { 0.1f, 0.25f, 0.85f, 1.0f };
+static const glm::vec4 HomeKeeperColour = { 0.95f, 0.85f, 0.1f, 1.0f };
+static const glm::vec4 AwayKeeperColour = { 0.1f, 0.8f, 0.3f, 1.0f };
+static const glm::vec4 RefereeColour = { 0.1f, 0.1f, 0.1f, 1.0f };
+
+// 4-4-2 for the home team, in fractions of the half it defends, x towards halfway and z across the pitch
+static const glm::vec2 Formation[CrowdTeamSize] = {
+	{ 0.05f, 0.5f },
+	{ 0.3f, 0.15f }, { 0.3f, 0.38f }, { 0.3f, 0.62f }, { 0.3f, 0.85f },
+	{ 0.6f, 0.15f }, { 0.6f, 0.38f }, { 0.6f, 0.62f }, { 0.6f, 0.85f },
+	{ 0.9f, 0.4f }, { 0.9f, 0.6f },
+};
+
+// referee in the centre circle, assistants on opposite touchlines
+static const glm::vec2 RefereePositions[CrowdReferees] = {
+	{ 0.5f, 0.4f }, { 0.25f, -0.02f }, { 0.75f, 1.02f },
+};
+
+// small integer hash so every player gets the same clip and phase on every run
+static u32 HashIndex(u32 x) {
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+static float HashUnit(u32 x) {
+	return (HashIndex(x) & 0xffffff) / (float)0x1000000;
+}
+
+MocapCrowd::MocapCrowd()
+{
+	BuildPitchLines();
+}
+
+bool MocapCrowd::AddClip(const MocapFile& file)
+{
+	if (file.GetNumFrames() == 0) {
+		return false;
+	}
+	std::unique_ptr<MocapClipSoA> clip(new MocapClipSoA());
+	clip->Build(file);
+	if (clip->GetNumFrames() == 0) {
+		return false;
+	}
+	if (_interpolation == MocapInterpolation::CatmullRom) {
+		clip->BuildCubic();
+	}
+	const MocapPoseSoA& first = clip->GetPose(0);
+	glm::vec3 origin(0.0f);
+	int found = 0;
+	for (int i = 0; i < PlayerPoints; i++) {
+		glm::vec3 point(first.x[i], first.y[i], first.z[i]);
+		if (!IsMissingPoint(point)) {
+			origin += point;
+			found++;
+		}
+	}
+	origin = found ? origin / (float)found : origin;
+	origin.y = 0.0f;
+	if (!_keyClips.empty()) {
+		_keyClips.emplace_back();
+		_keyClips.back().Build(*clip, _keyTolerance);
+	}
+	_clips.push_back(std::move(clip));
+	_clipOrigins.push_back(origin);
+	return true;
+}
+
+void MocapCrowd::SetInterpolation(MocapInterpolation interpolation)
+{
+	_interpolation = interpolation;
+	if (_interpolation == MocapInterpolation::CatmullRom) {
+		for (auto& clip : _clips) {
+			clip->BuildCubic();
+		}
+	}
+}
+
+void MocapCrowd::PlacePlayer(size_t index, CrowdPlayer& player) const
+{
+	const size_t formationPlayers = 2 * CrowdTeamSize;
+	glm::vec2 onPitch; // fractions of the pitch length and width
+	if (index < formationPlayers) {
+		bool home = index < CrowdTeamSize;
+		glm::vec2 slot = Formation[index % CrowdTeamSize];
+		onPitch = home ? glm::vec2(slot.x * 0.5f, slot.y) : glm::vec2(1.0f - slot.x * 0.5f, 1.0f - slot.y);
+		bool keeper = index % CrowdTeamSize == 0;
+		player.colour = home ? (keeper ? HomeKeeperColour : HomeColour) : (keeper ? AwayKeeperColour : AwayColour);
+		player.yaw = home ? 0.0f : glm::pi<float>();
+	}
+	else if (index < formationPlayers + CrowdReferees) {
+		onPitch = RefereePositions[index - formationPlayers];
+		player.colour = RefereeColour;
+		player.yaw = glm::half_pi<float>();
+	}
+	else {
+		onPitch = glm::vec2(HashUnit((u32)index * 2), HashUnit((u32)index * 2 + 1));
+		player.colour = index % 2 ? HomeColour : AwayColour;
+		player.yaw = HashUnit((u32)index * 3) * glm::two_pi<float>();
+	}
+	player.position = glm::vec3((onPitch.x - 0.5f) * CrowdPitchLength, 0.0f, (onPitch.y - 0.5f) * CrowdPitchWidth);
+	player.clip = HashIndex((u32)index) % _clips.size();
+	double clipSeconds = _clips[player.clip]->GetNumFrames() / MocapDefaultFps;
+	player.phaseSeconds = HashUnit((u32)index * 5 + 1) * clipSeconds;
+}
+
+void MocapCrowd::SetNumPlayers(size_t numPlayers)
+{
+	if (_clips.empty()) {
+		numPlayers = 0;
+	}
+	_players.resize(numPlayers);
+	_requests.resize(numPlayers);
+	_keyCursors.resize(numPlayers);
+	_poses.resize(numPlayers);
+	_instances.resize(numPlayers * PlayerPoints);
+	for (size_t i = 0; i < numPlayers; i++) {
+		PlacePlayer(i, _players[i]);
+		_requests[i].clip = _clips[_players[i].clip].get();
+		_requests[i].keys = KeysFor(_players[i].clip);
+		_requests[i].keyCursor = &_keyCursors[i];
+		_requests[i].seconds = _players[i].phaseSeconds + _time;
+		_requests[i].wrap = MocapWrapMode::Loop;
+	}
+	if (_matching) {
+		_matchStates.resize(numPlayers);
+		_fadeRequests.resize(numPlayers);
+		_fadeKeyCursors.resize(numPlayers);
+		_fadePoses.resize(numPlayers);
+		for (size_t i = 0; i < numPlayers; i++) {
+			_fadeRequests[i].keyCursor = &_fadeKeyCursors[i];
+			ResetMatchState(i);
+		}
+	}
+}
+
+void MocapCrowd::SetMotionMatching(bool enabled, const MocapPoseIndex& poseIndex)
+{
+	if (enabled && !_matchDatabase) {
+		std::vector<const MocapClipSoA*> clips;
+		for (const auto& clip : _clips) {
+			clips.push_back(clip.get());
+		}
+		_matchDatabase = std::make_unique<MocapMatchDatabase>();
+		_matchDatabase->Build(clips.data(), clips.size(), poseIndex);
+	}
+	_matching = enabled;
+	// back in formation either way
+	SetNumPlayers(_players.size());
+}
+
+void MocapCrowd::ResetMatchDatabase()
+{
+	_matchDatabase.reset();
+	if (_matching) {
+		_matching = false;
+		SetNumPlayers(_players.size());
+	}
+}
+
+void MocapCrowd::SetKeyframed(bool enabled, float tolerance)
+{
+	if (enabled && (_keyClips.size() != _clips.size() || tolerance != _keyTolerance)) {
+		std::vector<const MocapClipSoA*> clips;
+		for (const auto& clip : _clips) {
+			clips.push_back(clip.get());
+		}
+		_keyClips.clear();
+		_keyClips.resize(clips.size());
+		_keyTolerance = tolerance;
+		ReduceClips(clips.data(), clips.size(), tolerance, _keyClips.data());
+		// the new keys can sit where the old ones were, so the cursors can't tell them apart
+		for (auto& cursor : _keyCursors) {
+			cursor.Reset();
+		}
+		for (auto& cursor : _fadeKeyCursors) {
+			cursor.Reset();
+		}
+	}
+	_keyframed = enabled;
+	for (size_t i = 0; i < _players.size(); i++) {
+		const size_t clip = _matching ? _matchStates[i].clip : _players[i].clip;
+		_requests[i].keys = KeysFor(clip);
+		if (_matching) {
+			_fadeRequests[i].keys = KeysFor(_matchStates[i].fadeClip);
+		}
+	}
+}
+
+size_t MocapCrowd::GetKeyBytes() const
+{
+	size_t bytes = 0;
+	for (const auto& keys : _keyClips) {
+		bytes += keys.GetSizeBytes();
+	}
+	return bytes;
+}
+
+size_t MocapCrowd::GetDenseBytes() const
+{
+	size_t bytes = 0;
+	for (const auto& clip : _clips) {
+		bytes += clip->GetNumFrames() * sizeof(MocapPoseSoA);
+	}
+	return bytes;
+}
+
+void MocapCrowd::ResetMatchState(size_t index)
+{
+	CrowdMatchState& state = _matchStates[index];
+	const CrowdPlayer& player = _players[index];
+	size_t numFrames = _clips[player.clip]->GetNumFrames();
+	state.clip = (u32)player.clip;
+	state.frame = numFrames > 1 ? HashUnit((u32)index * 5 + 1) * (numFrames - 1) : 0.0;
+	state.fadeClip = state.clip;
+	state.fadeFrame = 0.0;
+	state.fade = 0.0f;
+	state.sinceSearch = 0.0;
+	state.stick = glm::vec2(0.0f);
+	state.home = player.position;
+	state.searchSeconds = 0.0;
+	state.searched = false;
+	_requests[index].wrap = MocapWrapMode::Clamp;
+	_fadeRequests[index].wrap = MocapWrapMode::Clamp;
+}
+
+glm::vec2 MocapCrowd::WanderStick(size_t index) const
+{
+	if (index == CrowdControlledPlayer) {
+		return _controlStick;
+	}
+	const CrowdPlayer& player = _players[index];
+	const CrowdMatchState& state = _matchStates[index];
+	glm::vec2 home(state.home.x - player.position.x, state.home.z - player.position.z);
+	if (glm::length(home) > CrowdWanderLeash) {
+		return glm::normalize(home);
+	}
+	u32 slot = (u32)(_time / CrowdWanderSeconds) * 7919u + (u32)index;
+	if (HashIndex(slot) % 3 == 0) {
+		return glm::vec2(0.0f); // stand still for a bit
+	}
+	float angle = HashUnit(slot * 2 + 1) * glm::two_pi<float>();
+	float speed = 0.5f + 0.5f * HashUnit(slot * 2 + 2);
+	return glm::vec2(cosf(angle), sinf(angle)) * speed;
+}
+
+void MocapCrowd::StepMatchedPlayer(size_t index, double deltaT)
+{
+	CrowdPlayer& player = _players[index];
+	CrowdMatchState& state = _matchStates[index];
+	const MocapMatchDatabase& database = *_matchDatabase;
+	state.stick = WanderStick(index);
+
+	// turn towards the stick, the clips' own forward is along x
+	float stickLength = glm::length(state.stick);
+	if (stickLength > 0.2f) {
+		float wanted = atan2f(-state.stick.y, state.stick.x);
+		float turn = wanted - player.yaw;
+		turn = atan2f(sinf(turn), cosf(turn));
+		float maxTurn = (float)(CrowdMatchTurnRate * deltaT);
+		player.yaw += std::max(-maxTurn, std::min(maxTurn, turn));
+	}
+	float c = cosf(player.yaw);
+	float s = sinf(player.yaw);
+
+	// play on, moving the player by however far the clip's root moved
+	double frames = deltaT * _fps;
+	size_t numFrames = database.GetNumFrames(state.clip);
+	glm::vec2 rootBefore = database.GetRoot(state.clip, state.frame);
+	state.frame = std::min(state.frame + frames, (double)(numFrames > 0 ? numFrames - 1 : 0));
+	glm::vec2 step = database.GetRoot(state.clip, state.frame) - rootBefore;
+	player.position += glm::vec3(c * step.x + s * step.y, 0.0f, c * step.y - s * step.x);
+	player.position.x = std::max(-CrowdPitchLength * 0.55f, std::min(CrowdPitchLength * 0.55f, player.position.x));
+	player.position.z = std::max(-CrowdPitchWidth * 0.55f, std::min(CrowdPitchWidth * 0.55f, player.position.z));
+	if (state.fade > 0.0f) {
+		state.fadeFrame = std::min(state.fadeFrame + frames, (double)(database.GetNumFrames(state.fadeClip) - 1));
+		state.fade = std::max(0.0f, state.fade - (float)(deltaT / CrowdMatchFadeSeconds));
+	}
+	state.sinceSearch += deltaT;
+	state.searched = false;
+
+	bool atEnd = state.frame + 1.0 >= numFrames;
+	if (atEnd || (state.fade <= 0.0f && state.sinceSearch >= CrowdMatchSearchSeconds)) {
+		auto start = std::chrono::high_resolution_clock::now();
+		u32 frame = (u32)state.frame;
+		float query[MotionMatchFeatures];
+		database.GetFeatures(state.clip, frame, query);
+
+		// where the root should be, easing from how it's moving now towards the stick, in the clip's axes
+		glm::vec2 wanted(c * state.stick.x - s * state.stick.y, s * state.stick.x + c * state.stick.y);
+		wanted *= database.GetMaxSpeed();
+		glm::vec2 moving = database.GetRoot(state.clip, frame + 1.0) - database.GetRoot(state.clip, frame);
+		glm::vec2 trajectory[MotionMatchTrajectoryPoints];
+		for (int k = 0; k < MotionMatchTrajectoryPoints; k++) {
+			float t = (float)MotionMatchTrajectoryFrames[k];
+			trajectory[k] = wanted * t + (moving - wanted) * (1.0f - expf(-CrowdMatchResponse * t)) / CrowdMatchResponse;
+		}
+		float carryOn[MotionMatchFeatures];
+		memcpy(carryOn, query, sizeof(query));
+		database.SetTrajectory(trajectory, query);
+		float costToBeat = atEnd ? FLT_MAX : MocapMatchDatabase::Cost(query, carryOn) * CrowdMatchJumpBias;
+
+		MotionMatchResult match;
+		if (database.Search(query, costToBeat, state.clip, frame, match)) {
+			state.fadeClip = state.clip;
+			state.fadeFrame = state.frame;
+			state.fade = 1.0f;
+			state.clip = match.clip;
+			state.frame = match.frame;
+		}
+		else if (atEnd) {
+			// nothing else to go to, start the clip again
+			state.frame = 0.0;
+		}
+		state.sinceSearch = 0.0;
+		state.searched = true;
+		state.searchSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	_requests[index].clip = _clips[state.clip].get();
+	_requests[index].keys = KeysFor(state.clip);
+	_requests[index].seconds = state.frame / _fps;
+	_fadeRequests[index].clip = _clips[state.fadeClip].get();
+	_fadeRequests[index].keys = KeysFor(state.fadeClip);
+	_fadeRequests[index].seconds = state.fadeFrame / _fps;
+}
+
+void MocapCrowd::BlendMatchedPose(size_t index)
+{
+	const CrowdMatchState& state = _matchStates[index];
+	MocapPoseSoA& pose = _poses[index];
+	glm::vec2 root = _matchDatabase->GetRoot(state.clip, state.frame);
+	if (state.fade <= 0.0f) {
+		for (int p = 0; p < PlayerPoints; p++) {
+			if (!IsMissingPoint(glm::vec3(pose.x[p], pose.y[p], pose.z[p]))) {
+				pose.x[p] -= root.x;
+				pose.z[p] -= root.y;
+			}
+		}
+		return;
+	}
+	EvaluatePosesSerial(&_fadeRequests[index], 1, _fps, &_fadePoses[index], _interpolation);
+	const MocapPoseSoA& from = _fadePoses[index];
+	glm::vec2 fromRoot = _matchDatabase->GetRoot(state.fadeClip, state.fadeFrame);
+	float t = 1.0f - state.fade;
+	for (int p = 0; p < PlayerPoints; p++) {
+		glm::vec3 a(from.x[p] - fromRoot.x, from.y[p], from.z[p] - fromRoot.y);
+		glm::vec3 b(pose.x[p] - root.x, pose.y[p], pose.z[p] - root.y);
+		bool aMissing = IsMissingPoint(glm::vec3(from.x[p], from.y[p], from.z[p]));
+		bool bMissing = IsMissingPoint(glm::vec3(pose.x[p], pose.y[p], pose.z[p]));
+		// a point only one side has is taken from that side rather than dragged towards the missing value
+		glm::vec3 mixed = aMissing ? (bMissing ? glm::vec3(MocapMissingPointValue) : b) : (bMissing ? a : glm::mix(a, b, t));
+		pose.x[p] = mixed.x;
+		pose.y[p] = mixed.y;
+		pose.z[p] = mixed.z;
+	}
+}
+
+void MocapCrowd::Update(double deltaT)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	_time += deltaT;
+	size_t numPlayers = _players.size();
+	size_t numBlocks = (numPlayers + CrowdBlockSize - 1) / CrowdBlockSize;
+	auto updateBlock = [&](size_t block) {
+		size_t first = block * CrowdBlockSize;
+		size_t last = first + CrowdBlockSize < numPlayers ? first + CrowdBlockSize : numPlayers;
+		for (size_t i = first; i < last; i++) {
+			if (_matching) {
+				StepMatchedPlayer(i, deltaT);
+			}
+			else {
+				_requests[i].seconds = _players[i].phaseSeconds + _time;
+			}
+		}
+		EvaluatePosesSerial(&_requests[first], last - first, _fps, &_poses[first], _interpolation);
+		for (size_t i = first; i < last; i++) {
+			if (_matching) {
+				BlendMatchedPose(i);
+			}
+			const CrowdPlayer& player = _players[i];
+			const MocapPoseSoA& pose = _poses[i];
+			// matched poses are already relative to their roots
+			const glm::vec3 origin = _matching ? glm::vec3(0.0f) : _clipOrigins[player.clip];
+			float c = cosf(player.yaw);
+			float s = sinf(player.yaw);
+			SphereInstance* out = &_instances[i * PlayerPoints];
+			for (int p = 0; p < PlayerPoints; p++) {
+				glm::vec3 point(pose.x[p], pose.y[p], pose.z[p]);
+				if (point.x < CrowdHiddenBelow || point.y < CrowdHiddenBelow || point.z < CrowdHiddenBelow) {
+					out[p].position = player.position;
+					out[p].radius = 0.0f;
+				}
+				else {
+					float x = point.x - origin.x;
+					float z = point.z - origin.z;
+					out[p].position = player.position + glm::vec3(c * x + s * z, point.y, c * z - s * x);
+					out[p].radius = CrowdSphereRadius;
+				}
+				out[p].colour = player.colour;
+			}
+		}
+	};
+	if (numBlocks > 1) {
+		GetFrameThreadPool().ParallelFor(numBlocks, updateBlock);
+	}
+	else if (numBlocks == 1) {
+		updateBlock(0);
+	}
+	if (_matching) {
+		double searchSeconds = 0.0;
+		_lastSearches = 0;
+		for (const auto& state : _matchStates) {
+			if (state.searched) {
+				searchSeconds += state.searchSeconds;
+				_lastSearches++;
+			}
+		}
+		_lastSearchMicroseconds = _lastSearches > 0 ? searchSeconds * 1e6 / _lastSearches : 0.0;
+	}
+	_lastUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void MocapCrowd::BuildPitchLines()
+{
+	const float hl = CrowdPitchLength * 0.5f;
+	const float hw = CrowdPitchWidth * 0.5f;
+	const glm::vec3 corners[4] = { { -hl, 0, -hw }, { hl, 0, -hw }, { hl, 0, hw }, { -hl, 0, hw } };
+	for (int i = 0; i < 4; i++) {
+		_pitchLines.push_back(corners[i]);
+		_pitchLines.push_back(corners[(i + 1) % 4]);
+	}
+	_pitchLines.push_back({ 0, 0, -hw });
+	_pitchLines.push_back({ 0, 0, hw });
+	// centre circle, 9.15m with the pitch 105m long
+	const int segments = 32;
+	const float radius = CrowdPitchLength * 9.15f / 105.0f;
+	for (int i = 0; i < segments; i++) {
+		float a0 = glm::two_pi<float>() * i / segments;
+		float a1 = glm::two_pi<float>() * (i + 1) / segments;
+		_pitchLines.push_back({ cosf(a0) * radius, 0, sinf(a0) * radius });
+		_pitchLines.push_back({ cosf(a1) * radius, 0, sinf(a1) * radius });
+	}
+	// penalty areas, 16.5m deep and 40.3m wide
+	const float depth = CrowdPitchLength * 16.5f / 105.0f;
+	const float halfWidth = CrowdPitchWidth * 20.15f / 68.0f;
+	for (int side = -1; side <= 1; side += 2) {
+		float goalLine = side * hl;
+		float edge = side * (hl - depth);
+		_pitchLines.push_back({ goalLine, 0, -halfWidth });
+		_pitchLines.push_back({ edge, 0, -halfWidth });
+		_pitchLines.push_back({ edge, 0, -halfWidth });
+		_pitchLines.push_back({ edge, 0, halfWidth });
+		_pitchLines.push_back({ edge, 0, halfWidth });
+		_pitchLines.push_back({ goalLine, 0, halfWidth });
+	}
+}
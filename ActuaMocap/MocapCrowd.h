@@ -0,0 +1,160 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+#include "MocapClipSoA.h"
+#include "MocapKeyClip.h"
+#include "MocapPoseBatch.h"
+#include "SphereInstance.h"
+#include "MocapMotionMatching.h"
+
+class MocapFile;
+class MocapPoseIndex;
+
+#define CrowdTeamSize 11
+#define CrowdReferees 3
+#define CrowdPitchLength 1400.0f // clip units, a player is roughly 25 tall
+#define CrowdPitchWidth 900.0f
+#define CrowdControlledPlayer 9 // the home side's first striker, steered by SetControlStick when motion matching
+
+struct CrowdPlayer {
+	size_t clip;          // into the crowd's clips
+	double phaseSeconds;  // offset into the clip at crowd time 0
+	glm::vec3 position;   // where the clip's first frame is centred on the pitch
+	float yaw;            // radians about y
+	glm::vec4 colour;
+};
+
+// a player driven by motion matching, playing from frame of clip while fading out of fadeClip
+struct CrowdMatchState {
+	u32 clip;
+	double frame;
+	u32 fadeClip;
+	double fadeFrame;
+	float fade;            // weight of fadeClip, falls to 0 over the fade
+	double sinceSearch;    // seconds
+	glm::vec2 stick;       // wanted direction and speed on the pitch, x along it and y across, length up to 1
+	glm::vec3 home;        // where it was placed, wandering players are pulled back towards it
+	double searchSeconds;  // how long its last search took
+	bool searched;         // during the last Update
+};
+
+/// <summary>
+/// a pitch full of players each playing their own clip. poses are evaluated with EvaluatePosesSerial and
+/// placed into SphereInstances in blocks across GetFrameThreadPool, so one instanced draw shows the whole crowd.
+/// the first 2 * CrowdTeamSize + CrowdReferees players take up a kick off formation, any more fill the pitch
+/// </summary>
+class MocapCrowd
+{
+public:
+	MocapCrowd();
+	/// <summary>
+	/// convert file's frames into a clip players can be given, returns false for an empty file
+	/// </summary>
+	bool AddClip(const MocapFile& file);
+	inline size_t GetNumClips() const {
+		return _clips.size();
+	}
+	/// <summary>
+	/// lay out numPlayers players, clips and phases are picked deterministically from the player index
+	/// </summary>
+	void SetNumPlayers(size_t numPlayers);
+	inline size_t GetNumPlayers() const {
+		return _players.size();
+	}
+	// ignored unless above 0
+	inline void SetFps(double fps) {
+		if (fps > 0.0) {
+			_fps = fps;
+		}
+	}
+	// precomputes every clip's cubic coefficients the first time CatmullRom is asked for
+	void SetInterpolation(MocapInterpolation interpolation);
+	void Update(double deltaT);
+	inline const std::vector<SphereInstance>& GetInstances() const {
+		return _instances;
+	}
+	inline const std::vector<glm::vec3>& GetPitchLines() const {
+		return _pitchLines;
+	}
+	// wall clock time of the last Update
+	inline double GetLastUpdateMs() const {
+		return _lastUpdateMs;
+	}
+	/// <summary>
+	/// drive the players by motion matching instead of each looping its own clip. every tick each player
+	/// searches the crowd's clips for the frame best matching its pose and where its stick says it should be
+	/// heading, then fades across to it. the feature database is built from poseIndex's components the
+	/// first time, so turn it on once the pose index is up to date. turning it off puts players back in formation
+	/// </summary>
+	void SetMotionMatching(bool enabled, const MocapPoseIndex& poseIndex);
+	inline bool IsMotionMatching() const {
+		return _matching;
+	}
+	// stick for CrowdControlledPlayer, the rest wander on their own
+	inline void SetControlStick(const glm::vec2& stick) {
+		_controlStick = stick;
+	}
+	// searches in the last Update and their average time
+	inline size_t GetLastSearches() const {
+		return _lastSearches;
+	}
+	inline double GetLastSearchMicroseconds() const {
+		return _lastSearchMicroseconds;
+	}
+	inline const MocapMatchDatabase* GetMatchDatabase() const {
+		return _matchDatabase.get();
+	}
+	// drop the feature database once the pose index it came from is replaced, stopping motion matching.
+	// the next SetMotionMatching builds it again
+	void ResetMatchDatabase();
+	/// <summary>
+	/// play every clip from its keys reduced to within tolerance rather than its dense frames, always
+	/// linearly. the keys are rebuilt when the tolerance changes
+	/// </summary>
+	void SetKeyframed(bool enabled, float tolerance);
+	inline bool IsKeyframed() const {
+		return _keyframed;
+	}
+	// of every clip's keys, and of the same clips' dense poses
+	size_t GetKeyBytes() const;
+	size_t GetDenseBytes() const;
+private:
+	void PlacePlayer(size_t index, CrowdPlayer& player) const;
+	void BuildPitchLines();
+	void ResetMatchState(size_t index);
+	glm::vec2 WanderStick(size_t index) const;
+	// advance player index by deltaT, search if it's due, and set its requests
+	void StepMatchedPlayer(size_t index, double deltaT);
+	// the player's pose and the one it's fading from, both moved to their roots and mixed into _poses
+	void BlendMatchedPose(size_t index);
+	// clips too long to reduce keep playing from their frames
+	inline const MocapKeyClip* KeysFor(size_t clip) const {
+		return _keyframed && _keyClips[clip].GetNumFrames() == _clips[clip]->GetNumFrames() ? &_keyClips[clip] : nullptr;
+	}
+private:
+	std::vector<std::unique_ptr<MocapClipSoA>> _clips;
+	std::vector<glm::vec3> _clipOrigins; // centre of each clip's first frame on the ground, subtracted before placing
+	std::vector<CrowdPlayer> _players;
+	std::vector<MocapPoseRequest> _requests;
+	std::vector<MocapKeyCursor> _keyCursors; // one per request, so players playing on from keys reuse their segments
+	std::vector<MocapPoseSoA> _poses;
+	std::vector<SphereInstance> _instances; // PlayerPoints per player
+	std::vector<glm::vec3> _pitchLines;
+	double _time = 0.0;
+	double _fps = MocapDefaultFps;
+	MocapInterpolation _interpolation = MocapInterpolation::Linear;
+	double _lastUpdateMs = 0.0;
+	std::unique_ptr<MocapMatchDatabase> _matchDatabase; // built the first time motion matching is turned on
+	bool _matching = false;
+	std::vector<CrowdMatchState> _matchStates;
+	std::vector<MocapPoseRequest> _fadeRequests;
+	std::vector<MocapKeyCursor> _fadeKeyCursors;
+	std::vector<MocapPoseSoA> _fadePoses;
+	glm::vec2 _controlStick = glm::vec2(0.0f);
+	size_t _lastSearches = 0;
+	double _lastSearchMicroseconds = 0.0;
+	std::vector<MocapKeyClip> _keyClips; // one per clip once keyframed has been turned on
+	float _keyTolerance = 0.0f;
+	bool _keyframed = false;
+};
@@ -1,8 +1,18 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <iostream>
+#include <string.h>
 #include "MocapFile.h"
+#include "ByteSwap.h"
+#include "MappedFile.h"
+#include "MocapFrameStream.h"
+#include "ArchiveFile.h"
+#include "ComapzFormat.h"
+#include "MocapKeyClip.h"
+#include "DecodedClipCache.h"
 
+static_assert(sizeof(MocapFrame) == PlayerPoints * 3 * sizeof(float), "MocapFrame must be tightly packed floats");
 
 MocapFile::MocapFile( bool reverseEndianness)
 	:_reverseSourceFileEndianness(reverseEndianness)
@@ -10,68 +20,334 @@ MocapFile::MocapFile( bool reverseEndianness)
 	
 }
 
-void MocapFile::ReadFileFloats(std::string filePath, bool reverseEndianness) {
-	_floats.clear();
+MocapFile::~MocapFile()
+{
+}
+
+bool MocapFile::ReadWholeFile(const std::string& filePath, std::vector<u8>& bytesOut)
+{
 	std::ifstream in(filePath, std::ifstream::binary);
-	int begin = in.tellg();
+	if (!in) {
+		return false;
+	}
 	in.seekg(0, in.end);
-	int end = in.tellg();
+	std::streamoff length = in.tellg();
 	in.seekg(0, in.beg);
-	int length = end - begin;
-
-	int floatBufferSize = length / 4;
-	std::vector<char> bbuffer;
-	unsigned int word = 0;
-	unsigned int rword = 0;
-
-	for (int i = 0; i < floatBufferSize; i++) {
-		char b1, b2, b3, b4;
-		in.read(&b1, 1);
-		in.read(&b2, 1);
-		in.read(&b3, 1);
-		in.read(&b4, 1);
-		if (_reverseSourceFileEndianness) {
-			bbuffer.push_back(b4);
-			bbuffer.push_back(b3);
-			bbuffer.push_back(b2);
-			bbuffer.push_back(b1);
+	if (length < 0) {
+		return false;
+	}
+	bytesOut.resize((size_t)length);
+	in.read((char*)bytesOut.data(), length);
+	return in.gcount() == length;
+}
+
+void MocapFile::DecodeComapFrames(const u8* src, size_t numFrames, bool reverseEndianness, MocapFrame* out)
+{
+	for (size_t i = 0; i < numFrames; i++) {
+		const u8* frameStart = src + i * MocapFrameSizeBytes + sizeof(float); // skip the leading point count
+		if (reverseEndianness) {
+			ByteSwap32(frameStart, out[i].points, PlayerPoints * 3);
 		}
 		else {
-			bbuffer.push_back(b1);
-			bbuffer.push_back(b2);
-			bbuffer.push_back(b3);
-			bbuffer.push_back(b4);
+			memcpy(out[i].points, frameStart, sizeof(MocapFrame));
 		}
-		
-		auto asAFloat = *((float*)&bbuffer[(bbuffer.size() - 4)]);
-		_floats.push_back(asAFloat);
 	}
 }
 
-void MocapFile::ReadFloatsIntoFrameStructs()
+void MocapFile::Clear()
 {
 	_frames.clear();
-	int numFrames = _floats.size() / MocapFrameSizeFloats;
-	for (int i = 0; i < numFrames; i++) {
-		MocapFrame frame;
-		//frame.points
-		for (int j = 0; j < PlayerPoints; j++) {
-			int startIndex = i * MocapFrameSizeFloats + j * 3 + 1;
-			auto vec3 = glm::vec3{
-				_floats[startIndex],
-				_floats[startIndex + 1],
-				_floats[startIndex + 2]
-			};
-			frame.points[j] = vec3;
+	_mapped.reset();
+	_view = MocapFrameView();
+	_stream.reset();
+	_viewFrames = nullptr;
+	_numViewFrames = 0;
+	_backend = MocapFileBackend::Decoded;
+}
+
+bool MocapFile::FileIsPacked(const std::string& filePath)
+{
+	std::ifstream in(filePath, std::ifstream::binary);
+	char magic[4] = {};
+	in.read(magic, 4);
+	return in.gcount() == 4 && (memcmp(magic, ComapzMagic, 4) == 0 || memcmp(magic, ComapkMagic, 4) == 0);
+}
+
+bool MocapFile::Open(std::string path, const MocapLoadOptions& options)
+{
+	bool packed = FileIsPacked(path);
+	if (!packed && options.streamThresholdBytes > 0) {
+		// before the decoded cache, which would read and decode the whole file to build its image
+		std::ifstream in(path, std::ifstream::binary | std::ifstream::ate);
+		if (in && (size_t)in.tellg() > options.streamThresholdBytes) {
+			return LoadStreamed(path, options.streamBudgetBytes);
 		}
-		_frames.push_back(frame);
 	}
+	if (options.decodedCache && options.decodedCache->TryOpen(path, *this)) {
+		return true;
+	}
+	if (packed) {
+		// packed clips can only be decoded whole
+		Load(path);
+		return !_frames.empty();
+	}
+	if (options.map) {
+		return LoadMapped(path);
+	}
+	Load(path);
+	return !_frames.empty();
 }
 
 void MocapFile::Load(std::string path)
 {
-	ReadFileFloats(path, _reverseSourceFileEndianness);
-	ReadFloatsIntoFrameStructs();
+	std::vector<u8> bytes;
+	Clear();
+	if (!ReadWholeFile(path, bytes)) {
+		std::cout << "Failed to load file " << path << "\n";
+		return;
+	}
+	if (!DecodeBytes(bytes.data(), bytes.size())) {
+		std::cout << "Failed to decode file " << path << "\n";
+	}
+}
+
+bool MocapFile::DecodeBytes(const u8* data, size_t size)
+{
+	return DecodeBuffer(data, size, _reverseSourceFileEndianness, _frames);
+}
+
+bool MocapFile::DecodeBuffer(const u8* data, size_t size, bool reverseEndianness, std::vector<MocapFrame>& out)
+{
+	if (IsComapz(data, size)) {
+		ComapzInfo info;
+		// a corrupt header could ask for more frames than there's memory for
+		if (!ReadComapzInfo(data, size, info) || info.numFrames > ComapzMaxFrames(size)) {
+			out.clear();
+			return false;
+		}
+		out.resize(info.numFrames);
+		if (!DecodeComapz(data, size, out.data())) {
+			out.clear();
+			return false;
+		}
+		return true;
+	}
+	if (IsComapk(data, size)) {
+		MocapKeyClip keys;
+		if (!keys.Decode(data, size)) {
+			out.clear();
+			return false;
+		}
+		out.resize(keys.GetNumFrames());
+		keys.Expand(out.data());
+		return true;
+	}
+	size_t numFrames = size / MocapFrameSizeBytes;
+	out.resize(numFrames);
+	DecodeComapFrames(data, numFrames, reverseEndianness, out.data());
+	return true;
+}
+
+bool MocapFile::LoadMapped(std::string path)
+{
+	auto mapped = std::make_shared<MappedFile>();
+	if (!mapped->Open(path)) {
+		Clear();
+		std::cout << "Failed to map file " << path << "\n";
+		return false;
+	}
+	size_t size = mapped->GetSize();
+	return LoadMappedSlice(mapped, 0, size);
+}
+
+bool MocapFile::LoadMappedSlice(std::shared_ptr<const MappedFile> source, size_t offset, size_t size)
+{
+	Clear();
+	if (!source || offset > source->GetSize() || size > source->GetSize() - offset) {
+		std::cout << "mapped slice out of range\n";
+		return false;
+	}
+	if (IsComapz(source->GetData() + offset, size) || IsComapk(source->GetData() + offset, size)) {
+		// nothing to view lazily in a packed clip, decode it and let the mapping go
+		return DecodeBytes(source->GetData() + offset, size);
+	}
+	_mapped = source;
+	_view = MocapFrameView(source->GetData() + offset, size / MocapFrameSizeBytes, MocapFrameSizeBytes, sizeof(float), _reverseSourceFileEndianness);
+	_backend = MocapFileBackend::Mapped;
+	return true;
+}
+
+bool MocapFile::LoadFromArchive(const ArchiveFile& archive, size_t index)
+{
+	size_t offset, size;
+	if (!archive.GetResourceRange(index, offset, size)) {
+		Clear();
+		std::cout << "no entry " << index << " in " << archive.GetDataFilePath() << "\n";
+		return false;
+	}
+	if (!IsClipBuffer(archive.GetMappedData()->GetData() + offset, size, _reverseSourceFileEndianness)) {
+		Clear();
+		std::cout << "entry " << index << " of " << archive.GetDataFilePath() << " isn't a clip\n";
+		return false;
+	}
+	return LoadMappedSlice(archive.GetMappedData(), offset, size);
+}
+
+bool MocapFile::LoadStreamed(std::string path, size_t budgetBytes)
+{
+	Clear();
+	auto stream = std::make_unique<MocapFrameStream>();
+	if (!stream->Open(path, _reverseSourceFileEndianness, budgetBytes)) {
+		std::cout << "Failed to stream file " << path << "\n";
+		return false;
+	}
+	_stream = std::move(stream);
+	_backend = MocapFileBackend::Streamed;
+	return true;
+}
+
+void MocapFile::LoadView(const MocapFrame* frames, size_t numFrames)
+{
+	Clear();
+	_viewFrames = frames;
+	_numViewFrames = numFrames;
+	_backend = MocapFileBackend::View;
+}
+
+bool MocapFile::LoadNativeImage(std::shared_ptr<const MappedFile> image, size_t offset, size_t numFrames)
+{
+	Clear();
+	if (!image || offset > image->GetSize() || numFrames > (image->GetSize() - offset) / sizeof(MocapFrame)) {
+		std::cout << "native image out of range\n";
+		return false;
+	}
+	_mapped = image;
+	_viewFrames = (const MocapFrame*)(image->GetData() + offset);
+	_numViewFrames = numFrames;
+	_backend = MocapFileBackend::View;
+	return true;
+}
+
+bool MocapFile::IsClipBuffer(const u8* data, size_t size, bool reverseEndianness)
+{
+	if (IsComapz(data, size) || IsComapk(data, size)) {
+		return true;
+	}
+	if (size == 0 || size % MocapFrameSizeBytes != 0) {
+		return false;
+	}
+	float pointCount;
+	if (reverseEndianness) {
+		ByteSwap32(data, &pointCount, 1);
+	}
+	else {
+		memcpy(&pointCount, data, sizeof(float));
+	}
+	return pointCount == (float)PlayerPoints;
+}
+
+size_t MocapFile::CountFramesInBuffer(const u8* start, size_t startSize, u64 fileSize)
+{
+	ComapzInfo info;
+	if (ReadComapzInfo(start, startSize, info)) {
+		return info.numFrames;
+	}
+	size_t numFrames;
+	if (ReadComapkNumFrames(start, startSize, numFrames)) {
+		return numFrames;
+	}
+	return (size_t)(fileSize / MocapFrameSizeBytes);
+}
+
+bool MocapFile::DecodeBufferInto(const u8* data, size_t size, bool reverseEndianness, MocapFrame* out, size_t numFrames)
+{
+	if (IsComapz(data, size)) {
+		ComapzInfo info;
+		if (!ReadComapzInfo(data, size, info) || info.numFrames != numFrames) {
+			return false;
+		}
+		return DecodeComapz(data, size, out);
+	}
+	if (IsComapk(data, size)) {
+		MocapKeyClip keys;
+		if (!keys.Decode(data, size) || keys.GetNumFrames() != numFrames) {
+			return false;
+		}
+		keys.Expand(out);
+		return true;
+	}
+	if (size / MocapFrameSizeBytes < numFrames) {
+		return false;
+	}
+	DecodeComapFrames(data, numFrames, reverseEndianness, out);
+	return true;
+}
+
+size_t MocapFile::GetNumFrames() const
+{
+	switch (_backend) {
+	case MocapFileBackend::Mapped:
+		return _view.size();
+	case MocapFileBackend::Streamed:
+		return _stream->GetNumFrames();
+	case MocapFileBackend::View:
+		return _numViewFrames;
+	default:
+		return _frames.size();
+	}
+}
+
+void MocapFile::GetFrame(size_t index, MocapFrame& out) const
+{
+	switch (_backend) {
+	case MocapFileBackend::Mapped:
+		_view.ReadFrame(index, out);
+		break;
+	case MocapFileBackend::Streamed:
+		_stream->GetFrame(index, out);
+		break;
+	case MocapFileBackend::View:
+		out = _viewFrames[index];
+		break;
+	default:
+		out = _frames[index];
+		break;
+	}
+}
+
+const MocapFrame* MocapFile::GetFramePointer() const
+{
+	switch (_backend) {
+	case MocapFileBackend::Decoded:
+		return _frames.data();
+	case MocapFileBackend::View:
+		return _viewFrames;
+	default:
+		return nullptr;
+	}
+}
+
+size_t MocapFile::GetMemoryFootprint() const
+{
+	switch (_backend) {
+	case MocapFileBackend::Mapped:
+		return _view.size() * MocapFrameSizeBytes;
+	case MocapFileBackend::Streamed:
+		return _stream->GetCapacity() * sizeof(MocapFrame);
+	case MocapFileBackend::View:
+		// a library arena's frames belong to the library, a mapped image's belong to this file
+		return _mapped ? _numViewFrames * sizeof(MocapFrame) : 0;
+	default:
+		return _frames.size() * sizeof(MocapFrame);
+	}
+}
+
+void MocapFile::CopyFrames(std::vector<MocapFrame>& out) const
+{
+	out.resize(GetNumFrames());
+	for (size_t i = 0; i < out.size(); i++) {
+		GetFrame(i, out[i]);
+	}
 }
 
 const std::vector<MocapFrame>& MocapFile::CGetFrames() const
@@ -1,20 +1,119 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <memory>
 #include <glm/glm.hpp>
 #include "MocapFrame.h"
+#include "MocapFrameView.h"
+#include "BasicTypedefs.h"
+
+class MappedFile;
+class MocapFrameStream;
+class ArchiveFile;
+class DecodedClipCache;
+
+enum class MocapFileBackend {
+	Decoded,  // every frame decoded up front into _frames
+	Mapped,   // file mapped read only, frames decoded as they're read
+	Streamed, // bounded window of frames around the playhead read by a background thread
+	View      // decoded frames used in place, e.g. from a MocapLibrary arena or a mapped DecodedClipCache image
+};
+
+struct MocapLoadOptions {
+	bool map = false;
+	size_t streamThresholdBytes = 0; // files bigger than this are streamed, 0 to never stream
+	size_t streamBudgetBytes = 64 * 1024 * 1024;
+	DecodedClipCache* decodedCache = nullptr; // tried before anything else when set
+};
 
 class MocapFile {
 public:
 	MocapFile(bool reverseEndianness);
+	~MocapFile();
+	/// <summary>
+	/// load path with whichever backend options picks for a file of its size
+	/// </summary>
+	bool Open(std::string path, const MocapLoadOptions& options);
 	void Load(std::string path);
+	/// <summary>
+	/// map the file rather than decode it - opening costs the same whatever the file size
+	/// </summary>
+	bool LoadMapped(std::string path);
+	/// <summary>
+	/// view size bytes at offset into an already mapped file, e.g. one entry of an archive.
+	/// keeps source alive for as long as this file uses it
+	/// </summary>
+	bool LoadMappedSlice(std::shared_ptr<const MappedFile> source, size_t offset, size_t size);
+	/// <summary>
+	/// view entry index of an archive in place, no copy is made
+	/// </summary>
+	bool LoadFromArchive(const ArchiveFile& archive, size_t index);
+	/// <summary>
+	/// stream the file through a ring of at most budgetBytes of decoded frames
+	/// </summary>
+	bool LoadStreamed(std::string path, size_t budgetBytes);
+	/// <summary>
+	/// use numFrames decoded frames owned elsewhere, they must outlive this file
+	/// </summary>
+	void LoadView(const MocapFrame* frames, size_t numFrames);
+	/// <summary>
+	/// use numFrames native endian frames stored at offset in image, keeping image alive
+	/// </summary>
+	bool LoadNativeImage(std::shared_ptr<const MappedFile> image, size_t offset, size_t numFrames);
+
+	size_t GetNumFrames() const;
+	void GetFrame(size_t index, MocapFrame& out) const;
+	// contiguous decoded frames for the Decoded and View backends, nullptr otherwise
+	const MocapFrame* GetFramePointer() const;
+	inline MocapFileBackend GetBackend() const {
+		return _backend;
+	}
+	inline const MocapFrameView& GetFrameView() const {
+		return _view;
+	}
+	// bytes of frame data this file keeps resident, counting mapped bytes as if every page were touched
+	size_t GetMemoryFootprint() const;
+	// copy every frame out, whichever backend holds them
+	void CopyFrames(std::vector<MocapFrame>& out) const;
+	// decoded backend only - empty when the file is mapped, use GetFrame instead
 	const std::vector<MocapFrame>& CGetFrames() const;
 	std::vector<MocapFrame>& GetFrames();
+
+	/// <summary>
+	/// decode numFrames raw .comap frames (a leading point count float followed by the points)
+	/// straight into out, byte swapping each float if reverseEndianness is set
+	/// </summary>
+	static void DecodeComapFrames(const u8* src, size_t numFrames, bool reverseEndianness, MocapFrame* out);
+	/// <summary>
+	/// decode a whole .comap, .comapz or .comapk held in memory
+	/// </summary>
+	static bool DecodeBuffer(const u8* data, size_t size, bool reverseEndianness, std::vector<MocapFrame>& out);
+	/// <summary>
+	/// number of frames in a .comap, .comapz or .comapk of fileSize bytes, given at least its first ComapzHeaderSize bytes
+	/// (ComapkHeaderSize for a .comapk)
+	/// </summary>
+	static size_t CountFramesInBuffer(const u8* start, size_t startSize, u64 fileSize);
+	/// <summary>
+	/// decode the first numFrames frames of a whole .comap, .comapz or .comapk held in memory into out
+	/// </summary>
+	static bool DecodeBufferInto(const u8* data, size_t size, bool reverseEndianness, MocapFrame* out, size_t numFrames);
+	/// <summary>
+	/// whether data looks like a clip: a .comapz or .comapk, or raw .comap frames, a whole number of them
+	/// starting with the point count
+	/// </summary>
+	static bool IsClipBuffer(const u8* data, size_t size, bool reverseEndianness);
+	static bool ReadWholeFile(const std::string& filePath, std::vector<u8>& bytesOut);
 private:
-	void ReadFileFloats(std::string filePath, bool reverseEndianness);
-	void ReadFloatsIntoFrameStructs();
+	static bool FileIsPacked(const std::string& filePath); // .comapz or .comapk
+	bool DecodeBytes(const u8* data, size_t size);
+	void Clear();
 private:
+	MocapFileBackend _backend = MocapFileBackend::Decoded;
 	std::vector<MocapFrame> _frames;
-	std::vector<float> _floats;
+	std::shared_ptr<const MappedFile> _mapped;
+	MocapFrameView _view;
+	std::unique_ptr<MocapFrameStream> _stream;
+	const MocapFrame* _viewFrames = nullptr;
+	size_t _numViewFrames = 0;
 	bool _reverseSourceFileEndianness;
 };
@@ -1,3 +1,8 @@
 #pragma once
 #define PlayerPoints 28
-#define MocapFrameSizeFloats (PlayerPoints * 3 + 1)
\ No newline at end of file
+#define MocapFrameSizeFloats (PlayerPoints * 3 + 1)
+#define MocapFrameSizeBytes (MocapFrameSizeFloats * 4)
+
+#define MocapDefaultFps 16.0
+
+#define MocapMissingPointValue -10000.0f // coordinate value of points that weren't captured in a frame
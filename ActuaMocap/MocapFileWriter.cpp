@@ -0,0 +1,57 @@
+#include "MocapFileWriter.h"
+#include <fstream>
+#include <vector>
+#include <string.h>
+#include "MocapFile.h"
+#include "ComapzFormat.h"
+#include "MocapKeyClip.h"
+#include "MocapClipSoA.h"
+#include "ByteSwap.h"
+
+static bool WriteBytes(const std::string& path, const std::vector<u8>& bytes) {
+	std::ofstream out(path, std::ofstream::binary | std::ofstream::trunc);
+	if (!out) {
+		return false;
+	}
+	out.write((const char*)bytes.data(), bytes.size());
+	return (bool)out;
+}
+
+bool WriteComap(const MocapFile& file, const std::string& path, bool bigEndian)
+{
+	std::vector<MocapFrame> frames;
+	file.CopyFrames(frames);
+	std::vector<u8> bytes(frames.size() * MocapFrameSizeBytes);
+	const float pointCount = (float)PlayerPoints; // every frame starts with the number of points
+	for (size_t i = 0; i < frames.size(); i++) {
+		u8* frameStart = &bytes[i * MocapFrameSizeBytes];
+		memcpy(frameStart, &pointCount, sizeof(float));
+		memcpy(frameStart + sizeof(float), frames[i].points, sizeof(MocapFrame));
+		if (bigEndian) {
+			ByteSwap32(frameStart, frameStart, MocapFrameSizeFloats);
+		}
+	}
+	return WriteBytes(path, bytes);
+}
+
+bool WriteComapz(const MocapFile& file, const std::string& path, float tolerance)
+{
+	std::vector<MocapFrame> frames;
+	file.CopyFrames(frames);
+	std::vector<u8> bytes;
+	EncodeComapz(frames.data(), frames.size(), tolerance, bytes);
+	return WriteBytes(path, bytes);
+}
+
+bool WriteComapk(const MocapFile& file, const std::string& path, float tolerance)
+{
+	MocapClipSoA clip;
+	clip.Build(file);
+	MocapKeyClip keys;
+	if (!keys.Build(clip, tolerance)) {
+		return false;
+	}
+	std::vector<u8> bytes;
+	keys.Encode(bytes);
+	return WriteBytes(path, bytes);
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+
+class MocapFile;
+
+/// <summary>
+/// write file as a raw .comap, bigEndian should match SourceEndiannessReversed for the original game's files
+/// </summary>
+bool WriteComap(const MocapFile& file, const std::string& path, bool bigEndian);
+/// <summary>
+/// write file as a packed .comapz, see ComapzFormat.h
+/// </summary>
+bool WriteComapz(const MocapFile& file, const std::string& path, float tolerance);
+/// <summary>
+/// write file reduced to keys as a .comapk, see MocapKeyClip.h
+/// </summary>
+bool WriteComapk(const MocapFile& file, const std::string& path, float tolerance);
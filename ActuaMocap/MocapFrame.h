@@ -5,3 +5,9 @@
 struct MocapFrame {
 	glm::vec3 points[PlayerPoints];
 };
+
+
+// some frames lose only one or two coordinates of a point, treat those as missing too
+inline bool IsMissingPoint(const glm::vec3& point) {
+	return point.x == MocapMissingPointValue || point.y == MocapMissingPointValue || point.z == MocapMissingPointValue;
+}
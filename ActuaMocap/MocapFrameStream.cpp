@@ -0,0 +1,185 @@
+#include "MocapFrameStream.h"
+#include <iostream>
+#include "MocapFile.h"
+
+#define PREFETCH_CHUNK_FRAMES 64
+
+MocapFrameStream::MocapFrameStream()
+{
+}
+
+MocapFrameStream::~MocapFrameStream()
+{
+	Close();
+}
+
+bool MocapFrameStream::Open(const std::string& path, bool reverseEndianness, size_t budgetBytes)
+{
+	Close();
+	_syncReader.open(path, std::ifstream::binary);
+	if (!_syncReader) {
+		return false;
+	}
+	_syncReader.seekg(0, _syncReader.end);
+	_numFrames = (size_t)_syncReader.tellg() / MocapFrameSizeBytes;
+	_syncReader.seekg(0, _syncReader.beg);
+	_path = path;
+	_reverseEndianness = reverseEndianness;
+
+	// the budget is a ceiling, one too small for a single frame means every frame is read on demand
+	size_t capacity = budgetBytes / sizeof(MocapFrame);
+	if (capacity > _numFrames) {
+		capacity = _numFrames; // whole clip fits, nothing will ever be evicted
+	}
+	_ring.resize(capacity);
+	_slotFrames.assign(capacity, -1);
+	// keep a quarter of the ring behind the playhead for scrubbing back
+	_prefetchAhead = capacity - capacity / 4;
+	_playhead = 0;
+	_direction = 1;
+	_quit = false;
+	_prefetchFailed = false;
+	_syncReadFailed = false;
+	if (capacity > 0) {
+		_thread = std::thread(&MocapFrameStream::PrefetchThread, this);
+	}
+	return true;
+}
+
+void MocapFrameStream::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+	if (_thread.joinable()) {
+		_thread.join();
+	}
+	_syncReader.close();
+	_ring.clear();
+	_ring.shrink_to_fit();
+	_slotFrames.clear();
+	_numFrames = 0;
+}
+
+bool MocapFrameStream::IsResident(size_t frame) const
+{
+	return !_ring.empty() && _slotFrames[frame % _ring.size()] == (i64)frame;
+}
+
+bool MocapFrameStream::ReadFrames(std::ifstream& in, size_t first, size_t count, std::vector<u8>& scratch, MocapFrame* out)
+{
+	scratch.resize(count * MocapFrameSizeBytes);
+	in.clear();
+	in.seekg((std::streamoff)first * MocapFrameSizeBytes, in.beg);
+	in.read((char*)scratch.data(), scratch.size());
+	if ((size_t)in.gcount() != scratch.size()) {
+		return false;
+	}
+	MocapFile::DecodeComapFrames(scratch.data(), count, _reverseEndianness, out);
+	return true;
+}
+
+void MocapFrameStream::GetFrame(size_t index, MocapFrame& out)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		// work out which way playback is going from the shortest way round the loop
+		size_t forwardDistance = (index + _numFrames - _playhead) % _numFrames;
+		if (forwardDistance != 0) {
+			_direction = forwardDistance <= _numFrames / 2 ? 1 : -1;
+		}
+		_playhead = index;
+		if (IsResident(index)) {
+			out = _ring[index % _ring.size()];
+			_wake.notify_one();
+			return;
+		}
+	}
+	// prefetcher is behind (or we've just seeked) - read this one frame now
+	if (!ReadFrames(_syncReader, index, 1, _syncScratch, &out) && !_syncReadFailed) {
+		// said once, the playhead will keep coming back to it
+		_syncReadFailed = true;
+		std::cout << "failed to read frame " << index << " from " << _path << "\n";
+	}
+	_wake.notify_one();
+}
+
+size_t MocapFrameStream::GetResidentFrameCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	size_t count = 0;
+	for (auto frame : _slotFrames) {
+		count += frame >= 0;
+	}
+	return count;
+}
+
+size_t MocapFrameStream::NextFrameToFetch(size_t& runLengthOut)
+{
+	// walk out from the playhead in the direction of playback to the first missing frame,
+	// then measure how many missing frames follow it contiguously in the file
+	runLengthOut = 0;
+	bool clipFitsInRing = _numFrames <= _ring.size();
+	for (size_t k = 0; k < _prefetchAhead; k++) {
+		i64 unwrapped = (i64)_playhead + _direction * (i64)k;
+		if (!clipFitsInRing && (unwrapped < 0 || unwrapped >= (i64)_numFrames)) {
+			// past the end of a clip bigger than the ring the frames wrapped round to would
+			// share slots with ones we still want, stop here and let the loop back read on demand
+			break;
+		}
+		size_t frame = (size_t)((unwrapped + (i64)_numFrames) % (i64)_numFrames);
+		if (IsResident(frame)) {
+			continue;
+		}
+		size_t run = 1;
+		while (run < PREFETCH_CHUNK_FRAMES && k + run < _prefetchAhead) {
+			i64 next = (i64)frame + _direction * (i64)run;
+			if (next < 0 || next >= (i64)_numFrames || IsResident((size_t)next)) {
+				break;
+			}
+			run++;
+		}
+		runLengthOut = run;
+		// reading backwards still reads the file forwards, from the lowest frame of the run
+		return _direction > 0 ? frame : frame - (run - 1);
+	}
+	return 0;
+}
+
+void MocapFrameStream::PrefetchThread()
+{
+	std::ifstream in(_path, std::ifstream::binary);
+	std::vector<u8> scratch;
+	std::vector<MocapFrame> decoded;
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_quit) {
+		if (_prefetchFailed) {
+			_wake.wait(lock);
+			continue;
+		}
+		size_t runLength;
+		size_t first = NextFrameToFetch(runLength);
+		if (runLength == 0) {
+			_wake.wait(lock);
+			continue;
+		}
+		lock.unlock();
+		decoded.resize(runLength);
+		bool ok = ReadFrames(in, first, runLength, scratch, decoded.data());
+		lock.lock();
+		if (!ok) {
+			// the file's gone or shrunk under us, leave the rest to GetFrame rather than retrying on every call
+			std::cout << "prefetch failed at frame " << first << " of " << _path << ", reading on demand from now on\n";
+			_prefetchFailed = true;
+			continue;
+		}
+		for (size_t i = 0; i < runLength; i++) {
+			size_t frame = first + i;
+			size_t slot = frame % _ring.size();
+			_ring[slot] = decoded[i];
+			_slotFrames[slot] = (i64)frame;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "MocapFrame.h"
+#include "BasicTypedefs.h"
+
+/// <summary>
+/// plays a .comap too big to decode in one go. a fixed size ring of decoded frames is kept around
+/// the playhead and a background thread reads ahead in the direction of playback, overwriting the
+/// frames furthest behind. a frame that hasn't been prefetched is read synchronously.
+/// </summary>
+class MocapFrameStream
+{
+public:
+	MocapFrameStream();
+	~MocapFrameStream();
+	MocapFrameStream(const MocapFrameStream&) = delete;
+	MocapFrameStream& operator=(const MocapFrameStream&) = delete;
+	/// <param name="budgetBytes">memory ceiling for the ring of decoded frames, never exceeded</param>
+	bool Open(const std::string& path, bool reverseEndianness, size_t budgetBytes);
+	void Close();
+	inline size_t GetNumFrames() const {
+		return _numFrames;
+	}
+	// number of frames the ring holds, fixed once opened
+	inline size_t GetCapacity() const {
+		return _ring.size();
+	}
+	void GetFrame(size_t index, MocapFrame& out);
+	size_t GetResidentFrameCount();
+private:
+	void PrefetchThread();
+	bool IsResident(size_t frame) const;
+	bool ReadFrames(std::ifstream& in, size_t first, size_t count, std::vector<u8>& scratch, MocapFrame* out);
+	size_t NextFrameToFetch(size_t& runLengthOut);
+private:
+	std::string _path;
+	size_t _numFrames = 0;
+	bool _reverseEndianness = false;
+
+	// frame f lives in slot f % capacity, _slotFrames says which frame each slot currently holds
+	std::vector<MocapFrame> _ring;
+	std::vector<i64> _slotFrames;
+	size_t _prefetchAhead = 0;
+
+	size_t _playhead = 0;
+	int _direction = 1;
+	bool _prefetchFailed = false; // stops the prefetcher, GetFrame reads everything itself after that
+
+	std::ifstream _syncReader; // render thread reads for frames the prefetcher hasn't got to yet
+	std::vector<u8> _syncScratch;
+	bool _syncReadFailed = false;
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _quit = false;
+	std::thread _thread;
+};
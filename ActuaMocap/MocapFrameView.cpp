@@ -0,0 +1,24 @@
+#include "MocapFrameView.h"
+#include <string.h>
+#include "ByteSwap.h"
+
+MocapFrameView::MocapFrameView()
+	:_data(nullptr), _numFrames(0), _frameStride(0), _pointsOffset(0), _reverseEndianness(false)
+{
+}
+
+MocapFrameView::MocapFrameView(const u8* data, size_t numFrames, size_t frameStride, size_t pointsOffset, bool reverseEndianness)
+	:_data(data), _numFrames(numFrames), _frameStride(frameStride), _pointsOffset(pointsOffset), _reverseEndianness(reverseEndianness)
+{
+}
+
+void MocapFrameView::ReadFrame(size_t index, MocapFrame& out) const
+{
+	const u8* src = _data + index * _frameStride + _pointsOffset;
+	if (_reverseEndianness) {
+		ByteSwap32(src, out.points, PlayerPoints * 3);
+	}
+	else {
+		memcpy(out.points, src, sizeof(MocapFrame));
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stddef.h>
+#include "MocapFrame.h"
+#include "BasicTypedefs.h"
+
+/// <summary>
+/// read only window onto frames that live in someone else's memory (usually a mapped file).
+/// frames are decoded, byte swapping if needed, only as they are read.
+/// </summary>
+class MocapFrameView
+{
+public:
+	MocapFrameView();
+	/// <param name="data">first byte of the first frame</param>
+	/// <param name="numFrames">number of frames in the view</param>
+	/// <param name="frameStride">bytes from the start of one frame to the next</param>
+	/// <param name="pointsOffset">bytes from the start of a frame to its first point</param>
+	/// <param name="reverseEndianness">whether the stored floats need byte swapping</param>
+	MocapFrameView(const u8* data, size_t numFrames, size_t frameStride, size_t pointsOffset, bool reverseEndianness);
+
+	inline size_t size() const {
+		return _numFrames;
+	}
+	inline bool empty() const {
+		return _numFrames == 0;
+	}
+	void ReadFrame(size_t index, MocapFrame& out) const;
+	inline MocapFrame operator[](size_t index) const {
+		MocapFrame frame;
+		ReadFrame(index, frame);
+		return frame;
+	}
+private:
+	const u8* _data;
+	size_t _numFrames;
+	size_t _frameStride;
+	size_t _pointsOffset;
+	bool _reverseEndianness;
+};
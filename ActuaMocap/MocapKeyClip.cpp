@@ -0,0 +1,619 @@
+#include "MocapKeyClip.h"
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include "MocapClipSoA.h"
+#include "ThreadPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MOCAP_X86 1
+#include <emmintrin.h>
+#endif
+
+#define KeyMaxQuantised 0xFFFE // below KeyMissing
+
+static_assert(sizeof(MocapKey) == 8 && offsetof(MocapKey, frame) == 0, "a key and the one after it are one 16 byte load of (frame, x, y, z) twice");
+static_assert(KeyBlockFrames <= 255, "frame offsets into a block's keys are 8 bit");
+
+static void PutU16(std::vector<u8>& out, u16 v) {
+	out.push_back((u8)v);
+	out.push_back((u8)(v >> 8));
+}
+
+static void PutU32(std::vector<u8>& out, u32 v) {
+	for (int i = 0; i < 4; i++) {
+		out.push_back((u8)(v >> (i * 8)));
+	}
+}
+
+static void PutF32(std::vector<u8>& out, float f) {
+	u32 v;
+	memcpy(&v, &f, 4);
+	PutU32(out, v);
+}
+
+static u16 GetU16(const u8* p) {
+	return (u16)(p[0] | (p[1] << 8));
+}
+
+static u32 GetU32(const u8* p) {
+	return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static float GetF32(const u8* p) {
+	u32 v = GetU32(p);
+	float f;
+	memcpy(&f, &v, 4);
+	return f;
+}
+
+// a pair of keys standing in for the padding points, a segment with nowhere to go
+static const MocapKey PaddingKeys[2] = { { 0, 0, 0, 0 }, { 1, 0, 0, 0 } };
+
+// out = each point along the segment from keys[p][0] to keys[p][1] at frame at, for all PosePaddedPoints.
+// a point missing at key 0 comes out missing, and one going missing at key 1 holds at key 0
+static void SamplePointsScalar(const MocapKey* const* keys, float at, const glm::vec3& min, const glm::vec3& step, MocapPoseSoA& out)
+{
+	for (int p = 0; p < PosePaddedPoints; p++) {
+		const MocapKey& from = keys[p][0];
+		const MocapKey& to = keys[p][1];
+		if (from.x == KeyMissing) {
+			out.x[p] = out.y[p] = out.z[p] = MocapMissingPointValue;
+			continue;
+		}
+		float u = to.x == KeyMissing ? 0.0f : (at - from.frame) / (float)(to.frame - from.frame);
+		out.x[p] = min.x + step.x * (from.x + ((float)to.x - from.x) * u);
+		out.y[p] = min.y + step.y * (from.y + ((float)to.y - from.y) * u);
+		out.z[p] = min.z + step.z * (from.z + ((float)to.z - from.z) * u);
+	}
+}
+
+#ifdef MOCAP_X86
+
+static inline __m128 SampleAxisSSE2(__m128 from, __m128 to, __m128 u, float min, float step)
+{
+	__m128 q = _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), u));
+	return _mm_add_ps(_mm_set1_ps(min), _mm_mul_ps(_mm_set1_ps(step), q));
+}
+
+static void SamplePointsSSE2(const MocapKey* const* keys, float at, const glm::vec3& min, const glm::vec3& step, MocapPoseSoA& out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i missing16 = _mm_set1_epi16((short)KeyMissing);
+	const __m128 atV = _mm_set1_ps(at);
+	const __m128 missingValue = _mm_set1_ps(MocapMissingPointValue);
+	for (int p = 0; p < PosePaddedPoints; p += 8) {
+		// each point's pair of keys is one row of (frame, x, y, z) twice, transpose 8 rows into one register per field
+		__m128i t0 = _mm_loadu_si128((const __m128i*)keys[p + 0]);
+		__m128i t1 = _mm_loadu_si128((const __m128i*)keys[p + 1]);
+		__m128i t2 = _mm_loadu_si128((const __m128i*)keys[p + 2]);
+		__m128i t3 = _mm_loadu_si128((const __m128i*)keys[p + 3]);
+		__m128i t4 = _mm_loadu_si128((const __m128i*)keys[p + 4]);
+		__m128i t5 = _mm_loadu_si128((const __m128i*)keys[p + 5]);
+		__m128i t6 = _mm_loadu_si128((const __m128i*)keys[p + 6]);
+		__m128i t7 = _mm_loadu_si128((const __m128i*)keys[p + 7]);
+		__m128i a0 = _mm_unpacklo_epi16(t0, t1), a1 = _mm_unpackhi_epi16(t0, t1);
+		__m128i a2 = _mm_unpacklo_epi16(t2, t3), a3 = _mm_unpackhi_epi16(t2, t3);
+		__m128i a4 = _mm_unpacklo_epi16(t4, t5), a5 = _mm_unpackhi_epi16(t4, t5);
+		__m128i a6 = _mm_unpacklo_epi16(t6, t7), a7 = _mm_unpackhi_epi16(t6, t7);
+		__m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+		__m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+		__m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+		__m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+		__m128i fields[8] = {
+			_mm_unpacklo_epi64(b0, b4), _mm_unpackhi_epi64(b0, b4), _mm_unpacklo_epi64(b1, b5), _mm_unpackhi_epi64(b1, b5),
+			_mm_unpacklo_epi64(b2, b6), _mm_unpackhi_epi64(b2, b6), _mm_unpacklo_epi64(b3, b7), _mm_unpackhi_epi64(b3, b7)
+		};
+		__m128i fromMissing = _mm_cmpeq_epi16(fields[1], missing16);
+		__m128i toMissing = _mm_cmpeq_epi16(fields[5], missing16);
+		// then 4 points at a time as floats
+		for (int half = 0; half < 2; half++) {
+			__m128 f[8];
+			for (int i = 0; i < 8; i++) {
+				f[i] = _mm_cvtepi32_ps(half ? _mm_unpackhi_epi16(fields[i], zero) : _mm_unpacklo_epi16(fields[i], zero));
+			}
+			__m128 fromMask = _mm_castsi128_ps(half ? _mm_unpackhi_epi16(fromMissing, fromMissing) : _mm_unpacklo_epi16(fromMissing, fromMissing));
+			__m128 toMask = _mm_castsi128_ps(half ? _mm_unpackhi_epi16(toMissing, toMissing) : _mm_unpacklo_epi16(toMissing, toMissing));
+			__m128 u = _mm_andnot_ps(toMask, _mm_div_ps(_mm_sub_ps(atV, f[0]), _mm_sub_ps(f[4], f[0])));
+			__m128 x = SampleAxisSSE2(f[1], f[5], u, min.x, step.x);
+			__m128 y = SampleAxisSSE2(f[2], f[6], u, min.y, step.y);
+			__m128 z = SampleAxisSSE2(f[3], f[7], u, min.z, step.z);
+			__m128 missing = _mm_and_ps(fromMask, missingValue);
+			int lane = p + half * 4;
+			_mm_storeu_ps(out.x + lane, _mm_or_ps(missing, _mm_andnot_ps(fromMask, x)));
+			_mm_storeu_ps(out.y + lane, _mm_or_ps(missing, _mm_andnot_ps(fromMask, y)));
+			_mm_storeu_ps(out.z + lane, _mm_or_ps(missing, _mm_andnot_ps(fromMask, z)));
+		}
+	}
+}
+
+// bit p set for each point whose segment in cursor doesn't cover frame
+static u32 StaleSegmentsSSE2(const MocapKeyCursor& cursor, float frame)
+{
+	const __m128 frameV = _mm_set1_ps(frame);
+	u32 stale = 0;
+	for (int p = 0; p < PosePaddedPoints; p += 4) {
+		__m128 covered = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(cursor.fromFrame + p), frameV), _mm_cmplt_ps(frameV, _mm_loadu_ps(cursor.toFrame + p)));
+		stale |= (u32)(~_mm_movemask_ps(covered) & 0xF) << p;
+	}
+	return stale;
+}
+
+// the segments from keys[i][0] to keys[i][1] into cursor for points p to p + 3, stored whole 4 lanes at a time
+// so the loads of the next sample aren't held up behind them
+static void LoadSegmentsSSE2(const MocapKey* const* keys, const glm::vec3& min, const glm::vec3& step, MocapKeyCursor& cursor, int p)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i r0 = _mm_loadu_si128((const __m128i*)keys[0]);
+	__m128i r1 = _mm_loadu_si128((const __m128i*)keys[1]);
+	__m128i r2 = _mm_loadu_si128((const __m128i*)keys[2]);
+	__m128i r3 = _mm_loadu_si128((const __m128i*)keys[3]);
+	__m128i a0 = _mm_unpacklo_epi16(r0, r1), a1 = _mm_unpackhi_epi16(r0, r1);
+	__m128i a2 = _mm_unpacklo_epi16(r2, r3), a3 = _mm_unpackhi_epi16(r2, r3);
+	// (frame, x), (y, z) of the first keys and the same of the second
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128 from = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b0, zero));
+	__m128 fx = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b0, zero));
+	__m128 fy = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b1, zero));
+	__m128 fz = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b1, zero));
+	__m128 to = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b2, zero));
+	__m128 tx = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b2, zero));
+	__m128 ty = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b3, zero));
+	__m128 tz = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b3, zero));
+	const __m128 missing16 = _mm_set1_ps((float)KeyMissing);
+	__m128 fromMissing = _mm_cmpeq_ps(fx, missing16);
+	// missing from the first key, or going missing at the second, stands still
+	__m128 perFrame = _mm_andnot_ps(_mm_or_ps(fromMissing, _mm_cmpeq_ps(tx, missing16)), _mm_div_ps(_mm_set1_ps(1.0f), _mm_sub_ps(to, from)));
+	__m128 missing = _mm_and_ps(fromMissing, _mm_set1_ps(MocapMissingPointValue));
+	_mm_storeu_ps(cursor.fromFrame + p, from);
+	_mm_storeu_ps(cursor.toFrame + p, to);
+	_mm_storeu_ps(cursor.x + p, _mm_or_ps(missing, _mm_andnot_ps(fromMissing, _mm_add_ps(_mm_set1_ps(min.x), _mm_mul_ps(_mm_set1_ps(step.x), fx)))));
+	_mm_storeu_ps(cursor.y + p, _mm_or_ps(missing, _mm_andnot_ps(fromMissing, _mm_add_ps(_mm_set1_ps(min.y), _mm_mul_ps(_mm_set1_ps(step.y), fy)))));
+	_mm_storeu_ps(cursor.z + p, _mm_or_ps(missing, _mm_andnot_ps(fromMissing, _mm_add_ps(_mm_set1_ps(min.z), _mm_mul_ps(_mm_set1_ps(step.z), fz)))));
+	_mm_storeu_ps(cursor.dx + p, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(step.x), _mm_sub_ps(tx, fx)), perFrame));
+	_mm_storeu_ps(cursor.dy + p, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(step.y), _mm_sub_ps(ty, fy)), perFrame));
+	_mm_storeu_ps(cursor.dz + p, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(step.z), _mm_sub_ps(tz, fz)), perFrame));
+}
+
+// out = every point along its segment in cursor at frame at
+static void SampleSegmentsSSE2(const MocapKeyCursor& cursor, float at, MocapPoseSoA& out)
+{
+	const __m128 atV = _mm_set1_ps(at);
+	for (int p = 0; p < PosePaddedPoints; p += 4) {
+		__m128 since = _mm_sub_ps(atV, _mm_loadu_ps(cursor.fromFrame + p));
+		_mm_storeu_ps(out.x + p, _mm_add_ps(_mm_loadu_ps(cursor.x + p), _mm_mul_ps(_mm_loadu_ps(cursor.dx + p), since)));
+		_mm_storeu_ps(out.y + p, _mm_add_ps(_mm_loadu_ps(cursor.y + p), _mm_mul_ps(_mm_loadu_ps(cursor.dy + p), since)));
+		_mm_storeu_ps(out.z + p, _mm_add_ps(_mm_loadu_ps(cursor.z + p), _mm_mul_ps(_mm_loadu_ps(cursor.dz + p), since)));
+	}
+}
+
+#else
+
+static void SamplePointsSSE2(const MocapKey* const* keys, float at, const glm::vec3& min, const glm::vec3& step, MocapPoseSoA& out)
+{
+	SamplePointsScalar(keys, at, min, step, out);
+}
+
+static u32 StaleSegmentsSSE2(const MocapKeyCursor& cursor, float frame)
+{
+	u32 stale = 0;
+	for (int p = 0; p < PosePaddedPoints; p++) {
+		if (!(cursor.fromFrame[p] <= frame && frame < cursor.toFrame[p])) {
+			stale |= 1u << p;
+		}
+	}
+	return stale;
+}
+
+static void LoadSegmentsSSE2(const MocapKey* const* keys, const glm::vec3& min, const glm::vec3& step, MocapKeyCursor& cursor, int p)
+{
+	for (int i = 0; i < 4; i++, p++) {
+		const MocapKey& from = keys[i][0];
+		const MocapKey& to = keys[i][1];
+		cursor.fromFrame[p] = from.frame;
+		cursor.toFrame[p] = to.frame;
+		if (from.x == KeyMissing) {
+			cursor.x[p] = cursor.y[p] = cursor.z[p] = MocapMissingPointValue;
+			cursor.dx[p] = cursor.dy[p] = cursor.dz[p] = 0.0f;
+			continue;
+		}
+		cursor.x[p] = min.x + step.x * from.x;
+		cursor.y[p] = min.y + step.y * from.y;
+		cursor.z[p] = min.z + step.z * from.z;
+		float perFrame = to.x == KeyMissing ? 0.0f : 1.0f / (float)(to.frame - from.frame);
+		cursor.dx[p] = step.x * ((float)to.x - from.x) * perFrame;
+		cursor.dy[p] = step.y * ((float)to.y - from.y) * perFrame;
+		cursor.dz[p] = step.z * ((float)to.z - from.z) * perFrame;
+	}
+}
+
+static void SampleSegmentsSSE2(const MocapKeyCursor& cursor, float at, MocapPoseSoA& out)
+{
+	for (int p = 0; p < PosePaddedPoints; p++) {
+		float since = at - cursor.fromFrame[p];
+		out.x[p] = cursor.x[p] + cursor.dx[p] * since;
+		out.y[p] = cursor.y[p] + cursor.dy[p] * since;
+		out.z[p] = cursor.z[p] + cursor.dz[p] * since;
+	}
+}
+
+#endif
+
+bool IsComapk(const u8* data, size_t size)
+{
+	return size >= ComapkHeaderSize && memcmp(data, ComapkMagic, 4) == 0;
+}
+
+bool ReadComapkNumFrames(const u8* data, size_t size, size_t& numFrames)
+{
+	if (!IsComapk(data, size) || GetU32(data + 4) != ComapkVersion) {
+		return false;
+	}
+	numFrames = GetU32(data + 8);
+	return numFrames <= KeyMaxFrames;
+}
+
+void MocapKeyClip::SetQuantisation(const MocapClipSoA& clip, float tolerance)
+{
+	_numFrames = clip.GetNumFrames();
+	_tolerance = tolerance;
+	_maxError = 0.0f;
+	glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+	for (size_t f = 0; f < _numFrames; f++) {
+		const MocapPoseSoA& pose = clip.GetPose(f);
+		for (int p = 0; p < PlayerPoints; p++) {
+			glm::vec3 position(pose.x[p], pose.y[p], pose.z[p]);
+			if (!IsMissingPoint(position)) {
+				low = glm::min(low, position);
+				high = glm::max(high, position);
+			}
+		}
+	}
+	if (low.x > high.x) {
+		low = high = glm::vec3(0.0f);
+	}
+	// steps of half the tolerance keep the rounding to under half of it in 3d, leaving the rest for the lines between keys
+	_min = low;
+	_step = glm::max(glm::vec3(tolerance * 0.5f), (high - low) / (float)KeyMaxQuantised);
+	_step = glm::max(_step, glm::vec3(FLT_MIN));
+}
+
+void MocapKeyClip::ReducePoint(const MocapClipSoA& clip, int point, std::vector<MocapKey>& out, float& maxError) const
+{
+	out.clear();
+	maxError = 0.0f;
+	auto position = [&clip, point](size_t frame) {
+		const MocapPoseSoA& pose = clip.GetPose(frame);
+		return glm::vec3(pose.x[point], pose.y[point], pose.z[point]);
+	};
+	auto quantise = [this](const glm::vec3& p, u32 frame) {
+		glm::vec3 q = glm::clamp(glm::round((p - _min) / _step), glm::vec3(0.0f), glm::vec3((float)KeyMaxQuantised));
+		return MocapKey{ (u16)frame, (u16)q.x, (u16)q.y, (u16)q.z };
+	};
+	auto dequantise = [this](const MocapKey& key) {
+		return _min + _step * glm::vec3(key.x, key.y, key.z);
+	};
+	auto addKey = [&](const MocapKey& key, const glm::vec3& original) {
+		out.push_back(key);
+		maxError = std::max(maxError, glm::length(dequantise(key) - original));
+	};
+	float toleranceSquared = _tolerance * _tolerance;
+	std::vector<std::pair<size_t, size_t>> segments;
+	size_t start = 0;
+	while (start < _numFrames) {
+		// a run of frames the point is either present or missing for
+		bool missing = IsMissingPoint(position(start));
+		size_t end = start;
+		while (end + 1 < _numFrames && IsMissingPoint(position(end + 1)) == missing) {
+			end++;
+		}
+		if (missing) {
+			out.push_back(MocapKey{ (u16)start, KeyMissing, 0, 0 });
+			start = end + 1;
+			continue;
+		}
+		// Douglas-Peucker against the line between the keys as they'll be stored,
+		// the right half pushed first so keys come out in frame order
+		segments.clear();
+		segments.push_back(std::make_pair(start, end));
+		while (!segments.empty()) {
+			size_t a = segments.back().first;
+			size_t b = segments.back().second;
+			segments.pop_back();
+			glm::vec3 from = dequantise(quantise(position(a), 0));
+			glm::vec3 to = dequantise(quantise(position(b), 0));
+			float worst = 0.0f;
+			size_t split = a;
+			for (size_t f = a + 1; f < b; f++) {
+				glm::vec3 line = from + (to - from) * ((float)(f - a) / (float)(b - a));
+				glm::vec3 error = position(f) - line;
+				float errorSquared = glm::dot(error, error);
+				if (errorSquared > worst) {
+					worst = errorSquared;
+					split = f;
+				}
+			}
+			if (worst > toleranceSquared) {
+				segments.push_back(std::make_pair(split, b));
+				segments.push_back(std::make_pair(a, split));
+			}
+			else {
+				maxError = std::max(maxError, sqrtf(worst));
+				addKey(quantise(position(a), (u32)a), position(a));
+			}
+		}
+		if (end != start) {
+			addKey(quantise(position(end), (u32)end), position(end));
+		}
+		start = end + 1;
+	}
+}
+
+void MocapKeyClip::Assemble(std::vector<MocapKey>* pointKeys)
+{
+	_keys.clear();
+	for (int p = 0; p < PlayerPoints; p++) {
+		_pointFirstKey[p] = (u32)_keys.size();
+		_keys.insert(_keys.end(), pointKeys[p].begin(), pointKeys[p].end());
+		MocapKey sentinel = pointKeys[p].empty() ? MocapKey{ 0, 0, 0, 0 } : pointKeys[p].back();
+		sentinel.frame = KeyMaxFrames;
+		_keys.push_back(sentinel);
+	}
+	BuildIndex();
+}
+
+void MocapKeyClip::BuildIndex()
+{
+	size_t numBlocks = (_numFrames + KeyBlockFrames - 1) / KeyBlockFrames;
+	_blockKeys.resize(numBlocks * PlayerPoints);
+	_frameKeys.resize(_numFrames * PlayerPoints);
+	for (int p = 0; p < PlayerPoints; p++) {
+		u32 key = _pointFirstKey[p];
+		for (size_t f = 0; f < _numFrames; f++) {
+			while (_keys[key + 1].frame <= f) {
+				key++;
+			}
+			if (f % KeyBlockFrames == 0) {
+				_blockKeys[(f / KeyBlockFrames) * PlayerPoints + p] = key;
+			}
+			_frameKeys[f * PlayerPoints + p] = (u8)(key - _blockKeys[(f / KeyBlockFrames) * PlayerPoints + p]);
+		}
+	}
+}
+
+bool MocapKeyClip::Build(const MocapClipSoA& clip, float tolerance)
+{
+	Clear();
+	if (clip.GetNumFrames() > KeyMaxFrames) {
+		return false;
+	}
+	SetQuantisation(clip, tolerance);
+	std::vector<MocapKey> pointKeys[PlayerPoints];
+	for (int p = 0; p < PlayerPoints; p++) {
+		float error;
+		ReducePoint(clip, p, pointKeys[p], error);
+		_maxError = std::max(_maxError, error);
+	}
+	Assemble(pointKeys);
+	return true;
+}
+
+void MocapKeyClip::Clear()
+{
+	_numFrames = 0;
+	_tolerance = 0.0f;
+	_maxError = 0.0f;
+	_keys.clear();
+	_blockKeys.clear();
+	_frameKeys.clear();
+}
+
+size_t MocapKeyClip::GetSizeBytes() const
+{
+	return sizeof(*this) + _keys.size() * sizeof(MocapKey) + _blockKeys.size() * sizeof(u32) + _frameKeys.size();
+}
+
+static_assert(PlayerPoints % 4 == 0, "cursors load segments 4 points at a time");
+
+void MocapKeyClip::LoadSegments(int point, MocapKeyCursor& cursor) const
+{
+	const MocapKey* keys[4];
+	for (int i = 0; i < 4; i++) {
+		keys[i] = &_keys[cursor.key[point + i]];
+	}
+	LoadSegmentsSSE2(keys, _min, _step, cursor, point);
+}
+
+void MocapKeyClip::SampleFrame(size_t frame, float t, MocapPoseSoA& out, MocapKeyCursor* cursor) const
+{
+	if (_numFrames == 0) {
+		memset(&out, 0, sizeof(MocapPoseSoA));
+		return;
+	}
+	if (frame >= _numFrames - 1) {
+		frame = _numFrames - 1;
+		t = 0.0f;
+	}
+	if (cursor) {
+		if (cursor->clip != this) {
+			cursor->clip = this;
+			for (int p = 0; p < PlayerPoints; p++) {
+				cursor->key[p] = FindKey(p, frame);
+			}
+			for (int p = 0; p < PlayerPoints; p += 4) {
+				LoadSegments(p, *cursor);
+			}
+			for (int p = PlayerPoints; p < PosePaddedPoints; p++) {
+				// a segment the padding never leaves, standing still at 0
+				cursor->fromFrame[p] = 0.0f;
+				cursor->toFrame[p] = FLT_MAX;
+				cursor->x[p] = cursor->y[p] = cursor->z[p] = 0.0f;
+				cursor->dx[p] = cursor->dy[p] = cursor->dz[p] = 0.0f;
+			}
+		}
+		u32 stale = StaleSegmentsSSE2(*cursor, (float)frame);
+		for (int p = 0; stale != 0; p += 4, stale >>= 4) {
+			if ((stale & 0xF) == 0) {
+				continue;
+			}
+			for (int i = 0; i < 4; i++) {
+				// stale points step on to the next pair of keys, which is where playing on takes them, so only a
+				// seek needs the index. frame is always below the end marker, so key + 1 isn't read when key is it
+				u32 key = cursor->key[p + i] + ((stale >> i) & 1);
+				if (frame < _keys[key].frame || frame >= _keys[key + 1].frame) {
+					key = FindKey(p + i, frame);
+				}
+				cursor->key[p + i] = key;
+			}
+			LoadSegments(p, *cursor);
+		}
+		SampleSegmentsSSE2(*cursor, (float)frame + t, out);
+		return;
+	}
+	const u32* block = &_blockKeys[(frame / KeyBlockFrames) * PlayerPoints];
+	const u8* offsets = &_frameKeys[frame * PlayerPoints];
+	const MocapKey* keys[PosePaddedPoints];
+	for (int p = 0; p < PlayerPoints; p++) {
+		keys[p] = &_keys[block[p] + offsets[p]];
+	}
+	for (int p = PlayerPoints; p < PosePaddedPoints; p++) {
+		keys[p] = PaddingKeys;
+	}
+	SamplePointsSSE2(keys, (float)frame + t, _min, _step, out);
+	for (int p = PlayerPoints; p < PosePaddedPoints; p++) {
+		out.x[p] = out.y[p] = out.z[p] = 0.0f;
+	}
+}
+
+void MocapKeyClip::Sample(size_t a, size_t b, float t, MocapPoseSoA& out, MocapKeyCursor* cursor) const
+{
+	if (b == a + 1) {
+		SampleFrame(a, t, out, cursor);
+		return;
+	}
+	SampleFrame(a, 0.0f, out, cursor);
+	if (b != a && t != 0.0f) {
+		// wrapping back to the start, or any other pair of frames
+		MocapPoseSoA to;
+		SampleFrame(b, 0.0f, to);
+		LerpPoses(out, to, t, out);
+	}
+}
+
+void MocapKeyClip::Expand(MocapFrame* out) const
+{
+	MocapPoseSoA pose;
+	for (size_t f = 0; f < _numFrames; f++) {
+		SampleFrame(f, 0.0f, pose);
+		PoseToFrame(pose, out[f]);
+	}
+}
+
+void MocapKeyClip::Encode(std::vector<u8>& out) const
+{
+	out.clear();
+	out.insert(out.end(), ComapkMagic, ComapkMagic + 4);
+	PutU32(out, ComapkVersion);
+	PutU32(out, (u32)_numFrames);
+	PutF32(out, _tolerance);
+	PutF32(out, _maxError);
+	for (int axis = 0; axis < 3; axis++) {
+		PutF32(out, _min[axis]);
+	}
+	for (int axis = 0; axis < 3; axis++) {
+		PutF32(out, _step[axis]);
+	}
+	for (int p = 0; p < PlayerPoints; p++) {
+		u32 end = p + 1 < PlayerPoints ? _pointFirstKey[p + 1] : (u32)_keys.size();
+		PutU32(out, _keys.empty() ? 0 : end - _pointFirstKey[p] - 1);
+	}
+	for (int p = 0; p < PlayerPoints && !_keys.empty(); p++) {
+		for (u32 k = _pointFirstKey[p]; _keys[k].frame != KeyMaxFrames; k++) {
+			PutU16(out, _keys[k].frame);
+			PutU16(out, _keys[k].x);
+			PutU16(out, _keys[k].y);
+			PutU16(out, _keys[k].z);
+		}
+	}
+}
+
+bool MocapKeyClip::Decode(const u8* data, size_t size)
+{
+	Clear();
+	if (!IsComapk(data, size) || GetU32(data + 4) != ComapkVersion) {
+		return false;
+	}
+	size_t numFrames = GetU32(data + 8);
+	float tolerance = GetF32(data + 12);
+	float maxError = GetF32(data + 16);
+	glm::vec3 min, step;
+	for (int axis = 0; axis < 3; axis++) {
+		min[axis] = GetF32(data + 20 + axis * 4);
+		step[axis] = GetF32(data + 32 + axis * 4);
+	}
+	if (numFrames > KeyMaxFrames || !(step.x > 0.0f && step.y > 0.0f && step.z > 0.0f)) {
+		return false;
+	}
+	const u8* counts = data + 44;
+	const u8* keyData = data + ComapkHeaderSize;
+	size_t remaining = size - ComapkHeaderSize;
+	std::vector<MocapKey> pointKeys[PlayerPoints];
+	for (int p = 0; p < PlayerPoints; p++) {
+		size_t count = GetU32(counts + p * 4);
+		if (count > remaining / sizeof(MocapKey) || (numFrames > 0) != (count > 0)) {
+			return false;
+		}
+		pointKeys[p].resize(count);
+		for (size_t k = 0; k < count; k++) {
+			MocapKey& key = pointKeys[p][k];
+			key.frame = GetU16(keyData);
+			key.x = GetU16(keyData + 2);
+			key.y = GetU16(keyData + 4);
+			key.z = GetU16(keyData + 6);
+			keyData += sizeof(MocapKey);
+			// frames have to start at 0 and go up, for the index and sampling to find them
+			bool ordered = k == 0 ? key.frame == 0 : key.frame > pointKeys[p][k - 1].frame;
+			if (!ordered || key.frame >= numFrames) {
+				return false;
+			}
+		}
+		remaining -= count * sizeof(MocapKey);
+	}
+	_numFrames = numFrames;
+	_tolerance = tolerance;
+	_maxError = maxError;
+	_min = min;
+	_step = step;
+	if (numFrames > 0) {
+		Assemble(pointKeys);
+	}
+	return true;
+}
+
+void ReduceClips(const MocapClipSoA* const* clips, size_t numClips, float tolerance, MocapKeyClip* out)
+{
+	GetThreadPool().ParallelFor(numClips, [&](size_t c) {
+		out[c].Clear();
+		if (clips[c]->GetNumFrames() <= KeyMaxFrames) {
+			out[c].SetQuantisation(*clips[c], tolerance);
+		}
+	});
+	std::vector<std::vector<MocapKey>> pointKeys(numClips * PlayerPoints);
+	std::vector<float> pointErrors(numClips * PlayerPoints, 0.0f);
+	GetThreadPool().ParallelFor(pointKeys.size(), [&](size_t i) {
+		const MocapKeyClip& clip = out[i / PlayerPoints];
+		if (clip.GetNumFrames() > 0) {
+			clip.ReducePoint(*clips[i / PlayerPoints], (int)(i % PlayerPoints), pointKeys[i], pointErrors[i]);
+		}
+	});
+	GetThreadPool().ParallelFor(numClips, [&](size_t c) {
+		if (out[c].GetNumFrames() == 0) {
+			return;
+		}
+		out[c]._maxError = *std::max_element(pointErrors.begin() + c * PlayerPoints, pointErrors.begin() + (c + 1) * PlayerPoints);
+		out[c].Assemble(&pointKeys[c * PlayerPoints]);
+	});
+}
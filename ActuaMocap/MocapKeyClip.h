@@ -0,0 +1,144 @@
+#pragma once
+#include <vector>
+#include <stddef.h>
+#include "MocapPoseSoA.h"
+#include "BasicTypedefs.h"
+
+class MocapClipSoA;
+
+/*
+	.comapk - keyframed clip format
+
+	little endian throughout.
+	header:
+		char magic[4]              "CMPK"
+		u32  version
+		u32  numFrames             at most KeyMaxFrames
+		f32  tolerance             error asked for when the clip was reduced
+		f32  maxError              largest error on any frame of the original, can exceed tolerance where a
+		                           clip's range needed coarser steps to fit 16 bits
+		f32  min[3]                per axis, position = min + q * step
+		f32  step[3]
+		u32  keyCount[28]          keys per point
+	then each point's keys, first point first, in frame order:
+		u16  frame
+		u16  q[3]                  KeyMissing in x where the point goes missing
+
+	each point moves in a straight line from one key to the next. the first and last frames of every run of
+	frames a point is there for are keys, and it's missing from a missing key up to the next key.
+	every frame of the original clip is reproduced to within maxError, so anything sampled between frames is too
+*/
+
+#define ComapkMagic "CMPK"
+#define ComapkVersion 1
+#define ComapkHeaderSize (4 + 4 + 4 + 4 + 4 + 3 * 4 * 2 + PlayerPoints * 4)
+#define KeyBlockFrames 16 // frames per entry of the index into each point's keys
+#define KeyMissing 0xFFFF
+#define KeyMaxFrames 0xFFFF // frame numbers are 16 bit, 0xFFFF marks the end of a point's keys
+
+struct MocapKey {
+	u16 frame;
+	u16 x, y, z;
+};
+
+class MocapKeyClip;
+
+/// <summary>
+/// where one player is in a MocapKeyClip, so playing on through it frame by frame needn't look up keys again.
+/// each point's current pair of keys is held decoded, as a position at the first and a change per frame. a point
+/// that has moved past its second key steps on to the next pair, only one sought away from both goes back to the index
+/// </summary>
+struct MocapKeyCursor {
+	const MocapKeyClip* clip = nullptr; // the clip the segments are in, nullptr until first sampled
+	u32 key[PlayerPoints];               // each point's first key of its segment, the next one is checked before the index
+	float fromFrame[PosePaddedPoints];
+	float toFrame[PosePaddedPoints];
+	float x[PosePaddedPoints], y[PosePaddedPoints], z[PosePaddedPoints];
+	float dx[PosePaddedPoints], dy[PosePaddedPoints], dz[PosePaddedPoints];
+	// forget the segments, for when the clip they were taken from is rebuilt in place
+	inline void Reset() {
+		clip = nullptr;
+	}
+};
+
+bool IsComapk(const u8* data, size_t size);
+/// <summary>
+/// numFrames from the header of a .comapk, false if data doesn't start with one
+/// </summary>
+bool ReadComapkNumFrames(const u8* data, size_t size, size_t& numFrames);
+
+/// <summary>
+/// a clip reduced to the fewest keys per point that keep every frame within a tolerance, by Douglas-Peucker,
+/// with positions quantised to 16 bits. sampling needs no state: a per frame table gives each point's key
+/// directly, and the pairs of keys either side are transposed 8 points at a time and interpolated across SSE lanes.
+/// playback that plays on through a clip passes a MocapKeyCursor, and then only decodes the points that have passed a key
+/// </summary>
+class MocapKeyClip
+{
+public:
+	/// <summary>
+	/// reduce clip so no point is more than tolerance from where it was on any frame, false if it has
+	/// more than KeyMaxFrames frames
+	/// </summary>
+	bool Build(const MocapClipSoA& clip, float tolerance);
+	void Clear();
+	inline size_t GetNumFrames() const {
+		return _numFrames;
+	}
+	inline float GetTolerance() const {
+		return _tolerance;
+	}
+	inline float GetMaxError() const {
+		return _maxError;
+	}
+	// keys across all points, not counting the one past each point's last key
+	inline size_t GetNumKeys() const {
+		return _keys.empty() ? 0 : _keys.size() - PlayerPoints;
+	}
+	size_t GetSizeBytes() const;
+	/// <summary>
+	/// blend frames a and b by t into out, the same as MocapClipSoA::Sample. cursor, if given, is used for a
+	/// </summary>
+	void Sample(size_t a, size_t b, float t, MocapPoseSoA& out, MocapKeyCursor* cursor = nullptr) const;
+	/// <summary>
+	/// the pose t of the way from frame to frame + 1, frame + t clamped to the last frame.
+	/// with a cursor the segments it holds are reused and it's left holding the ones around frame
+	/// </summary>
+	void SampleFrame(size_t frame, float t, MocapPoseSoA& out, MocapKeyCursor* cursor = nullptr) const;
+	/// <summary>
+	/// every frame back into a dense clip, numFrames of them
+	/// </summary>
+	void Expand(MocapFrame* out) const;
+	void Encode(std::vector<u8>& out) const;
+	bool Decode(const u8* data, size_t size);
+private:
+	friend void ReduceClips(const MocapClipSoA* const* clips, size_t numClips, float tolerance, MocapKeyClip* out);
+	void SetQuantisation(const MocapClipSoA& clip, float tolerance);
+	// the keys of one point, written to its own vector so points can be reduced in parallel
+	void ReducePoint(const MocapClipSoA& clip, int point, std::vector<MocapKey>& out, float& maxError) const;
+	void Assemble(std::vector<MocapKey>* pointKeys);
+	void BuildIndex();
+	// the last key of point at or before frame
+	inline u32 FindKey(int point, size_t frame) const {
+		return _blockKeys[(frame / KeyBlockFrames) * PlayerPoints + point] + _frameKeys[frame * PlayerPoints + point];
+	}
+	// the segments of the 4 points from point on, from their keys in cursor, decoded into cursor
+	void LoadSegments(int point, MocapKeyCursor& cursor) const;
+private:
+	size_t _numFrames = 0;
+	float _tolerance = 0.0f;
+	float _maxError = 0.0f;
+	glm::vec3 _min = glm::vec3(0.0f);
+	glm::vec3 _step = glm::vec3(1.0f);
+	// every point's keys one after another, each followed by a copy of its last key at frame KeyMaxFrames
+	std::vector<MocapKey> _keys;
+	u32 _pointFirstKey[PlayerPoints] = {};
+	std::vector<u32> _blockKeys; // per block of KeyBlockFrames then per point, the last key at or before the block's first frame
+	std::vector<u8> _frameKeys;  // per frame then per point, the last key at or before the frame counting from its block's
+};
+
+/// <summary>
+/// reduce many clips at once, every point of every clip its own job on the thread pool. out[i] is clips[i]
+/// reduced, left empty for clips longer than KeyMaxFrames
+/// </summary>
+void ReduceClips(const MocapClipSoA* const* clips, size_t numClips, float tolerance, MocapKeyClip* out);
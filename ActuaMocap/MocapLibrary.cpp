@@ -0,0 +1,102 @@
+#include "MocapLibrary.h"
+#include <chrono>
+#include <iostream>
+#include <atomic>
+#include "IFilesystem.h"
+#include "MocapFile.h"
+#include "ThreadPool.h"
+#include "FileReads.h"
+#include "ComapzFormat.h"
+#include "MocapKeyClip.h"
+
+MocapLibrary::MocapLibrary(bool reverseEndianness)
+	:_reverseEndianness(reverseEndianness)
+{
+}
+
+bool MocapLibrary::Load(const std::string& folder, IFilesystem* fileSystem)
+{
+	using namespace std::chrono;
+	auto start = high_resolution_clock::now();
+	_arena.clear();
+	_clips.clear();
+	_clipIndices.clear();
+
+	std::vector<std::string> paths;
+	std::vector<u64> sizes;
+	for (const auto& entry : fileSystem->ListDirectoryEntries(folder)) {
+		if (!entry.isDirectory && (FileHasExtension(entry.name, ".comap") || FileHasExtension(entry.name, ".comapz") || FileHasExtension(entry.name, ".comapk"))) {
+			_clips.push_back({ entry.name, 0, 0 });
+			paths.push_back(JoinPath(folder, entry.name));
+			sizes.push_back(entry.stat.size);
+		}
+	}
+
+	// size every clip first so the arena can be allocated once and each clip decoded straight into its slot.
+	// a .comap's frame count follows from its size, only packed clips need their headers read
+	std::vector<FileRead> headerReads;
+	std::vector<size_t> packedClips;
+	for (size_t i = 0; i < _clips.size(); i++) {
+		_clips[i].numFrames = (size_t)(sizes[i] / MocapFrameSizeBytes);
+		bool keyed = FileHasExtension(_clips[i].name, ".comapk");
+		if (keyed || FileHasExtension(_clips[i].name, ".comapz")) {
+			FileRead read;
+			read.path = paths[i];
+			read.length = keyed ? ComapkHeaderSize : ComapzHeaderSize;
+			headerReads.push_back(read);
+			packedClips.push_back(i);
+		}
+	}
+	fileSystem->ReadFiles(headerReads);
+	for (size_t i = 0; i < headerReads.size(); i++) {
+		const auto& read = headerReads[i];
+		_clips[packedClips[i]].numFrames = read.ok ? MocapFile::CountFramesInBuffer(read.data.data(), read.data.size(), sizes[packedClips[i]]) : 0;
+	}
+	size_t totalFrames = 0;
+	for (auto& clip : _clips) {
+		clip.firstFrame = totalFrames;
+		totalFrames += clip.numFrames;
+	}
+	_arena.resize(totalFrames);
+
+	std::atomic<size_t> bytesRead(0);
+	std::atomic<size_t> failures(0);
+	ReadAndProcessFiles(fileSystem, paths, sizes, DefaultReadBatchBytes, [&](size_t i, const FileRead& read) {
+		const auto& clip = _clips[i];
+		// a clip with no frames at the end starts one past the arena, so point at it rather than index it
+		if (!read.ok || !MocapFile::DecodeBufferInto(read.data.data(), read.data.size(), _reverseEndianness, _arena.data() + clip.firstFrame, clip.numFrames)) {
+			failures++;
+			return;
+		}
+		bytesRead += read.data.size();
+	});
+
+	for (size_t i = 0; i < _clips.size(); i++) {
+		_clipIndices[_clips[i].name] = i;
+	}
+
+	double secs = duration<double>(high_resolution_clock::now() - start).count();
+	std::cout << "preloaded " << _clips.size() << " clips, " << totalFrames << " frames ("
+		<< bytesRead / 1024 << " KB) in " << secs * 1000.0 << " ms on " << GetThreadPool().GetNumThreads() << " threads, "
+		<< bytesRead / (1024.0 * 1024.0) / secs << " MB/s\n";
+	if (failures > 0) {
+		std::cout << failures << " clips failed to load\n";
+	}
+	return failures == 0;
+}
+
+const MocapClipEntry* MocapLibrary::FindClip(const std::string& name) const
+{
+	auto it = _clipIndices.find(name);
+	return it == _clipIndices.end() ? nullptr : &_clips[it->second];
+}
+
+bool MocapLibrary::LoadClip(const std::string& name, MocapFile& file) const
+{
+	const MocapClipEntry* clip = FindClip(name);
+	if (clip == nullptr) {
+		return false;
+	}
+	file.LoadView(_arena.data() + clip->firstFrame, clip->numFrames);
+	return true;
+}
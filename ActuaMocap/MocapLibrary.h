@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "MocapFrame.h"
+
+class IFilesystem;
+class MocapFile;
+
+struct MocapClipEntry {
+	std::string name;  // file name within the library folder
+	size_t firstFrame; // index of the clip's first frame in the arena
+	size_t numFrames;
+};
+
+/// <summary>
+/// every clip in a folder decoded up front, in parallel, into one contiguous arena of frames.
+/// MocapFiles handed out by LoadClip are views into the arena, so switching clips costs nothing
+/// and analysis passes can walk every frame in the library linearly.
+/// </summary>
+class MocapLibrary
+{
+public:
+	MocapLibrary(bool reverseEndianness);
+	bool Load(const std::string& folder, IFilesystem* fileSystem);
+	inline const std::vector<MocapClipEntry>& GetClips() const {
+		return _clips;
+	}
+	inline const MocapFrame* GetFrames() const {
+		return _arena.data();
+	}
+	inline size_t GetTotalFrames() const {
+		return _arena.size();
+	}
+	const MocapClipEntry* FindClip(const std::string& name) const;
+	/// <summary>
+	/// point file at the named clip's frames in the arena
+	/// </summary>
+	bool LoadClip(const std::string& name, MocapFile& file) const;
+private:
+	std::vector<MocapFrame> _arena;
+	std::vector<MocapClipEntry> _clips;
+	std::unordered_map<std::string, size_t> _clipIndices;
+	bool _reverseEndianness;
+};
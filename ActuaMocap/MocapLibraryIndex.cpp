@@ -0,0 +1,297 @@
+#include "MocapLibraryIndex.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+#include "IFilesystem.h"
+#include "MocapFile.h"
+#include "FileReads.h"
+#include "Hash.h"
+
+struct IndexFileHeader {
+	char magic[4];
+	u32 version;
+	u32 recordSize;
+	u32 numRecords;
+	float fps;          // durations and speeds in the records are at this rate
+	u32 reserved;
+	u64 namesSize;
+	u64 checksum;       // Fnv1a64Words of the records then the names
+};
+
+struct IndexFileRecord {
+	u32 nameOffset;
+	u32 nameLength;
+	u64 sourceSize;
+	i64 modifiedTime;
+	u64 contentHash;
+	u32 numFrames;
+	float durationSeconds;
+	float aabbMin[3];
+	float aabbMax[3];
+	float maxJointSpeed;
+	u32 reserved;
+};
+
+static_assert(sizeof(IndexFileHeader) == 40, "IndexFileHeader is written to disk as is");
+static_assert(sizeof(IndexFileRecord) == 72, "IndexFileRecord is written to disk as is");
+
+MocapLibraryIndex::MocapLibraryIndex(bool reverseEndianness, double fps)
+	:_reverseEndianness(reverseEndianness),
+	_fps(fps)
+{
+}
+
+bool MocapLibraryIndex::Load(const std::string& indexPath)
+{
+	_clips.clear();
+	_lookup.clear();
+	std::vector<u8> bytes;
+	if (!MocapFile::ReadWholeFile(indexPath, bytes) || bytes.size() < sizeof(IndexFileHeader)) {
+		return false;
+	}
+	IndexFileHeader header;
+	memcpy(&header, bytes.data(), sizeof(header));
+	if (memcmp(header.magic, MocapIndexMagic, 4) != 0 || header.version != MocapIndexVersion
+		|| header.recordSize != sizeof(IndexFileRecord) || header.fps <= 0.0f) {
+		std::cout << indexPath << " isn't a clip index this version can read\n";
+		return false;
+	}
+	size_t recordsSize = (size_t)header.numRecords * sizeof(IndexFileRecord);
+	if (bytes.size() - sizeof(header) != recordsSize + header.namesSize
+		|| Fnv1a64Words(bytes.data() + sizeof(header), bytes.size() - sizeof(header)) != header.checksum) {
+		std::cout << indexPath << " is corrupt\n";
+		return false;
+	}
+	const IndexFileRecord* records = (const IndexFileRecord*)(bytes.data() + sizeof(header));
+	const char* names = (const char*)(bytes.data() + sizeof(header) + recordsSize);
+	// index written at another rate, durations and speeds scale with it
+	float rateScale = (float)(_fps / header.fps);
+	_clips.resize(header.numRecords);
+	for (size_t i = 0; i < _clips.size(); i++) {
+		const IndexFileRecord& record = records[i];
+		if ((u64)record.nameOffset + record.nameLength > header.namesSize) {
+			_clips.clear();
+			return false;
+		}
+		MocapClipMetadata& clip = _clips[i];
+		clip.name.assign(names + record.nameOffset, record.nameLength);
+		clip.sourceSize = record.sourceSize;
+		clip.modifiedTime = record.modifiedTime;
+		clip.contentHash = record.contentHash;
+		clip.numFrames = record.numFrames;
+		clip.durationSeconds = record.durationSeconds / rateScale;
+		clip.aabbMin = glm::vec3(record.aabbMin[0], record.aabbMin[1], record.aabbMin[2]);
+		clip.aabbMax = glm::vec3(record.aabbMax[0], record.aabbMax[1], record.aabbMax[2]);
+		clip.maxJointSpeed = record.maxJointSpeed * rateScale;
+	}
+	RebuildLookup();
+	return true;
+}
+
+bool MocapLibraryIndex::Save(const std::string& indexPath, IFilesystem* fileSystem) const
+{
+	std::vector<IndexFileRecord> records(_clips.size());
+	std::string names;
+	for (size_t i = 0; i < _clips.size(); i++) {
+		const MocapClipMetadata& clip = _clips[i];
+		IndexFileRecord& record = records[i];
+		memset(&record, 0, sizeof(record));
+		record.nameOffset = (u32)names.size();
+		record.nameLength = (u32)clip.name.size();
+		names += clip.name;
+		record.sourceSize = clip.sourceSize;
+		record.modifiedTime = clip.modifiedTime;
+		record.contentHash = clip.contentHash;
+		record.numFrames = clip.numFrames;
+		record.durationSeconds = clip.durationSeconds;
+		for (int c = 0; c < 3; c++) {
+			record.aabbMin[c] = clip.aabbMin[c];
+			record.aabbMax[c] = clip.aabbMax[c];
+		}
+		record.maxJointSpeed = clip.maxJointSpeed;
+	}
+	IndexFileHeader header = {};
+	memcpy(header.magic, MocapIndexMagic, 4);
+	header.version = MocapIndexVersion;
+	header.recordSize = sizeof(IndexFileRecord);
+	header.numRecords = (u32)records.size();
+	header.fps = (float)_fps;
+	header.namesSize = names.size();
+	// records are a multiple of 8 bytes, so hashing the two parts in turn matches hashing the file's tail in one go
+	header.checksum = Fnv1a64Words(names.data(), names.size(), Fnv1a64Words(records.data(), records.size() * sizeof(IndexFileRecord)));
+
+	std::string tempPath = indexPath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ofstream::binary | std::ofstream::trunc);
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)records.data(), records.size() * sizeof(IndexFileRecord));
+		out.write(names.data(), names.size());
+		if (!out) {
+			std::cout << "couldn't write " << tempPath << "\n";
+			return false;
+		}
+	}
+	if (!fileSystem->MoveFileReplacing(tempPath, indexPath)) {
+		std::cout << "couldn't replace " << indexPath << "\n";
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+size_t MocapLibraryIndex::Update(const std::string& folder, IFilesystem* fileSystem)
+{
+	std::vector<MocapClipMetadata> clips;
+	std::vector<size_t> toMeasure;
+	size_t listed = 0; // clips already in the index that are still in the folder
+	// the listing carries each file's stat, so unchanged clips cost nothing beyond it
+	for (const auto& entry : fileSystem->ListDirectoryEntries(folder)) {
+		if (entry.isDirectory || (!FileHasExtension(entry.name, ".comap") && !FileHasExtension(entry.name, ".comapz") && !FileHasExtension(entry.name, ".comapk"))) {
+			continue;
+		}
+		const MocapClipMetadata* existing = Find(entry.name);
+		listed += existing != nullptr;
+		if (existing && existing->sourceSize == entry.stat.size && existing->modifiedTime == entry.stat.modifiedTime) {
+			clips.push_back(*existing);
+			continue;
+		}
+		MocapClipMetadata clip;
+		clip.name = entry.name;
+		clip.sourceSize = entry.stat.size;
+		clip.modifiedTime = entry.stat.modifiedTime;
+		toMeasure.push_back(clips.size());
+		clips.push_back(clip);
+	}
+	MeasureAll(folder, clips, toMeasure, fileSystem);
+
+	size_t removed = _clips.size() - listed;
+	std::sort(clips.begin(), clips.end(), [](const MocapClipMetadata& a, const MocapClipMetadata& b) {
+		return a.name < b.name;
+	});
+	_clips = std::move(clips);
+	RebuildLookup();
+	return toMeasure.size() + removed;
+}
+
+size_t MocapLibraryIndex::UpdateClips(const std::string& folder, const std::vector<std::string>& names, IFilesystem* fileSystem)
+{
+	std::vector<size_t> toMeasure;
+	// erased once everything's measured, erasing now would move the clips toMeasure points at
+	std::vector<std::string> toRemove;
+	for (const auto& name : names) {
+		FileStat stat;
+		bool exists = fileSystem->GetFileStat(JoinPath(folder, name), stat);
+		auto found = _lookup.find(name);
+		if (!exists) {
+			if (found != _lookup.end() && std::find(toRemove.begin(), toRemove.end(), name) == toRemove.end()) {
+				toRemove.push_back(name);
+			}
+			continue;
+		}
+		if (found != _lookup.end() && _clips[found->second].sourceSize == stat.size && _clips[found->second].modifiedTime == stat.modifiedTime) {
+			continue;
+		}
+		if (found == _lookup.end()) {
+			MocapClipMetadata clip;
+			clip.name = name;
+			_lookup[name] = _clips.size();
+			_clips.push_back(clip);
+		}
+		size_t i = _lookup[name];
+		_clips[i].sourceSize = stat.size;
+		_clips[i].modifiedTime = stat.modifiedTime;
+		if (std::find(toMeasure.begin(), toMeasure.end(), i) == toMeasure.end()) {
+			toMeasure.push_back(i);
+		}
+	}
+	MeasureAll(folder, _clips, toMeasure, fileSystem);
+	_clips.erase(std::remove_if(_clips.begin(), _clips.end(), [&toRemove](const MocapClipMetadata& clip) {
+		return std::find(toRemove.begin(), toRemove.end(), clip.name) != toRemove.end();
+	}), _clips.end());
+	std::sort(_clips.begin(), _clips.end(), [](const MocapClipMetadata& a, const MocapClipMetadata& b) {
+		return a.name < b.name;
+	});
+	RebuildLookup();
+	return toMeasure.size() + toRemove.size();
+}
+
+void MocapLibraryIndex::MeasureAll(const std::string& folder, std::vector<MocapClipMetadata>& clips, const std::vector<size_t>& toMeasure, IFilesystem* fileSystem) const
+{
+	std::vector<std::string> paths;
+	std::vector<u64> sizes;
+	for (size_t i : toMeasure) {
+		paths.push_back(JoinPath(folder, clips[i].name));
+		sizes.push_back(clips[i].sourceSize);
+	}
+	std::atomic<size_t> failures(0);
+	ReadAndProcessFiles(fileSystem, paths, sizes, DefaultReadBatchBytes, [&](size_t i, const FileRead& read) {
+		MocapClipMetadata& clip = clips[toMeasure[i]];
+		if (!read.ok || !Measure(read.data.data(), read.data.size(), _reverseEndianness, _fps, clip)) {
+			// no stat matches, so the next update tries it again
+			MocapClipMetadata unmeasured;
+			unmeasured.name = clip.name;
+			clip = unmeasured;
+			failures++;
+		}
+	});
+	if (failures > 0) {
+		std::cout << failures << " clips couldn't be measured for the index\n";
+	}
+}
+
+const MocapClipMetadata* MocapLibraryIndex::Find(const std::string& name) const
+{
+	auto it = _lookup.find(name);
+	return it == _lookup.end() ? nullptr : &_clips[it->second];
+}
+
+bool MocapLibraryIndex::Measure(const u8* data, size_t size, bool reverseEndianness, double fps, MocapClipMetadata& out)
+{
+	std::vector<MocapFrame> frames;
+	if (!MocapFile::DecodeBuffer(data, size, reverseEndianness, frames)) {
+		return false;
+	}
+	out.contentHash = Fnv1a64(data, size);
+	out.numFrames = (u32)frames.size();
+	out.durationSeconds = (float)(frames.size() / fps);
+
+	glm::vec3 aabbMin(FLT_MAX);
+	glm::vec3 aabbMax(-FLT_MAX);
+	float maxStepSquared = 0.0f;
+	for (size_t f = 0; f < frames.size(); f++) {
+		for (int p = 0; p < PlayerPoints; p++) {
+			const glm::vec3& point = frames[f].points[p];
+			if (IsMissingPoint(point)) {
+				continue;
+			}
+			aabbMin = glm::min(aabbMin, point);
+			aabbMax = glm::max(aabbMax, point);
+			if (f > 0 && !IsMissingPoint(frames[f - 1].points[p])) {
+				glm::vec3 step = point - frames[f - 1].points[p];
+				maxStepSquared = std::max(maxStepSquared, glm::dot(step, step));
+			}
+		}
+	}
+	if (aabbMin.x > aabbMax.x) {
+		// nothing captured at all
+		aabbMin = aabbMax = glm::vec3(0.0f);
+	}
+	out.aabbMin = aabbMin;
+	out.aabbMax = aabbMax;
+	out.maxJointSpeed = (float)(sqrt(maxStepSquared) * fps);
+	return true;
+}
+
+void MocapLibraryIndex::RebuildLookup()
+{
+	_lookup.clear();
+	_lookup.reserve(_clips.size());
+	for (size_t i = 0; i < _clips.size(); i++) {
+		_lookup[_clips[i].name] = i;
+	}
+}
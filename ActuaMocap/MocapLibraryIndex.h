@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "BasicTypedefs.h"
+
+class IFilesystem;
+
+#define MocapIndexMagic "CMPI"
+#define MocapIndexVersion 1
+#define MocapIndexFileName "library.cmi"
+
+/// <summary>
+/// what the browser shows about a clip without opening it
+/// </summary>
+struct MocapClipMetadata {
+	std::string name;
+	u64 sourceSize = 0;
+	i64 modifiedTime = 0;
+	u64 contentHash = 0;    // FNV-1a of the clip file's bytes
+	u32 numFrames = 0;
+	float durationSeconds = 0.0f; // at the index's fps
+	glm::vec3 aabbMin = glm::vec3(0.0f); // over every captured point of every frame
+	glm::vec3 aabbMax = glm::vec3(0.0f);
+	float maxJointSpeed = 0.0f; // fastest any point moves between consecutive frames, units per second
+};
+
+/// <summary>
+/// per clip metadata for a whole library folder, kept in one binary file beside the clips.
+/// the file is a header, a table of fixed size records and a table of names, so it's
+/// read in one go and parsed without decoding anything.
+/// Update only measures clips whose size or modification time has changed
+/// </summary>
+class MocapLibraryIndex
+{
+public:
+	MocapLibraryIndex(bool reverseEndianness, double fps);
+	bool Load(const std::string& indexPath);
+	/// <summary>
+	/// written to a temporary file then moved over indexPath
+	/// </summary>
+	bool Save(const std::string& indexPath, IFilesystem* fileSystem) const;
+	/// <summary>
+	/// bring the index in line with the clips now in folder, measuring new and changed ones in parallel.
+	/// returns how many clips were added, changed or removed
+	/// </summary>
+	size_t Update(const std::string& folder, IFilesystem* fileSystem);
+	/// <summary>
+	/// like Update but only looks at the named clips, e.g. ones a directory watch reported.
+	/// clips that no longer exist are dropped
+	/// </summary>
+	size_t UpdateClips(const std::string& folder, const std::vector<std::string>& names, IFilesystem* fileSystem);
+	inline const std::vector<MocapClipMetadata>& GetClips() const {
+		return _clips;
+	}
+	const MocapClipMetadata* Find(const std::string& name) const;
+	/// <summary>
+	/// decode a whole clip file held in memory and fill in everything but its name and stat
+	/// </summary>
+	static bool Measure(const u8* data, size_t size, bool reverseEndianness, double fps, MocapClipMetadata& out);
+private:
+	void RebuildLookup();
+	void MeasureAll(const std::string& folder, std::vector<MocapClipMetadata>& clips, const std::vector<size_t>& toMeasure, IFilesystem* fileSystem) const;
+private:
+	std::vector<MocapClipMetadata> _clips;
+	std::unordered_map<std::string, size_t> _lookup;
+	bool _reverseEndianness;
+	double _fps;
+};
@@ -0,0 +1,495 @@
+#include "MocapMotionGraph.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+#include "IFilesystem.h"
+#include "MocapFile.h"
+#include "MocapLibrary.h"
+#include "MocapPoseSoA.h"
+#include "ThreadPool.h"
+#include "Hash.h"
+
+struct MotionGraphFileHeader {
+	char magic[4];
+	u32 version;
+	u32 numClips;
+	u32 numTransitions;
+	u32 window;
+	u32 reserved;
+	u64 namesSize;
+	u64 checksum;       // Fnv1a64Words of the clips, then the transitions, then the names
+};
+
+struct MotionGraphFileClip {
+	u32 nameOffset;
+	u32 nameLength;
+	u32 firstFrame;
+	u32 numFrames;
+};
+
+static_assert(sizeof(MotionGraphFileHeader) == 40, "MotionGraphFileHeader is written to disk as is");
+static_assert(sizeof(MotionGraphFileClip) == 16, "MotionGraphFileClip is written to disk as is");
+static_assert(sizeof(MotionGraphTransition) == 12, "MotionGraphTransition is written to disk as is");
+
+static u64 MotionGraphChecksum(const void* clips, size_t clipsSize, const void* transitions, size_t transitionsSize, const void* names, size_t namesSize) {
+	return Fnv1a64Words(names, namesSize, Fnv1a64Words(transitions, transitionsSize, Fnv1a64Words(clips, clipsSize)));
+}
+
+static bool TransitionBefore(const MotionGraphTransition& a, const MotionGraphTransition& b) {
+	return a.from != b.from ? a.from < b.from : a.cost < b.cost;
+}
+
+bool MocapMotionGraph::Build(const MocapLibrary& library, const MotionGraphOptions& options, MotionGraphBuildStats& stats,
+	const std::function<void(size_t, size_t)>& progress)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	stats = MotionGraphBuildStats();
+	_clips.clear();
+	_transitions.clear();
+	const size_t numFrames = library.GetTotalFrames();
+	if (numFrames >= UINT32_MAX) {
+		std::cout << "too many frames for a motion graph\n";
+		return false;
+	}
+	_window = options.window > 0 ? options.window : 1;
+	const size_t window = _window;
+	const size_t tileSize = options.tileSize > 0 ? options.tileSize : 64;
+
+	// a window may start at a frame if the whole window is in the same clip
+	std::vector<u32> clipOfFrame(numFrames);
+	std::vector<u8> windowFits(numFrames, 0);
+	for (const auto& clip : library.GetClips()) {
+		MotionGraphClip graphClip;
+		graphClip.name = clip.name;
+		graphClip.firstFrame = (u32)clip.firstFrame;
+		graphClip.numFrames = (u32)clip.numFrames;
+		for (size_t f = 0; f < clip.numFrames; f++) {
+			clipOfFrame[clip.firstFrame + f] = (u32)_clips.size();
+			windowFits[clip.firstFrame + f] = f + window <= clip.numFrames;
+		}
+		_clips.push_back(graphClip);
+	}
+
+	// clips are captured in place around the origin, so poses are compared where they are and a
+	// transition never needs the skeleton moving. missing points are zeroed rather than left at
+	// MocapMissingPointValue, where they'd swamp every distance they're part of
+	std::vector<MocapPoseSoA> poses(numFrames);
+	const MocapFrame* frames = library.GetFrames();
+	GetThreadPool().ParallelFor(numFrames, [&](size_t i) {
+		MocapFrame frame = frames[i];
+		for (int p = 0; p < PlayerPoints; p++) {
+			if (IsMissingPoint(frame.points[p])) {
+				frame.points[p] = glm::vec3(0.0f);
+			}
+		}
+		PoseFromFrame(frame, poses[i]);
+	}, 256);
+
+	// the matrix is symmetric so only tiles on and above the diagonal are computed, and each minimum found
+	// gives a transition both ways. every tile also works out a border of one frame, plus window - 1 more
+	// frames of raw distances below and to the right, so it can test its own cells for minima without its neighbours
+	const size_t numTileRows = (numFrames + tileSize - 1) / tileSize;
+	std::vector<std::pair<u32, u32>> tiles;
+	for (size_t row = 0; row < numTileRows; row++) {
+		for (size_t column = row; column < numTileRows; column++) {
+			tiles.push_back(std::make_pair((u32)row, (u32)column));
+		}
+	}
+	const float limit = options.threshold * options.threshold * window * PlayerPoints;
+	const size_t minGap = options.minGap;
+	std::vector<std::vector<MotionGraphTransition>> tileMinima(tiles.size());
+	std::atomic<u64> pairs(0);
+	std::atomic<size_t> tilesDone(0);
+	std::mutex progressMutex;
+	size_t progressReported = 0;
+
+	GetThreadPool().ParallelFor(tiles.size(), [&](size_t tile) {
+		const size_t rawSize = tileSize + window + 1;
+		const size_t cellsSize = tileSize + 2;
+		std::vector<float> raw(rawSize * rawSize, FLT_MAX);
+		std::vector<float> cells(cellsSize * cellsSize, FLT_MAX);
+		// signed, the border of the first tile row and column is before frame 0
+		const ptrdiff_t row0 = (ptrdiff_t)(tiles[tile].first * tileSize) - 1;
+		const ptrdiff_t column0 = (ptrdiff_t)(tiles[tile].second * tileSize) - 1;
+		const ptrdiff_t count = (ptrdiff_t)numFrames;
+
+		ptrdiff_t firstColumn = column0 < 0 ? -column0 : 0;
+		ptrdiff_t endColumn = std::min((ptrdiff_t)rawSize, count - column0);
+		u64 tilePairs = 0;
+		for (ptrdiff_t a = 0; a < (ptrdiff_t)rawSize; a++) {
+			ptrdiff_t row = row0 + a;
+			if (row < 0 || row >= count || endColumn <= firstColumn) {
+				continue;
+			}
+			PoseDistancesSquared(poses[row], &poses[column0 + firstColumn], endColumn - firstColumn, &raw[a * rawSize + firstColumn]);
+			tilePairs += endColumn - firstColumn;
+		}
+
+		for (ptrdiff_t a = 0; a < (ptrdiff_t)cellsSize; a++) {
+			ptrdiff_t row = row0 + a;
+			if (row < 0 || row >= count || !windowFits[row]) {
+				continue;
+			}
+			for (ptrdiff_t b = 0; b < (ptrdiff_t)cellsSize; b++) {
+				ptrdiff_t column = column0 + b;
+				if (column < 0 || column >= count || !windowFits[column]) {
+					continue;
+				}
+				if (clipOfFrame[row] == clipOfFrame[column] && (size_t)(row > column ? row - column : column - row) < minGap) {
+					continue;
+				}
+				float sum = 0.0f;
+				for (size_t k = 0; k < window; k++) {
+					sum += raw[(a + k) * rawSize + b + k];
+				}
+				cells[a * cellsSize + b] = sum;
+			}
+		}
+
+		std::vector<MotionGraphTransition>& minima = tileMinima[tile];
+		for (size_t a = 1; a <= tileSize; a++) {
+			for (size_t b = 1; b <= tileSize; b++) {
+				ptrdiff_t row = row0 + a;
+				ptrdiff_t column = column0 + b;
+				float d = cells[a * cellsSize + b];
+				if (row >= column || column >= count || d > limit) {
+					continue;
+				}
+				bool minimum = true;
+				for (int da = -1; da <= 1 && minimum; da++) {
+					for (int db = -1; db <= 1; db++) {
+						if ((da != 0 || db != 0) && cells[(a + da) * cellsSize + b + db] < d) {
+							minimum = false;
+							break;
+						}
+					}
+				}
+				if (minimum) {
+					MotionGraphTransition transition;
+					transition.from = (u32)row;
+					transition.to = (u32)column;
+					transition.cost = sqrtf(d / (window * PlayerPoints));
+					minima.push_back(transition);
+				}
+			}
+		}
+
+		pairs += tilePairs;
+		size_t done = ++tilesDone;
+		if (progress) {
+			std::lock_guard<std::mutex> lock(progressMutex);
+			// about every percent, and never going backwards when tiles finish out of order
+			if (done > progressReported && (done * 100 / tiles.size() != progressReported * 100 / tiles.size() || done == tiles.size())) {
+				progressReported = done;
+				progress(done, tiles.size());
+			}
+		}
+	});
+
+	for (const auto& minima : tileMinima) {
+		stats.minima += minima.size();
+		for (const auto& transition : minima) {
+			_transitions.push_back(transition);
+			MotionGraphTransition back = transition;
+			std::swap(back.from, back.to);
+			_transitions.push_back(back);
+		}
+	}
+	std::sort(_transitions.begin(), _transitions.end(), TransitionBefore);
+	if (options.maxPerFrame > 0) {
+		size_t kept = 0;
+		size_t run = 0;
+		for (size_t i = 0; i < _transitions.size(); i++) {
+			run = i > 0 && _transitions[i - 1].from == _transitions[i].from ? run + 1 : 0;
+			if (run < options.maxPerFrame) {
+				_transitions[kept++] = _transitions[i];
+			}
+		}
+		_transitions.resize(kept);
+	}
+	RebuildLookup();
+	Prune(stats);
+	stats.pairs = pairs;
+	stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+void MocapMotionGraph::Prune(MotionGraphBuildStats& stats)
+{
+	// a walk is always somewhere between transitions, landed in a clip and playing on towards its exits.
+	// so the nodes here are the transitions and the frames with exits. a transition leads to the first exit
+	// frame at or after where it lands plus the window, which plays out first, and an exit frame leads to its
+	// own transitions and the clip's next exit frame. only the largest strongly connected part is kept, so
+	// wherever a walk is it can still get everywhere else, rather than running off the end of a clip or
+	// into a loop it can't leave
+	const size_t numTransitions = _transitions.size();
+	const size_t totalFrames = _firstTransition.size() - 1;
+	std::vector<u32> exitFrames;   // frame of each exit node
+	std::vector<i64> exitNext;     // the clip's next exit node after each one, or -1
+	std::vector<i64> firstExitFrom(totalFrames, -1); // first exit node at or after each frame, in the same clip
+	for (const auto& clip : _clips) {
+		i64 next = -1;
+		for (size_t f = clip.numFrames; f-- > 0;) {
+			size_t frame = clip.firstFrame + f;
+			if (_firstTransition[frame + 1] > _firstTransition[frame]) {
+				exitFrames.push_back((u32)frame);
+				exitNext.push_back(next);
+				next = (i64)(numTransitions + exitFrames.size() - 1);
+			}
+			firstExitFrom[frame] = next;
+		}
+	}
+	auto edge = [&](size_t node, size_t i) -> i64 {
+		if (node < numTransitions) {
+			u32 frame;
+			size_t clip = GetClipOfFrame(_transitions[node].to, frame);
+			if (i > 0 || frame + _window >= _clips[clip].numFrames) {
+				return -1;
+			}
+			return firstExitFrom[_transitions[node].to + _window];
+		}
+		size_t exit = node - numTransitions;
+		size_t frame = exitFrames[exit];
+		size_t count = _firstTransition[frame + 1] - _firstTransition[frame];
+		return i < count ? (i64)(_firstTransition[frame] + i) : i == count ? exitNext[exit] : -1;
+	};
+
+	// Tarjan's algorithm, with an explicit stack so long chains of exits can't overflow the real one
+	const size_t numNodes = numTransitions + exitFrames.size();
+	std::vector<i64> order(numNodes, -1);
+	std::vector<i64> low(numNodes);
+	std::vector<u32> component(numNodes);
+	std::vector<u8> onStack(numNodes, 0);
+	std::vector<u32> stack;
+	std::vector<std::pair<size_t, size_t>> calls; // node, next edge to follow
+	std::vector<size_t> componentTransitions;
+	i64 visited = 0;
+	for (size_t root = 0; root < numNodes; root++) {
+		if (order[root] >= 0) {
+			continue;
+		}
+		order[root] = low[root] = visited++;
+		stack.push_back((u32)root);
+		onStack[root] = 1;
+		calls.push_back(std::make_pair(root, (size_t)0));
+		while (!calls.empty()) {
+			size_t node = calls.back().first;
+			i64 next = edge(node, calls.back().second);
+			if (next >= 0) {
+				calls.back().second++;
+				if (order[next] < 0) {
+					order[next] = low[next] = visited++;
+					stack.push_back((u32)next);
+					onStack[next] = 1;
+					calls.push_back(std::make_pair((size_t)next, (size_t)0));
+				}
+				else if (onStack[next]) {
+					low[node] = std::min(low[node], order[next]);
+				}
+				continue;
+			}
+			calls.pop_back();
+			if (!calls.empty()) {
+				size_t parent = calls.back().first;
+				low[parent] = std::min(low[parent], low[node]);
+			}
+			if (low[node] == order[node]) {
+				size_t transitions = 0;
+				u32 member;
+				do {
+					member = stack.back();
+					stack.pop_back();
+					onStack[member] = 0;
+					component[member] = (u32)componentTransitions.size();
+					transitions += member < numTransitions;
+				} while (member != node);
+				componentTransitions.push_back(transitions);
+			}
+		}
+	}
+
+	size_t largest = 0;
+	for (size_t i = 1; i < componentTransitions.size(); i++) {
+		if (componentTransitions[i] > componentTransitions[largest]) {
+			largest = i;
+		}
+	}
+	size_t kept = 0;
+	for (size_t i = 0; i < numTransitions; i++) {
+		if (component[i] == largest) {
+			_transitions[kept++] = _transitions[i];
+		}
+	}
+	stats.pruned += numTransitions - kept;
+	_transitions.resize(kept);
+	RebuildLookup();
+}
+
+void MocapMotionGraph::RebuildLookup()
+{
+	_lookup.clear();
+	u32 totalFrames = 0;
+	for (size_t i = 0; i < _clips.size(); i++) {
+		_lookup[_clips[i].name] = i;
+		totalFrames = std::max(totalFrames, _clips[i].firstFrame + _clips[i].numFrames);
+	}
+	_firstTransition.assign(totalFrames + 1, 0);
+	for (const auto& transition : _transitions) {
+		_firstTransition[transition.from + 1]++;
+	}
+	for (size_t i = 1; i < _firstTransition.size(); i++) {
+		_firstTransition[i] += _firstTransition[i - 1];
+	}
+}
+
+int MocapMotionGraph::FindClip(const std::string& name) const
+{
+	auto it = _lookup.find(name);
+	return it == _lookup.end() ? -1 : (int)it->second;
+}
+
+size_t MocapMotionGraph::GetClipOfFrame(u32 frame, u32& frameInClip) const
+{
+	auto it = std::upper_bound(_clips.begin(), _clips.end(), frame, [](u32 f, const MotionGraphClip& clip) {
+		return f < clip.firstFrame;
+	});
+	size_t clip = it == _clips.begin() ? 0 : (it - _clips.begin()) - 1;
+	frameInClip = frame - _clips[clip].firstFrame;
+	return clip;
+}
+
+const MotionGraphTransition* MocapMotionGraph::GetTransitionsFrom(size_t clip, size_t frame, size_t& count) const
+{
+	count = 0;
+	if (clip >= _clips.size() || frame >= _clips[clip].numFrames) {
+		return nullptr;
+	}
+	size_t global = _clips[clip].firstFrame + frame;
+	count = _firstTransition[global + 1] - _firstTransition[global];
+	return count > 0 ? &_transitions[_firstTransition[global]] : nullptr;
+}
+
+const MotionGraphTransition* MocapMotionGraph::ChooseTransition(size_t clip, size_t frame, u32& rng) const
+{
+	size_t count;
+	const MotionGraphTransition* here = GetTransitionsFrom(clip, frame, count);
+	if (count == 0) {
+		return nullptr;
+	}
+	size_t exits = 0;
+	size_t first = _clips[clip].firstFrame;
+	for (size_t f = first + frame; f < first + _clips[clip].numFrames; f++) {
+		exits += _firstTransition[f + 1] > _firstTransition[f];
+	}
+	rng = rng * 1664525u + 1013904223u;
+	if ((rng >> 8) % exits != 0) {
+		return nullptr;
+	}
+	rng = rng * 1664525u + 1013904223u;
+	return &here[(rng >> 8) % count];
+}
+
+bool MocapMotionGraph::Load(const std::string& path)
+{
+	_clips.clear();
+	_transitions.clear();
+	std::vector<u8> bytes;
+	if (!MocapFile::ReadWholeFile(path, bytes) || bytes.size() < sizeof(MotionGraphFileHeader)) {
+		return false;
+	}
+	MotionGraphFileHeader header;
+	memcpy(&header, bytes.data(), sizeof(header));
+	if (memcmp(header.magic, MotionGraphMagic, 4) != 0 || header.version != MotionGraphVersion || header.window == 0) {
+		std::cout << path << " isn't a motion graph this version can read\n";
+		return false;
+	}
+	size_t clipsSize = (size_t)header.numClips * sizeof(MotionGraphFileClip);
+	size_t transitionsSize = (size_t)header.numTransitions * sizeof(MotionGraphTransition);
+	const u8* clipsData = bytes.data() + sizeof(header);
+	const u8* transitionsData = clipsData + clipsSize;
+	const char* names = (const char*)(transitionsData + transitionsSize);
+	if (bytes.size() - sizeof(header) != clipsSize + transitionsSize + header.namesSize
+		|| MotionGraphChecksum(clipsData, clipsSize, transitionsData, transitionsSize, names, header.namesSize) != header.checksum) {
+		std::cout << path << " is corrupt\n";
+		return false;
+	}
+	u32 totalFrames = 0;
+	_clips.resize(header.numClips);
+	for (size_t i = 0; i < _clips.size(); i++) {
+		MotionGraphFileClip record;
+		memcpy(&record, clipsData + i * sizeof(record), sizeof(record));
+		if ((u64)record.nameOffset + record.nameLength > header.namesSize || record.firstFrame != totalFrames) {
+			std::cout << path << " is corrupt\n";
+			_clips.clear();
+			return false;
+		}
+		_clips[i].name.assign(names + record.nameOffset, record.nameLength);
+		_clips[i].firstFrame = record.firstFrame;
+		_clips[i].numFrames = record.numFrames;
+		totalFrames += record.numFrames;
+	}
+	_transitions.resize(header.numTransitions);
+	if (transitionsSize > 0) {
+		memcpy(_transitions.data(), transitionsData, transitionsSize);
+	}
+	for (size_t i = 0; i < _transitions.size(); i++) {
+		if (_transitions[i].from >= totalFrames || _transitions[i].to >= totalFrames
+			|| (i > 0 && TransitionBefore(_transitions[i], _transitions[i - 1]))) {
+			std::cout << path << " is corrupt\n";
+			_clips.clear();
+			_transitions.clear();
+			return false;
+		}
+	}
+	_window = header.window;
+	RebuildLookup();
+	return true;
+}
+
+bool MocapMotionGraph::Save(const std::string& path, IFilesystem* fileSystem) const
+{
+	std::vector<MotionGraphFileClip> records(_clips.size());
+	std::string names;
+	for (size_t i = 0; i < _clips.size(); i++) {
+		records[i].nameOffset = (u32)names.size();
+		records[i].nameLength = (u32)_clips[i].name.size();
+		records[i].firstFrame = _clips[i].firstFrame;
+		records[i].numFrames = _clips[i].numFrames;
+		names += _clips[i].name;
+	}
+	MotionGraphFileHeader header = {};
+	memcpy(header.magic, MotionGraphMagic, 4);
+	header.version = MotionGraphVersion;
+	header.numClips = (u32)records.size();
+	header.numTransitions = (u32)_transitions.size();
+	header.window = _window;
+	header.namesSize = names.size();
+	header.checksum = MotionGraphChecksum(records.data(), records.size() * sizeof(MotionGraphFileClip),
+		_transitions.data(), _transitions.size() * sizeof(MotionGraphTransition), names.data(), names.size());
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ofstream::binary | std::ofstream::trunc);
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)records.data(), records.size() * sizeof(MotionGraphFileClip));
+		out.write((const char*)_transitions.data(), _transitions.size() * sizeof(MotionGraphTransition));
+		out.write(names.data(), names.size());
+		if (!out) {
+			std::cout << "couldn't write " << tempPath << "\n";
+			return false;
+		}
+	}
+	if (!fileSystem->MoveFileReplacing(tempPath, path)) {
+		std::cout << "couldn't replace " << path << "\n";
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
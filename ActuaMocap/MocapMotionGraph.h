@@ -0,0 +1,101 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "BasicTypedefs.h"
+
+class IFilesystem;
+class MocapLibrary;
+
+#define MotionGraphMagic "CMPG"
+#define MotionGraphVersion 1
+#define MotionGraphFileName "library.cmg"
+
+struct MotionGraphClip {
+	std::string name;
+	u32 firstFrame; // frames of every clip are numbered one after another, in library order
+	u32 numFrames;
+};
+
+/// <summary>
+/// play the from clip up to frame from, then fade over the graph's window into the to clip
+/// starting at frame to. both are numbered across the whole library
+/// </summary>
+struct MotionGraphTransition {
+	u32 from;
+	u32 to;
+	float cost; // root mean square distance per point over the window
+};
+
+struct MotionGraphOptions {
+	u32 window = 4;           // frames compared, and faded across when the transition is taken
+	float threshold = 3.0f;   // largest cost kept as a transition, in the same units as the points
+	u32 minGap = 8;           // frames of the same clip closer than this aren't joined
+	u32 maxPerFrame = 8;      // cheapest transitions kept leaving each frame
+	u32 tileSize = 64;        // frames along each side of the blocks the distance matrix is computed in
+};
+
+struct MotionGraphBuildStats {
+	u64 pairs = 0;       // frame pairs compared
+	u64 minima = 0;      // local minima under the threshold, before pruning
+	u64 pruned = 0;      // transitions dropped for not being part of the largest connected graph
+	double seconds = 0.0;
+};
+
+/// <summary>
+/// transitions between similar poses anywhere in the library, so clips can be strung together
+/// into one continuous motion. built offline from the distance between every pair of frames and
+/// kept in one binary file beside the clips, in the same header, records, names layout as the index.
+/// only the largest strongly connected set of transitions is kept, so a walk can always carry on
+/// and can always get back to any part of the graph
+/// </summary>
+class MocapMotionGraph
+{
+public:
+	/// <summary>
+	/// compare every pair of frames in the library, in tiles spread over the thread pool.
+	/// progress is called now and then with how many tiles are done out of how many
+	/// </summary>
+	bool Build(const MocapLibrary& library, const MotionGraphOptions& options, MotionGraphBuildStats& stats,
+		const std::function<void(size_t, size_t)>& progress = nullptr);
+	bool Load(const std::string& path);
+	/// <summary>
+	/// written to a temporary file then moved over path
+	/// </summary>
+	bool Save(const std::string& path, IFilesystem* fileSystem) const;
+	inline const std::vector<MotionGraphClip>& GetClips() const {
+		return _clips;
+	}
+	inline const std::vector<MotionGraphTransition>& GetTransitions() const {
+		return _transitions;
+	}
+	inline u32 GetWindow() const {
+		return _window;
+	}
+	// index into GetClips, or -1
+	int FindClip(const std::string& name) const;
+	/// <summary>
+	/// transitions leaving frame of clip, cheapest first. count is 0 if there are none
+	/// </summary>
+	const MotionGraphTransition* GetTransitionsFrom(size_t clip, size_t frame, size_t& count) const;
+	/// <summary>
+	/// the clip and frame within it of a frame numbered across the library
+	/// </summary>
+	size_t GetClipOfFrame(u32 frame, u32& frameInClip) const;
+	/// <summary>
+	/// decide whether to leave clip at frame, picking uniformly between the frames from here to the
+	/// clip's end that have transitions, so the last one is always taken. rng is advanced.
+	/// nullptr to keep playing the clip
+	/// </summary>
+	const MotionGraphTransition* ChooseTransition(size_t clip, size_t frame, u32& rng) const;
+private:
+	void Prune(MotionGraphBuildStats& stats);
+	void RebuildLookup();
+private:
+	std::vector<MotionGraphClip> _clips;
+	std::vector<MotionGraphTransition> _transitions; // sorted by from, then cost
+	std::vector<u32> _firstTransition; // per frame into _transitions, plus one past the end
+	std::unordered_map<std::string, size_t> _lookup;
+	u32 _window = 0;
+};
@@ -0,0 +1,433 @@
+#include "MocapMotionMatching.h"
+#include <algorithm>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "MocapClipSoA.h"
+#include "MocapPoseIndex.h"
+#include "ByteSwap.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MOCAP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define MOCAP_TARGET_AVX
+#else
+#define MOCAP_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+#define MotionMatchVelocityStart MotionMatchPoseComponents
+#define MotionMatchTrajectoryStart (MotionMatchPoseComponents + MotionMatchVelocityComponents)
+#define MotionMatchSmallBlocks 2 // blocks per small bounding box
+#define MotionMatchLargeSmall 4  // small boxes per large one
+#define MotionMatchExcludeFrames 8
+#define MotionMatchPadding 1e15f // squares to far more than any real cost, but not to infinity
+
+static_assert(MotionMatchTrajectoryStart + MotionMatchTrajectoryPoints * 2 == MotionMatchFeatures, "features must fill MotionMatchFeatures exactly");
+static_assert(MotionMatchPoseComponents <= PoseIndexComponents, "the pose index has too few components");
+
+#define MotionMatchBlockFloats (MotionMatchFeatures * MotionMatchBlockFrames)
+
+static void BlockCostsScalar(const float* query, const float* block, float* out)
+{
+	for (int lane = 0; lane < MotionMatchBlockFrames; lane++) {
+		out[lane] = 0.0f;
+	}
+	for (int d = 0; d < MotionMatchFeatures; d++) {
+		for (int lane = 0; lane < MotionMatchBlockFrames; lane++) {
+			float diff = block[d * MotionMatchBlockFrames + lane] - query[d];
+			out[lane] += diff * diff;
+		}
+	}
+}
+
+// how far query is outside the box, squared. 0 inside it
+static float BoxCostScalar(const float* query, const float* boxMin, const float* boxMax)
+{
+	float sum = 0.0f;
+	for (int d = 0; d < MotionMatchFeatures; d++) {
+		float outside = std::max(boxMin[d] - query[d], 0.0f) + std::max(query[d] - boxMax[d], 0.0f);
+		sum += outside * outside;
+	}
+	return sum;
+}
+
+#ifdef MOCAP_X86
+
+static void BlockCostsSSE2(const float* query, const float* block, float* out)
+{
+	__m128 sumLo = _mm_setzero_ps();
+	__m128 sumHi = _mm_setzero_ps();
+	for (int d = 0; d < MotionMatchFeatures; d++) {
+		__m128 q = _mm_set1_ps(query[d]);
+		__m128 lo = _mm_sub_ps(_mm_loadu_ps(block + d * MotionMatchBlockFrames), q);
+		__m128 hi = _mm_sub_ps(_mm_loadu_ps(block + d * MotionMatchBlockFrames + 4), q);
+		sumLo = _mm_add_ps(sumLo, _mm_mul_ps(lo, lo));
+		sumHi = _mm_add_ps(sumHi, _mm_mul_ps(hi, hi));
+	}
+	_mm_storeu_ps(out, sumLo);
+	_mm_storeu_ps(out + 4, sumHi);
+}
+
+MOCAP_TARGET_AVX static void BlockCostsAVX(const float* query, const float* block, float* out)
+{
+	// two accumulators so the adds aren't one long dependency chain
+	__m256 sum0 = _mm256_setzero_ps();
+	__m256 sum1 = _mm256_setzero_ps();
+	for (int d = 0; d < MotionMatchFeatures; d += 2) {
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(block + d * MotionMatchBlockFrames), _mm256_set1_ps(query[d]));
+		__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(block + (d + 1) * MotionMatchBlockFrames), _mm256_set1_ps(query[d + 1]));
+		sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(d0, d0));
+		sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(d1, d1));
+	}
+	_mm256_storeu_ps(out, _mm256_add_ps(sum0, sum1));
+}
+
+static float BoxCostSSE2(const float* query, const float* boxMin, const float* boxMax)
+{
+	const __m128 zero = _mm_setzero_ps();
+	__m128 sum = _mm_setzero_ps();
+	for (int d = 0; d < MotionMatchFeatures; d += 4) {
+		__m128 q = _mm_loadu_ps(query + d);
+		__m128 outside = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(boxMin + d), q), zero),
+			_mm_max_ps(_mm_sub_ps(q, _mm_loadu_ps(boxMax + d)), zero));
+		sum = _mm_add_ps(sum, _mm_mul_ps(outside, outside));
+	}
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+MOCAP_TARGET_AVX static float BoxCostAVX(const float* query, const float* boxMin, const float* boxMax)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	__m256 q0 = _mm256_loadu_ps(query);
+	__m256 q1 = _mm256_loadu_ps(query + 8);
+	__m256 outside0 = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(boxMin), q0), zero),
+		_mm256_max_ps(_mm256_sub_ps(q0, _mm256_loadu_ps(boxMax)), zero));
+	__m256 outside1 = _mm256_add_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(boxMin + 8), q1), zero),
+		_mm256_max_ps(_mm256_sub_ps(q1, _mm256_loadu_ps(boxMax + 8)), zero));
+	__m256 v8 = _mm256_add_ps(_mm256_mul_ps(outside0, outside0), _mm256_mul_ps(outside1, outside1));
+	__m128 v = _mm_add_ps(_mm256_castps256_ps128(v8), _mm256_extractf128_ps(v8, 1));
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+	return _mm_cvtss_f32(v);
+}
+
+#else
+
+static void BlockCostsSSE2(const float* query, const float* block, float* out)
+{
+	BlockCostsScalar(query, block, out);
+}
+
+static void BlockCostsAVX(const float* query, const float* block, float* out)
+{
+	BlockCostsScalar(query, block, out);
+}
+
+static float BoxCostSSE2(const float* query, const float* boxMin, const float* boxMax)
+{
+	return BoxCostScalar(query, boxMin, boxMax);
+}
+
+static float BoxCostAVX(const float* query, const float* boxMin, const float* boxMax)
+{
+	return BoxCostScalar(query, boxMin, boxMax);
+}
+
+#endif
+
+static void BlockCosts(const float* query, const float* block, float* out)
+{
+	if (CpuSupportsAVX2()) {
+		BlockCostsAVX(query, block, out);
+	}
+	else {
+		BlockCostsSSE2(query, block, out);
+	}
+}
+
+static float BoxCost(const float* query, const float* boxMin, const float* boxMax)
+{
+	return CpuSupportsAVX2() ? BoxCostAVX(query, boxMin, boxMax) : BoxCostSSE2(query, boxMin, boxMax);
+}
+
+static glm::vec2 MedianOnGround(const MocapPoseSoA& pose, const glm::vec2& fallback)
+{
+	float xs[PlayerPoints];
+	float zs[PlayerPoints];
+	int count = 0;
+	for (int p = 0; p < PlayerPoints; p++) {
+		if (!IsMissingPoint(glm::vec3(pose.x[p], pose.y[p], pose.z[p]))) {
+			xs[count] = pose.x[p];
+			zs[count] = pose.z[p];
+			count++;
+		}
+	}
+	if (count == 0) {
+		return fallback;
+	}
+	std::nth_element(xs, xs + count / 2, xs + count);
+	std::nth_element(zs, zs + count / 2, zs + count);
+	return glm::vec2(xs[count / 2], zs[count / 2]);
+}
+
+void MocapMatchDatabase::Build(const MocapClipSoA* const* clips, size_t numClips, const MocapPoseIndex& poseIndex,
+	const MotionMatchWeights& weights)
+{
+	_clipFirstFrame.assign(1, 0);
+	for (size_t c = 0; c < numClips; c++) {
+		_clipFirstFrame.push_back(_clipFirstFrame.back() + (u32)clips[c]->GetNumFrames());
+	}
+	const size_t numFrames = _clipFirstFrame.back();
+	_features.assign(numFrames * MotionMatchFeatures, 0.0f);
+	_roots.resize(numFrames);
+
+	// unscaled features first
+	std::vector<float> components;
+	for (size_t c = 0; c < numClips; c++) {
+		const MocapClipSoA& clip = *clips[c];
+		const size_t n = clip.GetNumFrames();
+		const size_t first = _clipFirstFrame[c];
+		components.resize(n * PoseIndexComponents);
+		MocapFrame frame;
+		glm::vec2 root(0.0f);
+		for (size_t f = 0; f < n; f++) {
+			PoseToFrame(clip.GetPose(f), frame);
+			poseIndex.ProjectPose(frame, &components[f * PoseIndexComponents]);
+			root = MedianOnGround(clip.GetPose(f), root);
+			_roots[first + f] = root;
+		}
+		for (size_t f = 0; f < n; f++) {
+			float* out = &_features[(first + f) * MotionMatchFeatures];
+			const float* here = &components[f * PoseIndexComponents];
+			for (int i = 0; i < MotionMatchPoseComponents; i++) {
+				out[i] = here[i];
+			}
+			size_t before = f > 0 ? f - 1 : f;
+			size_t after = f + 1 < n ? f + 1 : f;
+			float frames = after > before ? (float)(after - before) : 1.0f;
+			for (int i = 0; i < MotionMatchVelocityComponents; i++) {
+				out[MotionMatchVelocityStart + i] = (components[after * PoseIndexComponents + i] - components[before * PoseIndexComponents + i]) / frames;
+			}
+			for (int k = 0; k < MotionMatchTrajectoryPoints; k++) {
+				size_t ahead = std::min(f + MotionMatchTrajectoryFrames[k], n - 1);
+				glm::vec2 step = _roots[first + ahead] - _roots[first + f];
+				out[MotionMatchTrajectoryStart + k * 2] = step.x;
+				out[MotionMatchTrajectoryStart + k * 2 + 1] = step.y;
+			}
+		}
+	}
+
+	// each group scaled to unit spread so none of them swamps the others just by its units
+	_maxSpeed = 0.0f;
+	const int groupStart[4] = { 0, MotionMatchVelocityStart, MotionMatchTrajectoryStart, MotionMatchFeatures };
+	const float groupWeight[3] = { weights.pose, weights.velocity, weights.trajectory };
+	float groupScale[3] = {};
+	for (int g = 0; g < 3; g++) {
+		double variance = 0.0;
+		for (int d = groupStart[g]; d < groupStart[g + 1]; d++) {
+			double sum = 0.0, sumSquares = 0.0;
+			for (size_t f = 0; f < numFrames; f++) {
+				double v = _features[f * MotionMatchFeatures + d];
+				sum += v;
+				sumSquares += v * v;
+			}
+			if (numFrames > 0) {
+				double mean = sum / numFrames;
+				variance += std::max(sumSquares / numFrames - mean * mean, 0.0);
+			}
+		}
+		double spread = sqrt(variance / (groupStart[g + 1] - groupStart[g]));
+		groupScale[g] = spread > 1e-6 ? (float)(sqrt(groupWeight[g]) / spread) : 0.0f;
+	}
+	const int last = MotionMatchTrajectoryStart + (MotionMatchTrajectoryPoints - 1) * 2;
+	for (size_t f = 0; f < numFrames; f++) {
+		float* out = &_features[f * MotionMatchFeatures];
+		_maxSpeed = std::max(_maxSpeed, glm::length(glm::vec2(out[last], out[last + 1])) / MotionMatchTrajectoryFrames[MotionMatchTrajectoryPoints - 1]);
+		for (int g = 0; g < 3; g++) {
+			for (int d = groupStart[g]; d < groupStart[g + 1]; d++) {
+				out[d] *= groupScale[g];
+			}
+		}
+	}
+	_trajectoryScale = groupScale[2];
+	BuildBlocks();
+}
+
+void MocapMatchDatabase::BuildBlocks()
+{
+	std::vector<u32> searchable;
+	for (size_t c = 0; c + 1 < _clipFirstFrame.size(); c++) {
+		// the last frame of a clip leaves nothing to play
+		for (u32 f = _clipFirstFrame[c]; f + 1 < _clipFirstFrame[c + 1]; f++) {
+			searchable.push_back(f);
+		}
+	}
+	_numSearchable = searchable.size();
+	const size_t numBlocks = (searchable.size() + MotionMatchBlockFrames - 1) / MotionMatchBlockFrames;
+	_blocks.assign(numBlocks * MotionMatchBlockFloats, MotionMatchPadding);
+	_blockFrames.assign(numBlocks * MotionMatchBlockFrames, UINT32_MAX);
+	for (size_t i = 0; i < searchable.size(); i++) {
+		size_t block = i / MotionMatchBlockFrames;
+		size_t lane = i % MotionMatchBlockFrames;
+		const float* features = &_features[(size_t)searchable[i] * MotionMatchFeatures];
+		for (int d = 0; d < MotionMatchFeatures; d++) {
+			_blocks[block * MotionMatchBlockFloats + d * MotionMatchBlockFrames + lane] = features[d];
+		}
+		_blockFrames[i] = searchable[i];
+	}
+
+	// bounds of the real frames only, padding is never going to win so boxes needn't cover it
+	auto bound = [&](size_t firstBlock, size_t lastBlock, float* boxMin, float* boxMax) {
+		for (int d = 0; d < MotionMatchFeatures; d++) {
+			boxMin[d] = FLT_MAX;
+			boxMax[d] = -FLT_MAX;
+		}
+		for (size_t i = firstBlock * MotionMatchBlockFrames; i < lastBlock * MotionMatchBlockFrames && i < searchable.size(); i++) {
+			const float* features = &_features[(size_t)searchable[i] * MotionMatchFeatures];
+			for (int d = 0; d < MotionMatchFeatures; d++) {
+				boxMin[d] = std::min(boxMin[d], features[d]);
+				boxMax[d] = std::max(boxMax[d], features[d]);
+			}
+		}
+	};
+	const size_t numSmall = (numBlocks + MotionMatchSmallBlocks - 1) / MotionMatchSmallBlocks;
+	const size_t numLarge = (numSmall + MotionMatchLargeSmall - 1) / MotionMatchLargeSmall;
+	_smallMin.resize(numSmall * MotionMatchFeatures);
+	_smallMax.resize(numSmall * MotionMatchFeatures);
+	for (size_t s = 0; s < numSmall; s++) {
+		bound(s * MotionMatchSmallBlocks, (s + 1) * MotionMatchSmallBlocks, &_smallMin[s * MotionMatchFeatures], &_smallMax[s * MotionMatchFeatures]);
+	}
+	_largeMin.resize(numLarge * MotionMatchFeatures);
+	_largeMax.resize(numLarge * MotionMatchFeatures);
+	const size_t largeBlocks = MotionMatchSmallBlocks * MotionMatchLargeSmall;
+	for (size_t l = 0; l < numLarge; l++) {
+		bound(l * largeBlocks, (l + 1) * largeBlocks, &_largeMin[l * MotionMatchFeatures], &_largeMax[l * MotionMatchFeatures]);
+	}
+}
+
+glm::vec2 MocapMatchDatabase::GetRoot(size_t clip, double frame) const
+{
+	u32 first = _clipFirstFrame[clip];
+	u32 numFrames = _clipFirstFrame[clip + 1] - first;
+	if (numFrames == 0) {
+		return glm::vec2(0.0f);
+	}
+	frame = std::min(std::max(frame, 0.0), (double)(numFrames - 1));
+	u32 a = (u32)frame;
+	u32 b = std::min(a + 1, numFrames - 1);
+	return glm::mix(_roots[first + a], _roots[first + b], (float)(frame - a));
+}
+
+void MocapMatchDatabase::GetFeatures(size_t clip, size_t frame, float* query) const
+{
+	memcpy(query, &_features[(_clipFirstFrame[clip] + frame) * MotionMatchFeatures], MotionMatchFeatures * sizeof(float));
+}
+
+void MocapMatchDatabase::SetTrajectory(const glm::vec2* positions, float* query) const
+{
+	for (int k = 0; k < MotionMatchTrajectoryPoints; k++) {
+		query[MotionMatchTrajectoryStart + k * 2] = positions[k].x * _trajectoryScale;
+		query[MotionMatchTrajectoryStart + k * 2 + 1] = positions[k].y * _trajectoryScale;
+	}
+}
+
+float MocapMatchDatabase::Cost(const float* a, const float* b)
+{
+	float sum = 0.0f;
+	for (int d = 0; d < MotionMatchFeatures; d++) {
+		float diff = a[d] - b[d];
+		sum += diff * diff;
+	}
+	return sum;
+}
+
+void MocapMatchDatabase::ExcludedRange(u32 excludeClip, u32 excludeFrame, u32& begin, u32& end) const
+{
+	begin = end = 0;
+	if (excludeClip >= GetNumClips()) {
+		return;
+	}
+	u32 first = _clipFirstFrame[excludeClip];
+	begin = first + (excludeFrame > MotionMatchExcludeFrames ? excludeFrame - MotionMatchExcludeFrames : 0);
+	end = std::min(first + excludeFrame + MotionMatchExcludeFrames + 1, _clipFirstFrame[excludeClip + 1]);
+}
+
+void MocapMatchDatabase::Consider(const float* costs, size_t block, u32 excludeBegin, u32 excludeEnd, u32& bestFrame, float& bestCost) const
+{
+	for (int lane = 0; lane < MotionMatchBlockFrames; lane++) {
+		if (costs[lane] >= bestCost) {
+			continue;
+		}
+		u32 frame = _blockFrames[block * MotionMatchBlockFrames + lane];
+		if (frame == UINT32_MAX || (frame >= excludeBegin && frame < excludeEnd)) {
+			continue;
+		}
+		bestFrame = frame;
+		bestCost = costs[lane];
+	}
+}
+
+bool MocapMatchDatabase::Search(const float* query, float costToBeat, u32 excludeClip, u32 excludeFrame, MotionMatchResult& out) const
+{
+	u32 excludeBegin, excludeEnd;
+	ExcludedRange(excludeClip, excludeFrame, excludeBegin, excludeEnd);
+	u32 bestFrame = UINT32_MAX;
+	float bestCost = costToBeat;
+	const size_t numBlocks = _blockFrames.size() / MotionMatchBlockFrames;
+	const size_t numSmall = _smallMin.size() / MotionMatchFeatures;
+	const size_t numLarge = _largeMin.size() / MotionMatchFeatures;
+	float costs[MotionMatchBlockFrames];
+	for (size_t l = 0; l < numLarge; l++) {
+		if (BoxCost(query, &_largeMin[l * MotionMatchFeatures], &_largeMax[l * MotionMatchFeatures]) >= bestCost) {
+			continue;
+		}
+		size_t lastSmall = std::min((l + 1) * MotionMatchLargeSmall, numSmall);
+		for (size_t s = l * MotionMatchLargeSmall; s < lastSmall; s++) {
+			if (BoxCost(query, &_smallMin[s * MotionMatchFeatures], &_smallMax[s * MotionMatchFeatures]) >= bestCost) {
+				continue;
+			}
+			size_t lastBlock = std::min((s + 1) * MotionMatchSmallBlocks, numBlocks);
+			for (size_t b = s * MotionMatchSmallBlocks; b < lastBlock; b++) {
+				BlockCosts(query, &_blocks[b * MotionMatchBlockFloats], costs);
+				Consider(costs, b, excludeBegin, excludeEnd, bestFrame, bestCost);
+			}
+		}
+	}
+	if (bestFrame == UINT32_MAX) {
+		return false;
+	}
+	ResultFromFrame(bestFrame, bestCost, out);
+	return true;
+}
+
+bool MocapMatchDatabase::SearchBruteForce(const float* query, float costToBeat, u32 excludeClip, u32 excludeFrame, MotionMatchResult& out) const
+{
+	u32 excludeBegin, excludeEnd;
+	ExcludedRange(excludeClip, excludeFrame, excludeBegin, excludeEnd);
+	u32 bestFrame = UINT32_MAX;
+	float bestCost = costToBeat;
+	const size_t numBlocks = _blockFrames.size() / MotionMatchBlockFrames;
+	float costs[MotionMatchBlockFrames];
+	for (size_t b = 0; b < numBlocks; b++) {
+		BlockCosts(query, &_blocks[b * MotionMatchBlockFloats], costs);
+		Consider(costs, b, excludeBegin, excludeEnd, bestFrame, bestCost);
+	}
+	if (bestFrame == UINT32_MAX) {
+		return false;
+	}
+	ResultFromFrame(bestFrame, bestCost, out);
+	return true;
+}
+
+void MocapMatchDatabase::ResultFromFrame(u32 frame, float cost, MotionMatchResult& out) const
+{
+	auto it = std::upper_bound(_clipFirstFrame.begin(), _clipFirstFrame.end(), frame);
+	size_t clip = (it - _clipFirstFrame.begin()) - 1;
+	out.clip = (u32)clip;
+	out.frame = frame - _clipFirstFrame[clip];
+	out.cost = cost;
+}
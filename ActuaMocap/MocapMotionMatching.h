@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "BasicTypedefs.h"
+
+class MocapClipSoA;
+class MocapPoseIndex;
+
+#define MotionMatchPoseComponents 6     // of the pose index's principal components
+#define MotionMatchVelocityComponents 4 // how the first of them are changing
+#define MotionMatchTrajectoryPoints 3   // future root positions, see MotionMatchTrajectoryFrames
+#define MotionMatchFeatures 16          // all of the above, 2 AVX registers
+#define MotionMatchBlockFrames 8        // frames searched together, one per AVX lane
+
+// how far ahead each trajectory point is
+static const int MotionMatchTrajectoryFrames[MotionMatchTrajectoryPoints] = { 4, 8, 12 };
+
+/// <summary>
+/// how much each group of features counts towards a match, after each group is scaled to unit spread
+/// </summary>
+struct MotionMatchWeights {
+	float pose = 1.0f;
+	float velocity = 1.0f;
+	float trajectory = 2.0f;
+};
+
+struct MotionMatchResult {
+	u32 clip;  // as passed to Build
+	u32 frame; // within the clip
+	float cost;
+};
+
+/// <summary>
+/// every frame of a set of clips as a short feature vector for motion matching: the pose and how it's
+/// moving, from the principal components of a MocapPoseIndex, and where the root will be over the next
+/// few frames, all relative to the frame's root in the clip's own axes.
+/// features are scaled and weighted when built, so a match's cost is just the squared distance to the query.
+/// frames are searched MotionMatchBlockFrames at a time with the widest kernel the cpu has, skipping whole
+/// runs of frames whose bounding boxes in feature space are already further away than the best so far
+/// </summary>
+class MocapMatchDatabase
+{
+public:
+	/// <summary>
+	/// clips are referred to by their index in clips from then on and must outlive the database.
+	/// with an index that hasn't been fitted yet only the trajectory is matched
+	/// </summary>
+	void Build(const MocapClipSoA* const* clips, size_t numClips, const MocapPoseIndex& poseIndex,
+		const MotionMatchWeights& weights = MotionMatchWeights());
+	inline size_t GetNumClips() const {
+		return _clipFirstFrame.empty() ? 0 : _clipFirstFrame.size() - 1;
+	}
+	inline size_t GetNumFrames(size_t clip) const {
+		return _clipFirstFrame[clip + 1] - _clipFirstFrame[clip];
+	}
+	// frames a search can land on, every frame but the last of each clip
+	inline size_t GetNumSearchable() const {
+		return _numSearchable;
+	}
+	/// <summary>
+	/// the point on the ground under the frame, the median of its points across the ground so a kicked ball doesn't drag it.
+	/// frame can be fractional, and is clamped to the clip
+	/// </summary>
+	glm::vec2 GetRoot(size_t clip, double frame) const;
+	// fastest the root moves over the trajectory, in units per frame
+	inline float GetMaxSpeed() const {
+		return _maxSpeed;
+	}
+	/// <summary>
+	/// the scaled features of frame, to start a query from
+	/// </summary>
+	void GetFeatures(size_t clip, size_t frame, float* query) const;
+	/// <summary>
+	/// replace query's trajectory with where the root should be at each of MotionMatchTrajectoryFrames,
+	/// relative to where it is now and in the clip's axes
+	/// </summary>
+	void SetTrajectory(const glm::vec2* positions, float* query) const;
+	/// <summary>
+	/// the cheapest frame for query costing less than costToBeat. frames of excludeClip near excludeFrame
+	/// are skipped so a player doesn't keep jumping a frame or two along the clip it's already playing,
+	/// pass UINT32_MAX for excludeClip to consider everything. returns false if nothing beat costToBeat
+	/// </summary>
+	bool Search(const float* query, float costToBeat, u32 excludeClip, u32 excludeFrame, MotionMatchResult& out) const;
+	// the same without skipping anything, for checking and timing Search
+	bool SearchBruteForce(const float* query, float costToBeat, u32 excludeClip, u32 excludeFrame, MotionMatchResult& out) const;
+	// squared distance between two scaled feature vectors
+	static float Cost(const float* a, const float* b);
+private:
+	void BuildBlocks();
+	void Consider(const float* costs, size_t block, u32 excludeBegin, u32 excludeEnd, u32& bestFrame, float& bestCost) const;
+	void ExcludedRange(u32 excludeClip, u32 excludeFrame, u32& begin, u32& end) const;
+	void ResultFromFrame(u32 frame, float cost, MotionMatchResult& out) const;
+private:
+	std::vector<u32> _clipFirstFrame;  // per clip into the frames, plus one past the end
+	std::vector<float> _features;      // MotionMatchFeatures per frame, scaled
+	std::vector<glm::vec2> _roots;     // per frame
+	float _trajectoryScale = 0.0f;     // applied to positions by SetTrajectory
+	float _maxSpeed = 0.0f;
+	size_t _numSearchable = 0;
+	// searchable frames transposed into blocks, MotionMatchFeatures rows of MotionMatchBlockFrames lanes,
+	// the last block padded with frames that can never win
+	std::vector<float> _blocks;
+	std::vector<u32> _blockFrames;     // the frame in each lane, UINT32_MAX for padding
+	// feature space bounds per run of blocks, small runs inside large ones
+	std::vector<float> _smallMin, _smallMax;
+	std::vector<float> _largeMin, _largeMax;
+};
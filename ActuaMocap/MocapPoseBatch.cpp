@@ -0,0 +1,63 @@
+#include "MocapPoseBatch.h"
+#include "MocapClipSoA.h"
+#include "MocapKeyClip.h"
+#include "ThreadPool.h"
+#include "ByteSwap.h"
+#include <string.h>
+
+#define PoseBatchBlockSize 256 // requests per ParallelFor index, so the pool's per index cost stays small
+
+typedef void(*LerpPosesKernel)(const MocapPoseSoA&, const MocapPoseSoA&, float, MocapPoseSoA&);
+typedef void(*CubicPoseKernel)(const MocapPoseSoA*, float, MocapPoseSoA&);
+
+struct PoseKernels {
+	LerpPosesKernel lerp;
+	CubicPoseKernel cubic; // nullptr for linear batches
+};
+
+static inline void EvaluatePose(const MocapPoseRequest& request, double fps, const PoseKernels& kernels, MocapPoseSoA& out) {
+	size_t numFrames = request.keys ? request.keys->GetNumFrames() : request.clip ? request.clip->GetNumFrames() : 0;
+	if (numFrames == 0) {
+		memset(&out, 0, sizeof(MocapPoseSoA));
+		return;
+	}
+	MocapFramePair pair = MapTimeToFrames(request.seconds, fps, numFrames, request.wrap);
+	if (request.keys) {
+		request.keys->Sample(pair.frame, pair.next, pair.t, out, request.keyCursor);
+		return;
+	}
+	if (kernels.cubic && request.clip->HasCubic()) {
+		kernels.cubic(request.clip->GetCubicSegment(pair.frame), pair.t, out);
+		return;
+	}
+	kernels.lerp(request.clip->GetPose(pair.frame), request.clip->GetPose(pair.next), pair.t, out);
+}
+
+void EvaluatePosesSerial(const MocapPoseRequest* requests, size_t count, double fps, MocapPoseSoA* out, MocapInterpolation interpolation)
+{
+	// pick the kernels once per batch rather than once per pose
+	bool avx = CpuSupportsAVX2();
+	PoseKernels kernels;
+	kernels.lerp = avx ? LerpPosesAVX : LerpPosesSSE2;
+	kernels.cubic = nullptr;
+	if (interpolation == MocapInterpolation::CatmullRom) {
+		kernels.cubic = avx ? EvaluateCubicPoseAVX : EvaluateCubicPoseSSE2;
+	}
+	for (size_t i = 0; i < count; i++) {
+		EvaluatePose(requests[i], fps, kernels, out[i]);
+	}
+}
+
+void EvaluatePoses(const MocapPoseRequest* requests, size_t count, double fps, MocapPoseSoA* out, MocapInterpolation interpolation)
+{
+	size_t numBlocks = (count + PoseBatchBlockSize - 1) / PoseBatchBlockSize;
+	if (numBlocks <= 1) {
+		EvaluatePosesSerial(requests, count, fps, out, interpolation);
+		return;
+	}
+	GetThreadPool().ParallelFor(numBlocks, [&](size_t block) {
+		size_t first = block * PoseBatchBlockSize;
+		size_t n = first + PoseBatchBlockSize < count ? PoseBatchBlockSize : count - first;
+		EvaluatePosesSerial(requests + first, n, fps, out + first, interpolation);
+	});
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+#include "MocapPoseSoA.h"
+#include "MocapSampler.h"
+
+class MocapClipSoA;
+class MocapKeyClip;
+struct MocapKeyCursor;
+
+struct MocapPoseRequest {
+	const MocapClipSoA* clip;
+	double seconds;
+	MocapWrapMode wrap = MocapWrapMode::Loop;
+	const MocapKeyClip* keys = nullptr; // sampled instead of clip when set, always linearly
+	MocapKeyCursor* keyCursor = nullptr; // this request's place in keys from the last time, for playing on through it
+};
+
+/// <summary>
+/// write the pose of every request into out[i], count of them, with clips playing at fps.
+/// each pose is one LerpPoses call, blocks of requests are spread across the thread pool.
+/// requests for empty clips get a zero pose. CatmullRom falls back to linear for clips without BuildCubic.
+/// uses GetThreadPool, so don't call it from inside a ParallelFor
+/// </summary>
+void EvaluatePoses(const MocapPoseRequest* requests, size_t count, double fps, MocapPoseSoA* out,
+	MocapInterpolation interpolation = MocapInterpolation::Linear);
+
+/// <summary>
+/// the same on the calling thread only
+/// </summary>
+void EvaluatePosesSerial(const MocapPoseRequest* requests, size_t count, double fps, MocapPoseSoA* out,
+	MocapInterpolation interpolation = MocapInterpolation::Linear);
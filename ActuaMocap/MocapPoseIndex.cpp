@@ -0,0 +1,760 @@
+#include "MocapPoseIndex.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <string.h>
+#include <stdio.h>
+#include <float.h>
+#include <math.h>
+#include "IFilesystem.h"
+#include "MocapFile.h"
+#include "FileReads.h"
+#include "ThreadPool.h"
+#include "Hash.h"
+
+#define PoseFeatureFloats (PosePaddedPoints * 3)
+#define PoseTreeLeafSize 8 // frames below this aren't split any further
+#define PoseBoundSlack 0.999f // so rounding in the projections can never prune a true neighbour
+
+struct PoseIndexFileHeader {
+	char magic[4];
+	u32 version;
+	u32 numClips;
+	u32 numFrames;
+	u32 components;
+	u32 fitted;
+	u64 namesSize;
+	u64 checksum;       // Fnv1a64Words of the clips, mean, basis, features then names
+};
+
+struct PoseIndexFileClip {
+	u32 nameOffset;
+	u32 nameLength;
+	u64 sourceSize;
+	i64 modifiedTime;
+	u32 firstFrame;
+	u32 numFrames;
+};
+
+static_assert(sizeof(PoseIndexFileHeader) == 40, "PoseIndexFileHeader is written to disk as is");
+static_assert(sizeof(PoseIndexFileClip) == 32, "PoseIndexFileClip is written to disk as is");
+
+static inline const float* Floats(const MocapPoseSoA& pose) {
+	return pose.x;
+}
+
+static inline float* Floats(MocapPoseSoA& pose) {
+	return pose.x;
+}
+
+static inline float ProjectedDistance(const float* a, const float* b) {
+	float sum = 0.0f;
+	for (int c = 0; c < PoseIndexComponents; c++) {
+		float d = a[c] - b[c];
+		sum += d * d;
+	}
+	return sqrtf(sum);
+}
+
+/// <summary>
+/// eigenvalues and unit eigenvectors of the symmetric n x n matrix a by cyclic Jacobi rotations.
+/// a is destroyed, vectors gets the eigenvectors as its columns
+/// </summary>
+static void SymmetricEigen(std::vector<double>& a, int n, std::vector<double>& vectors, std::vector<double>& values)
+{
+	vectors.assign((size_t)n * n, 0.0);
+	for (int i = 0; i < n; i++) {
+		vectors[(size_t)i * n + i] = 1.0;
+	}
+	double scale = 0.0;
+	for (size_t i = 0; i < a.size(); i++) {
+		scale += a[i] * a[i];
+	}
+	for (int sweep = 0; sweep < 64; sweep++) {
+		double off = 0.0;
+		for (int p = 0; p < n; p++) {
+			for (int q = p + 1; q < n; q++) {
+				off += a[(size_t)p * n + q] * a[(size_t)p * n + q];
+			}
+		}
+		if (off <= scale * 1e-24) {
+			break;
+		}
+		for (int p = 0; p < n - 1; p++) {
+			for (int q = p + 1; q < n; q++) {
+				double apq = a[(size_t)p * n + q];
+				if (fabs(apq) < 1e-300) {
+					continue;
+				}
+				double theta = (a[(size_t)q * n + q] - a[(size_t)p * n + p]) / (2.0 * apq);
+				double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+				double c = 1.0 / sqrt(t * t + 1.0);
+				double s = t * c;
+				for (int k = 0; k < n; k++) {
+					double akp = a[(size_t)k * n + p];
+					double akq = a[(size_t)k * n + q];
+					a[(size_t)k * n + p] = c * akp - s * akq;
+					a[(size_t)k * n + q] = s * akp + c * akq;
+				}
+				for (int k = 0; k < n; k++) {
+					double apk = a[(size_t)p * n + k];
+					double aqk = a[(size_t)q * n + k];
+					a[(size_t)p * n + k] = c * apk - s * aqk;
+					a[(size_t)q * n + k] = s * apk + c * aqk;
+				}
+				for (int k = 0; k < n; k++) {
+					double vkp = vectors[(size_t)k * n + p];
+					double vkq = vectors[(size_t)k * n + q];
+					vectors[(size_t)k * n + p] = c * vkp - s * vkq;
+					vectors[(size_t)k * n + q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+	values.resize(n);
+	for (int i = 0; i < n; i++) {
+		values[i] = a[(size_t)i * n + i];
+	}
+}
+
+MocapPoseIndex::MocapPoseIndex(bool reverseEndianness)
+	:_reverseEndianness(reverseEndianness)
+{
+}
+
+bool MocapPoseIndex::Load(const std::string& indexPath)
+{
+	_clips.clear();
+	_features.clear();
+	_fitted = false;
+	std::vector<u8> bytes;
+	if (!MocapFile::ReadWholeFile(indexPath, bytes) || bytes.size() < sizeof(PoseIndexFileHeader)) {
+		RebuildLookup();
+		BuildTree();
+		return false;
+	}
+	PoseIndexFileHeader header;
+	memcpy(&header, bytes.data(), sizeof(header));
+	if (memcmp(header.magic, PoseIndexMagic, 4) != 0 || header.version != PoseIndexVersion
+		|| header.components != PoseIndexComponents) {
+		std::cout << indexPath << " isn't a pose index this version can read\n";
+		RebuildLookup();
+		BuildTree();
+		return false;
+	}
+	size_t clipsSize = (size_t)header.numClips * sizeof(PoseIndexFileClip);
+	size_t fitSize = sizeof(MocapPoseSoA) * (1 + PoseIndexComponents);
+	size_t featuresSize = (size_t)header.numFrames * sizeof(MocapPoseSoA);
+	if (bytes.size() - sizeof(header) != clipsSize + fitSize + featuresSize + header.namesSize
+		|| Fnv1a64Words(bytes.data() + sizeof(header), bytes.size() - sizeof(header)) != header.checksum) {
+		std::cout << indexPath << " is corrupt\n";
+		RebuildLookup();
+		BuildTree();
+		return false;
+	}
+	const u8* clipsData = bytes.data() + sizeof(header);
+	const u8* fitData = clipsData + clipsSize;
+	const u8* featuresData = fitData + fitSize;
+	const char* names = (const char*)(featuresData + featuresSize);
+	u32 totalFrames = 0;
+	_clips.resize(header.numClips);
+	for (size_t i = 0; i < _clips.size(); i++) {
+		PoseIndexFileClip record;
+		memcpy(&record, clipsData + i * sizeof(record), sizeof(record));
+		if ((u64)record.nameOffset + record.nameLength > header.namesSize || record.firstFrame != totalFrames) {
+			std::cout << indexPath << " is corrupt\n";
+			_clips.clear();
+			RebuildLookup();
+			BuildTree();
+			return false;
+		}
+		PoseIndexClip& clip = _clips[i];
+		clip.name.assign(names + record.nameOffset, record.nameLength);
+		clip.sourceSize = record.sourceSize;
+		clip.modifiedTime = record.modifiedTime;
+		clip.firstFrame = record.firstFrame;
+		clip.numFrames = record.numFrames;
+		totalFrames += record.numFrames;
+	}
+	if (totalFrames != header.numFrames) {
+		std::cout << indexPath << " is corrupt\n";
+		_clips.clear();
+		RebuildLookup();
+		BuildTree();
+		return false;
+	}
+	memcpy(&_mean, fitData, sizeof(MocapPoseSoA));
+	memcpy(_basis, fitData + sizeof(MocapPoseSoA), sizeof(MocapPoseSoA) * PoseIndexComponents);
+	_fitted = header.fitted != 0;
+	_features.resize(header.numFrames);
+	if (featuresSize > 0) {
+		memcpy(_features.data(), featuresData, featuresSize);
+	}
+	// the tree is cheap next to reading the clips, so it isn't stored
+	RebuildLookup();
+	BuildTree();
+	return true;
+}
+
+bool MocapPoseIndex::Save(const std::string& indexPath, IFilesystem* fileSystem) const
+{
+	std::vector<PoseIndexFileClip> records(_clips.size());
+	std::string names;
+	for (size_t i = 0; i < _clips.size(); i++) {
+		PoseIndexFileClip& record = records[i];
+		record.nameOffset = (u32)names.size();
+		record.nameLength = (u32)_clips[i].name.size();
+		record.sourceSize = _clips[i].sourceSize;
+		record.modifiedTime = _clips[i].modifiedTime;
+		record.firstFrame = _clips[i].firstFrame;
+		record.numFrames = _clips[i].numFrames;
+		names += _clips[i].name;
+	}
+	PoseIndexFileHeader header = {};
+	memcpy(header.magic, PoseIndexMagic, 4);
+	header.version = PoseIndexVersion;
+	header.numClips = (u32)records.size();
+	header.numFrames = (u32)_features.size();
+	header.components = PoseIndexComponents;
+	header.fitted = _fitted ? 1 : 0;
+	header.namesSize = names.size();
+	// everything before the names is a multiple of 8 bytes, so hashing the parts in turn matches hashing the file's tail
+	u64 checksum = Fnv1a64Words(records.data(), records.size() * sizeof(PoseIndexFileClip));
+	checksum = Fnv1a64Words(&_mean, sizeof(MocapPoseSoA), checksum);
+	checksum = Fnv1a64Words(_basis, sizeof(MocapPoseSoA) * PoseIndexComponents, checksum);
+	checksum = Fnv1a64Words(_features.data(), _features.size() * sizeof(MocapPoseSoA), checksum);
+	header.checksum = Fnv1a64Words(names.data(), names.size(), checksum);
+
+	std::string tempPath = indexPath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ofstream::binary | std::ofstream::trunc);
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)records.data(), records.size() * sizeof(PoseIndexFileClip));
+		out.write((const char*)&_mean, sizeof(MocapPoseSoA));
+		out.write((const char*)_basis, sizeof(MocapPoseSoA) * PoseIndexComponents);
+		out.write((const char*)_features.data(), _features.size() * sizeof(MocapPoseSoA));
+		out.write(names.data(), names.size());
+		if (!out) {
+			std::cout << "couldn't write " << tempPath << "\n";
+			return false;
+		}
+	}
+	if (!fileSystem->MoveFileReplacing(tempPath, indexPath)) {
+		std::cout << "couldn't replace " << indexPath << "\n";
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+size_t MocapPoseIndex::Update(const std::string& folder, IFilesystem* fileSystem)
+{
+	std::vector<PendingClip> clips;
+	size_t kept = 0;
+	size_t changed = 0;
+	for (const auto& entry : fileSystem->ListDirectoryEntries(folder)) {
+		if (entry.isDirectory || (!FileHasExtension(entry.name, ".comap") && !FileHasExtension(entry.name, ".comapz") && !FileHasExtension(entry.name, ".comapk"))) {
+			continue;
+		}
+		PendingClip pending;
+		const PoseIndexClip* existing = Find(entry.name);
+		if (existing && existing->sourceSize == entry.stat.size && existing->modifiedTime == entry.stat.modifiedTime) {
+			pending.clip = *existing;
+			pending.read = false;
+			kept++;
+		}
+		else {
+			pending.clip.name = entry.name;
+			pending.clip.sourceSize = entry.stat.size;
+			pending.clip.modifiedTime = entry.stat.modifiedTime;
+			pending.read = true;
+			changed++;
+		}
+		clips.push_back(std::move(pending));
+	}
+	size_t removed = _clips.size() - kept;
+	if (changed + removed == 0) {
+		return 0;
+	}
+	Rebuild(folder, clips, fileSystem);
+	return changed + removed;
+}
+
+size_t MocapPoseIndex::UpdateClips(const std::string& folder, const std::vector<std::string>& names, IFilesystem* fileSystem)
+{
+	std::vector<PendingClip> clips(_clips.size());
+	for (size_t i = 0; i < _clips.size(); i++) {
+		clips[i].clip = _clips[i];
+		clips[i].read = false;
+	}
+	std::vector<u8> removed(_clips.size(), 0);
+	std::unordered_map<std::string, size_t> added;
+	size_t changes = 0;
+	for (const auto& name : names) {
+		if (!FileHasExtension(name, ".comap") && !FileHasExtension(name, ".comapz") && !FileHasExtension(name, ".comapk")) {
+			continue;
+		}
+		FileStat stat;
+		bool exists = fileSystem->GetFileStat(JoinPath(folder, name), stat);
+		auto found = _lookup.find(name);
+		size_t i;
+		if (found != _lookup.end()) {
+			i = found->second;
+		}
+		else if (added.count(name)) {
+			i = added[name];
+		}
+		else if (exists) {
+			i = clips.size();
+			added[name] = i;
+			clips.push_back(PendingClip());
+			clips[i].clip.name = name;
+			removed.push_back(0);
+		}
+		else {
+			continue;
+		}
+		if (!exists) {
+			changes += removed[i] == 0;
+			removed[i] = 1;
+			continue;
+		}
+		PoseIndexClip& clip = clips[i].clip;
+		if (i < _clips.size() && removed[i] == 0 && clip.sourceSize == stat.size && clip.modifiedTime == stat.modifiedTime) {
+			continue;
+		}
+		changes += !clips[i].read || removed[i] != 0;
+		clip.sourceSize = stat.size;
+		clip.modifiedTime = stat.modifiedTime;
+		clips[i].read = true;
+		removed[i] = 0;
+	}
+	if (changes == 0) {
+		return 0;
+	}
+	size_t kept = 0;
+	for (size_t i = 0; i < clips.size(); i++) {
+		if (removed[i] == 0) {
+			if (kept != i) {
+				clips[kept] = std::move(clips[i]);
+			}
+			kept++;
+		}
+	}
+	clips.resize(kept);
+	Rebuild(folder, clips, fileSystem);
+	return changes;
+}
+
+void MocapPoseIndex::Rebuild(const std::string& folder, std::vector<PendingClip>& clips, IFilesystem* fileSystem)
+{
+	std::sort(clips.begin(), clips.end(), [](const PendingClip& a, const PendingClip& b) {
+		return a.clip.name < b.clip.name;
+	});
+	// the components only speed the search up, they never change its results, so a stale fit is kept
+	// until a good part of the library is new rather than re-reading everything for every clip
+	u64 changedBytes = 0;
+	u64 totalBytes = 0;
+	for (const auto& pending : clips) {
+		totalBytes += pending.clip.sourceSize;
+		changedBytes += pending.read ? pending.clip.sourceSize : 0;
+	}
+	bool refit = !_fitted || changedBytes * 4 > totalBytes;
+	std::vector<size_t> toRead;
+	std::vector<std::string> paths;
+	std::vector<u64> sizes;
+	for (size_t i = 0; i < clips.size(); i++) {
+		clips[i].read = clips[i].read || refit;
+		if (clips[i].read) {
+			toRead.push_back(i);
+			paths.push_back(JoinPath(folder, clips[i].clip.name));
+			sizes.push_back(clips[i].clip.sourceSize);
+		}
+	}
+	std::vector<u8> failed(clips.size(), 0);
+	std::atomic<size_t> failures(0);
+	ReadAndProcessFiles(fileSystem, paths, sizes, DefaultReadBatchBytes, [&](size_t i, const FileRead& read) {
+		PendingClip& pending = clips[toRead[i]];
+		if (!read.ok || !MocapFile::DecodeBuffer(read.data.data(), read.data.size(), _reverseEndianness, pending.frames)) {
+			failed[toRead[i]] = 1;
+			failures++;
+		}
+	});
+	if (failures > 0) {
+		std::cout << failures << " clips couldn't be read for the pose index\n";
+	}
+
+	if (refit) {
+		// per lane mean of the present points, moved to the origin the same way features are
+		std::vector<double> sums(PoseFeatureFloats, 0.0);
+		std::vector<double> counts(PoseFeatureFloats, 0.0);
+		for (size_t i = 0; i < clips.size(); i++) {
+			for (const auto& frame : clips[i].frames) {
+				float cx = 0.0f, cz = 0.0f;
+				int present = 0;
+				for (int p = 0; p < PlayerPoints; p++) {
+					if (!IsMissingPoint(frame.points[p])) {
+						cx += frame.points[p].x;
+						cz += frame.points[p].z;
+						present++;
+					}
+				}
+				if (present == 0) {
+					continue;
+				}
+				cx /= present;
+				cz /= present;
+				for (int p = 0; p < PlayerPoints; p++) {
+					if (IsMissingPoint(frame.points[p])) {
+						continue;
+					}
+					sums[p] += frame.points[p].x - cx;
+					sums[PosePaddedPoints + p] += frame.points[p].y;
+					sums[PosePaddedPoints * 2 + p] += frame.points[p].z - cz;
+					counts[p]++;
+					counts[PosePaddedPoints + p]++;
+					counts[PosePaddedPoints * 2 + p]++;
+				}
+			}
+		}
+		float* mean = Floats(_mean);
+		for (int i = 0; i < PoseFeatureFloats; i++) {
+			mean[i] = counts[i] > 0.0 ? (float)(sums[i] / counts[i]) : 0.0f;
+		}
+	}
+
+	std::vector<PoseIndexClip> newClips;
+	std::vector<size_t> sources;
+	u32 totalFrames = 0;
+	for (size_t i = 0; i < clips.size(); i++) {
+		if (failed[i]) {
+			continue;
+		}
+		PoseIndexClip clip = clips[i].clip;
+		if (clips[i].read) {
+			clip.numFrames = (u32)clips[i].frames.size();
+		}
+		newClips.push_back(clip);
+		newClips.back().firstFrame = totalFrames;
+		totalFrames += clip.numFrames;
+		sources.push_back(i);
+	}
+	std::vector<MocapPoseSoA> features(totalFrames);
+	GetThreadPool().ParallelFor(newClips.size(), [&](size_t c) {
+		const PendingClip& pending = clips[sources[c]];
+		MocapPoseSoA* out = features.data() + newClips[c].firstFrame;
+		if (pending.read) {
+			for (size_t f = 0; f < pending.frames.size(); f++) {
+				FeatureFromFrame(pending.frames[f], out[f]);
+			}
+		}
+		else {
+			// the clip's old place in the current features
+			memcpy(out, _features.data() + pending.clip.firstFrame, newClips[c].numFrames * sizeof(MocapPoseSoA));
+		}
+	});
+	_clips = std::move(newClips);
+	_features = std::move(features);
+	if (refit) {
+		FitComponents();
+	}
+	RebuildLookup();
+	BuildTree();
+}
+
+void MocapPoseIndex::FeatureFromFrame(const MocapFrame& frame, MocapPoseSoA& out) const
+{
+	float cx = 0.0f, cz = 0.0f;
+	int present = 0;
+	for (int p = 0; p < PlayerPoints; p++) {
+		if (!IsMissingPoint(frame.points[p])) {
+			cx += frame.points[p].x;
+			cz += frame.points[p].z;
+			present++;
+		}
+	}
+	if (present > 0) {
+		cx /= present;
+		cz /= present;
+	}
+	memset(&out, 0, sizeof(out));
+	for (int p = 0; p < PlayerPoints; p++) {
+		if (IsMissingPoint(frame.points[p])) {
+			out.x[p] = _mean.x[p];
+			out.y[p] = _mean.y[p];
+			out.z[p] = _mean.z[p];
+		}
+		else {
+			out.x[p] = frame.points[p].x - cx;
+			out.y[p] = frame.points[p].y;
+			out.z[p] = frame.points[p].z - cz;
+		}
+	}
+}
+
+void MocapPoseIndex::FitComponents()
+{
+	memset(_basis, 0, sizeof(_basis));
+	_fitted = false;
+	const size_t numFrames = _features.size();
+	if (numFrames < 2) {
+		return;
+	}
+	const int n = PoseFeatureFloats;
+	std::vector<double> mean(n, 0.0);
+	for (const auto& feature : _features) {
+		const float* f = Floats(feature);
+		for (int i = 0; i < n; i++) {
+			mean[i] += f[i];
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		mean[i] /= (double)numFrames;
+	}
+	// upper triangle of the covariance, a block of frames per task and summed after
+	const size_t blockFrames = 1024;
+	const size_t numBlocks = (numFrames + blockFrames - 1) / blockFrames;
+	std::vector<std::vector<double>> partial(numBlocks);
+	GetThreadPool().ParallelFor(numBlocks, [&](size_t b) {
+		std::vector<double>& cov = partial[b];
+		cov.assign((size_t)n * n, 0.0);
+		double d[PoseFeatureFloats];
+		size_t end = std::min(numFrames, (b + 1) * blockFrames);
+		for (size_t f = b * blockFrames; f < end; f++) {
+			const float* feature = Floats(_features[f]);
+			for (int i = 0; i < n; i++) {
+				d[i] = feature[i] - mean[i];
+			}
+			for (int i = 0; i < n; i++) {
+				double di = d[i];
+				double* row = &cov[(size_t)i * n];
+				for (int j = i; j < n; j++) {
+					row[j] += di * d[j];
+				}
+			}
+		}
+	});
+	std::vector<double> covariance((size_t)n * n, 0.0);
+	for (const auto& cov : partial) {
+		for (size_t i = 0; i < covariance.size(); i++) {
+			covariance[i] += cov[i];
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		for (int j = i; j < n; j++) {
+			double value = covariance[(size_t)i * n + j] / (double)numFrames;
+			covariance[(size_t)i * n + j] = value;
+			covariance[(size_t)j * n + i] = value;
+		}
+	}
+	std::vector<double> vectors, values;
+	SymmetricEigen(covariance, n, vectors, values);
+	std::vector<int> order(n);
+	for (int i = 0; i < n; i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return values[a] > values[b];
+	});
+	for (int c = 0; c < PoseIndexComponents; c++) {
+		float* axis = Floats(_basis[c]);
+		for (int i = 0; i < n; i++) {
+			axis[i] = (float)vectors[(size_t)i * n + order[c]];
+		}
+	}
+	_fitted = true;
+}
+
+void MocapPoseIndex::Project(const MocapPoseSoA& feature, float* out) const
+{
+	const float* f = Floats(feature);
+	for (int c = 0; c < PoseIndexComponents; c++) {
+		const float* axis = Floats(_basis[c]);
+		float sum = 0.0f;
+		for (int i = 0; i < PoseFeatureFloats; i++) {
+			sum += axis[i] * f[i];
+		}
+		out[c] = sum;
+	}
+}
+
+void MocapPoseIndex::BuildTree()
+{
+	const size_t numFrames = _features.size();
+	_projected.resize(numFrames * PoseIndexComponents);
+	GetThreadPool().ParallelFor(numFrames, [&](size_t f) {
+		Project(_features[f], &_projected[f * PoseIndexComponents]);
+	}, 256);
+	_tree.clear();
+	_treeOrder.resize(numFrames);
+	for (size_t i = 0; i < numFrames; i++) {
+		_treeOrder[i] = (u32)i;
+	}
+	if (numFrames > 0) {
+		u32 rng = 1;
+		BuildNode(0, (u32)numFrames, rng);
+	}
+}
+
+int MocapPoseIndex::BuildNode(u32 first, u32 count, u32& rng)
+{
+	int index = (int)_tree.size();
+	_tree.push_back(TreeNode());
+	if (count <= PoseTreeLeafSize) {
+		_tree[index] = { first, count, 0.0f, -1, -1 };
+		return index;
+	}
+	rng = rng * 1664525u + 1013904223u;
+	std::swap(_treeOrder[first], _treeOrder[first + (rng >> 8) % count]);
+	u32 vantage = _treeOrder[first];
+	const float* vp = &_projected[(size_t)vantage * PoseIndexComponents];
+	u32 rest = count - 1;
+	std::vector<std::pair<float, u32>> distances(rest);
+	for (u32 i = 0; i < rest; i++) {
+		u32 frame = _treeOrder[first + 1 + i];
+		distances[i] = std::make_pair(ProjectedDistance(vp, &_projected[(size_t)frame * PoseIndexComponents]), frame);
+	}
+	// everything before half is no further than the radius, everything from it on no nearer
+	u32 half = rest / 2;
+	std::nth_element(distances.begin(), distances.begin() + half, distances.end());
+	for (u32 i = 0; i < rest; i++) {
+		_treeOrder[first + 1 + i] = distances[i].second;
+	}
+	float radius = distances[half].first;
+	int inside = BuildNode(first + 1, half, rng);
+	int outside = BuildNode(first + 1 + half, rest - half, rng);
+	_tree[index] = { vantage, 0, radius, inside, outside };
+	return index;
+}
+
+void MocapPoseIndex::Query(const MocapFrame& pose, size_t k, std::vector<PoseMatch>& out) const
+{
+	out.clear();
+	if (k == 0 || _features.empty()) {
+		return;
+	}
+	MocapPoseSoA feature;
+	FeatureFromFrame(pose, feature);
+	float projected[PoseIndexComponents];
+	Project(feature, projected);
+
+	// the k best so far as a max heap on the full distance, so the front is the one to beat.
+	// the distance between projections never exceeds the full one, so anything whose projection
+	// is already further than that can't get in, and neither can a subtree whose bound is
+	std::vector<std::pair<float, u32>> best;
+	best.reserve(k + 1);
+	auto worst = [&]() {
+		return best.size() < k ? FLT_MAX : best.front().first;
+	};
+	auto consider = [&](u32 frame, float lowerBound) {
+		if (lowerBound * PoseBoundSlack >= worst()) {
+			return;
+		}
+		float distanceSquared;
+		PoseDistancesSquared(feature, &_features[frame], 1, &distanceSquared);
+		float distance = sqrtf(distanceSquared);
+		if (distance < worst()) {
+			best.push_back(std::make_pair(distance, frame));
+			std::push_heap(best.begin(), best.end());
+			if (best.size() > k) {
+				std::pop_heap(best.begin(), best.end());
+				best.pop_back();
+			}
+		}
+	};
+	std::vector<std::pair<int, float>> stack;
+	stack.push_back(std::make_pair(0, 0.0f));
+	while (!stack.empty()) {
+		int n = stack.back().first;
+		float bound = stack.back().second;
+		stack.pop_back();
+		if (bound * PoseBoundSlack >= worst()) {
+			continue;
+		}
+		const TreeNode& node = _tree[n];
+		if (node.count > 0) {
+			for (u32 i = node.vantage; i < node.vantage + node.count; i++) {
+				u32 frame = _treeOrder[i];
+				consider(frame, ProjectedDistance(projected, &_projected[(size_t)frame * PoseIndexComponents]));
+			}
+			continue;
+		}
+		float d = ProjectedDistance(projected, &_projected[(size_t)node.vantage * PoseIndexComponents]);
+		consider(node.vantage, d);
+		float insideBound = std::max(bound, d - node.radius);
+		float outsideBound = std::max(bound, node.radius - d);
+		// the side the query falls in is pushed last so it's searched first
+		if (d < node.radius) {
+			stack.push_back(std::make_pair(node.outside, outsideBound));
+			stack.push_back(std::make_pair(node.inside, insideBound));
+		}
+		else {
+			stack.push_back(std::make_pair(node.inside, insideBound));
+			stack.push_back(std::make_pair(node.outside, outsideBound));
+		}
+	}
+	std::sort_heap(best.begin(), best.end());
+	out.resize(best.size());
+	for (size_t i = 0; i < best.size(); i++) {
+		FindMatch(best[i].second, best[i].first, out[i]);
+	}
+}
+
+void MocapPoseIndex::QueryBruteForce(const MocapFrame& pose, size_t k, std::vector<PoseMatch>& out) const
+{
+	out.clear();
+	if (k == 0 || _features.empty()) {
+		return;
+	}
+	MocapPoseSoA feature;
+	FeatureFromFrame(pose, feature);
+	std::vector<float> distances(_features.size());
+	PoseDistancesSquared(feature, _features.data(), _features.size(), distances.data());
+	std::vector<u32> order(_features.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = (u32)i;
+	}
+	k = std::min(k, order.size());
+	std::partial_sort(order.begin(), order.begin() + k, order.end(), [&](u32 a, u32 b) {
+		return distances[a] != distances[b] ? distances[a] < distances[b] : a < b;
+	});
+	out.resize(k);
+	for (size_t i = 0; i < k; i++) {
+		FindMatch(order[i], sqrtf(distances[order[i]]), out[i]);
+	}
+}
+
+const PoseIndexClip* MocapPoseIndex::Find(const std::string& name) const
+{
+	auto it = _lookup.find(name);
+	return it == _lookup.end() ? nullptr : &_clips[it->second];
+}
+
+void MocapPoseIndex::ProjectPose(const MocapFrame& pose, float* components) const
+{
+	MocapPoseSoA feature;
+	FeatureFromFrame(pose, feature);
+	Project(feature, components);
+}
+
+void MocapPoseIndex::RebuildLookup()
+{
+	_lookup.clear();
+	_lookup.reserve(_clips.size());
+	for (size_t i = 0; i < _clips.size(); i++) {
+		_lookup[_clips[i].name] = i;
+	}
+}
+
+void MocapPoseIndex::FindMatch(u32 frame, float distance, PoseMatch& out) const
+{
+	auto it = std::upper_bound(_clips.begin(), _clips.end(), frame, [](u32 f, const PoseIndexClip& clip) {
+		return f < clip.firstFrame;
+	});
+	size_t clip = it == _clips.begin() ? 0 : (it - _clips.begin()) - 1;
+	out.clip = (u32)clip;
+	out.frame = frame - _clips[clip].firstFrame;
+	out.distance = distance / sqrtf((float)PlayerPoints);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "BasicTypedefs.h"
+#include "MocapPoseSoA.h"
+
+class IFilesystem;
+
+#define PoseIndexMagic "CMPX"
+#define PoseIndexVersion 1
+#define PoseIndexFileName "library.cpx"
+#define PoseIndexComponents 16 // principal components the search tree works in
+
+struct PoseIndexClip {
+	std::string name;
+	u64 sourceSize = 0;
+	i64 modifiedTime = 0;
+	u32 firstFrame = 0; // into the index's frames, clips are in name order
+	u32 numFrames = 0;
+};
+
+struct PoseMatch {
+	u32 clip;       // into GetClips
+	u32 frame;      // within the clip
+	float distance; // root mean square distance per point, after both poses are moved to the origin
+};
+
+/// <summary>
+/// every frame in a library folder as a pose feature, for finding the frames most like a given pose.
+/// features are the pose moved so its points are centred on the origin across the ground, with missing
+/// points filled in from the library's mean pose. they're searched with a vantage point tree built on
+/// their principal components, and since distances between the components are never more than the
+/// real distance, the tree can skip most frames without ever missing the true nearest ones.
+/// kept beside the clips in one binary file, and brought up to date clip by clip like MocapLibraryIndex
+/// </summary>
+class MocapPoseIndex
+{
+public:
+	MocapPoseIndex(bool reverseEndianness);
+	bool Load(const std::string& indexPath);
+	/// <summary>
+	/// written to a temporary file then moved over indexPath
+	/// </summary>
+	bool Save(const std::string& indexPath, IFilesystem* fileSystem) const;
+	/// <summary>
+	/// bring the index in line with the clips now in folder, reading only new and changed ones unless
+	/// enough has changed that the components are refitted. returns how many clips were added, changed or removed
+	/// </summary>
+	size_t Update(const std::string& folder, IFilesystem* fileSystem);
+	/// <summary>
+	/// like Update but only looks at the named clips, e.g. ones a directory watch reported
+	/// </summary>
+	size_t UpdateClips(const std::string& folder, const std::vector<std::string>& names, IFilesystem* fileSystem);
+	/// <summary>
+	/// the k frames nearest pose, nearest first. pose can be any frame, captured or edited
+	/// </summary>
+	void Query(const MocapFrame& pose, size_t k, std::vector<PoseMatch>& out) const;
+	// the same results by comparing against every frame, for checking and timing Query
+	void QueryBruteForce(const MocapFrame& pose, size_t k, std::vector<PoseMatch>& out) const;
+	inline const std::vector<PoseIndexClip>& GetClips() const {
+		return _clips;
+	}
+	inline size_t GetNumFrames() const {
+		return _features.size();
+	}
+	const PoseIndexClip* Find(const std::string& name) const;
+	/// <summary>
+	/// pose's first PoseIndexComponents principal components, a compact description of it for other searches.
+	/// all zero until the index has been fitted
+	/// </summary>
+	void ProjectPose(const MocapFrame& pose, float* components) const;
+private:
+	struct PendingClip {
+		PoseIndexClip clip;
+		bool read = false;              // otherwise its features are copied from the current index
+		std::vector<MocapFrame> frames; // when read
+	};
+	void Rebuild(const std::string& folder, std::vector<PendingClip>& clips, IFilesystem* fileSystem);
+	void FeatureFromFrame(const MocapFrame& frame, MocapPoseSoA& out) const;
+	void FitComponents();
+	void Project(const MocapPoseSoA& feature, float* out) const;
+	void BuildTree();
+	int BuildNode(u32 first, u32 count, u32& rng);
+	void RebuildLookup();
+	void FindMatch(u32 frame, float distance, PoseMatch& out) const;
+private:
+	struct TreeNode {
+		u32 vantage;   // frame the node splits around, or first in _treeOrder for a leaf
+		u32 count;     // frames in a leaf, 0 for a split
+		float radius;  // frames within this of the vantage point go inside
+		int inside;
+		int outside;
+	};
+	std::vector<PoseIndexClip> _clips;
+	std::unordered_map<std::string, size_t> _lookup;
+	MocapPoseSoA _mean = {};                     // stands in for missing points
+	MocapPoseSoA _basis[PoseIndexComponents] = {}; // unit length principal axes, largest first
+	bool _fitted = false;
+	std::vector<MocapPoseSoA> _features;         // every frame of every clip
+	std::vector<float> _projected;               // PoseIndexComponents per frame
+	std::vector<TreeNode> _tree;
+	std::vector<u32> _treeOrder;
+	bool _reverseEndianness;
+};
@@ -0,0 +1,369 @@
+#include "MocapPoseSoA.h"
+#include "ByteSwap.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MOCAP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define MOCAP_TARGET_AVX
+#else
+#define MOCAP_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+#define PoseFloats (PosePaddedPoints * 3)
+
+void PoseFromFrame(const MocapFrame& frame, MocapPoseSoA& out)
+{
+	memset(&out, 0, sizeof(MocapPoseSoA));
+	for (int i = 0; i < PlayerPoints; i++) {
+		out.x[i] = frame.points[i].x;
+		out.y[i] = frame.points[i].y;
+		out.z[i] = frame.points[i].z;
+	}
+}
+
+void PoseToFrame(const MocapPoseSoA& pose, MocapFrame& out)
+{
+	for (int i = 0; i < PlayerPoints; i++) {
+		out.points[i] = glm::vec3(pose.x[i], pose.y[i], pose.z[i]);
+	}
+}
+
+void LerpPosesScalar(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out)
+{
+	const float* pa = a.x;
+	const float* pb = b.x;
+	float* po = out.x;
+	for (int i = 0; i < PoseFloats; i++) {
+		po[i] = pa[i] + (pb[i] - pa[i]) * t;
+	}
+}
+
+void CatmullRomCoefficients(const MocapPoseSoA& p0, const MocapPoseSoA& p1, const MocapPoseSoA& p2, const MocapPoseSoA& p3, MocapPoseSoA* out)
+{
+	memset(out, 0, 4 * sizeof(MocapPoseSoA));
+	const float* f0 = p0.x;
+	const float* f1 = p1.x;
+	const float* f2 = p2.x;
+	const float* f3 = p3.x;
+	float* c0 = out[0].x;
+	float* c1 = out[1].x;
+	float* c2 = out[2].x;
+	float* c3 = out[3].x;
+	for (int i = 0; i < PlayerPoints; i++) {
+		bool missing = IsMissingPoint(glm::vec3(p0.x[i], p0.y[i], p0.z[i])) || IsMissingPoint(glm::vec3(p1.x[i], p1.y[i], p1.z[i]))
+			|| IsMissingPoint(glm::vec3(p2.x[i], p2.y[i], p2.z[i])) || IsMissingPoint(glm::vec3(p3.x[i], p3.y[i], p3.z[i]));
+		// the x, y and z lanes follow each other, so step through all three from x
+		for (int lane = i; lane < PoseFloats; lane += PosePaddedPoints) {
+			float v0 = f0[lane], v1 = f1[lane], v2 = f2[lane], v3 = f3[lane];
+			c0[lane] = v1;
+			if (missing) {
+				// no usable tangents, fall back to the same straight line LerpPoses gives
+				c1[lane] = v2 - v1;
+				continue;
+			}
+			c1[lane] = 0.5f * (v2 - v0);
+			c2[lane] = v0 - 2.5f * v1 + 2.0f * v2 - 0.5f * v3;
+			c3[lane] = 0.5f * (v3 - v0) + 1.5f * (v1 - v2);
+		}
+	}
+}
+
+void EvaluateCubicPoseScalar(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out)
+{
+	const float* c0 = coefficients[0].x;
+	const float* c1 = coefficients[1].x;
+	const float* c2 = coefficients[2].x;
+	const float* c3 = coefficients[3].x;
+	float* po = out.x;
+	for (int i = 0; i < PoseFloats; i++) {
+		po[i] = ((c3[i] * t + c2[i]) * t + c1[i]) * t + c0[i];
+	}
+}
+
+static void AddScaledPoseScalar(const MocapPoseSoA& in, float weight, MocapPoseSoA& acc)
+{
+	const float* pi = in.x;
+	float* pa = acc.x;
+	for (int i = 0; i < PoseFloats; i++) {
+		pa[i] += pi[i] * weight;
+	}
+}
+
+static void AddWeightedPoseScalar(const MocapPoseSoA& in, const MocapPoseSoA& weights, MocapPoseSoA& acc)
+{
+	const float* pi = in.x;
+	const float* pw = weights.x;
+	float* pa = acc.x;
+	for (int i = 0; i < PoseFloats; i++) {
+		pa[i] += pi[i] * pw[i];
+	}
+}
+
+void PoseDistancesSquaredScalar(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out)
+{
+	const float* pa = a.x;
+	for (size_t p = 0; p < count; p++) {
+		const float* pb = poses[p].x;
+		float sum = 0.0f;
+		for (int i = 0; i < PoseFloats; i++) {
+			float d = pa[i] - pb[i];
+			sum += d * d;
+		}
+		out[p] = sum;
+	}
+}
+
+#ifdef MOCAP_X86
+
+static void AddWeightedPoseSSE2(const MocapPoseSoA& in, const MocapPoseSoA& weights, MocapPoseSoA& acc)
+{
+	const float* pi = in.x;
+	const float* pw = weights.x;
+	float* pa = acc.x;
+	for (int i = 0; i < PoseFloats; i += 4) {
+		_mm_storeu_ps(pa + i, _mm_add_ps(_mm_loadu_ps(pa + i), _mm_mul_ps(_mm_loadu_ps(pi + i), _mm_loadu_ps(pw + i))));
+	}
+}
+
+MOCAP_TARGET_AVX static void AddWeightedPoseAVX(const MocapPoseSoA& in, const MocapPoseSoA& weights, MocapPoseSoA& acc)
+{
+	const float* pi = in.x;
+	const float* pw = weights.x;
+	float* pa = acc.x;
+	for (int i = 0; i < PoseFloats; i += 8) {
+		_mm256_storeu_ps(pa + i, _mm256_add_ps(_mm256_loadu_ps(pa + i), _mm256_mul_ps(_mm256_loadu_ps(pi + i), _mm256_loadu_ps(pw + i))));
+	}
+}
+
+static void AddScaledPoseSSE2(const MocapPoseSoA& in, float weight, MocapPoseSoA& acc)
+{
+	const float* pi = in.x;
+	float* pa = acc.x;
+	const __m128 vw = _mm_set1_ps(weight);
+	for (int i = 0; i < PoseFloats; i += 4) {
+		_mm_storeu_ps(pa + i, _mm_add_ps(_mm_loadu_ps(pa + i), _mm_mul_ps(_mm_loadu_ps(pi + i), vw)));
+	}
+}
+
+MOCAP_TARGET_AVX static void AddScaledPoseAVX(const MocapPoseSoA& in, float weight, MocapPoseSoA& acc)
+{
+	const float* pi = in.x;
+	float* pa = acc.x;
+	const __m256 vw = _mm256_set1_ps(weight);
+	for (int i = 0; i < PoseFloats; i += 8) {
+		_mm256_storeu_ps(pa + i, _mm256_add_ps(_mm256_loadu_ps(pa + i), _mm256_mul_ps(_mm256_loadu_ps(pi + i), vw)));
+	}
+}
+
+void LerpPosesSSE2(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out)
+{
+	const float* pa = a.x;
+	const float* pb = b.x;
+	float* po = out.x;
+	const __m128 vt = _mm_set1_ps(t);
+	for (int i = 0; i < PoseFloats; i += 4) {
+		__m128 va = _mm_loadu_ps(pa + i);
+		__m128 vb = _mm_loadu_ps(pb + i);
+		_mm_storeu_ps(po + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+	}
+}
+
+MOCAP_TARGET_AVX void LerpPosesAVX(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out)
+{
+	// 12 registers per pose, 4 per lane. unaligned loads cost nothing extra on aligned data
+	// and keep this safe for poses in heap objects that C++14 new doesn't over-align
+	const float* pa = a.x;
+	const float* pb = b.x;
+	float* po = out.x;
+	const __m256 vt = _mm256_set1_ps(t);
+	for (int i = 0; i < PoseFloats; i += 8) {
+		__m256 va = _mm256_loadu_ps(pa + i);
+		__m256 vb = _mm256_loadu_ps(pb + i);
+		_mm256_storeu_ps(po + i, _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(vb, va), vt)));
+	}
+}
+
+void EvaluateCubicPoseSSE2(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out)
+{
+	const float* c0 = coefficients[0].x;
+	const float* c1 = coefficients[1].x;
+	const float* c2 = coefficients[2].x;
+	const float* c3 = coefficients[3].x;
+	float* po = out.x;
+	const __m128 vt = _mm_set1_ps(t);
+	for (int i = 0; i < PoseFloats; i += 4) {
+		__m128 r = _mm_loadu_ps(c3 + i);
+		r = _mm_add_ps(_mm_mul_ps(r, vt), _mm_loadu_ps(c2 + i));
+		r = _mm_add_ps(_mm_mul_ps(r, vt), _mm_loadu_ps(c1 + i));
+		r = _mm_add_ps(_mm_mul_ps(r, vt), _mm_loadu_ps(c0 + i));
+		_mm_storeu_ps(po + i, r);
+	}
+}
+
+MOCAP_TARGET_AVX void EvaluateCubicPoseAVX(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out)
+{
+	// Horner's rule, 3 multiply-adds per register and no reads outside this segment
+	const float* c0 = coefficients[0].x;
+	const float* c1 = coefficients[1].x;
+	const float* c2 = coefficients[2].x;
+	const float* c3 = coefficients[3].x;
+	float* po = out.x;
+	const __m256 vt = _mm256_set1_ps(t);
+	for (int i = 0; i < PoseFloats; i += 8) {
+		__m256 r = _mm256_loadu_ps(c3 + i);
+		r = _mm256_add_ps(_mm256_mul_ps(r, vt), _mm256_loadu_ps(c2 + i));
+		r = _mm256_add_ps(_mm256_mul_ps(r, vt), _mm256_loadu_ps(c1 + i));
+		r = _mm256_add_ps(_mm256_mul_ps(r, vt), _mm256_loadu_ps(c0 + i));
+		_mm256_storeu_ps(po + i, r);
+	}
+}
+
+void PoseDistancesSquaredSSE2(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out)
+{
+	const float* pa = a.x;
+	for (size_t p = 0; p < count; p++) {
+		const float* pb = poses[p].x;
+		// two accumulators so the adds aren't one long dependency chain
+		__m128 sum0 = _mm_setzero_ps();
+		__m128 sum1 = _mm_setzero_ps();
+		for (int i = 0; i < PoseFloats; i += 8) {
+			__m128 d0 = _mm_sub_ps(_mm_loadu_ps(pa + i), _mm_loadu_ps(pb + i));
+			__m128 d1 = _mm_sub_ps(_mm_loadu_ps(pa + i + 4), _mm_loadu_ps(pb + i + 4));
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(d0, d0));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(d1, d1));
+		}
+		__m128 v = _mm_add_ps(sum0, sum1);
+		v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+		out[p] = _mm_cvtss_f32(v);
+	}
+}
+
+MOCAP_TARGET_AVX void PoseDistancesSquaredAVX(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out)
+{
+	const float* pa = a.x;
+	for (size_t p = 0; p < count; p++) {
+		const float* pb = poses[p].x;
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		for (int i = 0; i < PoseFloats; i += 16) {
+			__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(pa + i), _mm256_loadu_ps(pb + i));
+			__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(pa + i + 8), _mm256_loadu_ps(pb + i + 8));
+			sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(d0, d0));
+			sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(d1, d1));
+		}
+		__m256 v8 = _mm256_add_ps(sum0, sum1);
+		__m128 v = _mm_add_ps(_mm256_castps256_ps128(v8), _mm256_extractf128_ps(v8, 1));
+		v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+		out[p] = _mm_cvtss_f32(v);
+	}
+}
+
+#else
+
+void PoseDistancesSquaredSSE2(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out)
+{
+	PoseDistancesSquaredScalar(a, poses, count, out);
+}
+
+void PoseDistancesSquaredAVX(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out)
+{
+	PoseDistancesSquaredScalar(a, poses, count, out);
+}
+
+static void AddWeightedPoseSSE2(const MocapPoseSoA& in, const MocapPoseSoA& weights, MocapPoseSoA& acc)
+{
+	AddWeightedPoseScalar(in, weights, acc);
+}
+
+static void AddWeightedPoseAVX(const MocapPoseSoA& in, const MocapPoseSoA& weights, MocapPoseSoA& acc)
+{
+	AddWeightedPoseScalar(in, weights, acc);
+}
+
+static void AddScaledPoseSSE2(const MocapPoseSoA& in, float weight, MocapPoseSoA& acc)
+{
+	AddScaledPoseScalar(in, weight, acc);
+}
+
+static void AddScaledPoseAVX(const MocapPoseSoA& in, float weight, MocapPoseSoA& acc)
+{
+	AddScaledPoseScalar(in, weight, acc);
+}
+
+void EvaluateCubicPoseSSE2(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out)
+{
+	EvaluateCubicPoseScalar(coefficients, t, out);
+}
+
+void EvaluateCubicPoseAVX(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out)
+{
+	EvaluateCubicPoseScalar(coefficients, t, out);
+}
+
+void LerpPosesSSE2(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out)
+{
+	LerpPosesScalar(a, b, t, out);
+}
+
+void LerpPosesAVX(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out)
+{
+	LerpPosesScalar(a, b, t, out);
+}
+
+#endif
+
+void LerpPoses(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out)
+{
+	// any cpu with AVX2 has AVX
+	if (CpuSupportsAVX2()) {
+		LerpPosesAVX(a, b, t, out);
+	}
+	else {
+		LerpPosesSSE2(a, b, t, out);
+	}
+}
+
+void EvaluateCubicPose(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out)
+{
+	if (CpuSupportsAVX2()) {
+		EvaluateCubicPoseAVX(coefficients, t, out);
+	}
+	else {
+		EvaluateCubicPoseSSE2(coefficients, t, out);
+	}
+}
+
+void AddScaledPose(const MocapPoseSoA& in, float weight, MocapPoseSoA& acc)
+{
+	if (CpuSupportsAVX2()) {
+		AddScaledPoseAVX(in, weight, acc);
+	}
+	else {
+		AddScaledPoseSSE2(in, weight, acc);
+	}
+}
+
+void AddWeightedPose(const MocapPoseSoA& in, const MocapPoseSoA& weights, MocapPoseSoA& acc)
+{
+	if (CpuSupportsAVX2()) {
+		AddWeightedPoseAVX(in, weights, acc);
+	}
+	else {
+		AddWeightedPoseSSE2(in, weights, acc);
+	}
+}
+
+void PoseDistancesSquared(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out)
+{
+	if (CpuSupportsAVX2()) {
+		PoseDistancesSquaredAVX(a, poses, count, out);
+	}
+	else {
+		PoseDistancesSquaredSSE2(a, poses, count, out);
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "MocapFrame.h"
+#include <stddef.h>
+
+#define PosePaddedPoints 32 // PlayerPoints rounded up to a whole number of AVX registers
+
+/// <summary>
+/// one frame stored as separate x, y and z lanes, each padded to PosePaddedPoints floats.
+/// 32 byte aligned so every lane can be loaded straight into AVX registers.
+/// the padding points are kept at zero
+/// </summary>
+struct alignas(32) MocapPoseSoA {
+	float x[PosePaddedPoints];
+	float y[PosePaddedPoints];
+	float z[PosePaddedPoints];
+};
+
+static_assert(sizeof(MocapPoseSoA) == PosePaddedPoints * 3 * sizeof(float), "MocapPoseSoA must have no padding between lanes");
+
+enum class MocapInterpolation {
+	Linear,
+	CatmullRom // cubic through the frames either side, from coefficients precomputed per segment
+};
+
+void PoseFromFrame(const MocapFrame& frame, MocapPoseSoA& out);
+void PoseToFrame(const MocapPoseSoA& pose, MocapFrame& out);
+
+/// <summary>
+/// out = a + (b - a) * t for every lane, out may be a or b.
+/// picks the widest kernel the cpu supports (AVX, then SSE2, then scalar)
+/// </summary>
+void LerpPoses(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out);
+
+// the individual kernels, exposed so the benchmarks can compare them
+void LerpPosesScalar(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out);
+void LerpPosesSSE2(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out);
+void LerpPosesAVX(const MocapPoseSoA& a, const MocapPoseSoA& b, float t, MocapPoseSoA& out);
+
+/// <summary>
+/// out[0..3] = the Catmull-Rom polynomial from p1 (t = 0) to p2 (t = 1), as c0 + c1 t + c2 t^2 + c3 t^3.
+/// points missing from any of the four poses get a straight line from p1 to p2 instead
+/// </summary>
+void CatmullRomCoefficients(const MocapPoseSoA& p0, const MocapPoseSoA& p1, const MocapPoseSoA& p2, const MocapPoseSoA& p3, MocapPoseSoA* out);
+
+/// <summary>
+/// out = the cubic with coefficients coefficients[0..3] at t, picking a kernel the same way LerpPoses does
+/// </summary>
+void EvaluateCubicPose(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out);
+
+void EvaluateCubicPoseScalar(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out);
+void EvaluateCubicPoseSSE2(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out);
+void EvaluateCubicPoseAVX(const MocapPoseSoA* coefficients, float t, MocapPoseSoA& out);
+
+/// <summary>
+/// acc += in * weight for every lane, for building poses out of weighted sums of frames
+/// </summary>
+void AddScaledPose(const MocapPoseSoA& in, float weight, MocapPoseSoA& acc);
+
+/// <summary>
+/// acc += in * weights lane by lane, weights holding one weight per float of the pose
+/// </summary>
+void AddWeightedPose(const MocapPoseSoA& in, const MocapPoseSoA& weights, MocapPoseSoA& acc);
+
+/// <summary>
+/// out[i] = the sum of squared differences between a and poses[i] over every lane, padding included.
+/// missing points count like any other value, so zero them first if they shouldn't dominate
+/// </summary>
+void PoseDistancesSquared(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out);
+
+void PoseDistancesSquaredScalar(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out);
+void PoseDistancesSquaredSSE2(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out);
+void PoseDistancesSquaredAVX(const MocapPoseSoA& a, const MocapPoseSoA* poses, size_t count, float* out);
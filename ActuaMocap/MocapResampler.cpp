@@ -0,0 +1,173 @@
+#include "MocapResampler.h"
+#include "MocapClipSoA.h"
+#include "MocapFile.h"
+#include "MocapFileWriter.h"
+#include "IFilesystem.h"
+#include "ThreadPool.h"
+#include "BasicTypedefs.h"
+#include <math.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <iostream>
+
+#define ResampleNegligibleWeight 1e-6f // taps weighted less than this are skipped, so exact hits don't drag in missing neighbours
+
+static const double Pi = 3.14159265358979323846;
+
+static double FilterSupport(ResampleFilter filter) {
+	return filter == ResampleFilter::Lanczos3 ? 3.0 : 2.0;
+}
+
+static double FilterWeight(ResampleFilter filter, double x) {
+	x = fabs(x);
+	if (filter == ResampleFilter::Lanczos3) {
+		if (x < 1e-9) {
+			return 1.0;
+		}
+		if (x >= 3.0) {
+			return 0.0;
+		}
+		double px = Pi * x;
+		return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+	}
+	// Keys cubic with a = -0.5, the Catmull-Rom spline as a convolution kernel
+	if (x < 1.0) {
+		return (1.5 * x - 2.5) * x * x + 1.0;
+	}
+	if (x < 2.0) {
+		return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+	}
+	return 0.0;
+}
+
+// one bit per point that has a missing coordinate
+static u32 MissingMask(const MocapPoseSoA& pose) {
+	u32 mask = 0;
+	for (int i = 0; i < PlayerPoints; i++) {
+		if (IsMissingPoint(glm::vec3(pose.x[i], pose.y[i], pose.z[i]))) {
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+}
+
+void ResampleClip(const MocapClipSoA& clip, double sourceFps, double targetFps, ResampleFilter filter, std::vector<MocapFrame>& out)
+{
+	out.clear();
+	size_t numFrames = clip.GetNumFrames();
+	if (numFrames == 0 || sourceFps <= 0.0 || targetFps <= 0.0) {
+		return;
+	}
+	double step = sourceFps / targetFps; // source frames per output frame
+	double scale = step > 1.0 ? step : 1.0;
+	double reach = FilterSupport(filter) * scale;
+	size_t numOut = (size_t)floor((numFrames - 1) / step + 1e-9) + 1;
+	out.resize(numOut);
+
+	std::vector<u32> missing(numFrames);
+	for (size_t i = 0; i < numFrames; i++) {
+		missing[i] = MissingMask(clip.GetPose(i));
+	}
+
+	std::vector<float> weights;
+	MocapPoseSoA acc;
+	for (size_t j = 0; j < numOut; j++) {
+		double position = j * step;
+		long long first = (long long)ceil(position - reach);
+		long long last = (long long)floor(position + reach);
+		weights.resize((size_t)(last - first + 1));
+		double total = 0.0;
+		for (long long k = first; k <= last; k++) {
+			double w = FilterWeight(filter, (position - k) / scale);
+			weights[(size_t)(k - first)] = (float)w;
+			total += w;
+		}
+		memset(&acc, 0, sizeof(acc));
+		u32 touchesMissing = 0;
+		for (long long k = first; k <= last; k++) {
+			float w = (float)(weights[(size_t)(k - first)] / total);
+			if (fabsf(w) < ResampleNegligibleWeight) {
+				continue;
+			}
+			// hold the end frames past either end of the clip
+			size_t source = k < 0 ? 0 : k >= (long long)numFrames ? numFrames - 1 : (size_t)k;
+			AddScaledPose(clip.GetPose(source), w, acc);
+			touchesMissing |= missing[source];
+		}
+		if (touchesMissing) {
+			size_t nearest = (size_t)floor(position + 0.5);
+			nearest = nearest < numFrames ? nearest : numFrames - 1;
+			const MocapPoseSoA& pose = clip.GetPose(nearest);
+			for (int i = 0; i < PlayerPoints; i++) {
+				if (touchesMissing & (1u << i)) {
+					acc.x[i] = pose.x[i];
+					acc.y[i] = pose.y[i];
+					acc.z[i] = pose.z[i];
+				}
+			}
+		}
+		PoseToFrame(acc, out[j]);
+	}
+}
+
+static std::string ReplaceExtension(const std::string& name, const std::string& extension) {
+	size_t dot = name.rfind('.');
+	return (dot == std::string::npos ? name : name.substr(0, dot)) + extension;
+}
+
+bool ResampleFolder(const ResampleJob& job, IFilesystem* fileSystem, ResampleStats& stats)
+{
+	std::vector<std::string> names;
+	for (const auto& name : fileSystem->ListFilesInDirectory(job.folder)) {
+		if (FileHasExtension(name, ".comap") || FileHasExtension(name, ".comapz") || FileHasExtension(name, ".comapk")) {
+			names.push_back(name);
+		}
+	}
+	if (names.empty()) {
+		std::cout << "no .comap, .comapz or .comapk files found in " << job.folder << "\n";
+		return false;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::atomic<size_t> skipped(0), failed(0), sourceFrames(0), outputFrames(0);
+	std::mutex resampleTimeMutex;
+	double resampleSeconds = 0.0;
+	GetThreadPool().ParallelFor(names.size(), [&](size_t i) {
+		MocapFile file(job.reverseEndianness);
+		file.Load(JoinPath(job.folder, names[i]));
+		if (file.GetNumFrames() == 0) {
+			skipped++;
+			return;
+		}
+		MocapClipSoA clip;
+		clip.Build(file);
+		std::vector<MocapFrame> frames;
+		auto resampleStart = std::chrono::high_resolution_clock::now();
+		ResampleClip(clip, job.sourceFps, job.targetFps, job.filter, frames);
+		double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - resampleStart).count();
+
+		MocapFile resampled(job.reverseEndianness);
+		resampled.LoadView(frames.data(), frames.size());
+		std::string outPath = JoinPath(job.outFolder, ReplaceExtension(names[i], job.comapz ? ".comapz" : ".comap"));
+		bool ok = job.comapz ? WriteComapz(resampled, outPath, job.comapzTolerance) : WriteComap(resampled, outPath, job.reverseEndianness);
+		if (!ok) {
+			failed++;
+			return;
+		}
+		sourceFrames += file.GetNumFrames();
+		outputFrames += frames.size();
+		std::lock_guard<std::mutex> lock(resampleTimeMutex);
+		resampleSeconds += secs;
+	});
+
+	stats.clips = names.size() - skipped - failed;
+	stats.skipped = skipped;
+	stats.failed = failed;
+	stats.sourceFrames = sourceFrames;
+	stats.outputFrames = outputFrames;
+	stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	stats.resampleSeconds = resampleSeconds;
+	return failed == 0;
+}
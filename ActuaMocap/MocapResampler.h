@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "MocapFrame.h"
+
+class MocapClipSoA;
+class IFilesystem;
+
+enum class ResampleFilter {
+	CatmullRom, // 4 taps, matches MocapInterpolation::CatmullRom playback
+	Lanczos3    // 6 taps windowed sinc, sharper but can ring on sudden movements
+};
+
+/// <summary>
+/// resample clip, captured at sourceFps, to targetFps. the result starts on the first frame and
+/// stops at or before the last, it isn't looped. filters are widened when downsampling so they
+/// also low pass. points missing from any frame the filter reaches take the nearest frame's value
+/// </summary>
+void ResampleClip(const MocapClipSoA& clip, double sourceFps, double targetFps, ResampleFilter filter, std::vector<MocapFrame>& out);
+
+struct ResampleJob {
+	std::string folder;    // every .comap and .comapz in here
+	std::string outFolder; // written with the same names
+	double sourceFps;
+	double targetFps;
+	ResampleFilter filter;
+	bool comapz;           // write .comapz rather than .comap
+	float comapzTolerance;
+	bool reverseEndianness;
+};
+
+struct ResampleStats {
+	size_t clips = 0;
+	size_t skipped = 0; // empty or unreadable clips
+	size_t failed = 0;  // couldn't be written
+	size_t sourceFrames = 0;
+	size_t outputFrames = 0;
+	double seconds = 0.0;         // wall clock for the whole job
+	double resampleSeconds = 0.0; // summed across threads, ResampleClip only
+};
+
+/// <summary>
+/// resample every clip in job.folder, one clip per thread pool task
+/// </summary>
+bool ResampleFolder(const ResampleJob& job, IFilesystem* fileSystem, ResampleStats& stats);
@@ -0,0 +1,57 @@
+#include "MocapSampler.h"
+#include <math.h>
+
+MocapFramePair MapTimeToFrames(double seconds, double fps, size_t numFrames, MocapWrapMode wrap)
+{
+	MocapFramePair pair = { 0, 0, 0.0f };
+	if (numFrames < 2) {
+		return pair;
+	}
+	double position = seconds * fps; // in frames
+	// frame / fps * fps can land a hair under frame, which would pick the one before
+	double nearest = floor(position + 0.5);
+	if (fabs(position - nearest) < 1e-6) {
+		position = nearest;
+	}
+	double last = (double)(numFrames - 1);
+	switch (wrap) {
+	case MocapWrapMode::Loop: {
+		double whole = floor(position);
+		long long frame = (long long)whole % (long long)numFrames;
+		if (frame < 0) {
+			frame += numFrames;
+		}
+		pair.frame = (size_t)frame;
+		pair.next = pair.frame + 1 < numFrames ? pair.frame + 1 : 0;
+		pair.t = (float)(position - whole);
+		return pair;
+	}
+	case MocapWrapMode::Clamp:
+		position = position < 0.0 ? 0.0 : position > last ? last : position;
+		break;
+	case MocapWrapMode::PingPong: {
+		// there and back is one period, fold the way back onto the way there
+		double period = 2.0 * last;
+		position = fmod(position, period);
+		if (position < 0.0) {
+			position += period;
+		}
+		if (position > last) {
+			position = period - position;
+		}
+		break;
+	}
+	}
+	double whole = floor(position);
+	pair.frame = (size_t)whole;
+	if (pair.frame >= numFrames - 1) {
+		// exactly on the last frame
+		pair.frame = numFrames - 1;
+		pair.next = numFrames - 1;
+		pair.t = 0.0f;
+		return pair;
+	}
+	pair.next = pair.frame + 1;
+	pair.t = (float)(position - whole);
+	return pair;
+}
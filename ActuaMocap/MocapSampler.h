@@ -0,0 +1,22 @@
+#pragma once
+#include <stddef.h>
+
+enum class MocapWrapMode {
+	Loop,    // the last frame blends back into the first, as the viewer has always played clips
+	Clamp,   // hold the first frame before the start and the last frame after the end
+	PingPong // play forwards to the last frame then backwards to the first
+};
+
+// two frames to blend and how far between them, for a given time
+struct MocapFramePair {
+	size_t frame;
+	size_t next; // frame + 1, or where wrap goes after it
+	float t;     // 0 is frame, 1 is next
+};
+
+/// <summary>
+/// which frames of a numFrames frame clip playing at fps are on screen at seconds, with no other state.
+/// any seconds works, negative ones included, so reverse playback and scrubbing are just different times.
+/// with CatmullRom the segment to sample is frame, whichever way playback is going
+/// </summary>
+MocapFramePair MapTimeToFrames(double seconds, double fps, size_t numFrames, MocapWrapMode wrap);
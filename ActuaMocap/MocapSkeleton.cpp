@@ -0,0 +1,124 @@
+#include "MocapSkeleton.h"
+#include <iostream>
+#include <glm/ext/matrix_transform.hpp>
+#include "MocapPoseSoA.h"
+
+bool MocapSkeleton::Build(const SkeletonConnectivity& connectivity, size_t numJoints)
+{
+	std::vector<u32> parents(numJoints, SkeletonNoParent);
+	std::vector<std::vector<u32>> children(numJoints);
+	bool ok = true;
+	for (const auto& entry : connectivity) {
+		if (entry.first >= numJoints) {
+			std::cout << "skeleton joint " << entry.first << " out of range, " << numJoints << " joints\n";
+			ok = false;
+			continue;
+		}
+		for (size_t child : entry.second) {
+			if (child >= numJoints || parents[child] != SkeletonNoParent) {
+				std::cout << "skeleton joint " << child << (child >= numJoints ? " out of range" : " has more than one parent") << "\n";
+				ok = false;
+				continue;
+			}
+			parents[child] = (u32)entry.first;
+			children[entry.first].push_back((u32)child);
+		}
+	}
+
+	// breadth first from the roots, so parents come first and siblings stay together
+	std::vector<u32> order;
+	order.reserve(numJoints);
+	for (size_t joint = 0; joint < numJoints; joint++) {
+		if (parents[joint] == SkeletonNoParent) {
+			order.push_back((u32)joint);
+		}
+	}
+	for (size_t i = 0; i < order.size(); i++) {
+		for (u32 child : children[order[i]]) {
+			order.push_back(child);
+		}
+	}
+	if (order.size() != numJoints) {
+		// joints on a cycle are never reached from a root
+		std::cout << "skeleton has a cycle, " << numJoints - order.size() << " joints can't be reached from a root\n";
+		ok = false;
+	}
+	if (!ok) {
+		*this = MocapSkeleton();
+		return false;
+	}
+
+	_joints = order;
+	_sortedIndex.resize(numJoints);
+	for (size_t i = 0; i < numJoints; i++) {
+		_sortedIndex[_joints[i]] = (u32)i;
+	}
+	_parents.resize(numJoints);
+	for (size_t i = 0; i < numJoints; i++) {
+		u32 parent = parents[_joints[i]];
+		_parents[i] = parent == SkeletonNoParent ? SkeletonNoParent : _sortedIndex[parent];
+	}
+	_localPositions.assign(numJoints, glm::vec3(0.0f));
+	_localRotations.assign(numJoints, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	_worldPositions.assign(numJoints, glm::vec3(0.0f));
+	_worldRotations.assign(numJoints, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	return true;
+}
+
+void MocapSkeleton::SetLocalPosition(size_t joint, const glm::vec3& position)
+{
+	_localPositions[_sortedIndex[joint]] = position;
+}
+
+void MocapSkeleton::SetLocalEulers(size_t joint, const glm::vec3& eulers)
+{
+	// about y, then x, then z
+	glm::quat rotation = glm::angleAxis(eulers.y, glm::vec3(0.0f, 1.0f, 0.0f))
+		* glm::angleAxis(eulers.x, glm::vec3(1.0f, 0.0f, 0.0f))
+		* glm::angleAxis(eulers.z, glm::vec3(0.0f, 0.0f, 1.0f));
+	SetLocalRotation(joint, rotation);
+}
+
+void MocapSkeleton::SetLocalRotation(size_t joint, const glm::quat& rotation)
+{
+	_localRotations[_sortedIndex[joint]] = rotation;
+}
+
+void MocapSkeleton::SetFromPose(const MocapPoseSoA& pose)
+{
+	size_t numJoints = _parents.size();
+	for (size_t i = 0; i < numJoints; i++) {
+		u32 joint = _joints[i];
+		u32 parent = _parents[i];
+		glm::vec3 position = joint == 0 ? glm::vec3(0.0f) : glm::vec3(pose.x[joint - 1], pose.y[joint - 1], pose.z[joint - 1]);
+		if (parent != SkeletonNoParent && _joints[parent] != 0) {
+			u32 parentPoint = _joints[parent] - 1;
+			position -= glm::vec3(pose.x[parentPoint], pose.y[parentPoint], pose.z[parentPoint]);
+		}
+		_localPositions[i] = position;
+		_localRotations[i] = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	}
+	UpdateWorldTransforms();
+}
+
+void MocapSkeleton::UpdateWorldTransforms()
+{
+	size_t numJoints = _parents.size();
+	for (size_t i = 0; i < numJoints; i++) {
+		u32 parent = _parents[i];
+		if (parent == SkeletonNoParent) {
+			_worldPositions[i] = _localPositions[i];
+			_worldRotations[i] = _localRotations[i];
+		}
+		else {
+			_worldPositions[i] = _worldPositions[parent] + _worldRotations[parent] * _localPositions[i];
+			_worldRotations[i] = _worldRotations[parent] * _localRotations[i];
+		}
+	}
+}
+
+glm::mat4 MocapSkeleton::GetWorldTransform(size_t joint) const
+{
+	size_t i = _sortedIndex[joint];
+	return glm::translate(glm::mat4(1.0f), _worldPositions[i]) * glm::toMat4(_worldRotations[i]);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <stddef.h>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include "BasicTypedefs.h"
+
+struct MocapPoseSoA;
+
+typedef std::vector < std::pair<size_t, std::vector<size_t>>> SkeletonConnectivity; // parent, vector of children
+
+#define SkeletonNoParent 0xFFFFFFFF
+
+/// <summary>
+/// a hierarchy of joints held flat. joints are stored sorted so every parent comes before its children,
+/// with each joint's parent as an index, and local and world positions and rotations each in their own
+/// contiguous array, so solving the world transforms is one pass from the first joint to the last.
+/// joints are numbered as in the connectivity it's built from, joint 0 the root and joint i point i - 1
+/// </summary>
+class MocapSkeleton
+{
+public:
+	/// <summary>
+	/// lay out numJoints joints from connectivity, joints it doesn't give a parent are roots.
+	/// false, leaving the skeleton empty, if a joint is out of range, has two parents or is its own ancestor.
+	/// the only call that allocates
+	/// </summary>
+	bool Build(const SkeletonConnectivity& connectivity, size_t numJoints);
+	inline size_t GetNumJoints() const {
+		return _parents.size();
+	}
+	// SkeletonNoParent for roots
+	inline u32 GetParent(size_t joint) const {
+		u32 parent = _parents[_sortedIndex[joint]];
+		return parent == SkeletonNoParent ? parent : _joints[parent];
+	}
+	void SetLocalPosition(size_t joint, const glm::vec3& position);
+	void SetLocalEulers(size_t joint, const glm::vec3& eulers);
+	void SetLocalRotation(size_t joint, const glm::quat& rotation);
+	/// <summary>
+	/// put every joint where pose has its point, each as an offset from its parent with no rotation.
+	/// the root sits at the origin
+	/// </summary>
+	void SetFromPose(const MocapPoseSoA& pose);
+	// world from local for every joint, parents first
+	void UpdateWorldTransforms();
+	inline const glm::vec3& GetWorldPosition(size_t joint) const {
+		return _worldPositions[_sortedIndex[joint]];
+	}
+	inline const glm::quat& GetWorldRotation(size_t joint) const {
+		return _worldRotations[_sortedIndex[joint]];
+	}
+	glm::mat4 GetWorldTransform(size_t joint) const;
+private:
+	// all indexed by position in the sorted order
+	std::vector<u32> _parents;
+	std::vector<u32> _joints;      // the joint number at each position
+	std::vector<glm::vec3> _localPositions;
+	std::vector<glm::quat> _localRotations;
+	std::vector<glm::vec3> _worldPositions;
+	std::vector<glm::quat> _worldRotations;
+	std::vector<u32> _sortedIndex; // by joint number, its position in the sorted order
+};
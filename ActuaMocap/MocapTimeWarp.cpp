@@ -0,0 +1,355 @@
+#include "MocapTimeWarp.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include "MocapClipSoA.h"
+#include "ThreadPool.h"
+#include "ByteSwap.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MOCAP_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define MOCAP_TARGET_AVX
+#else
+#define MOCAP_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+#define TimeWarpRows (PlayerPoints * 3)
+#define TimeWarpPadding 8 // frames past the end of each row, so a whole AVX register can be read from the last frame
+#define TimeWarpUnreachable FLT_MAX
+
+static_assert(TimeWarpRows % 2 == 0, "the kernels take rows two at a time");
+
+static const float TimeWarpInvPoints = 1.0f / PlayerPoints;
+
+// out[l] = distance between frame l of a and frame l of b, with a and b already offset to the first cell
+static void DiagonalCostsScalar(const float* a, size_t strideA, const float* b, size_t strideB, size_t count, float* out)
+{
+	for (size_t l = 0; l < count; l++) {
+		out[l] = 0.0f;
+	}
+	for (size_t r = 0; r < TimeWarpRows; r++) {
+		const float* rowA = a + r * strideA;
+		const float* rowB = b + r * strideB;
+		for (size_t l = 0; l < count; l++) {
+			float diff = rowA[l] - rowB[l];
+			out[l] += diff * diff;
+		}
+	}
+	for (size_t l = 0; l < count; l++) {
+		out[l] = sqrtf(out[l] * TimeWarpInvPoints);
+	}
+}
+
+// cur[l] = costs[l] + the cheapest of the cell above, the cell to the left and the cell diagonally before
+static void DiagonalStepScalar(const float* costs, const float* prev1, const float* prev2, size_t count, float* cur)
+{
+	for (size_t l = 0; l < count; l++) {
+		cur[l] = costs[l] + std::min(std::min(prev1[l], prev1[l + 1]), prev2[l]);
+	}
+}
+
+#ifdef MOCAP_X86
+
+// these write whole registers to out, which must have room for count rounded up to TimeWarpPadding
+static void DiagonalCostsSSE2(const float* a, size_t strideA, const float* b, size_t strideB, size_t count, float* out)
+{
+	__m128 scale = _mm_set1_ps(TimeWarpInvPoints);
+	for (size_t l = 0; l < count; l += 4) {
+		__m128 sum0 = _mm_setzero_ps();
+		__m128 sum1 = _mm_setzero_ps();
+		for (size_t r = 0; r < TimeWarpRows; r += 2) {
+			__m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + r * strideA + l), _mm_loadu_ps(b + r * strideB + l));
+			__m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + (r + 1) * strideA + l), _mm_loadu_ps(b + (r + 1) * strideB + l));
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(d0, d0));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(d1, d1));
+		}
+		_mm_storeu_ps(out + l, _mm_sqrt_ps(_mm_mul_ps(_mm_add_ps(sum0, sum1), scale)));
+	}
+}
+
+MOCAP_TARGET_AVX static void DiagonalCostsAVX(const float* a, size_t strideA, const float* b, size_t strideB, size_t count, float* out)
+{
+	__m256 scale = _mm256_set1_ps(TimeWarpInvPoints);
+	for (size_t l = 0; l < count; l += 8) {
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		for (size_t r = 0; r < TimeWarpRows; r += 2) {
+			__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + r * strideA + l), _mm256_loadu_ps(b + r * strideB + l));
+			__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + (r + 1) * strideA + l), _mm256_loadu_ps(b + (r + 1) * strideB + l));
+			sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(d0, d0));
+			sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(d1, d1));
+		}
+		_mm256_storeu_ps(out + l, _mm256_sqrt_ps(_mm256_mul_ps(_mm256_add_ps(sum0, sum1), scale)));
+	}
+}
+
+static void DiagonalStepSSE2(const float* costs, const float* prev1, const float* prev2, size_t count, float* cur)
+{
+	size_t l = 0;
+	for (; l + 4 <= count; l += 4) {
+		__m128 best = _mm_min_ps(_mm_min_ps(_mm_loadu_ps(prev1 + l), _mm_loadu_ps(prev1 + l + 1)), _mm_loadu_ps(prev2 + l));
+		_mm_storeu_ps(cur + l, _mm_add_ps(_mm_loadu_ps(costs + l), best));
+	}
+	DiagonalStepScalar(costs + l, prev1 + l, prev2 + l, count - l, cur + l);
+}
+
+MOCAP_TARGET_AVX static void DiagonalStepAVX(const float* costs, const float* prev1, const float* prev2, size_t count, float* cur)
+{
+	size_t l = 0;
+	for (; l + 8 <= count; l += 8) {
+		__m256 best = _mm256_min_ps(_mm256_min_ps(_mm256_loadu_ps(prev1 + l), _mm256_loadu_ps(prev1 + l + 1)), _mm256_loadu_ps(prev2 + l));
+		_mm256_storeu_ps(cur + l, _mm256_add_ps(_mm256_loadu_ps(costs + l), best));
+	}
+	DiagonalStepScalar(costs + l, prev1 + l, prev2 + l, count - l, cur + l);
+}
+
+#else
+
+static void DiagonalCostsSSE2(const float* a, size_t strideA, const float* b, size_t strideB, size_t count, float* out)
+{
+	DiagonalCostsScalar(a, strideA, b, strideB, count, out);
+}
+
+static void DiagonalCostsAVX(const float* a, size_t strideA, const float* b, size_t strideB, size_t count, float* out)
+{
+	DiagonalCostsScalar(a, strideA, b, strideB, count, out);
+}
+
+static void DiagonalStepSSE2(const float* costs, const float* prev1, const float* prev2, size_t count, float* cur)
+{
+	DiagonalStepScalar(costs, prev1, prev2, count, cur);
+}
+
+static void DiagonalStepAVX(const float* costs, const float* prev1, const float* prev2, size_t count, float* cur)
+{
+	DiagonalStepScalar(costs, prev1, prev2, count, cur);
+}
+
+#endif
+
+static i64 FloorDiv(i64 a, i64 b)
+{
+	i64 q = a / b;
+	return (a % b != 0 && a < 0) ? q - 1 : q;
+}
+
+static i64 CeilDiv(i64 a, i64 b)
+{
+	return -FloorDiv(-a, b);
+}
+
+void TimeWarpClip::Build(const MocapClipSoA& clip)
+{
+	_numFrames = clip.GetNumFrames();
+	_stride = _numFrames + TimeWarpPadding;
+	_rows.assign(TimeWarpRows * _stride, 0.0f);
+	_reversed.assign(TimeWarpRows * _stride, 0.0f);
+	for (size_t f = 0; f < _numFrames; f++) {
+		const MocapPoseSoA& pose = clip.GetPose(f);
+		float cx = 0.0f;
+		float cz = 0.0f;
+		int present = 0;
+		for (int p = 0; p < PlayerPoints; p++) {
+			if (!IsMissingPoint(glm::vec3(pose.x[p], pose.y[p], pose.z[p]))) {
+				cx += pose.x[p];
+				cz += pose.z[p];
+				present++;
+			}
+		}
+		if (present > 0) {
+			cx /= present;
+			cz /= present;
+		}
+		size_t back = _numFrames - 1 - f;
+		for (int p = 0; p < PlayerPoints; p++) {
+			if (IsMissingPoint(glm::vec3(pose.x[p], pose.y[p], pose.z[p]))) {
+				continue; // stays at the centre
+			}
+			float coords[3] = { pose.x[p] - cx, pose.y[p], pose.z[p] - cz };
+			for (int c = 0; c < 3; c++) {
+				size_t row = (c * PlayerPoints + p) * _stride;
+				_rows[row + f] = coords[c];
+				_reversed[row + back] = coords[c];
+			}
+		}
+	}
+}
+
+static float FrameDistance(const float* rowsA, size_t strideA, size_t i, const float* rowsB, size_t strideB, size_t j)
+{
+	float sum = 0.0f;
+	for (size_t r = 0; r < TimeWarpRows; r++) {
+		float diff = rowsA[r * strideA + i] - rowsB[r * strideB + j];
+		sum += diff * diff;
+	}
+	return sqrtf(sum * TimeWarpInvPoints);
+}
+
+/// <summary>
+/// walk back from the last cell to the first through whichever neighbour was cheapest, cell(i, j) giving the
+/// accumulated cost there, then fill in the deviation and cost from the path's distances
+/// </summary>
+template <typename CellFn>
+static void FinishAlignment(const float* rowsA, size_t strideA, size_t n, const float* rowsB, size_t strideB, size_t m,
+	CellFn cell, TimeWarpAlignment& out)
+{
+	out.path.clear();
+	i64 i = (i64)n - 1;
+	i64 j = (i64)m - 1;
+	float total = cell(i, j);
+	out.path.push_back(TimeWarpStep{ (u32)i, (u32)j });
+	while (i > 0 || j > 0) {
+		float diagonal = (i > 0 && j > 0) ? cell(i - 1, j - 1) : TimeWarpUnreachable;
+		float up = i > 0 ? cell(i - 1, j) : TimeWarpUnreachable;
+		float left = j > 0 ? cell(i, j - 1) : TimeWarpUnreachable;
+		// the diagonal wins ties so identical clips come out as a straight line
+		if (diagonal <= up && diagonal <= left) {
+			i--;
+			j--;
+		}
+		else if (up <= left) {
+			i--;
+		}
+		else {
+			j--;
+		}
+		out.path.push_back(TimeWarpStep{ (u32)i, (u32)j });
+	}
+	std::reverse(out.path.begin(), out.path.end());
+
+	out.deviation.assign(n, 0.0f);
+	std::vector<u32> matches(n, 0);
+	for (const TimeWarpStep& step : out.path) {
+		out.deviation[step.a] += FrameDistance(rowsA, strideA, step.a, rowsB, strideB, step.b);
+		matches[step.a]++;
+	}
+	for (size_t f = 0; f < n; f++) {
+		out.deviation[f] /= matches[f]; // every frame is on the path at least once
+	}
+	out.cost = total / out.path.size();
+}
+
+static void Unaligned(TimeWarpAlignment& out)
+{
+	out.path.clear();
+	out.deviation.clear();
+	out.cost = TimeWarpUnreachable;
+}
+
+bool TimeWarpAligner::Align(const TimeWarpClip& a, const TimeWarpClip& b, size_t band, TimeWarpAlignment& out)
+{
+	i64 n = (i64)a._numFrames;
+	i64 m = (i64)b._numFrames;
+	if (n == 0 || m == 0) {
+		Unaligned(out);
+		return false;
+	}
+	// cell (i, j) is in the band if it's within band frames of the line from (0, 0) to (n - 1, m - 1),
+	// measured along the longer clip, which with d = i (m - 1) - j (n - 1) is |d| <= band * the shorter length.
+	// along anti-diagonal k, where j = k - i, that's a single run of i, kept at least one cell long so every
+	// cell has a neighbour in the band on the anti-diagonal before it. any wider than both clips and every cell is in
+	i64 span = n + m - 2;
+	i64 radius = (i64)std::min<size_t>(std::max<size_t>(band, 1), (size_t)(n + m)) * std::min(n - 1, m - 1);
+	radius = std::max(radius, (span + 1) / 2);
+	i64 numDiagonals = n + m - 1;
+
+	// buffers are indexed by i + 1 so i = -1 can be read. anti-diagonal -2 holds the one free cell before (0, 0)
+	for (int d = 0; d < 3; d++) {
+		_diagonals[d].assign(n + 2, TimeWarpUnreachable);
+	}
+	_diagonals[1][0] = 0.0f;
+	_costs.resize(n + TimeWarpPadding);
+	_stored.clear();
+	_storedOffset.resize(numDiagonals);
+	_storedLo.resize(numDiagonals);
+	_storedHi.resize(numDiagonals);
+
+	bool avx = CpuSupportsAVX2();
+	for (i64 k = 0; k < numDiagonals; k++) {
+		i64 lo = std::max<i64>(0, k - (m - 1));
+		i64 hi = std::min<i64>(n - 1, k);
+		if (span > 0) {
+			lo = std::max(lo, CeilDiv(k * (n - 1) - radius, span));
+			hi = std::min(hi, FloorDiv(k * (n - 1) + radius, span));
+		}
+		size_t count = (size_t)(hi - lo + 1);
+		// frame k - i of b is frame m - 1 - k + i of b reversed, so both run forwards with i
+		const float* rowsA = a._rows.data() + lo;
+		const float* rowsB = b._reversed.data() + (m - 1 - k + lo);
+		float* cur = _diagonals[k % 3].data();
+		const float* prev1 = _diagonals[(k + 2) % 3].data();
+		const float* prev2 = _diagonals[(k + 1) % 3].data();
+		if (avx) {
+			DiagonalCostsAVX(rowsA, a._stride, rowsB, b._stride, count, _costs.data());
+			DiagonalStepAVX(_costs.data(), prev1 + lo, prev2 + lo, count, cur + lo + 1);
+		}
+		else {
+			DiagonalCostsSSE2(rowsA, a._stride, rowsB, b._stride, count, _costs.data());
+			DiagonalStepSSE2(_costs.data(), prev1 + lo, prev2 + lo, count, cur + lo + 1);
+		}
+		// the next two anti-diagonals read at most one cell either side of this one's run,
+		// anything further out in this buffer is left over from three anti-diagonals ago
+		cur[lo] = TimeWarpUnreachable;
+		cur[hi + 2] = TimeWarpUnreachable;
+		_storedOffset[k] = _stored.size();
+		_storedLo[k] = lo;
+		_storedHi[k] = hi;
+		_stored.insert(_stored.end(), cur + lo + 1, cur + hi + 2);
+	}
+
+	FinishAlignment(a._rows.data(), a._stride, (size_t)n, b._rows.data(), b._stride, (size_t)m,
+		[this](i64 i, i64 j) { return Stored(i + j, i); }, out);
+	return true;
+}
+
+float TimeWarpAligner::Stored(i64 diagonal, i64 i) const
+{
+	if (i < _storedLo[diagonal] || i > _storedHi[diagonal]) {
+		return TimeWarpUnreachable;
+	}
+	return _stored[_storedOffset[diagonal] + (size_t)(i - _storedLo[diagonal])];
+}
+
+bool TimeWarpAligner::AlignNaive(const TimeWarpClip& a, const TimeWarpClip& b, TimeWarpAlignment& out)
+{
+	size_t n = a._numFrames;
+	size_t m = b._numFrames;
+	if (n == 0 || m == 0) {
+		Unaligned(out);
+		return false;
+	}
+	std::vector<float> accumulated(n * m);
+	for (size_t i = 0; i < n; i++) {
+		for (size_t j = 0; j < m; j++) {
+			float best = 0.0f;
+			if (i > 0 || j > 0) {
+				best = TimeWarpUnreachable;
+				if (i > 0) {
+					best = std::min(best, accumulated[(i - 1) * m + j]);
+				}
+				if (j > 0) {
+					best = std::min(best, accumulated[i * m + j - 1]);
+				}
+				if (i > 0 && j > 0) {
+					best = std::min(best, accumulated[(i - 1) * m + j - 1]);
+				}
+			}
+			accumulated[i * m + j] = FrameDistance(a._rows.data(), a._stride, i, b._rows.data(), b._stride, j) + best;
+		}
+	}
+	FinishAlignment(a._rows.data(), a._stride, n, b._rows.data(), b._stride, m,
+		[&](i64 i, i64 j) { return accumulated[(size_t)i * m + (size_t)j]; }, out);
+	return true;
+}
+
+void AlignAgainstClips(const TimeWarpClip& a, const std::vector<const TimeWarpClip*>& others, size_t band, std::vector<TimeWarpAlignment>& out)
+{
+	out.resize(others.size());
+	GetThreadPool().ParallelFor(others.size(), [&](size_t i) {
+		TimeWarpAligner aligner;
+		aligner.Align(a, *others[i], band, out[i]);
+	});
+}
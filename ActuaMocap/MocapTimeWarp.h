@@ -0,0 +1,73 @@
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include "BasicTypedefs.h"
+
+class MocapClipSoA;
+
+#define TimeWarpDefaultBand 8 // frames either side of the straight line from first frames to last frames
+
+/// <summary>
+/// a clip's frames moved so each is centred on the origin across the ground, with missing points at the
+/// centre, and transposed so one coordinate of every frame is contiguous, forwards and backwards.
+/// that way the frames along an anti-diagonal of the cost matrix line up with each other in memory
+/// </summary>
+class TimeWarpClip
+{
+public:
+	void Build(const MocapClipSoA& clip);
+	inline size_t GetNumFrames() const {
+		return _numFrames;
+	}
+private:
+	friend class TimeWarpAligner;
+	std::vector<float> _rows;     // PlayerPoints * 3 rows of _stride floats
+	std::vector<float> _reversed; // the same with the frames in reverse order
+	size_t _numFrames = 0;
+	size_t _stride = 0;           // _numFrames rounded up with padding to read past the end into
+};
+
+struct TimeWarpStep {
+	u32 a; // frame in the first clip
+	u32 b; // frame in the second
+};
+
+struct TimeWarpAlignment {
+	std::vector<TimeWarpStep> path;  // from both first frames to both last frames, one clip or both advancing each step
+	std::vector<float> deviation;    // per frame of the first clip, mean distance to the frames it's matched with
+	float cost = 0.0f;               // mean distance along the path
+};
+
+/// <summary>
+/// dynamic time warping between clips, with distances the root mean square per point.
+/// only cells within band frames of the straight line between the corners are filled (a Sakoe-Chiba band,
+/// widened where the clips' lengths are so different a path couldn't get through it otherwise),
+/// one anti-diagonal at a time so both the pose distances and the recurrence run across SIMD lanes.
+/// keeps its working buffers between calls, so use one per thread
+/// </summary>
+class TimeWarpAligner
+{
+public:
+	/// <summary>
+	/// band is at least 1, SIZE_MAX fills every cell. returns false, with an empty path and a cost of FLT_MAX, if either clip has no frames
+	/// </summary>
+	bool Align(const TimeWarpClip& a, const TimeWarpClip& b, size_t band, TimeWarpAlignment& out);
+	/// <summary>
+	/// the whole cost matrix a cell at a time with no band, for checking and timing Align
+	/// </summary>
+	static bool AlignNaive(const TimeWarpClip& a, const TimeWarpClip& b, TimeWarpAlignment& out);
+private:
+	float Stored(i64 diagonal, i64 i) const;
+private:
+	std::vector<float> _diagonals[3]; // the last three anti-diagonals, indexed by frame of a plus one
+	std::vector<float> _costs;
+	std::vector<float> _stored;       // every anti-diagonal's cells within the band, for the backtrack
+	std::vector<size_t> _storedOffset;
+	std::vector<i64> _storedLo, _storedHi;
+};
+
+/// <summary>
+/// align a against each of others, spread over the thread pool a clip at a time.
+/// out[i] is for others[i]
+/// </summary>
+void AlignAgainstClips(const TimeWarpClip& a, const std::vector<const TimeWarpClip*>& others, size_t band, std::vector<TimeWarpAlignment>& out);
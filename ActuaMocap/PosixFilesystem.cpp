@@ -0,0 +1,368 @@
+#ifndef _WIN32
+#include "PosixFilesystem.h"
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/inotify.h>
+#include "ThreadPool.h"
+#include "FileReads.h"
+#include "IoUring.h"
+
+// glibc doesn't wrap getdents64 on older versions, so it's called directly
+struct LinuxDirent64 {
+	u64 d_ino;
+	i64 d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[1];
+};
+
+#define DirentBufferSize (64 * 1024)
+
+static void FillStat(const struct stat& st, FileStat& out)
+{
+	out.size = (u64)st.st_size;
+	out.modifiedTime = (i64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+/// <summary>
+/// append the names in dirPath to out, prefixed with prefix. stats are filled in later,
+/// except for entries whose type the filesystem didn't report, which are stat'd here to tell directories apart
+/// </summary>
+static bool ReadDirectory(const std::string& dirPath, const std::string& prefix, std::vector<DirectoryEntry>& out)
+{
+	int fd = openat(AT_FDCWD, dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	std::vector<char> buffer(DirentBufferSize);
+	while (true) {
+		long bytes = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+		if (bytes <= 0) {
+			break;
+		}
+		for (long offset = 0; offset < bytes;) {
+			const LinuxDirent64* dirent = (const LinuxDirent64*)(buffer.data() + offset);
+			offset += dirent->d_reclen;
+			if (strcmp(dirent->d_name, ".") == 0 || strcmp(dirent->d_name, "..") == 0) {
+				continue;
+			}
+			DirectoryEntry entry;
+			entry.name = prefix + dirent->d_name;
+			if (dirent->d_type == DT_UNKNOWN) {
+				struct stat st;
+				entry.isDirectory = fstatat(fd, dirent->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+			}
+			else {
+				entry.isDirectory = dirent->d_type == DT_DIR;
+			}
+			out.push_back(entry);
+		}
+	}
+	close(fd);
+	return true;
+}
+
+std::vector<std::string> PosixFilesystem::ListFilesInDirectory(std::string dir) const
+{
+	std::vector<DirectoryEntry> entries;
+	ReadDirectory(dir, "", entries);
+	std::vector<std::string> names;
+	names.reserve(entries.size());
+	for (auto& entry : entries) {
+		names.push_back(std::move(entry.name));
+	}
+	return names;
+}
+
+u32 PosixFilesystem::GetMaxFilepathLength() const
+{
+	return PATH_MAX;
+}
+
+bool PosixFilesystem::GetFileStat(const std::string& path, FileStat& out) const
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		return false;
+	}
+	FillStat(st, out);
+	return true;
+}
+
+bool PosixFilesystem::MoveFileReplacing(const std::string& from, const std::string& to) const
+{
+	return rename(from.c_str(), to.c_str()) == 0;
+}
+
+std::vector<DirectoryEntry> PosixFilesystem::ListDirectoryEntries(const std::string& dir, bool recursive) const
+{
+	ThreadPool& pool = GetIoThreadPool();
+	std::vector<DirectoryEntry> entries;
+
+	// breadth first, reading every directory of a level at once
+	std::vector<std::string> level = { "" };
+	while (!level.empty()) {
+		std::vector<std::vector<DirectoryEntry>> found(level.size());
+		pool.ParallelFor(level.size(), [&](size_t i) {
+			std::string prefix = level[i].empty() ? "" : level[i] + PathSeparator;
+			ReadDirectory(JoinPath(dir, level[i]), prefix, found[i]);
+		});
+		std::vector<std::string> nextLevel;
+		for (auto& directoryEntries : found) {
+			for (auto& entry : directoryEntries) {
+				if (recursive && entry.isDirectory) {
+					nextLevel.push_back(entry.name);
+				}
+				entries.push_back(std::move(entry));
+			}
+		}
+		level = std::move(nextLevel);
+	}
+
+	// getdents doesn't give sizes or times, and stat is one round trip per file on a network mount,
+	// so these are spread over the pool too
+	pool.ParallelFor(entries.size(), [&](size_t i) {
+		struct stat st;
+		if (fstatat(AT_FDCWD, JoinPath(dir, entries[i].name).c_str(), &st, 0) == 0) {
+			FillStat(st, entries[i].stat);
+		}
+	}, 64);
+	return entries;
+}
+
+class InotifyWatch
+: public IDirectoryWatch {
+public:
+	InotifyWatch(int fd)
+		:_fd(fd)
+	{
+	}
+	~InotifyWatch()
+	{
+		close(_fd);
+	}
+	virtual void Poll(std::vector<FileChange>& out) override
+	{
+		alignas(struct inotify_event) char buffer[16 * 1024];
+		while (true) {
+			ssize_t bytes = read(_fd, buffer, sizeof(buffer));
+			if (bytes <= 0) {
+				return; // EAGAIN, nothing more queued
+			}
+			for (ssize_t offset = 0; offset < bytes;) {
+				const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+				offset += sizeof(struct inotify_event) + event->len;
+				if (event->mask & IN_Q_OVERFLOW) {
+					out.push_back({ FileChangeType::Overflow, "" });
+					continue;
+				}
+				if (event->len == 0) {
+					continue;
+				}
+				// created files are reported once they're closed, so nobody reads a half written capture
+				if (event->mask & IN_MOVED_TO) {
+					out.push_back({ FileChangeType::Added, event->name });
+				}
+				else if (event->mask & IN_CLOSE_WRITE) {
+					out.push_back({ FileChangeType::Modified, event->name });
+				}
+				else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+					out.push_back({ FileChangeType::Removed, event->name });
+				}
+			}
+		}
+	}
+private:
+	int _fd;
+};
+
+std::unique_ptr<IDirectoryWatch> PosixFilesystem::WatchDirectory(const std::string& dir) const
+{
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		return nullptr;
+	}
+	if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+		std::cout << "couldn't watch " << dir << "\n";
+		close(fd);
+		return nullptr;
+	}
+	return std::unique_ptr<IDirectoryWatch>(new InotifyWatch(fd));
+}
+
+#ifdef __linux__
+
+#define ReadQueueDepth 64
+#define MaxReadChunk (1u << 30) // io_uring reads take a 32 bit length
+
+struct PendingRead {
+	int fd = -1;
+	size_t done = 0;
+	bool complete = false;
+};
+
+static bool QueueNextChunk(IoUring& ring, FileRead& read, PendingRead& pending, size_t index)
+{
+	size_t remaining = read.data.size() - pending.done;
+	u32 chunk = remaining > MaxReadChunk ? MaxReadChunk : (u32)remaining;
+	return ring.QueueRead(pending.fd, read.data.data() + pending.done, chunk, read.offset + pending.done, index);
+}
+
+/// <summary>
+/// keep up to the ring's depth of reads in flight, opening each file as a slot frees up.
+/// completions are handled on this thread. anything the ring couldn't finish is read again on the thread pool,
+/// so every read still gets its onComplete
+/// </summary>
+static void ReadFilesWithRing(IoUring& ring, std::vector<FileRead>& reads, const FileReadCallback& onComplete)
+{
+	std::vector<PendingRead> pending(reads.size());
+	size_t next = 0;
+	size_t settled = 0; // finished here, or left for the thread pool
+	size_t inFlight = 0;
+	auto closeFile = [&](size_t i) {
+		if (pending[i].fd >= 0) {
+			close(pending[i].fd);
+			pending[i].fd = -1;
+		}
+	};
+	auto finish = [&](size_t i, bool ok) {
+		closeFile(i);
+		reads[i].ok = ok;
+		pending[i].complete = true;
+		settled++;
+		if (onComplete) {
+			onComplete(i);
+		}
+	};
+	auto queueOrGiveUp = [&](size_t i) {
+		if (QueueNextChunk(ring, reads[i], pending[i], i)) {
+			return true;
+		}
+		closeFile(i);
+		settled++;
+		return false;
+	};
+
+	bool ringFailed = false;
+	while (settled < reads.size()) {
+		while (inFlight < ring.GetQueueDepth() && next < reads.size()) {
+			size_t i = next++;
+			FileRead& read = reads[i];
+			int fd = open(read.path.c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat st;
+			if (fd < 0 || fstat(fd, &st) != 0) {
+				if (fd >= 0) {
+					close(fd);
+				}
+				finish(i, false);
+				continue;
+			}
+			pending[i].fd = fd;
+			u64 available = read.offset < (u64)st.st_size ? (u64)st.st_size - read.offset : 0;
+			read.data.resize(read.length == ReadToEndOfFile || read.length > available ? (size_t)available : read.length);
+			if (read.data.empty()) {
+				finish(i, true);
+				continue;
+			}
+			if (queueOrGiveUp(i)) {
+				inFlight++;
+			}
+		}
+		if (inFlight == 0) {
+			continue;
+		}
+		if (!ring.SubmitAndWait(1)) {
+			ringFailed = true;
+			break;
+		}
+		u64 userData;
+		i32 result;
+		while (ring.PopCompletion(userData, result)) {
+			size_t i = (size_t)userData;
+			FileRead& read = reads[i];
+			if (result == -EAGAIN || result == -EINTR) {
+				if (!queueOrGiveUp(i)) {
+					inFlight--;
+				}
+				continue;
+			}
+			if (result < 0) {
+				inFlight--;
+				finish(i, false);
+				continue;
+			}
+			pending[i].done += (size_t)result;
+			if (result > 0 && pending[i].done < read.data.size()) {
+				// short read, or a file over MaxReadChunk - carry on from where it stopped
+				if (!queueOrGiveUp(i)) {
+					inFlight--;
+				}
+				continue;
+			}
+			// a zero length read means the file shrank since it was stat'd
+			read.data.resize(pending[i].done);
+			inFlight--;
+			finish(i, true);
+		}
+	}
+
+	bool drained = true;
+	if (ringFailed) {
+		std::cout << "io_uring failed part way through a batch of reads, reading the rest on the thread pool\n";
+		// the kernel may still be writing into buffers, it has to be done with them before they're reused or freed
+		drained = ring.Drain();
+	}
+	std::vector<size_t> unfinished;
+	for (size_t i = 0; i < reads.size(); i++) {
+		closeFile(i);
+		if (!pending[i].complete) {
+			unfinished.push_back(i);
+		}
+	}
+	if (unfinished.empty()) {
+		return;
+	}
+	std::vector<FileRead> retries(unfinished.size());
+	for (size_t j = 0; j < unfinished.size(); j++) {
+		FileRead& read = reads[unfinished[j]];
+		if (!drained) {
+			// leaked on purpose, a late write into it is harmless where one into reused memory isn't
+			new std::vector<u8>(std::move(read.data));
+		}
+		retries[j].path = read.path;
+		retries[j].offset = read.offset;
+		retries[j].length = read.length;
+	}
+	ReadFilesOnThreadPool(retries, [&](size_t j) {
+		size_t i = unfinished[j];
+		reads[i] = std::move(retries[j]);
+		if (onComplete) {
+			onComplete(i);
+		}
+	});
+}
+
+#endif
+
+void PosixFilesystem::ReadFiles(std::vector<FileRead>& reads, const FileReadCallback& onComplete) const
+{
+#ifdef __linux__
+	// a ring per call keeps this safe to call from several threads, setting one up is a few microseconds
+	IoUring ring;
+	if (ring.Init(ReadQueueDepth)) {
+		ReadFilesWithRing(ring, reads, onComplete);
+		return;
+	}
+#endif
+	ReadFilesOnThreadPool(reads, onComplete);
+}
+
+#endif
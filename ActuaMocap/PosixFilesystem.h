@@ -0,0 +1,21 @@
+#pragma once
+#include "IFilesystem.h"
+#include "BasicTypedefs.h"
+#include <vector>
+
+/// <summary>
+/// linux backend. directories are read with getdents64 in large batches and stat'd in parallel,
+/// which matters most on network mounted capture directories where every call is a round trip.
+/// changes are watched with inotify, and batches of reads go through io_uring where the kernel allows it
+/// </summary>
+class PosixFilesystem
+: public IFilesystem {
+public:
+	virtual std::vector<std::string> ListFilesInDirectory(std::string dir) const override;
+	virtual u32 GetMaxFilepathLength() const override;
+	virtual bool GetFileStat(const std::string& path, FileStat& out) const override;
+	virtual bool MoveFileReplacing(const std::string& from, const std::string& to) const override;
+	virtual std::vector<DirectoryEntry> ListDirectoryEntries(const std::string& dir, bool recursive = false) const override;
+	virtual std::unique_ptr<IDirectoryWatch> WatchDirectory(const std::string& dir) const override;
+	virtual void ReadFiles(std::vector<FileRead>& reads, const FileReadCallback& onComplete = FileReadCallback()) const override;
+};
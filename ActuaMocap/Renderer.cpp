@@ -5,7 +5,9 @@
 #include <glm/ext/matrix_transform.hpp>
 #include "Camera.h"
 #include <string.h>
+#include <stddef.h>
 #include "MocapFrame.h"
+#include "SphereInstance.h"
 
 #define DRAW_DISTANCE 10000.0f
 #define NUM_CHANNELS 4
@@ -67,6 +69,62 @@ std::string colourFragGlsl =
 
 #pragma endregion
 
+#pragma region instanced colour shader
+
+std::string instancedColourVertGlsl =
+"#version 330 core\n"
+"layout(location = 0) in vec3 aPos;\n"
+"layout(location = 1) in vec3 aNormal;\n"
+"layout(location = 2) in vec4 aPositionRadius;\n" // per instance
+"layout(location = 3) in vec4 aColour;\n" // per instance
+
+"out vec3 FragPos;\n"
+"out vec3 Normal;\n"
+"out vec4 ObjectColor;\n"
+
+"uniform mat4 view;\n"
+"uniform mat4 projection;\n"
+
+"void main()\n"
+"{\n"
+"    FragPos = aPositionRadius.xyz + aPos * aPositionRadius.w;\n"
+"    Normal = aNormal;\n"
+"    ObjectColor = aColour;\n"
+"    gl_Position = projection * view * vec4(FragPos, 1.0);\n"
+"}\n";
+
+std::string instancedColourFragGlsl =
+"#version 330 core\n"
+"out vec4 FragColor;\n"
+
+"in vec3 Normal;\n"
+"in vec3 FragPos;\n"
+"in vec4 ObjectColor;\n"
+
+"uniform vec3 lightPos;\n"
+"uniform vec3 viewPos;\n"
+"uniform vec3 lightColor;\n"
+
+"void main()\n"
+"{\n"
+"    float ambientStrength = 0.1;\n"
+"    vec3 ambient = ambientStrength * lightColor;\n"
+"    vec3 norm = normalize(Normal);\n"
+"    vec3 lightDir = normalize(lightPos - FragPos);\n"
+"    float diff = max(dot(norm, lightDir), 0.0);\n"
+"    vec3 diffuse = diff * lightColor;\n"
+"    float specularStrength = 0.5;\n"
+"    vec3 viewDir = normalize(viewPos - FragPos);\n"
+"    vec3 reflectDir = reflect(-lightDir, norm);\n"
+"    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);\n"
+"    vec3 specular = specularStrength * spec * lightColor;\n"
+
+"    vec3 result = (ambient + diffuse + specular) * ObjectColor.xyz;\n"
+"    FragColor = vec4(result, ObjectColor[3]);\n"
+"}\n";
+
+#pragma endregion
+
 #pragma region line shader
 
 std::string lineVertGlsl =
@@ -182,10 +240,12 @@ void Renderer::Initialize()
 
     InitializeSphereVertices();
     InitializeLineVertices();
+    InitializeInstancedSphereVertices();
 
     // load all shaders
     m_colouredShader.LoadFromString(colourVertGlsl, colourFragGlsl);
     m_lineShader.LoadFromString(lineVertGlsl, lineFragGlsl);
+    m_instancedColouredShader.LoadFromString(instancedColourVertGlsl, instancedColourFragGlsl);
     m_billboardShader.LoadFromString(billboardVertGlsl, billBoardFragGlsl);
 
     // load fonts
@@ -242,6 +302,51 @@ void Renderer::InitializeLineVertices()
     glEnableVertexAttribArray(0);
 }
 
+/// <summary>
+/// the low poly sphere, plus an empty per instance buffer that
+/// DrawSphereInstances grows as needed, and the buffer for DrawLineList
+/// </summary>
+void Renderer::InitializeInstancedSphereVertices()
+{
+    unsigned int VBO;
+    glGenVertexArrays(1, &m_instancedSphereVAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &m_instancedSphereEBO);
+    glGenBuffers(1, &m_sphereInstancesVBO);
+
+    glBindVertexArray(m_instancedSphereVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, m_instancedSphere.getInterleavedVertexSize(), m_instancedSphere.getInterleavedVertices(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_instancedSphereEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_instancedSphere.getIndexSize(), m_instancedSphere.getIndices(), GL_STATIC_DRAW);
+
+    // position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, m_instancedSphere.getInterleavedStride(), (void*)0);
+    glEnableVertexAttribArray(0);
+    // normal attribute
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, m_instancedSphere.getInterleavedStride(), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // per instance position + radius and colour
+    glBindBuffer(GL_ARRAY_BUFFER, m_sphereInstancesVBO);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void*)offsetof(SphereInstance, colour));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    glGenVertexArrays(1, &m_lineListVAO);
+    glGenBuffers(1, &m_lineListVBO);
+    glBindVertexArray(m_lineListVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_lineListVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+}
+
 void Renderer::SetLinesVertexBuffer(const MocapFrame& frame)
 {
     for (int i = 1; i < PlayerPoints; i++) {
@@ -310,6 +415,49 @@ void Renderer::DrawLines(const MocapFrame& frame, const Camera& cam, const glm::
     glDrawArrays(GL_LINES, 0, PlayerPoints * 2);
 }
 
+void Renderer::DrawSphereInstances(const SphereInstance* instances, size_t count, const Camera& camera)
+{
+    if (count == 0) {
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_sphereInstancesVBO);
+    if (count > m_sphereInstancesCapacity) {
+        m_sphereInstancesCapacity = count;
+    }
+    // orphan the old storage so the driver doesn't stall on last frame's draw still reading it
+    glBufferData(GL_ARRAY_BUFFER, m_sphereInstancesCapacity * sizeof(SphereInstance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(SphereInstance), instances);
+
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)m_scrWidth / (float)m_scrHeight, 0.1f, DRAW_DISTANCE);
+    m_instancedColouredShader.use();
+    m_instancedColouredShader.setMat4("view", camera.GetViewMatrix());
+    m_instancedColouredShader.setMat4("projection", projection);
+    m_instancedColouredShader.setVec3("viewPos", camera.Position);
+    m_instancedColouredShader.setVec3("lightPos", m_lightPos);
+    m_instancedColouredShader.setVec3("lightColor", m_lightColour);
+
+    glBindVertexArray(m_instancedSphereVAO);
+    glDrawElementsInstanced(GL_TRIANGLES, m_instancedSphere.getIndexCount(), GL_UNSIGNED_INT, 0, (GLsizei)count);
+}
+
+void Renderer::DrawLineList(const glm::vec3* points, size_t count, const Camera& camera, const glm::vec4& colour)
+{
+    if (count < 2) {
+        return;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_lineListVBO);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::vec3), points, GL_DYNAMIC_DRAW);
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)m_scrWidth / (float)m_scrHeight, 0.1f, DRAW_DISTANCE);
+
+    m_lineShader.use();
+    m_lineShader.setMat4("view", camera.GetViewMatrix());
+    m_lineShader.setMat4("projection", projection);
+    m_lineShader.setVec4("objectColor", colour);
+
+    glBindVertexArray(m_lineListVAO);
+    glDrawArrays(GL_LINES, 0, (GLsizei)count);
+}
+
 void Renderer::SetLightPos(const glm::vec3& value)
 {
     m_lightPos = value;
@@ -10,7 +10,7 @@
 #include FT_FREETYPE_H
 
 struct MocapFrame;
-class MocapNode;
+struct SphereInstance;
 class Camera;
 
 struct RendererInitialisationData {
@@ -28,6 +28,10 @@ public:
     void DrawMocapFrame(const MocapFrame& frame, const Camera& cam);
     void DrawSphere(const glm::vec3& centeredAt, const glm::vec3& dimensions, const Camera& camera, const glm::vec4& colour) const;
     void DrawTextBillboard(std::string text, const glm::vec3& textColour, const glm::vec3& woldPos, const float scale, const Camera& camera);
+    // every sphere in one instanced draw call, using a lower poly sphere than DrawSphere
+    void DrawSphereInstances(const SphereInstance* instances, size_t count, const Camera& camera);
+    // pairs of points, each pair one line
+    void DrawLineList(const glm::vec3* points, size_t count, const Camera& camera, const glm::vec4& colour);
 
     void SetLightPos(const glm::vec3& value);
     void SetLightColour(const glm::vec3& value);
@@ -38,6 +42,7 @@ private:
     void Initialize();
     void InitializeSphereVertices();
     void InitializeLineVertices();
+    void InitializeInstancedSphereVertices();
     void SetLinesVertexBuffer(const MocapFrame& frame);
     void InitFT();
 private:
@@ -57,11 +62,21 @@ private:
     unsigned int m_linesVAO;
     unsigned int m_linesVBO;
 
+    Sphere m_instancedSphere = Sphere(1.0f, 12, 8); // hundreds of players' worth are drawn at once, so keep it cheap
+    unsigned int m_instancedSphereVAO;
+    unsigned int m_instancedSphereEBO;
+    unsigned int m_sphereInstancesVBO;
+    size_t m_sphereInstancesCapacity = 0;
+
+    unsigned int m_lineListVAO;
+    unsigned int m_lineListVBO;
+
     unsigned int m_freeTypeVAO;
     unsigned int m_freeTypeVBO;
 
     Shader m_colouredShader;
     Shader m_lineShader;
+    Shader m_instancedColouredShader;
     Shader m_billboardShader;
 
     glm::vec3 m_lightPos;
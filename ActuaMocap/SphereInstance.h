@@ -0,0 +1,9 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// one sphere of an instanced draw, laid out to match the per instance attributes of Renderer::DrawSphereInstances
+struct SphereInstance {
+	glm::vec3 position;
+	float radius; // 0 hides the sphere
+	glm::vec4 colour;
+};
@@ -1,6 +1,7 @@
 #include "TextFileResourceListParser.h"
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 void ParseResourcesTextFile(std::string filePath, ParseResourcesTextFileCallback callback)
 {
@@ -10,23 +11,20 @@ void ParseResourcesTextFile(std::string filePath, ParseResourcesTextFileCallback
     int onLine = 0;
     while (getline(spritesFile, line)) {
         onLine++;
-        const auto lineBufferSize = 300;
-        char lineCopy[lineBufferSize];
-        strcpy_s(lineCopy, line.c_str());
-        rsize_t strMax = line.length();
-        char* next_token;
-        char* ptr = strtok_s(lineCopy, " ", &next_token);
+        // stringstream rather than strtok_s so this builds everywhere, and it also drops the \r
+        // left on lines of a windows config read on linux
+        istringstream tokens(line);
+        string token;
         std::string pathAndIdentifierName[2];
         int numOnThisLine = 0;
         bool errored = false;
-        while (ptr != NULL) {
-            pathAndIdentifierName[numOnThisLine] = string(ptr);
-            if (++numOnThisLine > 2) {
+        while (tokens >> token) {
+            if (numOnThisLine == 2) {
                 std::cerr << "more than two space separated entries on line " << onLine << '\n';
                 errored = true;
                 break;
             }
-            ptr = strtok_s(NULL, " ", &next_token);
+            pathAndIdentifierName[numOnThisLine++] = token;
         }
         if (numOnThisLine < 2) {
             std::cerr << "less than two space separated entries on line " << onLine << '\n';
@@ -0,0 +1,101 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t numThreads)
+	:_nextIndex(0)
+{
+	if (numThreads == 0) {
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (size_t i = 0; i + 1 < numThreads; i++) {
+		_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+	for (auto& worker : _workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::RunJob()
+{
+	while (true) {
+		size_t begin = _nextIndex.fetch_add(_jobGrain);
+		if (begin >= _jobCount) {
+			return;
+		}
+		size_t end = std::min(_jobCount, begin + _jobGrain);
+		for (size_t i = begin; i < end; i++) {
+			(*_job)(i);
+		}
+	}
+}
+
+void ThreadPool::WorkerLoop()
+{
+	size_t seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (true) {
+		_wake.wait(lock, [&]() { return _quit || _generation != seenGeneration; });
+		if (_quit) {
+			return;
+		}
+		seenGeneration = _generation;
+		_busyWorkers++;
+		lock.unlock();
+		RunJob();
+		lock.lock();
+		if (--_busyWorkers == 0) {
+			_done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn, size_t grainSize)
+{
+	if (count == 0) {
+		return;
+	}
+	std::lock_guard<std::mutex> submitLock(_submitMutex);
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		// a worker that slept through the last job may still be draining it
+		_done.wait(lock, [&]() { return _busyWorkers == 0; });
+		_job = &fn;
+		_jobCount = count;
+		_jobGrain = std::max<size_t>(1, grainSize);
+		_nextIndex = 0;
+		_generation++;
+	}
+	_wake.notify_all();
+	RunJob();
+	// workers that woke late find nothing left to claim, wait for any still mid-item
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done.wait(lock, [&]() { return _busyWorkers == 0; });
+	_job = nullptr;
+}
+
+ThreadPool& GetThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool& GetIoThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool& GetFrameThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
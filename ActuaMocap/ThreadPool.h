@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <stddef.h>
+
+/// <summary>
+/// fixed set of worker threads, one per core. ParallelFor hands out indices from a shared counter
+/// so uneven work (clips of different lengths) balances itself. the calling thread joins in too.
+/// </summary>
+class ThreadPool
+{
+public:
+	ThreadPool(size_t numThreads = 0); // 0 = one per hardware thread
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	inline size_t GetNumThreads() const {
+		return _workers.size() + 1;
+	}
+	/// <summary>
+	/// call fn(i) for every i in [0, count) across the pool and wait for them all.
+	/// grainSize indices are claimed at a time
+	/// </summary>
+	void ParallelFor(size_t count, const std::function<void(size_t)>& fn, size_t grainSize = 1);
+private:
+	void WorkerLoop();
+	void RunJob();
+private:
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+	std::mutex _submitMutex; // one ParallelFor at a time
+	bool _quit = false;
+	size_t _generation = 0;
+	size_t _busyWorkers = 0;
+
+	const std::function<void(size_t)>* _job = nullptr;
+	size_t _jobCount = 0;
+	size_t _jobGrain = 1;
+	std::atomic<size_t> _nextIndex;
+};
+
+// shared pool for the whole program's compute jobs. one job runs at a time, so nothing here should block on io
+ThreadPool& GetThreadPool();
+// blocking file reads and directory listings, so waiting on the disk never holds up GetThreadPool's jobs
+ThreadPool& GetIoThreadPool();
+// work the render thread waits on every frame, kept apart so it never queues behind a background job
+ThreadPool& GetFrameThreadPool();
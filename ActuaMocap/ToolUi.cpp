@@ -7,20 +7,65 @@
 #include "IFilesystem.h"
 #include "MocapFile.h"
 #include "MocapAnimation.h"
+#include "ArchiveFile.h"
+#include "MocapLibrary.h"
+#include "MocapClipCache.h"
+#include "MocapLibraryIndex.h"
+#include "MocapCrowd.h"
+#include "MocapMotionGraph.h"
+#include "MocapPoseIndex.h"
+#include "MocapClipSoA.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <cmath>
 
 ToolUi::~ToolUi()
 {
+    if (_pendingLoad.valid()) {
+        _pendingLoad.wait();
+    }
+    if (_pendingIndex.valid()) {
+        _pendingIndex.wait();
+    }
+    if (_pendingPoseIndex.valid()) {
+        _pendingPoseIndex.wait();
+    }
+    if (_pendingMotionGraph.valid()) {
+        _pendingMotionGraph.wait();
+    }
+    if (_pendingAlignment.valid()) {
+        _pendingAlignment.wait();
+    }
+    for (auto& retiring : _retiringFiles) {
+        retiring.wait();
+    }
+    if (_clipCache) {
+        MocapClipCacheStats stats = _clipCache->GetStats();
+        std::cout << "clip cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions << " evictions, "
+            << stats.bytes / 1024 << " KB of " << stats.budgetBytes / 1024 << " KB in use\n";
+    }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 }
 
-ToolUi::ToolUi(GLFWwindow* window, IFilesystem* fileSystem, MocapAnimation* animation, MocapFile* file, const Config& config)
+ToolUi::ToolUi(GLFWwindow* window, IFilesystem* fileSystem, MocapAnimation* animation, MocapFile* file, const Config& config, const MocapLibrary* library, DecodedClipCache* decodedCache)
 	:_fileSystem(fileSystem),
     _mocapFilesFolder(config.MocapFilesFolder),
     _animation(animation),
-    _file(file)
+    _file(file),
+    _reverseFileEndianness(config.ReverseFileEndianness),
+    _library(library),
+    _crowdPlayers(2 * CrowdTeamSize + CrowdReferees),
+    _crowdKeyTolerance(config.KeyframeTolerance),
+    _loadOptions(config.GetMocapLoadOptions())
 {
+    _loadOptions.decodedCache = decodedCache;
+    if (config.ClipCacheBudgetMB > 0) {
+        _clipCache = std::make_unique<MocapClipCache>(config.ClipCacheBudgetMB * 1024 * 1024);
+    }
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -38,7 +83,10 @@ ToolUi::ToolUi(GLFWwindow* window, IFilesystem* fileSystem, MocapAnimation* anim
     else {
         std::cout << "Unrecognised theme in config file" << std::endl;
     }
-    _mocapFiles = _fileSystem->ListFilesInDirectory(config.MocapFilesFolder);
+    RescanFolder();
+    _folderWatch = _fileSystem->WatchDirectory(_mocapFilesFolder);
+    LoadIndex();
+    StartIndexUpdate();
     // Setup Platform/Renderer backends
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     const char* glsl_version = "#version 130";
@@ -55,8 +103,25 @@ void ToolUi::Update(double deltaT)
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
+    PublishFinishedLoad();
+    PublishIndexUpdate();
+    PublishMotionGraph();
+    PublishClosestAlignment();
+    PollFolderChanges();
     if (!_paused) {
         _animation->Update(deltaT);
+        if (_crowdMode && _crowd->IsMotionMatching()) {
+            SteerControlledPlayer();
+        }
+        if (_crowdMode) {
+            _crowd->Update(deltaT);
+        }
+        if (_graphWalk) {
+            WalkMotionGraph();
+        }
+    }
+    if (_similarLive && _poseIndex && _animation->GetCurrentFrameNumber() != _similarFrame) {
+        FindSimilarPoses();
     }
     
     DoUiWindow();
@@ -74,48 +139,844 @@ void ToolUi::Draw() const
 
 void ToolUi::LoadFile(std::string fileName)
 {
-    _animation->ResetAfterNewFileLoad();
-    _file->Load(_mocapFilesFolder + "\\" + fileName);
+    if (_pendingLoad.valid()) {
+        _queuedFileName = fileName;
+        return;
+    }
+    if (_library && _library->FindClip(fileName)) {
+        // already decoded, nothing to wait for
+        auto view = std::make_shared<MocapFile>(_reverseFileEndianness);
+        _library->LoadClip(fileName, *view);
+        SwapInFile(std::move(view), fileName, _crossfadeSeconds);
+        return;
+    }
+
+    std::shared_ptr<ArchiveFile> archive;
+    size_t index = 0;
+    size_t separator = fileName.rfind(':');
+    if (separator != std::string::npos && _archives.count(fileName.substr(0, separator))) {
+        archive = _archives[fileName.substr(0, separator)];
+        index = std::stoul(fileName.substr(separator + 1));
+    }
+    // archive entries are cached under the archive's path, so rewriting the .DAT invalidates all of them
+    std::string path = archive ? archive->GetDataFilePath() : JoinPath(_mocapFilesFolder, fileName);
+    _loadingCacheKey = archive ? path + ":" + std::to_string(index) : path;
+    _loadingCacheable = _clipCache && _fileSystem->GetFileStat(path, _loadingStat);
+    if (_loadingCacheable) {
+        if (std::shared_ptr<MocapFile> cached = _clipCache->Find(_loadingCacheKey, _loadingStat)) {
+            SwapInFile(std::move(cached), fileName, _crossfadeSeconds);
+            return;
+        }
+    }
+
+    // the current clip keeps playing from _file while this one loads
+    _loadingFile = std::make_shared<MocapFile>(_reverseFileEndianness);
+    _loadingFileName = fileName;
+    MocapFile* loading = _loadingFile.get();
+    if (archive) {
+        _pendingLoad = std::async(std::launch::async, [loading, archive, index]() {
+            return loading->LoadFromArchive(*archive, index);
+        });
+        return;
+    }
+    MocapLoadOptions options = _loadOptions;
+    _pendingLoad = std::async(std::launch::async, [loading, path, options]() {
+        return loading->Open(path, options);
+    });
+}
+
+void ToolUi::SwapInFile(std::shared_ptr<MocapFile> file, const std::string& fileName, double fadeSeconds, double startSeconds)
+{
+    if (fileName == _graphTarget) {
+        _graphTarget.clear();
+        if (file->GetNumFrames() == _graphTargetFrames) {
+            fadeSeconds = _motionGraph->GetWindow() / _fps;
+        }
+        else {
+            // still worth playing, but not from a frame the graph picked
+            std::cout << "motion graph is out of date with " << fileName << ", rebuild it with --motion-graph\n";
+            _graphWalk = false;
+            _seekFileName.clear();
+        }
+    }
+    if (fileName == _seekFileName) {
+        startSeconds = _seekFrame / _fps;
+        _seekFileName.clear();
+    }
+    if (_paused) {
+        // Update isn't called while paused, so a fade would never get past the outgoing clip
+        fadeSeconds = 0.0;
+    }
+    _animation->CrossfadeToFile(file.get(), fadeSeconds, startSeconds);
+    _file = file.get();
     _loadedFile = fileName;
+    // freeing the old clip can mean joining its stream thread, keep that off the frame loop
+    _retiringFiles.erase(std::remove_if(_retiringFiles.begin(), _retiringFiles.end(), [](const std::future<void>& retiring) {
+        return retiring.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }), _retiringFiles.end());
+    if (_ownedFile) {
+        _retiringFiles.push_back(std::async(std::launch::async, [retired = std::move(_ownedFile)]() mutable { retired.reset(); }));
+    }
+    _ownedFile = std::move(file);
+}
+
+void ToolUi::OpenArchives()
+{
+    // every NAME.DAT with a NAME.OFF beside it is an archive, list each of its entries that's a clip
+    std::vector<std::string> entries;
+    for (const auto& name : _mocapFiles) {
+        if (!FileHasExtension(name, ".DAT")) {
+            continue;
+        }
+        std::string offsetsName = name.substr(0, name.size() - 4) + ".OFF";
+        if (std::find(_mocapFiles.begin(), _mocapFiles.end(), offsetsName) == _mocapFiles.end()) {
+            continue;
+        }
+        auto archive = std::make_shared<ArchiveFile>();
+        if (!archive->Open(JoinPath(_mocapFilesFolder, offsetsName), JoinPath(_mocapFilesFolder, name))) {
+            continue;
+        }
+        for (size_t i = 0; i < archive->GetNumResources(); i++) {
+            ResourceFile resource;
+            if (archive->GetResourceFile(i, resource) && MocapFile::IsClipBuffer(resource.data, resource.size, _reverseFileEndianness)) {
+                entries.push_back(name + ":" + std::to_string(i));
+            }
+        }
+        _archives[name] = archive;
+    }
+    _mocapFiles.insert(_mocapFiles.end(), entries.begin(), entries.end());
+}
+
+void ToolUi::LoadIndex()
+{
+    auto index = std::make_shared<MocapLibraryIndex>(_reverseFileEndianness, MocapDefaultFps);
+    index->Load(JoinPath(_mocapFilesFolder, MocapIndexFileName));
+    _index = index;
+    _browserDirty = true;
+    auto poseIndex = std::make_shared<MocapPoseIndex>(_reverseFileEndianness);
+    poseIndex->Load(JoinPath(_mocapFilesFolder, PoseIndexFileName));
+    _poseIndex = poseIndex;
+}
+
+void ToolUi::StartIndexUpdate(std::vector<std::string> clips)
+{
+    // measuring new clips reads them, keep that off the ui thread and work on a copy meanwhile
+    auto updating = std::make_shared<MocapLibraryIndex>(*_index);
+    std::string folder = _mocapFilesFolder;
+    std::string indexPath = JoinPath(_mocapFilesFolder, MocapIndexFileName);
+    IFilesystem* fileSystem = _fileSystem;
+    _pendingIndex = std::async(std::launch::async, [updating, folder, indexPath, fileSystem, clips]() {
+        size_t changes = clips.empty() ? updating->Update(folder, fileSystem) : updating->UpdateClips(folder, clips, fileSystem);
+        if (changes > 0) {
+            updating->Save(indexPath, fileSystem);
+        }
+        return std::shared_ptr<const MocapLibraryIndex>(updating);
+    });
+    auto updatingPoses = std::make_shared<MocapPoseIndex>(*_poseIndex);
+    std::string poseIndexPath = JoinPath(_mocapFilesFolder, PoseIndexFileName);
+    _pendingPoseIndex = std::async(std::launch::async, [updatingPoses, folder, poseIndexPath, fileSystem, clips]() {
+        size_t changes = clips.empty() ? updatingPoses->Update(folder, fileSystem) : updatingPoses->UpdateClips(folder, clips, fileSystem);
+        if (changes > 0) {
+            updatingPoses->Save(poseIndexPath, fileSystem);
+        }
+        return std::shared_ptr<const MocapPoseIndex>(updatingPoses);
+    });
+}
+
+void ToolUi::PublishIndexUpdate()
+{
+    if (_pendingPoseIndex.valid() && _pendingPoseIndex.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        _poseIndex = _pendingPoseIndex.get();
+        _similarPoses.clear(); // they name clips by their place in the old index
+        _similarFrame = -1;
+        if (_crowd) {
+            // the match database's features were projected with the old index's components
+            bool matching = _crowd->IsMotionMatching();
+            _crowd->ResetMatchDatabase();
+            if (matching && _poseIndex->GetNumFrames() > 0) {
+                _crowd->SetMotionMatching(true, *_poseIndex);
+            }
+            _crowd->Update(0.0);
+        }
+    }
+    if (!_pendingIndex.valid() || _pendingIndex.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    _index = _pendingIndex.get();
+    _browserDirty = true; // rows point into the old index
+}
+
+void ToolUi::RescanFolder()
+{
+    _mocapFiles = _fileSystem->ListFilesInDirectory(_mocapFilesFolder);
+    _archives.clear();
+    OpenArchives();
+    _browserDirty = true;
+    _alignCandidates.reset();
+    _alignCandidatesVersion++;
+}
+
+void ToolUi::PollFolderChanges()
+{
+    if (_folderWatch) {
+        std::vector<FileChange> changes;
+        _folderWatch->Poll(changes);
+        for (const auto& change : changes) {
+            if (change.type == FileChangeType::Overflow) {
+                _rescanNeeded = true;
+                continue;
+            }
+            // the index file and the temporaries it's written through show up here too
+            if (!FileHasExtension(change.name, ".comap") && !FileHasExtension(change.name, ".comapz") && !FileHasExtension(change.name, ".comapk")) {
+                continue;
+            }
+            auto listed = std::find(_mocapFiles.begin(), _mocapFiles.end(), change.name);
+            if (change.type == FileChangeType::Removed) {
+                if (listed != _mocapFiles.end()) {
+                    _mocapFiles.erase(listed);
+                }
+            }
+            else if (listed == _mocapFiles.end()) {
+                _mocapFiles.push_back(change.name);
+            }
+            _changedClips.push_back(change.name);
+            _browserDirty = true;
+            _alignCandidates.reset();
+            _alignCandidatesVersion++;
+        }
+    }
+    // one index update at a time, changes that arrive meanwhile wait for the next one
+    if (_pendingIndex.valid() || _pendingPoseIndex.valid()) {
+        return;
+    }
+    if (_rescanNeeded) {
+        _rescanNeeded = false;
+        _changedClips.clear();
+        RescanFolder();
+        StartIndexUpdate();
+    }
+    else if (!_changedClips.empty()) {
+        StartIndexUpdate(std::move(_changedClips));
+        _changedClips.clear();
+    }
+}
+
+void ToolUi::RebuildBrowserRows()
+{
+    _browserRows.clear();
+    bool limited = _minSeconds > 0.0f || _maxSeconds > 0.0f || _maxJointSpeed > 0.0f;
+    for (size_t i = 0; i < _mocapFiles.size(); i++) {
+        const std::string& name = _mocapFiles[i];
+        bool archiveEntry = name.find(':') != std::string::npos;
+        if (!archiveEntry && !FileHasExtension(name, ".comap") && !FileHasExtension(name, ".comapz") && !FileHasExtension(name, ".comapk")) {
+            continue;
+        }
+        if (_nameFilter[0] != '\0' && name.find(_nameFilter) == std::string::npos) {
+            continue;
+        }
+        const MocapClipMetadata* metadata = _index ? _index->Find(name) : nullptr;
+        if (limited) {
+            // can't say whether a clip the index doesn't cover passes, so leave it out
+            if (!metadata || metadata->durationSeconds < _minSeconds
+                || (_maxSeconds > 0.0f && metadata->durationSeconds > _maxSeconds)
+                || (_maxJointSpeed > 0.0f && metadata->maxJointSpeed > _maxJointSpeed)) {
+                continue;
+            }
+        }
+        _browserRows.push_back({ i, metadata });
+    }
+
+    auto extent = [](const MocapClipMetadata* m) {
+        glm::vec3 size = m->aabbMax - m->aabbMin;
+        return std::max(size.x, std::max(size.y, size.z));
+    };
+    auto sortKey = [this, &extent](const BrowserRow& row) -> double {
+        const MocapClipMetadata* m = row.metadata;
+        switch (_sortColumn) {
+        case 1: return m->numFrames;
+        case 2: return m->durationSeconds;
+        case 3: return extent(m);
+        default: return m->maxJointSpeed;
+        }
+    };
+    std::stable_sort(_browserRows.begin(), _browserRows.end(), [this, &sortKey](const BrowserRow& a, const BrowserRow& b) {
+        if (_sortColumn == 0) {
+            return _sortDescending ? _mocapFiles[b.file] < _mocapFiles[a.file] : _mocapFiles[a.file] < _mocapFiles[b.file];
+        }
+        // clips without metadata always sink to the bottom
+        if (!a.metadata || !b.metadata) {
+            return a.metadata != nullptr && b.metadata == nullptr;
+        }
+        return _sortDescending ? sortKey(b) < sortKey(a) : sortKey(a) < sortKey(b);
+    });
+    _browserDirty = false;
+}
+
+void ToolUi::PublishFinishedLoad()
+{
+    if (!_pendingLoad.valid() || _pendingLoad.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    bool loaded = _pendingLoad.get();
+    if (loaded && _loadingFile->GetNumFrames() > 0) {
+        // streamed clips keep a prefetch thread and a file handle going, they aren't worth holding on to
+        if (_loadingCacheable && _loadingFile->GetBackend() != MocapFileBackend::Streamed) {
+            _clipCache->Insert(_loadingCacheKey, _loadingStat, _loadingFile);
+        }
+        SwapInFile(std::move(_loadingFile), _loadingFileName, _crossfadeSeconds);
+    }
+    else {
+        std::cout << "couldn't load " << _loadingFileName << ", keeping " << _loadedFile << "\n";
+        _loadingFile.reset();
+        if (_loadingFileName == _graphTarget) {
+            std::cout << "motion graph is out of date with " << _graphTarget << ", rebuild it with --motion-graph\n";
+            _graphTarget.clear();
+            _graphWalk = false;
+        }
+    }
+    if (!_queuedFileName.empty()) {
+        std::string next = _queuedFileName;
+        _queuedFileName.clear();
+        LoadFile(next);
+    }
 }
 
 void ToolUi::DoPlayModeWindow()
 {
     ImGui::Text(_loadedFile.c_str());
+    if (_pendingLoad.valid()) {
+        ImGui::Text("loading %s...", _loadingFileName.c_str());
+    }
+    if (_clipCache) {
+        MocapClipCacheStats stats = _clipCache->GetStats();
+        ImGui::Text("clip cache: %llu hits, %llu misses, %llu evictions", (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+        ImGui::Text("%zu clips, %.1f / %.1f MB", stats.entries, stats.bytes / (1024.0 * 1024.0), stats.budgetBytes / (1024.0 * 1024.0));
+    }
     ImGui::Text("length %f", _animation->GetCurrentLengthSeconds());
     ImGui::Text("progress %f", _animation->GetAnimationProgressSeconds());
+    float scrub = (float)_animation->GetAnimationProgressSeconds();
+    if (ImGui::SliderFloat("time", &scrub, 0.0f, (float)_animation->GetCurrentLengthSeconds(), "%.3f s")) {
+        _animation->Sample(scrub);
+    }
+    float rate = (float)_animation->GetRate();
+    if (ImGui::SliderFloat("rate", &rate, -4.0f, 4.0f, "%.2fx")) {
+        _animation->SetRate(rate);
+    }
+    int wrap = (int)_animation->GetWrapMode();
+    if (ImGui::Combo("wrap", &wrap, "loop\0clamp\0ping-pong\0")) {
+        _animation->SetWrapMode((MocapWrapMode)wrap);
+    }
     if (ImGui::Button(_paused ? "Play" : "Pause")) {
         if (_paused) {
             _paused = false;
         }
         else {
+            _animation->EndCrossfade();
             _animation->PopulateSkeleton();
             _paused = true;
         }
     }
 
-    static int item_current_idx = 0; // Here we store our selection data as an index.
-    if (ImGui::BeginListBox("mocap files"))
-    {
-        for (int i = 1; i < _mocapFiles.size(); i++) { // skip first file as it's ".."
-            const bool is_selected = (item_current_idx == i);
-            if (ImGui::Selectable(_mocapFiles[i].c_str(), is_selected)) {
-                item_current_idx = i;
-                LoadFile(_mocapFiles[i]);
+    DoClipBrowser();
+
+    static char buf[64] = "";
+    if (ImGui::InputText("fps", buf, 64, ImGuiInputTextFlags_CharsDecimal)) {
+        // the box is empty or reads 0 on the way to typing most rates, keep the last one that made sense
+        double fps = atof(buf);
+        if (std::isfinite(fps) && fps > 0.0) {
+            _fps = fps;
+            _animation->SetFps(_fps);
+            if (_crowd) {
+                _crowd->SetFps(_fps);
             }
+        }
+    }
+    float crossfade = (float)_crossfadeSeconds;
+    if (ImGui::SliderFloat("crossfade", &crossfade, 0.0f, 2.0f, crossfade > 0.0f ? "%.2f s" : "cut")) {
+        _crossfadeSeconds = crossfade;
+    }
+    int interpolation = (int)_interpolation;
+    if (ImGui::Combo("interpolation", &interpolation, "linear\0catmull-rom\0")) {
+        _interpolation = (MocapInterpolation)interpolation;
+        _animation->SetInterpolation(_interpolation);
+        if (_crowd) {
+            _crowd->SetInterpolation(_interpolation);
+        }
+    }
 
-            // Set the initial focus when opening the combo (scrolling + keyboard navigation focus)
-            if (is_selected)
-                ImGui::SetItemDefaultFocus();
+    DoMotionGraphControls();
+    DoCrowdControls();
+    DoSimilarPoses();
+    DoTimeWarp();
+}
+
+const MocapCrowd* ToolUi::GetCrowd() const
+{
+    return _crowdMode ? _crowd.get() : nullptr;
+}
+
+void ToolUi::BuildCrowd()
+{
+    _crowd = std::make_unique<MocapCrowd>();
+    _crowd->SetFps(_fps);
+    _crowd->SetInterpolation(_interpolation);
+    if (_library) {
+        MocapFile view(_reverseFileEndianness);
+        for (const auto& clip : _library->GetClips()) {
+            _library->LoadClip(clip.name, view);
+            _crowd->AddClip(view);
+        }
+    }
+    else {
+        // without the preloaded library, load enough loose clips to give the players some variety
+        const size_t maxClips = 64;
+        MocapFile file(_reverseFileEndianness);
+        for (size_t i = 0; i < _mocapFiles.size() && _crowd->GetNumClips() < maxClips; i++) {
+            if (_mocapFiles[i].find(':') == std::string::npos && file.Open(JoinPath(_mocapFilesFolder, _mocapFiles[i]), _loadOptions)) {
+                _crowd->AddClip(file);
+            }
         }
-        ImGui::EndListBox();
     }
+    std::cout << "crowd using " << _crowd->GetNumClips() << " clips\n";
+    _crowd->SetNumPlayers(_crowdPlayers);
+    _crowd->Update(0.0);
+}
 
-    static char buf[64] = "";
-    if (ImGui::InputText("fps", buf, 64, ImGuiInputTextFlags_CharsDecimal)) {
-        _animation->SetFps(atof(buf));
+void ToolUi::DoCrowdControls()
+{
+    if (ImGui::Checkbox("crowd", &_crowdMode) && _crowdMode && !_crowd) {
+        BuildCrowd();
     }
+    if (!_crowdMode) {
+        return;
+    }
+    if (ImGui::SliderInt("players", &_crowdPlayers, 1, 1000)) {
+        _crowd->SetNumPlayers(_crowdPlayers);
+        _crowd->Update(0.0);
+    }
+    ImGui::Text("%zu players from %zu clips, update %.3f ms", _crowd->GetNumPlayers(), _crowd->GetNumClips(), _crowd->GetLastUpdateMs());
+    bool matching = _crowd->IsMotionMatching();
+    // the match database is projected with the pose index's components, which aren't there until it's built
+    ImGui::BeginDisabled(!_poseIndex || _poseIndex->GetNumFrames() == 0);
+    if (ImGui::Checkbox("motion matching", &matching)) {
+        _crowd->SetMotionMatching(matching, *_poseIndex);
+        _crowd->Update(0.0);
+    }
+    ImGui::EndDisabled();
+    if (matching) {
+        ImGui::Text("%zu frames to match, %zu searches last tick at %.2f us each", _crowd->GetMatchDatabase()->GetNumSearchable(),
+            _crowd->GetLastSearches(), _crowd->GetLastSearchMicroseconds());
+        ImGui::Text("arrow keys steer player %d", CrowdControlledPlayer + 1);
+    }
+    bool keyframed = _crowd->IsKeyframed();
+    bool keysChanged = ImGui::Checkbox("keyframed", &keyframed);
+    if (keyframed) {
+        keysChanged |= ImGui::SliderFloat("key tolerance", &_crowdKeyTolerance, 0.001f, 0.5f, "%.3f");
+    }
+    if (keysChanged) {
+        _crowd->SetKeyframed(keyframed, _crowdKeyTolerance);
+        _crowd->Update(0.0);
+    }
+    if (keyframed) {
+        ImGui::Text("keys %.1f KB against %.1f KB of frames", _crowd->GetKeyBytes() / 1024.0, _crowd->GetDenseBytes() / 1024.0);
+    }
+}
+
+void ToolUi::SteerControlledPlayer()
+{
+    // up and down along the pitch, left and right across it
+    glm::vec2 stick(0.0f);
+    if (!_io->WantCaptureKeyboard) {
+        stick.x += ImGui::IsKeyDown(ImGui::GetKeyIndex(ImGuiKey_UpArrow)) ? 1.0f : 0.0f;
+        stick.x -= ImGui::IsKeyDown(ImGui::GetKeyIndex(ImGuiKey_DownArrow)) ? 1.0f : 0.0f;
+        stick.y += ImGui::IsKeyDown(ImGui::GetKeyIndex(ImGuiKey_RightArrow)) ? 1.0f : 0.0f;
+        stick.y -= ImGui::IsKeyDown(ImGui::GetKeyIndex(ImGuiKey_LeftArrow)) ? 1.0f : 0.0f;
+    }
+    if (glm::length(stick) > 1.0f) {
+        stick = glm::normalize(stick);
+    }
+    _crowd->SetControlStick(stick);
+}
+
+void ToolUi::LoadMotionGraph()
+{
+    // building one compares every frame of the library against every other, keep it off the frame loop
+    std::string path = JoinPath(_mocapFilesFolder, MotionGraphFileName);
+    std::string folder = _mocapFilesFolder;
+    const MocapLibrary* library = _library;
+    IFilesystem* fileSystem = _fileSystem;
+    _pendingMotionGraph = std::async(std::launch::async, [path, folder, library, fileSystem]() {
+        auto graph = std::make_unique<MocapMotionGraph>();
+        if (graph->Load(path)) {
+            return graph;
+        }
+        if (!library) {
+            std::cout << "no motion graph in " << folder << ", build one with --motion-graph\n";
+            return std::unique_ptr<MocapMotionGraph>();
+        }
+        // the whole library is already in memory, which is all building one takes
+        MotionGraphBuildStats stats;
+        if (!graph->Build(*library, MotionGraphOptions(), stats)) {
+            return std::unique_ptr<MocapMotionGraph>();
+        }
+        std::cout << "built a motion graph of " << graph->GetTransitions().size() << " transitions in " << stats.seconds << " s\n";
+        graph->Save(path, fileSystem);
+        return graph;
+    });
+}
 
+void ToolUi::PublishMotionGraph()
+{
+    if (!_pendingMotionGraph.valid() || _pendingMotionGraph.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    _motionGraph = _pendingMotionGraph.get();
+    if (!_motionGraph) {
+        _graphWalk = false;
+    }
+}
+
+void ToolUi::WalkMotionGraph()
+{
+    // transitions are only taken playing forwards, and not while the last one is still loading or fading in
+    if (!_motionGraph || _pendingLoad.valid() || !_graphTarget.empty() || _animation->IsFading() || _animation->GetRate() <= 0.0) {
+        return;
+    }
+    int clip = _motionGraph->FindClip(_loadedFile);
+    int frame = _animation->GetCurrentFrameNumber();
+    if (clip < 0 || frame == _graphWalkFrame) {
+        return;
+    }
+    _graphWalkFrame = frame;
+    const MotionGraphTransition* transition = _motionGraph->ChooseTransition(clip, frame, _graphWalkRng);
+    if (!transition) {
+        return;
+    }
+    u32 toFrame;
+    const MotionGraphClip& to = _motionGraph->GetClips()[_motionGraph->GetClipOfFrame(transition->to, toFrame)];
+    if (!_library) {
+        // reading it could stall the frame, it's swapped in by SwapInFile once it's loaded
+        _graphTarget = to.name;
+        _graphTargetFrames = to.numFrames;
+        _seekFileName = to.name;
+        _seekFrame = (int)toFrame;
+        _graphWalkFrame = (int)toFrame;
+        LoadFile(to.name);
+        return;
+    }
+    auto file = std::make_shared<MocapFile>(_reverseFileEndianness);
+    if (!_library->LoadClip(to.name, *file) || file->GetNumFrames() != to.numFrames) {
+        std::cout << "motion graph is out of date with " << to.name << ", rebuild it with --motion-graph\n";
+        _graphWalk = false;
+        return;
+    }
+    SwapInFile(std::move(file), to.name, _motionGraph->GetWindow() / _fps, toFrame / _fps);
+    _graphWalkFrame = (int)toFrame;
+}
+
+void ToolUi::DoMotionGraphControls()
+{
+    if (ImGui::Checkbox("walk motion graph", &_graphWalk) && _graphWalk) {
+        if (!_motionGraph && !_pendingMotionGraph.valid()) {
+            LoadMotionGraph();
+        }
+        _graphWalkFrame = -1;
+    }
+    if (_pendingMotionGraph.valid()) {
+        ImGui::Text("loading motion graph...");
+    }
+    else if (_graphWalk && _motionGraph) {
+        ImGui::Text("%zu transitions between %zu clips", _motionGraph->GetTransitions().size(), _motionGraph->GetClips().size());
+        if (_motionGraph->FindClip(_loadedFile) < 0) {
+            ImGui::Text("%s isn't in the graph", _loadedFile.c_str());
+        }
+    }
+}
+
+void ToolUi::FindSimilarPoses()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    _poseIndex->Query(_animation->GetCurrentFrame(), (size_t)_similarCount, _similarPoses);
+    _similarQueryMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    _similarFrame = _animation->GetCurrentFrameNumber();
+}
+
+void ToolUi::SeekToPose(const PoseMatch& match)
+{
+    const std::string& name = _poseIndex->GetClips()[match.clip].name;
+    if (name == _loadedFile) {
+        _animation->SetToFrame((int)match.frame);
+        return;
+    }
+    _seekFileName = name;
+    _seekFrame = (int)match.frame;
+    LoadFile(name);
+}
+
+void ToolUi::DoSimilarPoses()
+{
+    if (!ImGui::CollapsingHeader("similar poses")) {
+        return;
+    }
+    if (_pendingPoseIndex.valid()) {
+        ImGui::Text("indexing poses...");
+    }
+    if (!_poseIndex || _poseIndex->GetNumFrames() == 0) {
+        return;
+    }
+    if (ImGui::Button("find")) {
+        FindSimilarPoses();
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("live", &_similarLive);
+    if (ImGui::SliderInt("matches", &_similarCount, 1, 64)) {
+        _similarFrame = -1;
+    }
+    ImGui::Text("%zu frames searched in %.3f ms", _poseIndex->GetNumFrames(), _similarQueryMs);
+    for (size_t i = 0; i < _similarPoses.size(); i++) {
+        const PoseMatch& match = _similarPoses[i];
+        char label[256];
+        snprintf(label, sizeof(label), "%s frame %u (%.2f)##similar%zu", _poseIndex->GetClips()[match.clip].name.c_str(), match.frame, match.distance, i);
+        if (ImGui::Selectable(label)) {
+            SeekToPose(match);
+        }
+    }
+}
+
+bool ToolUi::BuildTimeWarpClip(const std::string& fileName, TimeWarpClip& out) const
+{
+    MocapFile file(_reverseFileEndianness);
+    if (_library && _library->FindClip(fileName)) {
+        _library->LoadClip(fileName, file);
+    }
+    else {
+        file.Load(JoinPath(_mocapFilesFolder, fileName));
+    }
+    if (file.GetNumFrames() == 0) {
+        return false;
+    }
+    MocapClipSoA poses;
+    poses.Build(file);
+    out.Build(poses);
+    return true;
+}
+
+void ToolUi::AlignWith(const std::string& fileName)
+{
+    TimeWarpClip clip, other;
+    if (!_file || !BuildTimeWarpClip(fileName, other)) {
+        std::cout << "couldn't load " << fileName << " to align with\n";
+        return;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    MocapClipSoA poses;
+    poses.Build(*_file);
+    clip.Build(poses);
+    TimeWarpAligner aligner;
+    if (aligner.Align(clip, other, (size_t)_alignBand, _alignment)) {
+        _alignedFile = _loadedFile;
+        _alignedWith = fileName;
+    }
+    _alignMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void ToolUi::AlignWithClosest()
+{
+    if (!_file || _pendingAlignment.valid()) {
+        return;
+    }
+    // the playing clip is built here, it may be streaming and that's only safe to read from the frame loop
+    auto clip = std::make_shared<TimeWarpClip>();
+    MocapClipSoA poses;
+    poses.Build(*_file);
+    clip->Build(poses);
+    std::shared_ptr<const AlignCandidates> candidates = _alignCandidates;
+    std::vector<std::string> names;
+    if (!candidates) {
+        for (const auto& name : _mocapFiles) {
+            if (FileHasExtension(name, ".comap") || FileHasExtension(name, ".comapz") || FileHasExtension(name, ".comapk")) {
+                names.push_back(name);
+            }
+        }
+    }
+    int version = _alignCandidatesVersion;
+    std::string file = _loadedFile;
+    size_t band = (size_t)_alignBand;
+    _pendingAlignment = std::async(std::launch::async, [this, clip, candidates, names, version, file, band]() {
+        ClosestAlignment result;
+        result.candidates = candidates;
+        result.candidatesVersion = version;
+        result.file = file;
+        if (!result.candidates) {
+            auto built = std::make_shared<AlignCandidates>();
+            built->names = names;
+            built->clips.resize(names.size());
+            // reading clips blocks, keep it off the compute pool
+            GetIoThreadPool().ParallelFor(names.size(), [this, &built](size_t i) {
+                BuildTimeWarpClip(built->names[i], built->clips[i]);
+            });
+            result.candidates = built;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<const TimeWarpClip*> others;
+        std::vector<size_t> indices;
+        for (size_t i = 0; i < result.candidates->clips.size(); i++) {
+            if (result.candidates->names[i] != file && result.candidates->clips[i].GetNumFrames() > 0) {
+                others.push_back(&result.candidates->clips[i]);
+                indices.push_back(i);
+            }
+        }
+        std::vector<TimeWarpAlignment> alignments;
+        AlignAgainstClips(*clip, others, band, alignments);
+        size_t best = alignments.size();
+        for (size_t i = 0; i < alignments.size(); i++) {
+            if (best == alignments.size() || alignments[i].cost < alignments[best].cost) {
+                best = i;
+            }
+        }
+        if (best < alignments.size() && !alignments[best].path.empty()) {
+            result.alignment = std::move(alignments[best]);
+            result.with = result.candidates->names[indices[best]];
+        }
+        result.ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        return result;
+    });
+}
+
+void ToolUi::PublishClosestAlignment()
+{
+    if (!_pendingAlignment.valid() || _pendingAlignment.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    ClosestAlignment result = _pendingAlignment.get();
+    if (result.candidatesVersion == _alignCandidatesVersion) {
+        _alignCandidates = result.candidates;
+    }
+    if (!result.with.empty()) {
+        _alignment = std::move(result.alignment);
+        _alignedFile = result.file;
+        _alignedWith = result.with;
+        snprintf(_alignName, sizeof(_alignName), "%s", _alignedWith.c_str());
+    }
+    _alignMs = result.ms;
+}
+
+void ToolUi::DoTimeWarp()
+{
+    if (!ImGui::CollapsingHeader("time warp")) {
+        return;
+    }
+    ImGui::InputText("align with", _alignName, sizeof(_alignName));
+    ImGui::SliderInt("band", &_alignBand, 1, 64, "%d frames");
+    if (ImGui::Button("align")) {
+        AlignWith(_alignName);
+    }
+    ImGui::SameLine();
+    if (_pendingAlignment.valid()) {
+        ImGui::Text("finding the closest clip...");
+    }
+    else if (ImGui::Button("closest clip")) {
+        AlignWithClosest();
+    }
+    if (_alignedFile != _loadedFile || _alignment.path.empty()) {
+        return;
+    }
+    ImGui::Text("%s: mean distance %.3f over %zu steps, %.2f ms", _alignedWith.c_str(), _alignment.cost, _alignment.path.size(), _alignMs);
+
+    // how far each frame is from the frames it's matched with, and where playback is along it
+    int frame = std::min(_animation->GetCurrentFrameNumber(), (int)_alignment.deviation.size() - 1);
+    ImGui::PlotLines("deviation", _alignment.deviation.data(), (int)_alignment.deviation.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 80.0f));
+    // the item rect takes in the label too, the graph itself is the item width inside the frame padding
+    ImVec2 padding = ImGui::GetStyle().FramePadding;
+    ImVec2 plotMin = ImGui::GetItemRectMin();
+    float plotWidth = ImGui::CalcItemWidth() - padding.x * 2.0f;
+    float x = plotMin.x + padding.x + plotWidth * (frame + 0.5f) / _alignment.deviation.size();
+    ImGui::GetWindowDrawList()->AddLine(ImVec2(x, plotMin.y), ImVec2(x, ImGui::GetItemRectMax().y), IM_COL32(255, 80, 80, 255));
+
+    u32 first = UINT32_MAX, last = 0;
+    for (const TimeWarpStep& step : _alignment.path) {
+        if ((int)step.a == frame) {
+            first = std::min(first, step.b);
+            last = std::max(last, step.b);
+        }
+    }
+    char label[256];
+    if (first == last) {
+        snprintf(label, sizeof(label), "frame %d is %s frame %u (%.2f)", frame, _alignedWith.c_str(), first, _alignment.deviation[frame]);
+    }
+    else {
+        snprintf(label, sizeof(label), "frame %d is %s frames %u-%u (%.2f)", frame, _alignedWith.c_str(), first, last, _alignment.deviation[frame]);
+    }
+    if (ImGui::Selectable(label)) {
+        _seekFileName = _alignedWith;
+        _seekFrame = (int)first;
+        LoadFile(_alignedWith);
+    }
+}
+
+void ToolUi::DoClipBrowser()
+{
+    bool filterChanged = ImGui::InputText("filter", _nameFilter, sizeof(_nameFilter));
+    filterChanged |= ImGui::DragFloatRange2("seconds", &_minSeconds, &_maxSeconds, 0.1f, 0.0f, 10000.0f, "min %.1f", "max %.1f");
+    filterChanged |= ImGui::DragFloat("max joint speed", &_maxJointSpeed, 1.0f, 0.0f, 100000.0f, _maxJointSpeed > 0.0f ? "%.0f" : "any");
+    if (filterChanged) {
+        _browserDirty = true;
+    }
+    if (_pendingIndex.valid()) {
+        ImGui::Text("indexing clips...");
+    }
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg
+        | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_Resizable;
+    if (!ImGui::BeginTable("mocap files", 5, flags, ImVec2(0.0f, ImGui::GetTextLineHeightWithSpacing() * 15))) {
+        return;
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("name", ImGuiTableColumnFlags_DefaultSort);
+    ImGui::TableSetupColumn("frames");
+    ImGui::TableSetupColumn("seconds");
+    ImGui::TableSetupColumn("extent");
+    ImGui::TableSetupColumn("max speed");
+    ImGui::TableHeadersRow();
+
+    ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+    if (sortSpecs && sortSpecs->SpecsDirty && sortSpecs->SpecsCount > 0) {
+        _sortColumn = sortSpecs->Specs[0].ColumnIndex;
+        _sortDescending = sortSpecs->Specs[0].SortDirection == ImGuiSortDirection_Descending;
+        sortSpecs->SpecsDirty = false;
+        _browserDirty = true;
+    }
+    if (_browserDirty) {
+        RebuildBrowserRows();
+    }
+
+    // only the visible rows are submitted, so the table costs the same for 100 clips or 100k
+    ImGuiListClipper clipper;
+    clipper.Begin((int)_browserRows.size());
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            const std::string& name = _mocapFiles[_browserRows[row].file];
+            const MocapClipMetadata* metadata = _browserRows[row].metadata;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            if (ImGui::Selectable(name.c_str(), name == _loadedFile, ImGuiSelectableFlags_SpanAllColumns)) {
+                LoadFile(name);
+            }
+            if (!metadata) {
+                continue;
+            }
+            glm::vec3 size = metadata->aabbMax - metadata->aabbMin;
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", metadata->numFrames);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.2f", metadata->durationSeconds);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f x %.1f x %.1f", size.x, size.y, size.z);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", metadata->maxJointSpeed);
+        }
+    }
+    ImGui::EndTable();
 }
 
 void ToolUi::DoEditModeWindow()
@@ -124,6 +985,8 @@ void ToolUi::DoEditModeWindow()
     if (ImGui::SliderInt("frame", &sliderVal, 0, _animation->GetNumFrames() - 1)) {
         _animation->SetToFrame(sliderVal);
     }
+    DoSimilarPoses();
+    DoTimeWarp();
 }
 
 void ToolUi::DoUiWindow()
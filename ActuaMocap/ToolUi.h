@@ -1,12 +1,28 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <memory>
+#include <future>
+#include <map>
+#include "MocapFile.h"
+#include "IFilesystem.h"
+#include "MocapPoseSoA.h"
+#include "MocapTimeWarp.h"
 struct ImGuiIO;
 struct GLFWwindow;
 class IFilesystem;
 class MocapAnimation;
-class MocapFile;
 class Config;
+class ArchiveFile;
+class MocapLibrary;
+class MocapClipCache;
+class DecodedClipCache;
+class MocapLibraryIndex;
+struct MocapClipMetadata;
+class MocapCrowd;
+class MocapMotionGraph;
+class MocapPoseIndex;
+struct PoseMatch;
 
 enum ToolMode {
 	ToolModePlay,
@@ -17,7 +33,7 @@ class ToolUi
 {
 public:
 	~ToolUi();
-	ToolUi(GLFWwindow* window, IFilesystem* fileSystem, MocapAnimation* animation, MocapFile* file, const Config& config);
+	ToolUi(GLFWwindow* window, IFilesystem* fileSystem, MocapAnimation* animation, MocapFile* file, const Config& config, const MocapLibrary* library = nullptr, DecodedClipCache* decodedCache = nullptr);
 	void Update(double deltaT);
 	void Draw() const;
 	inline bool WantsMouse() const {
@@ -26,12 +42,40 @@ public:
 	inline bool WantsKeyboard() const {
 		return _wantKeyboardInput;
 	}
+	// the crowd to draw instead of the single skeleton, nullptr when crowd mode is off
+	const MocapCrowd* GetCrowd() const;
 private:
 	void LoadFile(std::string fileName);
+	void PublishFinishedLoad();
+	void SwapInFile(std::shared_ptr<MocapFile> file, const std::string& fileName, double fadeSeconds, double startSeconds = 0.0);
+	void OpenArchives();
+	void RescanFolder();
+	void PollFolderChanges();
+	void LoadIndex();
+	// clips empty means look at the whole folder
+	void StartIndexUpdate(std::vector<std::string> clips = std::vector<std::string>());
+	void PublishIndexUpdate();
+	void RebuildBrowserRows();
+	void BuildCrowd();
+	void LoadMotionGraph();
+	void PublishMotionGraph();
+	void WalkMotionGraph();
+	void SteerControlledPlayer();
+	void FindSimilarPoses();
+	void SeekToPose(const PoseMatch& match);
+	bool BuildTimeWarpClip(const std::string& fileName, TimeWarpClip& out) const;
+	void AlignWith(const std::string& fileName);
+	void AlignWithClosest();
+	void PublishClosestAlignment();
 private:
 	void DoPlayModeWindow();
 	void DoEditModeWindow();
 	void DoUiWindow();
+	void DoClipBrowser();
+	void DoCrowdControls();
+	void DoMotionGraphControls();
+	void DoSimilarPoses();
+	void DoTimeWarp();
 	void SwitchToEditMode();
 	void SwitchToPlayMode();
 	IFilesystem* _fileSystem;
@@ -41,9 +85,90 @@ private:
 	std::string _mocapFilesFolder;
 	MocapAnimation* _animation;
 	MocapFile* _file;
+	// clips load on a worker into _loadingFile, which is swapped in at the start of the frame after it finishes
+	// shared with _clipCache, which may still be holding a clip after it's swapped out
+	std::shared_ptr<MocapFile> _ownedFile;
+	std::shared_ptr<MocapFile> _loadingFile;
+	std::vector<std::future<void>> _retiringFiles; // swapped out clips being freed on a worker, waited for on shutdown
+	std::future<bool> _pendingLoad;
+	std::string _loadingFileName;
+	std::string _queuedFileName; // clicked while another load was in flight, latest click wins
+	bool _reverseFileEndianness;
+	const MocapLibrary* _library; // preloaded clips, nullptr unless PreloadLibrary is set
+	std::unique_ptr<MocapClipCache> _clipCache; // nullptr when ClipCacheBudgetMB is 0
+	std::string _loadingCacheKey;
+	FileStat _loadingStat;
+	bool _loadingCacheable = false;
 	std::vector<std::string> _mocapFiles;
+	std::unique_ptr<IDirectoryWatch> _folderWatch; // nullptr if the folder can't be watched, the list is then fixed at startup
+	std::vector<std::string> _changedClips; // reported by _folderWatch, waiting for the next index update
+	bool _rescanNeeded = false;
+	std::map<std::string, std::shared_ptr<ArchiveFile>> _archives; // keyed by .DAT file name, entries listed as NAME.DAT:index
 	std::string _loadedFile;
+
+	// clip metadata for the browser, read from the index file at startup and then brought up to date on a worker
+	std::shared_ptr<const MocapLibraryIndex> _index;
+	std::future<std::shared_ptr<const MocapLibraryIndex>> _pendingIndex;
+	// every frame of the folder for finding similar poses, kept up to date alongside _index
+	std::shared_ptr<const MocapPoseIndex> _poseIndex;
+	std::future<std::shared_ptr<const MocapPoseIndex>> _pendingPoseIndex;
+	struct BrowserRow {
+		size_t file; // into _mocapFiles
+		const MocapClipMetadata* metadata; // into _index, nullptr for clips it doesn't cover
+	};
+	std::vector<BrowserRow> _browserRows; // _mocapFiles filtered and sorted for the browser
+	bool _browserDirty = true;
+	char _nameFilter[128] = "";
+	float _minSeconds = 0.0f;
+	float _maxSeconds = 0.0f; // 0 for no limit
+	float _maxJointSpeed = 0.0f; // 0 for no limit
+	int _sortColumn = 0;
+	bool _sortDescending = false;
 	ToolMode _mode = ToolModePlay;
 	bool _paused = false;
+	double _fps = MocapDefaultFps;
+	MocapInterpolation _interpolation = MocapInterpolation::Linear;
+	double _crossfadeSeconds = 0.3; // when switching clips in the browser
+	std::unique_ptr<MocapCrowd> _crowd; // built the first time crowd mode is turned on
+	bool _crowdMode = false;
+	int _crowdPlayers;
+	float _crowdKeyTolerance; // when the crowd plays from keys
+	std::unique_ptr<MocapMotionGraph> _motionGraph; // loaded the first time walking is turned on
+	std::future<std::unique_ptr<MocapMotionGraph>> _pendingMotionGraph; // loading or building on a worker, nullptr if neither worked
+	bool _graphWalk = false;
+	std::string _graphTarget; // a transition's clip, loading through LoadFile when there's no library
+	u32 _graphTargetFrames = 0; // what the graph expects _graphTarget to have
+	int _graphWalkFrame = -1; // the frame transitions were last looked for on
+	u32 _graphWalkRng = 1;
+	std::vector<PoseMatch> _similarPoses; // into _poseIndex's clips
+	int _similarCount = 8;
+	bool _similarLive = false; // search again whenever the frame changes
+	int _similarFrame = -1;    // the frame last searched from
+	double _similarQueryMs = 0.0;
+	std::string _seekFileName; // a similar pose in another clip, started from _seekFrame once it loads
+	int _seekFrame = 0;
+	TimeWarpAlignment _alignment; // of _alignedFile against _alignedWith, stale once another clip is loaded
+	std::string _alignedFile;
+	std::string _alignedWith;
+	char _alignName[128] = "";
+	int _alignBand = TimeWarpDefaultBand;
+	double _alignMs = 0.0;
+	// every clip in the folder for finding the closest take, built the first time it's asked for
+	struct AlignCandidates {
+		std::vector<std::string> names;
+		std::vector<TimeWarpClip> clips;
+	};
+	std::shared_ptr<const AlignCandidates> _alignCandidates; // nullptr until built, dropped when the folder changes
+	int _alignCandidatesVersion = 0; // bumped when they're dropped, so a search already running doesn't put them back
+	struct ClosestAlignment {
+		std::shared_ptr<const AlignCandidates> candidates;
+		int candidatesVersion;
+		std::string file; // _loadedFile when the search started
+		std::string with; // empty if nothing could be aligned
+		TimeWarpAlignment alignment;
+		double ms;
+	};
+	std::future<ClosestAlignment> _pendingAlignment; // loading every clip can take seconds, it runs on a worker
+	MocapLoadOptions _loadOptions;
 };
 
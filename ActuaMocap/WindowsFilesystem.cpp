@@ -1,3 +1,4 @@
+#ifdef _WIN32
 #include "WindowsFilesystem.h"
 #include <windows.h>
 #include <tchar.h> 
@@ -5,41 +6,191 @@
 #include <strsafe.h>
 #include <atlstr.h>
 #include <iostream>
+#include "ThreadPool.h"
+#include "FileReads.h"
 
 #pragma comment(lib, "User32.lib")
 
-std::vector<std::string> list_directory(const std::string& directory)
+static i64 FileTimeToInt(const FILETIME& time)
+{
+	return (i64)(((u64)time.dwHighDateTime << 32) | time.dwLowDateTime);
+}
+
+// FindFirstFileEx hands back size and write time with each name, so no separate stat is needed
+static bool ReadDirectory(const std::string& directory, const std::string& prefix, std::vector<DirectoryEntry>& out)
 {
 	WIN32_FIND_DATAA findData;
-	HANDLE hFind = INVALID_HANDLE_VALUE;
 	std::string full_path = directory + "\\*";
-	std::vector<std::string> dir_list;
-
-	hFind = FindFirstFileA(full_path.c_str(), &findData);
+	HANDLE hFind = FindFirstFileExA(full_path.c_str(), FindExInfoBasic, &findData, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	do {
+		if (strcmp(findData.cFileName, ".") == 0 || strcmp(findData.cFileName, "..") == 0) {
+			continue;
+		}
+		DirectoryEntry entry;
+		entry.name = prefix + findData.cFileName;
+		entry.isDirectory = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+		entry.stat.size = ((u64)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+		entry.stat.modifiedTime = FileTimeToInt(findData.ftLastWriteTime);
+		out.push_back(entry);
+	} while (FindNextFileA(hFind, &findData) != 0);
+	FindClose(hFind);
+	return true;
+}
 
-	if (hFind == INVALID_HANDLE_VALUE)
+std::vector<std::string> WindowsFilesystem::ListFilesInDirectory(std::string dir) const
+{
+	std::vector<DirectoryEntry> entries;
+	if (!ReadDirectory(dir, "", entries)) {
 		throw std::runtime_error("Invalid handle value! Please check your path...");
+	}
+	std::vector<std::string> names;
+	names.reserve(entries.size());
+	for (auto& entry : entries) {
+		names.push_back(std::move(entry.name));
+	}
+	return names;
+}
 
-	while (FindNextFileA(hFind, &findData) != 0)
-	{
-		dir_list.push_back(std::string(findData.cFileName));
+u32 WindowsFilesystem::GetMaxFilepathLength() const
+{
+	return MAX_PATH;
+}
+
+bool WindowsFilesystem::GetFileStat(const std::string& path, FileStat& out) const
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) {
+		return false;
 	}
+	out.size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	out.modifiedTime = FileTimeToInt(data.ftLastWriteTime);
+	return true;
+}
 
-	FindClose(hFind);
+bool WindowsFilesystem::MoveFileReplacing(const std::string& from, const std::string& to) const
+{
+	// fails while something has the destination mapped
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
 
-	return dir_list;
+std::vector<DirectoryEntry> WindowsFilesystem::ListDirectoryEntries(const std::string& dir, bool recursive) const
+{
+	std::vector<DirectoryEntry> entries;
+	// breadth first, reading every directory of a level at once
+	std::vector<std::string> level = { "" };
+	while (!level.empty()) {
+		std::vector<std::vector<DirectoryEntry>> found(level.size());
+		GetIoThreadPool().ParallelFor(level.size(), [&](size_t i) {
+			std::string prefix = level[i].empty() ? "" : level[i] + PathSeparator;
+			ReadDirectory(JoinPath(dir, level[i]), prefix, found[i]);
+		});
+		std::vector<std::string> nextLevel;
+		for (auto& directoryEntries : found) {
+			for (auto& entry : directoryEntries) {
+				if (recursive && entry.isDirectory) {
+					nextLevel.push_back(entry.name);
+				}
+				entries.push_back(std::move(entry));
+			}
+		}
+		level = std::move(nextLevel);
+	}
+	return entries;
 }
 
-std::vector<std::string> WindowsFilesystem::ListFilesInDirectory(std::string dir) const
+#define WatchBufferSize (64 * 1024)
+
+class WindowsDirectoryWatch
+: public IDirectoryWatch {
+public:
+	WindowsDirectoryWatch(HANDLE directory)
+		:_directory(directory),
+		_buffer(WatchBufferSize / sizeof(DWORD))
+	{
+		memset(&_overlapped, 0, sizeof(_overlapped));
+		_overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	}
+	~WindowsDirectoryWatch()
+	{
+		CancelIo(_directory);
+		DWORD bytes;
+		GetOverlappedResult(_directory, &_overlapped, &bytes, TRUE);
+		CloseHandle(_overlapped.hEvent);
+		CloseHandle(_directory);
+	}
+	bool Start()
+	{
+		ResetEvent(_overlapped.hEvent);
+		return ReadDirectoryChangesW(_directory, _buffer.data(), WatchBufferSize, FALSE,
+			FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+			NULL, &_overlapped, NULL) != 0;
+	}
+	virtual void Poll(std::vector<FileChange>& out) override
+	{
+		DWORD bytes = 0;
+		if (!GetOverlappedResult(_directory, &_overlapped, &bytes, FALSE)) {
+			return; // ERROR_IO_INCOMPLETE, nothing yet
+		}
+		if (bytes == 0) {
+			// the buffer overflowed and the changes were thrown away
+			out.push_back({ FileChangeType::Overflow, "" });
+		}
+		const u8* at = (const u8*)_buffer.data();
+		while (bytes > 0) {
+			const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)at;
+			char name[MAX_PATH * 4];
+			int length = WideCharToMultiByte(CP_ACP, 0, info->FileName, info->FileNameLength / sizeof(WCHAR), name, sizeof(name), NULL, NULL);
+			std::string fileName(name, length > 0 ? length : 0);
+			switch (info->Action) {
+			case FILE_ACTION_ADDED:
+			case FILE_ACTION_RENAMED_NEW_NAME:
+				out.push_back({ FileChangeType::Added, fileName });
+				break;
+			case FILE_ACTION_MODIFIED:
+				out.push_back({ FileChangeType::Modified, fileName });
+				break;
+			case FILE_ACTION_REMOVED:
+			case FILE_ACTION_RENAMED_OLD_NAME:
+				out.push_back({ FileChangeType::Removed, fileName });
+				break;
+			}
+			if (info->NextEntryOffset == 0) {
+				break;
+			}
+			at += info->NextEntryOffset;
+		}
+		if (!Start()) {
+			out.push_back({ FileChangeType::Overflow, "" });
+		}
+	}
+private:
+	HANDLE _directory;
+	OVERLAPPED _overlapped;
+	std::vector<DWORD> _buffer; // change records have to be DWORD aligned
+};
+
+std::unique_ptr<IDirectoryWatch> WindowsFilesystem::WatchDirectory(const std::string& dir) const
 {
-	auto v = list_directory(dir);
-	for (const auto& s : v) {
-		std::cout << s << "\n";
+	HANDLE directory = CreateFileA(dir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+	if (directory == INVALID_HANDLE_VALUE) {
+		std::cout << "couldn't watch " << dir << "\n";
+		return nullptr;
+	}
+	std::unique_ptr<WindowsDirectoryWatch> watch(new WindowsDirectoryWatch(directory));
+	if (!watch->Start()) {
+		std::cout << "couldn't watch " << dir << "\n";
+		return nullptr;
 	}
-	return v;
+	return std::move(watch);
 }
 
-u32 WindowsFilesystem::GetMaxFilepathLength() const
+void WindowsFilesystem::ReadFiles(std::vector<FileRead>& reads, const FileReadCallback& onComplete) const
 {
-	return MAX_PATH;
+	ReadFilesOnThreadPool(reads, onComplete);
 }
+
+#endif
@@ -7,4 +7,9 @@ class WindowsFilesystem
 public:
 	virtual std::vector<std::string> ListFilesInDirectory(std::string dir) const override;
 	virtual u32 GetMaxFilepathLength() const override;
+	virtual bool GetFileStat(const std::string& path, FileStat& out) const override;
+	virtual bool MoveFileReplacing(const std::string& from, const std::string& to) const override;
+	virtual std::vector<DirectoryEntry> ListDirectoryEntries(const std::string& dir, bool recursive = false) const override;
+	virtual std::unique_ptr<IDirectoryWatch> WatchDirectory(const std::string& dir) const override;
+	virtual void ReadFiles(std::vector<FileRead>& reads, const FileReadCallback& onComplete = FileReadCallback()) const override;
 };
\ No newline at end of file